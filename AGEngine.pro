@@ -16,7 +16,24 @@ HEADERS       = ./headers/glwidget.h \
 				./headers/ssowindow.h \
 				./headers/ssowidget.h \
 				./headers/raytracingwindow.h \
-				./headers/sphere.h
+				./headers/sphere.h \
+				./headers/spheresoa.h \
+				./headers/raytracer.h \
+				./headers/glresourcecache.h \
+				./headers/shaderlibrary.h \
+				./headers/asynctextureloader.h \
+				./headers/texturecompressor.h \
+				./headers/frustum.h \
+				./headers/lightgrid.h \
+				./headers/hizbuffer.h \
+				./headers/framecapture.h \
+				./headers/meshoptimizer.h \
+				./headers/vertexquantizer.h \
+				./headers/uniformring.h \
+				./headers/benchmark.h \
+				./headers/ssaorenderer.h \
+				./headers/triplebuffer.h \
+				./headers/renderthread.h
 
 SOURCES       = ./sources/glwidget.cpp \
                 ./sources/main.cpp \
@@ -35,9 +52,24 @@ SOURCES       = ./sources/glwidget.cpp \
 				./sources/normalmapwindow.cpp \
 				./sources/ssowindow.cpp \
 				./sources/ssowidget.cpp \
-				./sources/raytracingwindow.cpp
+				./sources/raytracingwindow.cpp \
+				./sources/raytracer.cpp \
+				./sources/glresourcecache.cpp \
+				./sources/shaderlibrary.cpp \
+				./sources/asynctextureloader.cpp \
+				./sources/texturecompressor.cpp \
+				./sources/frustum.cpp \
+				./sources/lightgrid.cpp \
+				./sources/hizbuffer.cpp \
+				./sources/framecapture.cpp \
+				./sources/meshoptimizer.cpp \
+				./sources/vertexquantizer.cpp \
+				./sources/uniformring.cpp \
+				./sources/benchmark.cpp \
+				./sources/ssaorenderer.cpp \
+				./sources/renderthread.cpp
 
-QT           += widgets
+QT           += widgets concurrent
 FORMS		 = ./forms/basicwindow.ui \
 			   ./forms/phongwindow.ui \
 			   ./forms/texturingwindow.ui \
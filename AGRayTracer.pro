@@ -0,0 +1,17 @@
+# Headless ray tracer: renders scene files without a display
+TARGET        = AGRayTracer
+
+HEADERS       = ./headers/definitions.h \
+				./headers/sphere.h \
+				./headers/spheresoa.h \
+				./headers/raytracer.h
+
+SOURCES       = ./sources/raytracer.cpp \
+				./sources/raytracecli.cpp
+
+QT            = core gui
+CONFIG       += console c++11
+CONFIG       -= app_bundle
+INCLUDEPATH  += ./glm \
+				./headers \
+				./sources
@@ -0,0 +1,37 @@
+# Headless SSAO renderer: renders a model to an image on an offscreen surface
+TARGET        = AGSSAORender
+
+HEADERS       = ./headers/definitions.h \
+				./headers/Camera.h \
+				./headers/model.h \
+				./headers/meshoptimizer.h \
+				./headers/vertexquantizer.h \
+				./headers/frustum.h \
+				./headers/lightgrid.h \
+				./headers/hizbuffer.h \
+				./headers/glresourcecache.h \
+				./headers/shaderlibrary.h \
+				./headers/uniformring.h \
+				./headers/benchmark.h \
+				./headers/ssaorenderer.h
+
+SOURCES       = ./sources/Camera.cpp \
+				./sources/model.cpp \
+				./sources/meshoptimizer.cpp \
+				./sources/vertexquantizer.cpp \
+				./sources/frustum.cpp \
+				./sources/lightgrid.cpp \
+				./sources/hizbuffer.cpp \
+				./sources/glresourcecache.cpp \
+				./sources/shaderlibrary.cpp \
+				./sources/uniformring.cpp \
+				./sources/benchmark.cpp \
+				./sources/ssaorenderer.cpp \
+				./sources/ssaorendercli.cpp
+
+QT            = core gui widgets
+CONFIG       += console c++11
+CONFIG       -= app_bundle
+INCLUDEPATH  += ./glm \
+				./headers \
+				./sources
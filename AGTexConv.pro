@@ -0,0 +1,13 @@
+# Texture converter: compresses images into KTX files with BC1/BC3/BC5 mipmaps
+TARGET        = AGTexConv
+
+HEADERS       = ./headers/texturecompressor.h
+
+SOURCES       = ./sources/texturecompressor.cpp \
+				./sources/texconvcli.cpp
+
+QT            = core gui
+CONFIG       += console c++11
+CONFIG       -= app_bundle
+INCLUDEPATH  += ./headers \
+				./sources
@@ -14,6 +14,14 @@
 
 enum MovementType { FORWARD, BACKWARD, STRAFE_RIGHT, STRAFE_LEFT };
 
+// What Move, Rotate, Pan and the zoom change, to record and replay paths
+struct CameraState {
+	glm::vec3 position;
+	float xRot, yRot;
+	float xPan, yPan;
+	float fov;
+};
+
 class Camera
 {
 public:
@@ -37,6 +45,10 @@ public:
 	const glm::mat4 GetProj() const;
 	const glm::mat4 GetView() const;
 	const int GetType() const;
+	float GetFov() const; // Vertical, in radians
+
+	CameraState GetState() const;
+	void SetState(const CameraState &state);
 
 private:
 
@@ -0,0 +1,109 @@
+#ifndef ASYNCTEXTURELOADER_H
+#define ASYNCTEXTURELOADER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLWidget>
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <QTimer>
+
+#include "texturecompressor.h"
+
+#define TEX_UPLOAD_SLOTS 3 // Slices of the pixel buffer in flight
+#define TEX_UPLOAD_SLOT_SIZE (512 * 1024) // Bytes of one slice
+#define TEX_UPLOAD_SLICES_PER_STEP 2 // Slices copied on each event loop pass
+
+// Loads textures for a GL widget without blocking its thread. Images are
+// decoded on the global QThreadPool, then streamed into a new texture through
+// a ring of pixel buffer slices, a few of them on each pass of the event loop.
+// The ring is persistently mapped when the driver has ARB_buffer_storage, and
+// mapped slice by slice otherwise. Fences tell when a slice can be reused and
+// when the texture, with its mipmaps, is complete: only then textureReady() is
+// emitted, so the texture already bound keeps being used until that moment.
+// A KTX file next to the image (see AGTexConv) is loaded instead of it, unless
+// it is older: its compressed mip chain is uploaded as is.
+class AsyncTextureLoader : public QObject, protected QOpenGLFunctions_3_3_Core
+{
+	Q_OBJECT
+
+public:
+	AsyncTextureLoader(QOpenGLWidget *widget);
+	~AsyncTextureLoader();
+
+	// Called from the widget's initializeGL and cleanup (context current)
+	void initializeGL();
+	void cleanup();
+
+	// Starts loading filename for slot. A pending load of the same slot is
+	// discarded.
+	void load(int slot, const QString &filename);
+	void cancel(int slot);
+
+signals:
+	// The image was decoded (mirrored for GL, in RGBA8888)
+	void imageDecoded(int slot, const QImage &image);
+	// The texture is complete on the GPU. The receiver owns it. normalXY tells
+	// that it only has the X and Y of a normal map (BC5), Z must be rebuilt.
+	void textureReady(int slot, GLuint texture, bool normalXY);
+
+private slots:
+	void decodeFinished();
+	void uploadStep();
+
+private:
+	// Result of the worker threads
+	struct DecodedTexture {
+		QImage image; // the first level of compressed, if any
+		CompressedTexture compressed;
+	};
+
+	struct UploadJob {
+		int slot;
+		QString filename;
+		QImage image;
+		CompressedTexture compressed;
+		GLuint texture;
+		int nextRow;
+		GLsync done; // fence after the mipmaps, 0 while rows are left
+		qint64 requestTime;
+		qint64 decodeTime;
+	};
+
+	static DecodedTexture decodeTexture(const QString &filename, const QString &ktxFilename);
+	void uploadCompressed(UploadJob &job);
+
+	void createPixelBuffer(int slotSize);
+	void deletePixelBuffer();
+	bool uploadSlice(UploadJob &job);
+	void dropJob(int index);
+
+	QOpenGLWidget* m_widget;
+	bool m_initialized;
+
+	// Decoding
+	QHash<int, QFutureWatcher<DecodedTexture>*> m_decoding;
+	QHash<int, QString> m_decodingFiles;
+	QHash<int, qint64> m_requestTimes;
+	QElapsedTimer m_clock;
+
+	// Uploads
+	QList<UploadJob> m_jobs;
+	QTimer m_uploadTimer;
+	bool m_s3tcSupported;
+
+	// Pixel buffer ring
+	typedef void (QOPENGLF_APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+	BufferStorageProc m_bufferStorage;
+	GLuint m_pbo;
+	int m_slotSize;
+	uchar* m_persistentPtr;
+	GLsync m_slotFences[TEX_UPLOAD_SLOTS];
+	int m_nextSlot;
+};
+
+#endif
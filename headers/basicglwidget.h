@@ -18,6 +18,7 @@
 #include "../glm/glm.hpp"
 #include "../glm/gtc/matrix_transform.hpp"
 #include "definitions.h"
+#include "shaderlibrary.h"
 
 
 class BasicGLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
@@ -51,7 +52,8 @@ protected:
 
 private:
     // Shaders
-	void loadShaders();
+	bool loadShaders();
+	void reloadShaders();
 
 	// Camera
 	void projectionTransform(); // Type of camera
@@ -0,0 +1,62 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+
+#define BENCHMARK_FRAMES 600 // Frames rendered by default
+#define BENCHMARK_WARMUP_FRAMES 10 // First frames left out of the statistics
+#define BENCHMARK_QUERY_FRAMES 4 // Frames of GPU timer queries in flight
+#define CAMERA_PATH_RATE 30 // Keys per second while recording
+#define CAMERA_PATH_FILE "./camera.path" // Written when a recording stops
+
+// Camera of one instant of a recording, with the rotation the widget applies
+// to the model (mouse drags with the default camera)
+struct CameraKey {
+	double time; // seconds from the start of the recording
+	CameraState camera;
+	float modelXRot, modelYRot;
+};
+
+// Recorded camera path, replayed at any number of frames by sampling it at
+// even times, so every run renders the same views.
+class CameraPath
+{
+public:
+	CameraPath();
+
+	void clear();
+	void addKey(const CameraKey &key);
+	bool empty() const { return m_keys.empty(); }
+	double duration() const;
+
+	// Linear interpolation between the keys around time (seconds from the
+	// first key)
+	CameraKey sample(double time) const;
+
+	// Text file: the model and camera type, then one key per line
+	bool save(const std::string &filename) const;
+	bool load(const std::string &filename);
+
+	std::string model; // recorded with this model
+	int cameraType;
+
+private:
+	std::vector<CameraKey> m_keys;
+};
+
+// Times of one measure, one per frame (ms)
+struct TimingSeries {
+	std::string name;
+	std::vector<double> ms;
+};
+
+// p in [0, 1], nearest rank of the sorted values
+double percentile(std::vector<double> values, double p);
+
+// One row per series: frames, mean, p50, p90, p95, p99 and max
+bool writeTimingCSV(const std::string &filename, const std::vector<TimingSeries> &series);
+
+#endif
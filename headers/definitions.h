@@ -6,7 +6,18 @@
 /* Definition of constants */
 #define PI 3.14159f
 //#define INFINITY 1e8
-#define MAX_RAY_DEPTH 4
+#define MAX_RAY_DEPTH 16 // Safety cap only, paths are ended by Russian roulette
+#define RR_MIN_DEPTH 3 // Depth from which Russian roulette may end a path
+#define RAY_STACK_SIZE (MAX_RAY_DEPTH + 2) // At most one pending sibling per depth plus two children
+#define MAX_SHADOW_LIGHTS 8 // Above this, shading samples this many lights instead of all
+#define LOD_PIXEL_ERROR 1.0f // Simplification error allowed on screen (pixels) when picking a LOD
+#define OPTIMIZE_MODEL_INDICES 1 // Reorder the index buffers of the models for the vertex cache and overdraw
+#define QUANTIZE_VERTICES 1 // Upload the model vertices with 16-bit positions, octahedral normals and half float texture coordinates
+#define LIGHT_TILE_SIZE 16 // Pixels of the side of a screen tile of the deferred light pass
+#define LIGHT_RADIUS 0.5f // Range of the stress test lights, in model radii
+#define HIZ_TEXEL_SIZE 8 // Pixels of the side of a texel of the depth read back for the occlusion culling
+#define AA_EDGE_THRESHOLD 0.125f // Luma contrast of an edge for the post-process anti-aliasing, halved at high quality
+#define AA_SEARCH_STEPS 8 // Steps taken along an edge by the post-process anti-aliasing, doubled at high quality
 
 
 
@@ -0,0 +1,90 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include <qopenglframebufferobject.h>
+
+#include <fstream>
+#include <vector>
+
+#define CAPTURE_PBO_COUNT 3 // Frames being read back at once (ring of pixel buffers)
+#define CAPTURE_QUEUE_FRAMES 8 // Frames waiting for the writer before capture() waits for it
+#define CAPTURE_FPS 30 // Frame rate written in the Y4M header
+#define CAPTURE_DEFAULT_PATH "./capture" // Directory of the PNG sequence of the G key
+
+// Records the frames of a GL widget without waiting for the GPU. Each frame
+// is copied into the next pixel buffer of a ring (glReadPixels into a buffer
+// returns at once) and fenced. It is only mapped when the ring comes back to
+// that buffer, CAPTURE_PBO_COUNT frames later, and handed to the thread of
+// the FrameCapture, which encodes it: a PNG sequence, or raw Y4M video.
+// No frame is dropped: if the writer falls behind, capture() waits for it.
+// startCapture, capture and stopCapture need the context of the widget current.
+class FrameCapture : public QThread, protected QOpenGLFunctions_3_3_Core
+{
+public:
+	enum Format { PNG_SEQUENCE, Y4M };
+
+	FrameCapture();
+	~FrameCapture();
+
+	// A path ending in .y4m is written as one Y4M file (4:4:4, full range),
+	// any other one is the directory of the PNG files (frame_000000.png)
+	bool startCapture(const QString &path);
+	// The frames still in the ring are written, then the writer is waited for
+	void stopCapture();
+	bool isCapturing() const { return m_capturing; }
+
+	// Queues the read back of the width x height color buffer of framebuffer,
+	// resolved first if it is multisampled
+	void capture(GLuint framebuffer, int width, int height);
+
+protected:
+	void run() override; // the writer
+
+private:
+	struct Frame {
+		int index;
+		int width, height;
+		std::vector<uchar> pixels; // RGBA, rows from the bottom
+	};
+
+	void readSlot(int slot);
+	void queueFrame(Frame &frame);
+	void writeFrame(const Frame &frame);
+	void writeY4M(const Frame &frame);
+
+	QString m_path;
+	Format m_format;
+	bool m_capturing;
+
+	// Pixel buffer ring
+	GLuint m_pbos[CAPTURE_PBO_COUNT];
+	GLsync m_fences[CAPTURE_PBO_COUNT];
+	size_t m_pboSizes[CAPTURE_PBO_COUNT];
+	Frame m_slots[CAPTURE_PBO_COUNT]; // size and index of the pending frames
+	int m_nextSlot;
+	int m_frames;
+	QOpenGLFramebufferObject* m_resolve; // of multisampled framebuffers
+
+	// Frames for the writer
+	QMutex m_mutex;
+	QWaitCondition m_queued;
+	QWaitCondition m_dequeued;
+	QQueue<Frame> m_queue;
+	bool m_finish;
+	int m_waits; // frames that waited for the writer
+
+	// Writer thread only
+	std::ofstream m_video;
+	int m_videoWidth, m_videoHeight; // of the first frame, in the Y4M header
+	std::vector<uchar> m_planes;
+	int m_written;
+	int m_skipped;
+};
+
+#endif
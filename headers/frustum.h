@@ -0,0 +1,34 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+
+#include "../glm/glm.hpp"
+#include "model.h"
+
+// Planes of a view frustum, extracted from a clip matrix (Gribb and Hartmann).
+// Built from proj * view * model, the planes are in model coordinates, so the
+// bounds of the submeshes are tested as they are stored.
+class Frustum
+{
+public:
+	Frustum();
+	Frustum(const glm::mat4 &clip);
+
+	void setMatrix(const glm::mat4 &clip);
+
+	// Conservative tests: false only if the volume is fully outside a plane
+	bool sphereVisible(const glm::vec3 &center, float radius) const;
+	bool boxVisible(const glm::vec3 &bboxMin, const glm::vec3 &bboxMax) const;
+	bool subMeshVisible(const SubMesh &subMesh) const;
+
+	// Index ranges (first, count) of the visible submeshes for
+	// glMultiDrawElements, consecutive ones are merged. Returns the number of
+	// visible submeshes.
+	int visibleRanges(const std::vector<SubMesh> &subMeshes, std::vector<int> &first, std::vector<int> &count) const;
+
+private:
+	glm::vec4 m_planes[6]; // left, right, bottom, top, near, far (inwards)
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef GLRESOURCECACHE_H
+#define GLRESOURCECACHE_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QSize>
+#include <QString>
+#include <QOpenGLContext>
+#include <qopenglframebufferobject.h>
+
+#include "model.h"
+
+// Vertex buffers of a loaded model. They are shared by every context, the VAO
+// that points to them must still be created by each widget.
+// If quantized (see Model::quantizeVertices) the positions are unsigned short
+// xyzw, w being the box in the boxTexture buffer texture, the normals
+// octahedral short pairs, the tangents octahedral shorts with the handedness
+// in z, the materials unsigned byte rgba and the shininess and the texture
+// coordinates half floats.
+struct GLMesh {
+	Model* model;
+	bool quantized;
+	GLuint vboVerts, vboNorms;
+	GLuint vboTexCoords; // 0 if the model has no texture coordinates
+	GLuint vboTangents; // xyz and handedness, 0 without texture coordinates
+	GLuint vboMatAmb, vboMatDiff, vboMatSpec, vboMatShin;
+	GLuint boxBuffer, boxTexture; // 0 if not quantized
+	GLuint ibo; // the VAO of each widget must bind it too
+	int numVertices;
+	int numIndices; // of every LOD level (see Model::lods)
+};
+
+// GL objects kept alive across widget recreation. All the widget contexts
+// share objects (Qt::AA_ShareOpenGLContexts), so textures and buffers are
+// created once and found again by their file names or keys. Programs are
+// built by the ShaderLibrary: they hold per-widget uniforms.
+// Container objects (VAOs, FBOs) cannot be shared: framebuffers are cached
+// per context and released with releaseFramebuffers().
+// Every call needs a current context, of any thread. The cached objects live
+// as long as the share group.
+class GLResourceCache
+{
+public:
+	static GLResourceCache& instance();
+
+	// Textures and buffers built by the caller (0 if not found)
+	GLuint texture(const QString &key) const;
+	void addTexture(const QString &key, GLuint id);
+	GLuint buffer(const QString &key) const;
+	void addBuffer(const QString &key, GLuint id);
+
+	// OBJ model with its vertex buffers, loaded and uploaded on the first call
+	// (with loadModel).
+	GLMesh* mesh(const QString &filename);
+
+	// Loads an OBJ model with its indices optimized (no GL calls). It is kept
+	// in a binary file (.agmesh) under the cache location, read by the next
+	// loads until the OBJ, its MTL files or the build change. false if empty.
+	static bool loadModel(Model &model, const QString &filename);
+
+	// Framebuffer of the current context with colorAttachments color textures
+	// of internalFormat and a depth/stencil buffer. It is rebuilt if the size,
+	// the format or the number of attachments changed.
+	QOpenGLFramebufferObject* framebuffer(const QString &key, const QSize &size, int colorAttachments, GLenum internalFormat = GL_RGBA8);
+	void releaseFramebuffers(QOpenGLContext *context);
+
+private:
+	GLResourceCache() {}
+	GLResourceCache(const GLResourceCache&);
+	GLResourceCache& operator=(const GLResourceCache&);
+
+	mutable QMutex m_mutex; // the SSOWidget may render in its own thread
+
+	QHash<QString, GLuint> m_textures;
+	QHash<QString, GLuint> m_buffers;
+	QHash<QString, GLMesh*> m_meshes;
+	QMap<QPair<QOpenGLContext*, QString>, QOpenGLFramebufferObject*> m_framebuffers;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef HIZBUFFER_H
+#define HIZBUFFER_H
+
+#include <vector>
+
+#include "../glm/glm.hpp"
+
+// Pyramid of the farthest depth of a low resolution copy of the depth buffer,
+// for the occlusion culling. Every level halves the previous one, so a box is
+// tested against at most 2x2 texels of the level that matches its screen
+// size. The depths are the ones of the window ([0, 1], 1 is the background).
+class HiZBuffer
+{
+public:
+	HiZBuffer();
+
+	// depth: width x height texels, rows from the bottom, each one the farthest
+	// depth of a square of texelSize pixels of a screen of screenWidth x
+	// screenHeight pixels
+	void build(const std::vector<float> &depth, int width, int height, int texelSize, int screenWidth, int screenHeight);
+	bool empty() const { return m_levels.empty(); }
+	int levelCount() const { return (int)m_levels.size(); }
+
+	// Conservative test of a box through the clip matrix proj * view * model:
+	// false only if it is behind the depth of every pixel that it covers
+	bool boxVisible(const glm::mat4 &clip, const glm::vec3 &bboxMin, const glm::vec3 &bboxMax) const;
+
+private:
+	std::vector<std::vector<float> > m_levels;
+	std::vector<glm::ivec2> m_sizes;
+	int m_texelSize;
+	int m_screenWidth, m_screenHeight;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+
+#include <vector>
+
+#include "../glm/glm.hpp"
+
+// Point light of the deferred light pass
+struct PointLight {
+	glm::vec3 position;
+	float radius; // no light beyond it, 0 for no attenuation (the headlight)
+	glm::vec3 color;
+};
+
+// Screen tiles of LIGHT_TILE_SIZE pixels with the lights that can reach them,
+// so a pixel of the light pass only evaluates the lights of its tile. Built on
+// the CPU from the screen rectangle of every light sphere, each time the
+// camera or the lights change.
+class LightGrid
+{
+public:
+	LightGrid();
+
+	// lights in view coordinates
+	void build(const std::vector<PointLight> &lights, const glm::mat4 &projection, int width, int height);
+
+	int tilesX() const { return m_tilesX; }
+	int tilesY() const { return m_tilesY; }
+
+	// First index in indices() and number of lights of every tile, row by row
+	// from the bottom left one
+	const std::vector<unsigned int>& tiles() const { return m_tiles; }
+	const std::vector<unsigned int>& indices() const { return m_indices; }
+
+	// Statistics of the last build
+	float averageLights() const;
+	int maxLights() const { return m_maxLights; }
+
+private:
+	// Tiles [x0, x1) x [y0, y1) covered by the light, false if none
+	bool tileRect(const PointLight &light, const glm::mat4 &projection, int width, int height, glm::ivec4 &rect) const;
+
+	int m_tilesX, m_tilesY;
+	std::vector<unsigned int> m_tiles;
+	std::vector<unsigned int> m_indices;
+	std::vector<glm::ivec4> m_rects; // of every light, to fill the tiles
+	int m_maxLights;
+};
+
+#endif
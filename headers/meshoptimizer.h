@@ -0,0 +1,32 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+
+#define VERTEX_CACHE_SIZE 32 // Entries of the cache modelled by the triangle ordering
+#define VERTEX_CACHE_FIFO 16 // FIFO size used to report ACMR / ATVR
+
+// Reordering of indexed triangle lists for the GPU: triangles for the
+// post-transform vertex cache (Forsyth's linear-speed optimization), clusters
+// of them to reduce overdraw (as in Tipsify), and vertices in the order they
+// are fetched. Every function works on one range of an index buffer, so the
+// submeshes of a model keep their own ranges.
+class MeshOptimizer {
+public:
+	static void optimizeVertexCache(unsigned int *indices, int indexCount, int vertexCount);
+
+	// Splits the range where the cache starts cold and sorts those clusters so
+	// that the outer ones facing outwards are drawn first. positions has 3
+	// floats per vertex.
+	static void optimizeOverdraw(unsigned int *indices, int indexCount, const float *positions, int vertexCount);
+
+	// Renumbers the vertices in order of first use. remap[old] is the new index
+	// (or -1 if unused). Returns the number of vertices used.
+	static int optimizeVertexFetch(unsigned int *indices, int indexCount, int vertexCount, std::vector<int> &remap);
+
+	// Average cache miss ratio (transformed vertices per triangle) and average
+	// transformed vertex ratio (per vertex used, 1 is optimal) of a FIFO cache
+	static void cacheStats(const unsigned int *indices, int indexCount, int vertexCount, int cacheSize, float &acmr, float &atvr);
+};
+
+#endif
@@ -32,28 +32,107 @@ std::vector<Material> Materials
 
 typedef double Vertex;
 typedef double Normal;
+typedef double TexCoord;
 
 struct Face{
   std::vector<int> v;   // Model::load() only generates triangles, though.
   std::vector<int> n;
+  std::vector<int> t;   // empty if the face has no texture coordinates
   int mat;
+  int smooth;           // smoothing group (s line), 0 if off
   double normalC[3];
 };
 
+// Run of consecutive faces of one OBJ object/group with one material. Its
+// bounds are in model coordinates.
+struct SubMesh {
+  std::string name;
+  int firstFace;
+  int faceCount;
+  int mat;
+  float bboxMin[3];
+  float bboxMax[3];
+  float center[3];   // bounding sphere
+  float radius;
+};
+
+// Level of detail. The faces of every level follow each other in the index
+// buffer, level 0 being faces(). The submeshes keep the bounds of level 0
+// (simplification never moves a vertex out of them) with the face ranges of
+// this level in the index buffer.
+struct LODLevel {
+  int firstFace;
+  int faceCount;
+  double error;   // bound of the distance to the original surface
+  std::vector<SubMesh> subMeshes;
+};
+
+#define MODEL_LOD_LEVELS 5       // including the original
+#define MODEL_LOD_MIN_FACES 64   // coarser levels are not built
+#define MODEL_BINARY_VERSION 2   // of the files of saveBinary()
+
 class Model {
  public:
   Model();
   ~Model();
   void load(std::string filename);
+  // Binary copy of everything but faces(): the vertices, the submeshes, the
+  // levels of detail and the VBO arrays, with their tangents and the index
+  // order of optimizeIndices. Reading it skips the parsing and the
+  // generation of the levels and the tangents. The header keeps the
+  // material libraries and a stamp of the caller (of the sources and the
+  // build), so it can tell whether the copy is out of date before reading
+  // it. loadBinary() fails (leaving the model empty) on a file of another
+  // MODEL_BINARY_VERSION or stamp.
+  bool saveBinary(const std::string &filename, const std::string &stamp) const;
+  bool loadBinary(const std::string &filename, const std::string &stamp);
+  static bool readBinaryHeader(const std::string &filename, std::vector<std::string> &materialLibraries, std::string &stamp);
   const std::vector<Vertex>& vertices() const {
     return _vertices;
   }
   const std::vector<Normal>& normals() const {
     return _normals;
   }
+  // Two per vt line (u, v)
+  const std::vector<TexCoord>& texCoords() const {
+    return _texCoords;
+  }
   const std::vector<Face>& faces() const {
     return _faces;
   }
+  // MTL files of the mtllib lines, with the path of the OBJ
+  const std::vector<std::string>& materialLibraries() const {
+    return _materialLibraries;
+  }
+  // Split at every o, g and usemtl line (at least one)
+  const std::vector<SubMesh>& subMeshes() const {
+    return _subMeshes;
+  }
+  // Halving the faces each level, by quadric error edge collapses
+  const std::vector<LODLevel>& lods() const {
+    return _lods;
+  }
+  // Coarsest level whose error is under maxError (in model units)
+  int selectLOD(double maxError) const;
+  // Faces in the index buffer (all the levels)
+  int VBO_faces() const {
+    return _VBO_faces;
+  }
+  // Distinct vertices in the VBO arrays, which 3*VBO_faces() indices refer to
+  int VBO_numVertices() const {
+    return _VBO_numVertices;
+  }
+  // Optional: reorders the triangles of every submesh range for the vertex
+  // cache and overdraw, then the vertices in fetch order (prints ACMR/ATVR).
+  // Only once, the order is kept by saveBinary().
+  void optimizeIndices();
+  // Optional: compressed copies of the VBO arrays (prints their size and
+  // precision): positions in 16 bits inside the box of their submesh, whose
+  // index is the fourth component, octahedral normals in two snorm16, texture
+  // coordinates in half floats, materials in RGBA8 (shininess in a half) and
+  // tangents as octahedral normals with their handedness.
+  // After optimizeIndices, which reorders the float arrays only.
+  void quantizeVertices();
   void dumpStats() const;
   void dumpModel() const;
 
@@ -63,6 +142,15 @@ class Model {
   float *VBO_normals () {
     return _VBO_normals;
   }
+  // NULL if no face has texture coordinates, (0, 0) for the ones without
+  float *VBO_texcoords () {
+    return _VBO_texcoords;
+  }
+  // Tangent frames, 4 per vertex: the tangent and the handedness w of the
+  // bitangent, w cross(normal, tangent). NULL without VBO_texcoords.
+  float *VBO_tangents () {
+    return _VBO_tangents;
+  }
   float *VBO_matamb () {
     return _VBO_matamb;
   }
@@ -75,19 +163,75 @@ class Model {
   float *VBO_matshin () {
     return _VBO_matshin;
   }
+  unsigned int *VBO_indices () {
+    return _VBO_indices;
+  }
+
+  // Arrays of quantizeVertices(), empty until it is called
+  bool VBO_quantized () const {
+    return !_VBO_qpositions.empty();
+  }
+  const unsigned short *VBO_qpositions () const {   // 4 per vertex
+    return _VBO_qpositions.data();
+  }
+  const short *VBO_qnormals () const {              // 2 per vertex
+    return _VBO_qnormals.data();
+  }
+  const unsigned short *VBO_qtexcoords () const {   // 2 per vertex, NULL without VBO_texcoords
+    return _VBO_qtexcoords.empty() ? NULL : _VBO_qtexcoords.data();
+  }
+  const short *VBO_qtangents () const {             // 4 per vertex (2 octahedral, w, 0), NULL without VBO_tangents
+    return _VBO_qtangents.empty() ? NULL : _VBO_qtangents.data();
+  }
+  const unsigned char *VBO_qmatamb () const {       // 4 per vertex
+    return _VBO_qmatamb.data();
+  }
+  const unsigned char *VBO_qmatdiff () const {
+    return _VBO_qmatdiff.data();
+  }
+  const unsigned char *VBO_qmatspec () const {
+    return _VBO_qmatspec.data();
+  }
+  const unsigned short *VBO_qmatshin () const {     // 1 per vertex
+    return _VBO_qmatshin.data();
+  }
+  // Boxes of the quantized positions, one per submesh: min then extent, as
+  // 2 RGBA texels (w unused)
+  const std::vector<float>& VBO_boxes () const {
+    return _VBO_boxes;
+  }
 
  private:
   std::vector<Vertex> _vertices;
   std::vector<Normal> _normals;
+  std::vector<TexCoord> _texCoords;
   std::vector<Face> _faces;
+  std::vector<SubMesh> _subMeshes;
+  std::vector<LODLevel> _lods;
+  std::vector<std::string> _materialLibraries;
+  int _VBO_faces;
+  int _VBO_numVertices;
 
-  float *_VBO_vertices, *_VBO_normals;
+  float *_VBO_vertices, *_VBO_normals, *_VBO_texcoords, *_VBO_tangents;
   float *_VBO_matamb, *_VBO_matdiff, *_VBO_matspec, *_VBO_matshin;
+  unsigned int *_VBO_indices;
+  bool _indicesOptimized;
+
+  std::vector<unsigned short> _VBO_qpositions, _VBO_qtexcoords, _VBO_qmatshin;
+  std::vector<short> _VBO_qnormals, _VBO_qtangents;
+  std::vector<unsigned char> _VBO_qmatamb, _VBO_qmatdiff, _VBO_qmatspec;
+  std::vector<float> _VBO_boxes;
 
   void parseVOnly(std::stringstream & ss, std::string & block);
   void parseVN(std::stringstream & ss, std::string & block);
   void parseVT(std::stringstream & ss, std::string & block);
   void parseVTN(std::stringstream & ss, std::string & block);
+  void startSubMesh(const std::string & name);
+  void computeSubMeshBounds();
+  void buildLODs(std::vector<Face> &lodFaces);
+  void generateNormals();
+  void computeTangents();
+  void releaseVBOs();
 };
 
 #endif // MODEL_H
@@ -12,13 +12,15 @@
 #include <QKeyEvent>
 #include <QMatrix4x4>
 #include <QMouseEvent>
-#include <QOpenGLTexture>
 #include <QTime>
 #include <QWheelEvent>
 
 #include "../glm/glm.hpp"
 #include "../glm/gtc/matrix_transform.hpp"
 #include "../headers/definitions.h"
+#include "../headers/shaderlibrary.h"
+#include "../headers/uniformring.h"
+#include "../headers/asynctextureloader.h"
 
 
 class NormalMapGLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
@@ -42,6 +44,8 @@ public slots:
     void cleanup();
 
 signals:
+	// Image of a texture being loaded (1 or 2), ready before the texture
+	void textureDecoded(int slot, const QImage &image);
 
 protected:
     void initializeGL() override;
@@ -57,7 +61,11 @@ protected:
 
 private:
     // Shaders
-	void loadShaders();
+	bool loadShaders();
+	void reloadShaders();
+
+	// Textures
+	void setTexture(int slot, GLuint texture, bool normalXY);
 
 	// Camera
 	void projectionTransform(); // Type of camera
@@ -108,15 +116,19 @@ private:
 
 	// Shaders
     QOpenGLShaderProgram *m_program;
-	GLuint m_transLoc, m_projLoc, m_viewLoc;
+	FrameUniforms m_frameUniforms; // sent with the blocks of m_uniforms
+	UniformRing m_uniforms;
 	GLuint m_vertexLoc, m_normalLoc, m_colorLoc, m_texCoordsLoc, m_tangentLoc, m_bitangentLoc;
 	GLuint m_tex1LoadedLoc, m_tex2LoadedLoc;
 	GLuint m_tex1TextureLoc, m_tex2TextureLoc;
+	GLuint m_tex1NormalXYLoc, m_tex2NormalXYLoc;
 	GLuint m_lightPosLoc, m_lightColLoc;
 
 	// Textures
-	QOpenGLTexture *m_tex1Tex, *m_tex2Tex;
+	GLuint m_tex1Tex, m_tex2Tex;
 	bool m_tex1Loaded, m_tex2Loaded;
+	bool m_tex1NormalXY, m_tex2NormalXY;
+	AsyncTextureLoader* m_textureLoader;
 	
 };
 
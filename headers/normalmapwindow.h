@@ -1,4 +1,5 @@
 #include <QWidget>
+#include <QImage>
 #include "ui_normalmapwindow.h"
 
 class MainWindow;
@@ -18,6 +19,7 @@ private slots:
 	void deleteTex1();
 	void loadTex2();
 	void deleteTex2();
+	void showTexture(int slot, const QImage &image);
 	
 private:
 
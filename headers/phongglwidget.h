@@ -18,8 +18,13 @@
 #include "../glm/glm.hpp"
 #include "../glm/gtc/matrix_transform.hpp"
 #include "definitions.h"
+#include "shaderlibrary.h"
+#include "uniformring.h"
 #include "model.h"
+#include "glresourcecache.h"
+#include "frustum.h"
 #include "Camera.h"
+#include "framecapture.h"
 
 
 class PhongGLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
@@ -55,7 +60,7 @@ protected:
 
 private:
     // Shaders
-	void loadShaders();
+	bool loadShaders();
 	void reloadShaders();
 
 	// Camera
@@ -71,7 +76,7 @@ private:
 	void createBuffersModel();
 	void cleanBuffersModel();
 	void computeBBoxModel();
-	void modelTransform(); // Position and orientation of the scene
+	glm::mat4 modelTransform(); // Position and orientation of the scene
 	bool m_modelLoaded;
 
 	//Lighting
@@ -105,6 +110,20 @@ private:
 	float m_modelRadius;
 	GLuint m_VAOModel, m_VBOModelVerts, m_VBOModelNorms;
 	GLuint m_VBOModelMatAmb, m_VBOModelMatDiff, m_VBOModelMatSpec, m_VBOModelMatShin;
+	GLuint m_IBOModel;
+	GLuint m_modelBoxBuffer, m_modelBoxTexture; // of the quantized positions
+
+	// Frustum culling of the submeshes
+	bool m_frustumCulling;
+	std::vector<GLint> m_drawFirst;
+	std::vector<GLsizei> m_drawCount;
+	std::vector<const GLvoid*> m_drawOffsets; // m_drawFirst in bytes
+	int m_visibleSubMeshes;
+
+	// Level of detail, from the screen size of the model
+	int selectLOD(const glm::mat4 &model);
+	int m_forcedLOD; // -1 to pick it from the screen size
+	int m_currentLOD;
 
 	// Lights
 	glm::vec4 m_lightPos;
@@ -126,11 +145,16 @@ private:
 
 	// Shaders
     QOpenGLShaderProgram *m_program;
-	GLuint m_transLoc, m_projLoc, m_viewLoc;
+	FrameUniforms m_frameUniforms; // sent with the blocks of m_uniforms
+	UniformRing m_uniforms;
 	GLuint m_vertexLoc, m_normalLoc;
+	GLuint m_quantizedLoc, m_positionBoxesLoc;
 	GLuint m_matAmbLoc, m_matDiffLoc, m_matSpecLoc, m_matShinLoc;
 	GLuint m_lightPosLoc, m_lightColLoc;
 
+	// Capture of the frames (G key)
+	FrameCapture m_capture;
+
 	// FPS
 	//QTime m_time;
 	int m_frameCount;
@@ -0,0 +1,139 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../glm/glm.hpp"
+#include "definitions.h"
+#include "sphere.h"
+#include "spheresoa.h"
+
+// Whitted-style ray tracer over a SphereSoA scene. It does not depend on Qt,
+// so it is shared by the RayTracingWindow and the headless AGRayTracer tool.
+class RayTracer {
+public:
+	RayTracer();
+	~RayTracer();
+
+	// Scene
+	void loadDefaultScene();
+	bool loadScene(std::string filename);
+	const SphereSoA& spheres() const { return m_spheres; }
+
+	// Camera (looks from pos to target with a vertical fov in degrees)
+	void setCamera(const glm::vec3 &pos, const glm::vec3 &target, float fov);
+	void setBackgroundColor(const glm::vec3 &color) { m_bkgColor = color; }
+
+	// Adaptive sampling: every pixel takes at least minSamples and stops once the
+	// relative standard error of its mean falls below threshold (<= 0 disables it)
+	void setAdaptiveSampling(int minSamples, float threshold);
+
+	// Rays are evaluated with an explicit, fixed-capacity ray stack by default.
+	// The recursive version is kept to benchmark against it.
+	void setRecursiveTraversal(bool recursive) { m_recursive = recursive; }
+
+	// Image settings read from the scene file (0 if not given)
+	int sceneWidth() const { return m_sceneWidth; }
+	int sceneHeight() const { return m_sceneHeight; }
+	int sceneSamples() const { return m_sceneSamples; }
+
+	// Renders the scene into image (width * height colors, top row first) with
+	// up to samplesPerPixel samples per pixel. numThreads <= 0 uses all the
+	// hardware threads. The progress callback, if any, is called from the
+	// calling thread with a value in [0, 100].
+	void render(
+		int width,
+		int height,
+		int samplesPerPixel,
+		int numThreads,
+		std::vector<glm::vec3> &image,
+		std::function<void(int)> progress = nullptr);
+
+	// Rays (camera, secondary and shadow) and camera samples of the last render
+	long long numRays() const { return m_numRays; }
+	long long numSamples() const { return m_numSamples; }
+
+	// HDR output
+	static bool savePFM(const std::string &filename, int width, int height, const std::vector<glm::vec3> &image);
+	static bool saveEXR(const std::string &filename, int width, int height, const std::vector<glm::vec3> &image);
+
+private:
+	// Pending ray of the iterative traversal. weight is the factor applied to its
+	// color in the final pixel, throughput the one used by Russian roulette.
+	struct RayTask {
+		glm::vec3 orig;
+		glm::vec3 dir;
+		glm::vec3 weight;
+		glm::vec3 throughput;
+		int depth;
+	};
+
+	glm::vec3 traceRay(
+		const glm::vec3 &rayOrig,
+		const glm::vec3 &rayDir) const;
+
+	glm::vec3 traceRayRecursive(
+		const glm::vec3 &rayOrig,
+		const glm::vec3 &rayDir,
+		const glm::vec3 &throughput,
+		const int &depth) const;
+
+	float fresnel(
+		const glm::vec3 &rayDir,
+		const glm::vec3 &normalHit) const;
+
+	glm::vec3 directLighting(
+		const glm::vec3 &posHit,
+		const glm::vec3 &normalHit,
+		const glm::vec3 &colorHit) const;
+
+	glm::vec3 lightContribution(
+		const int &lightId,
+		const glm::vec3 &posHit,
+		const glm::vec3 &normalHit,
+		const glm::vec3 &colorHit) const;
+
+	bool intersection(
+		const int &sphereId,
+		const glm::vec3 &rayOrig,
+		const glm::vec3 &rayDir,
+		float &distHit,
+		glm::vec3 &posHit,
+		glm::vec3 &normalHit,
+		glm::vec3 &colorHit,
+		bool &isInside) const;
+
+	glm::vec3 blendReflRefrColors(
+		const SphereMaterial &material,
+		const glm::vec3 &rayDir,
+		const glm::vec3 &normalHit,
+		const glm::vec3 &reflColor,
+		const glm::vec3 &refrColor) const;
+
+	/* Attributes */
+	// Scene
+	SphereSoA m_spheres;
+	glm::vec3 m_bkgColor;
+	int m_sceneWidth;
+	int m_sceneHeight;
+	int m_sceneSamples;
+
+	// Sampling
+	int m_minSamples;
+	float m_varianceThreshold;
+	bool m_recursive;
+
+	// Camera
+	glm::vec3 m_camPos;
+	glm::vec3 m_camTarget;
+	float m_fov;
+
+	// Stats
+	std::atomic<long long> m_numRays;
+	std::atomic<long long> m_numSamples;
+};
+
+#endif
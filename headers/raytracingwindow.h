@@ -3,7 +3,7 @@
 
 #include "../glm/glm.hpp"
 #include "../headers/definitions.h"
-#include "../headers/sphere.h"
+#include "../headers/raytracer.h"
 
 class MainWindow;
 
@@ -28,36 +28,15 @@ private:
 
 
 	// Ray Tracing
-	glm::vec3 traceRay(
-		const glm::vec3 &rayOrig,
-		const glm::vec3 &rayDir,
-		const std::vector<Sphere> &spheres,
-		const int &depth);
-
-	void render(const std::vector<Sphere> &spheres);
-	
-	bool intersection(
-		const Sphere &sphere,
-		const glm::vec3 &rayOrig,
-		const glm::vec3 &rayDir,
-		float &distHit,
-		glm::vec3 &posHit,
-		glm::vec3 &normalHit,
-		glm::vec3 &colorHit, 
-		bool &isInside);
-
-	glm::vec3 blendReflRefrColors(
-		const Sphere* sphere,
-		const glm::vec3 &rayDir,
-		const glm::vec3 &normalHit,
-		const glm::vec3 &reflColor,
-		const glm::vec3 &refrColor);
+	void render();
 
 	/* Attributes */
 	// Screen
 	int m_width;
 	int m_height;
-	glm::vec3 background_color;
+
+	// Ray Tracing
+	RayTracer m_rayTracer;
 	
 	Ui::RayTracingWindow m_ui;
 	MainWindow* m_mainWindow;
@@ -0,0 +1,66 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QThread>
+#include <QSemaphore>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <qopenglframebufferobject.h>
+
+#include <atomic>
+
+#include "ssaorenderer.h"
+#include "triplebuffer.h"
+
+// Runs an SSAORenderer in its own thread, with a context shared with the
+// widget that presents its frames, so heavy frames do not block the GUI.
+// The GUI thread hands over the latest RenderSettings (camera, input and
+// options) and the thread hands back the latest finished frame, both through
+// a lock-free TripleBuffer: a burst of mouse events only renders the last one.
+class RenderThread : public QThread
+{
+	Q_OBJECT
+
+public:
+	// Finished frame: its color texture is shared with the widget's context,
+	// which waits for the fence before sampling it. The thread waits in turn
+	// for the presented fence (after the widget's blit) before drawing into
+	// the frame again or deleting it.
+	struct Frame {
+		QOpenGLFramebufferObject* fbo;
+		GLsync fence;
+		GLsync presented;
+
+		Frame() : fbo(nullptr), fence(0), presented(0) {}
+	};
+
+	// Created in the GUI thread, with the widget's current context
+	RenderThread(QOpenGLContext *shareContext, const RenderSettings &settings);
+	~RenderThread(); // stops the thread
+
+	// GUI thread: the next frame uses these settings
+	void setSettings(const RenderSettings &settings);
+	void stop();
+
+	// GUI thread: update() then front(), a null fbo before the first frame
+	TripleBuffer<Frame>& frames() { return m_frames; }
+
+signals:
+	void frameReady();
+	// The model or the stress test changed the scene: the camera is placed again
+	void sceneChanged(float sceneRadius, int lodCount);
+
+protected:
+	void run() override;
+
+private:
+	QOpenGLContext* m_context; // moved to this thread
+	QOffscreenSurface* m_surface; // created and destroyed in the GUI thread
+
+	TripleBuffer<RenderSettings> m_settings;
+	TripleBuffer<Frame> m_frames;
+	QSemaphore m_wake; // released with new settings or to stop
+	std::atomic<bool> m_quit;
+};
+
+#endif
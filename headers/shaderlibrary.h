@@ -0,0 +1,116 @@
+#ifndef SHADERLIBRARY_H
+#define SHADERLIBRARY_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QTimer>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+
+// Shader files of one program (the geometry shader is optional)
+struct ShaderFiles {
+	QString vertex;
+	QString fragment;
+	QString geometry;
+
+	ShaderFiles() {}
+	ShaderFiles(const QString &vert, const QString &frag, const QString &geom = QString())
+		: vertex(vert), fragment(frag), geometry(geom) {}
+};
+
+// Builds the shader programs of every GL widget. Linked programs are stored
+// as glGetProgramBinary blobs, in memory and in the cache directory, keyed by
+// their sources and the GL driver, so an unchanged program is never compiled
+// twice. When the driver supports parallel shader compilation, the programs
+// requested together are compiled at the same time.
+// The shader files are watched: shadersChanged() is emitted when one of them
+// is saved, and widgets reload their programs as they do on F5.
+// Programs can be built from any thread with a current context.
+class ShaderLibrary : public QObject
+{
+	Q_OBJECT
+
+public:
+	static ShaderLibrary& instance();
+
+	// New program owned by the caller (a context must be current). It is
+	// returned even if it does not link, check isLinked(). The attributes of
+	// previous, if given, keep their locations, so the VAOs built for it are
+	// still valid with the new program.
+	QOpenGLShaderProgram* program(const ShaderFiles &files, const QOpenGLShaderProgram *previous = nullptr);
+
+	// Same for several programs: all of them are compiled and linked before
+	// waiting for any result.
+	// Reloading (F5 or shadersChanged()): a caller that gets a program that
+	// does not link keeps its previous one. A new program starts with default
+	// uniforms, so the caller sends them again.
+	QList<QOpenGLShaderProgram*> programs(
+		const QList<ShaderFiles> &files,
+		const QList<QOpenGLShaderProgram*> &previous = QList<QOpenGLShaderProgram*>());
+
+signals:
+	// One of the shader files changed on disk (emitted once per burst of saves)
+	void shadersChanged();
+
+private slots:
+	void fileChanged(const QString &path);
+
+private:
+	ShaderLibrary();
+
+	struct ProgramBinary {
+		GLenum format;
+		QByteArray data;
+	};
+
+	// Program being built by programs()
+	struct PendingProgram {
+		ShaderFiles files;
+		QByteArray sources[3];
+		QList<QPair<QByteArray, GLint> > bindings;
+		QByteArray key;
+		QOpenGLShaderProgram* program;
+		QList<GLuint> shaders;
+		bool fromBinary;
+	};
+
+	void initFunctions(QOpenGLContext *context);
+	void compile(QOpenGLFunctions *f, PendingProgram &p);
+	void watch(const QString &filename);
+	QByteArray readSource(const QString &filename);
+	QByteArray programKey(const QByteArray sources[3], const QByteArray &bindings) const;
+
+	bool loadBinary(const QByteArray &key, ProgramBinary &binary);
+	void saveBinary(const QByteArray &key, const ProgramBinary &binary);
+	QString binaryFilename(const QByteArray &key) const;
+
+	// Entry points that QOpenGLFunctions_3_3_Core does not have
+	typedef void (QOPENGLF_APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	typedef void (QOPENGLF_APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+	typedef void (QOPENGLF_APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+	typedef void (QOPENGLF_APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+	bool m_functionsResolved;
+	GetProgramBinaryProc m_getProgramBinary;
+	ProgramBinaryProc m_programBinary;
+	ProgramParameteriProc m_programParameteri;
+	MaxShaderCompilerThreadsProc m_maxShaderCompilerThreads;
+	QByteArray m_driver;
+
+	QHash<QByteArray, ProgramBinary> m_binaries;
+	QString m_cacheDir;
+
+	QMutex m_mutex; // programs() of several threads
+
+	QFileSystemWatcher m_watcher;
+	QTimer m_changeTimer;
+};
+
+#endif
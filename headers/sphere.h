@@ -37,6 +37,8 @@ public:
 	}
 
 	glm::vec3 getCenter() const { return center; }
+	float getRadius() const { return radius; }
+	float getRadius2() const { return radius2; }
 	glm::vec3 getSurfaceColor() const { return surfaceColor; }
 	glm::vec3 getLightColor() const { return lightColor; }
 	float getRefractionIndex() const { return refractionIndex; }
@@ -0,0 +1,152 @@
+#ifndef SPHERESOA_H
+#define SPHERESOA_H
+
+#include <vector>
+#include <cmath>
+
+#include "../glm/glm.hpp"
+#include "sphere.h"
+
+// Intersection data of one sphere: center and squared radius packed in
+// exactly 16 bytes, so the traversal loop only touches what it needs.
+struct alignas(16) SphereBounds {
+	float cx, cy, cz;
+	float radius2;
+};
+
+// Shading data of one sphere. It is only read once the closest hit is known.
+struct SphereMaterial {
+	glm::vec3 surfaceColor;
+	glm::vec3 lightColor;
+	float emission;
+	float transparency; // in the range [0.0, 1.0]
+	float refractionIndex;
+	bool reflectivity;
+
+	glm::vec3 getSurfaceColor() const { return surfaceColor; }
+	glm::vec3 getLightColor() const { return lightColor; }
+	float getRefractionIndex() const { return refractionIndex; }
+	float transparencyFactor() const { return transparency; }
+	float emissionFactor() const { return emission; }
+	bool isLight() const { return (emission > 0.0f); }
+	bool refractsLight() const { return refractionIndex != 0; }
+	bool reflectsLight() const { return reflectivity; }
+};
+
+// Scene container storing spheres as a structure of arrays: the hot
+// intersection data lives in a contiguous array of SphereBounds and the
+// cold material data in a parallel array, at the same index.
+class SphereSoA {
+public:
+	SphereSoA() {}
+	~SphereSoA() {}
+
+	void add(const Sphere &sphere)
+	{
+		SphereBounds bounds;
+		glm::vec3 center = sphere.getCenter();
+		bounds.cx = center.x;
+		bounds.cy = center.y;
+		bounds.cz = center.z;
+		bounds.radius2 = sphere.getRadius2();
+		m_bounds.push_back(bounds);
+
+		SphereMaterial mat;
+		mat.surfaceColor = sphere.getSurfaceColor();
+		mat.lightColor = sphere.getLightColor();
+		mat.emission = sphere.emissionFactor();
+		mat.transparency = sphere.transparencyFactor();
+		mat.refractionIndex = sphere.getRefractionIndex();
+		mat.reflectivity = sphere.reflectsLight();
+		m_materials.push_back(mat);
+
+		// Emitters are also registered in the light list
+		if (mat.isLight())
+			m_lights.push_back((int)m_bounds.size() - 1);
+	}
+
+	void clear()
+	{
+		m_bounds.clear();
+		m_materials.clear();
+		m_lights.clear();
+	}
+
+	int size() const { return (int)m_bounds.size(); }
+
+	// Same test as Sphere::intersect, reading only the packed bounds
+	bool intersect(int id, const glm::vec3 &rayorig, const glm::vec3 &raydir, float &t0, float &t1) const
+	{
+		const SphereBounds &b = m_bounds[id];
+		float lx = b.cx - rayorig.x;
+		float ly = b.cy - rayorig.y;
+		float lz = b.cz - rayorig.z;
+		float tca = lx * raydir.x + ly * raydir.y + lz * raydir.z;
+		if (tca < 0) return false;
+		float d2 = lx * lx + ly * ly + lz * lz - tca * tca;
+		if (d2 > b.radius2) return false;
+		float thc = sqrt(b.radius2 - d2);
+		t0 = tca - thc;
+		t1 = tca + thc;
+
+		return true;
+	}
+
+	// Index of the closest sphere hit by the ray (or -1) and its distance
+	int closestHit(const glm::vec3 &rayorig, const glm::vec3 &raydir, float &tHit) const
+	{
+		int hitId = -1;
+		tHit = INFINITY;
+
+		int numSpheres = size();
+		for (int i = 0; i < numSpheres; ++i) {
+			float t0 = INFINITY, t1 = INFINITY;
+			if (intersect(i, rayorig, raydir, t0, t1)) {
+				if (t0 < 0) t0 = t1;
+				if (t0 < tHit) {
+					tHit = t0;
+					hitId = i;
+				}
+			}
+		}
+
+		return hitId;
+	}
+
+	// Any-hit query for shadow rays: stops at the first sphere found between
+	// the origin and maxDist. The sphere skipId (the light itself) is ignored.
+	bool occluded(const glm::vec3 &rayorig, const glm::vec3 &raydir, float maxDist, int skipId = -1) const
+	{
+		int numSpheres = size();
+		for (int i = 0; i < numSpheres; ++i) {
+			if (i == skipId)
+				continue;
+
+			float t0, t1;
+			if (intersect(i, rayorig, raydir, t0, t1)) {
+				if (t0 < 0) t0 = t1;
+				if (t0 > 0 && t0 < maxDist)
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Indices of the emitting spheres, built while adding them
+	const std::vector<int>& lights() const { return m_lights; }
+
+	glm::vec3 getCenter(int id) const
+	{
+		const SphereBounds &b = m_bounds[id];
+		return glm::vec3(b.cx, b.cy, b.cz);
+	}
+	const SphereMaterial& getMaterial(int id) const { return m_materials[id]; }
+
+private:
+	std::vector<SphereBounds> m_bounds;
+	std::vector<SphereMaterial> m_materials;
+	std::vector<int> m_lights;
+};
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef SSAORENDERER_H
+#define SSAORENDERER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QColor>
+#include <QElapsedTimer>
+#include <QString>
+#include <qopenglframebufferobject.h>
+
+#include <vector>
+
+#include "../glm/glm.hpp"
+#include "../glm/gtc/matrix_transform.hpp"
+#include "definitions.h"
+#include "model.h"
+#include "frustum.h"
+#include "lightgrid.h"
+#include "hizbuffer.h"
+#include "glresourcecache.h"
+#include "shaderlibrary.h"
+#include "uniformring.h"
+
+// Everything the owner of an SSAORenderer decides: camera, model and options.
+// It is copied as a whole, so it can be handed over to a render thread.
+struct RenderSettings {
+	RenderSettings();
+
+	// Camera and rotation of the model (mouse drags)
+	glm::mat4 projection;
+	float fov;
+	glm::mat4 view;
+	float xRot, yRot;
+
+	int width, height;
+	QString modelFilename;
+	int instanceCount; // stress test
+	bool instancing;
+	int lightCount; // stress test of the light pass
+	bool depthPrepass, drawOverdraw;
+
+	QColor background;
+	bool ssao, drawOnlySSAO;
+	float ssaoIntensity;
+	bool frustumCulling;
+	bool occlusionCulling;
+	int antialiasing; // SSAORenderer::Antialiasing
+	bool highQualityAA;
+	int forcedLOD;
+	QString normalMapFilename; // empty: none
+	int shaderGeneration; // incremented to reload the shaders
+};
+
+// Deferred SSAO pipeline of the SSOWidget: a geometry pass (after an optional
+// depth pre-pass) that writes the positions, normals (through the normal map
+// of the model, if it has one) and materials into the G-buffer, an AO pass
+// that computes the ambient occlusion into its own texture, and a light pass
+// that shades the G-buffer on a screen quad and composites the occlusion. The
+// light pass reads the lights from buffer textures and only evaluates the
+// ones of the screen tile of each pixel (see LightGrid). The anti-aliasing of the deferred
+// output is a post-process after the light pass (FXAA or SMAA 1x), which then
+// lights an intermediate image instead of the target: multisampled G-buffers
+// would multiply their memory and bandwidth.
+// With the occlusion culling, the geometry passes run in two phases: the
+// objects visible in the last frame are drawn, a Hi-Z buffer is built from
+// their depth (read back at low resolution) and the other objects in the
+// frustum are only drawn if it does not hide them.
+// Every pass keeps its result until one of its inputs changes: a frame with
+// the same camera, model and options only runs the light and anti-aliasing
+// passes, and a new intensity or the AO-only toggle do not compute the
+// occlusion again.
+// It only needs a current context, so it renders as well into the
+// framebuffer of a widget as into an FBO of a QOffscreenSurface (see
+// ssaorendercli.cpp). The camera is owned by the caller, which sends its
+// matrices.
+// Every call that is not a plain setter needs the context current.
+class SSAORenderer : protected QOpenGLFunctions_3_3_Core
+{
+public:
+	// Passes of a frame, in order
+	enum Pass { DEPTH_PASS, GEOMETRY_PASS, AO_PASS, LIGHT_PASS, AA_PASS, NUM_PASSES };
+	static const char* passName(int pass);
+
+	// Post-process anti-aliasing
+	enum Antialiasing { AA_NONE, AA_FXAA, AA_SMAA, NUM_ANTIALIASING };
+	static const char* antialiasingName(int mode);
+	static int antialiasingMode(const QString &name); // -1 if it is none of the names
+
+	SSAORenderer(const QString &modelFilename);
+
+	// Shaders, quad, G-buffer and model. false if the model cannot be loaded.
+	bool initialize(int width, int height);
+	void cleanup();
+	bool reloadShaders();
+	void resize(int width, int height);
+
+	// Switches the model in place, only its buffers are uploaded (once). Before
+	// initialize, it only changes the model that will be loaded.
+	bool setModel(const QString &modelFilename);
+	const QString& modelFilename() const { return m_modelFilename; }
+	bool modelLoaded() const { return m_modelLoaded; }
+	float modelRadius() const { return m_modelRadius; }
+	float sceneRadius() const { return m_sceneRadius; } // the stress test grid included
+
+	// Applies the settings that changed. true if the scene radius changed (new
+	// model or stress test), so the caller places its camera again.
+	bool apply(const RenderSettings &settings);
+
+	// Camera of the caller and rotation of the model (mouse drags)
+	void setProjection(const glm::mat4 &projection, float fov);
+	void setView(const glm::mat4 &view);
+	void setModelRotation(float xRot, float yRot);
+
+	// Options
+	void setBackgroundColor(const QColor &color) { m_bkgColor = color; m_geometryDirty = true; }
+	void setSSAO(bool active) { usingSSAO = active; flag_ssao = true; }
+	void setSSAOIntensity(float value) { ssao_intensity = value; flag_ssao = true; }
+	void setDrawOnlySSAO(bool active) { drawSSAO = active; flag_ssao = true; }
+
+	// Depth-only pre-pass of the positions, then a G-buffer pass with an equal
+	// depth test that shades each pixel once. The overdraw view shows how many
+	// fragments the G-buffer pass shaded per pixel.
+	void setDepthPrepass(bool active) { m_depthPrepass = active; m_geometryDirty = true; }
+	bool depthPrepass() const { return m_depthPrepass; }
+	void setDrawOverdraw(bool active);
+	bool drawOverdraw() const { return m_drawOverdraw; }
+
+	// Frustum culling of the submeshes
+	void setFrustumCulling(bool active) { m_frustumCulling = active; m_geometryDirty = true; }
+	bool frustumCulling() const { return m_frustumCulling; }
+	int visibleSubMeshes() const { return m_visibleSubMeshes; }
+	int subMeshCount() const;
+
+	// Occlusion culling of the submeshes (or of the instances of the stress
+	// test) inside the frustum. The counts are the ones of the last frame
+	// that drew the geometry, and are printed when they change.
+	void setOcclusionCulling(bool active);
+	bool occlusionCulling() const { return m_occlusionCulling; }
+	int occlusionDrawn() const { return m_occlusionDrawn; }
+	int occlusionCulled() const { return m_occlusionCulled; }
+
+	// Anti-aliasing of the lit image, timed as AA_PASS. The high quality
+	// follows the edges twice as far and finds fainter ones.
+	void setAntialiasing(int mode);
+	int antialiasing() const { return m_antialiasing; }
+	void setHighQualityAA(bool active) { m_highQualityAA = active; }
+	bool highQualityAA() const { return m_highQualityAA; }
+
+	// Tangent space normal map of the model, over its texture coordinates
+	// (empty to remove it). Models without them keep their normals.
+	void setNormalMap(const QString &filename);
+	const QString& normalMapFilename() const { return m_normalMapFilename; }
+
+	// Level of detail, -1 to pick it from the screen size of the model
+	void setForcedLOD(int level) { m_forcedLOD = level; m_geometryDirty = true; }
+	int forcedLOD() const { return m_forcedLOD; }
+	int lodCount() const;
+
+	// Stress test: count copies of the model on a grid (0 to disable it). The
+	// scene radius grows with the grid, the caller places its camera again.
+	// While it runs, render() prints its statistics once per second.
+	void setInstanceCount(int count);
+	int instanceCount() const { return (int)m_instances.size(); }
+	void setInstancing(bool active) { m_instancing = active; m_geometryDirty = true; }
+	bool instancing() const { return m_instancing; }
+	int visibleInstances() const { return m_visibleInstances; }
+	int drawCalls() const { return m_drawCalls; }
+
+	// Point lights spread over the scene besides the headlight (0 to disable
+	// them), to chart the cost of the light pass against their number. The
+	// tiles are reported with the next frame.
+	void setLightCount(int count);
+	int lightCount() const { return (int)m_lights.size(); }
+
+	// Renders a frame into the framebuffer target (defaultFramebufferObject()
+	// of a widget, or the handle of an FBO). If timerQueries is given, it
+	// holds NUM_PASSES GL_TIME_ELAPSED queries wrapped around the passes (the
+	// skipped ones measure nothing).
+	void render(GLuint target, const GLuint *timerQueries = nullptr);
+	qint64 geometryCpuNs() const { return m_geometryCpuNs; } // of the last frame
+
+	// The next frame runs every pass, even if nothing changed (stress test)
+	void invalidate() { m_geometryDirty = true; }
+
+private:
+	// Shaders
+	bool loadShaders();
+	void loadDepthShader();
+	void loadGShader();
+	void loadAOShader();
+	void loadLightShader();
+	void loadHiZShader();
+	void loadAAShaders();
+
+	// Scene
+	void computeCenterRadiusScene();
+
+	// Model
+	void createBuffersModel();
+	void cleanBuffersModel();
+	void computeBBoxModel();
+	void loadNormalMap();
+	glm::mat4 modelTransform(); // Position and orientation of the scene
+	glm::mat4 m_sceneTransform; // of the frame
+	bool m_modelLoaded;
+
+	// Quad
+	void createBuffersQuad();
+
+	// SSAO
+	void createGBuffers();
+	void createAABuffers(); // of the current mode only
+	void createSSAOKernels();
+
+	//Lighting
+	void setLighting();
+	void createLightBuffers();
+	void updateLights(); // view coordinates and tiles
+
+	// Draw
+	struct DrawList;
+	void cullScene(); // submeshes or instances in the frustum, for both geometry passes
+	void occlusionCull(); // second phase, after the objects of the first one
+	void drawScene(const DrawList &list, GLint instanceModelLoc, GLint instanceDiffuseLoc, GLint instancedLoc, GLint diffuseOverrideLoc);
+	void DepthPass(int phase); // Optional pre-pass
+	void GeometryPass(int firstPhase, int lastPhase); // 1st Pass
+	void HiZPass(); // Occlusion culling
+	void AOPass(); // 2nd Pass
+	void LightPass(GLuint target); // 3rd Pass
+	void AAPass(GLuint target); // Optional post-process
+
+	// Inputs changed since the last frame. The G-buffer also makes the AO dirty.
+	bool m_geometryDirty;
+	bool m_aoDirty;
+
+	/* Attributes */
+	// Screen
+	int m_width;
+	int m_height;
+
+	// Camera (matrices of the caller)
+	glm::mat4 m_projection;
+	float m_fov;
+	float m_xRot;
+	float m_yRot;
+
+	// Scene
+	glm::vec3 m_sceneCenter;
+	float m_sceneRadius;
+	QColor m_bkgColor;
+	bool m_backFaceCulling;
+
+	// Model (the buffers are owned by the GLResourceCache)
+	GLMesh* m_mesh;
+	QString m_modelFilename;
+	glm::vec3 m_modelCenter;
+	float m_modelRadius;
+	glm::vec3 m_modelBBoxMin, m_modelBBoxMax;
+	GLuint m_VAOModel;
+	GLuint m_VAODepth; // positions only
+	bool m_depthPrepass;
+	bool m_drawOverdraw;
+	QString m_normalMapFilename;
+	GLuint m_normalMapTex; // owned by the GLResourceCache, 0 if none
+
+	// Frustum culling of the submeshes
+	bool m_frustumCulling;
+	int m_visibleSubMeshes;
+
+	// Level of detail, from the screen size of the model
+	int selectLOD(const glm::mat4 &model);
+	int lodLevel(const glm::mat4 &model) const;
+	int m_forcedLOD; // -1 to pick it from the screen size
+	int m_currentLOD;
+
+	// Stress test: copies of the model on a grid, drawn with one instanced
+	// draw call per level of detail
+	struct Instance {
+		glm::mat4 transform; // applied after modelTransform()
+		glm::vec4 diffuse;   // rgb override, weighted by a
+	};
+	void setInstanceAttributes(size_t firstInstance, GLint modelLoc, GLint diffuseLoc);
+	void cullInstances();
+	void uploadInstances(DrawList &list, size_t first);
+	std::vector<Instance> m_instances;
+	GLuint m_instanceVBO;
+	bool m_instancing; // false: one draw call per instance, to compare
+	int m_visibleInstances;
+	int m_drawCalls;
+	QElapsedTimer m_stressTimer;
+	int m_stressFrames;
+	qint64 m_stressCpuNs;
+
+	// Draws of one phase: index ranges of the submeshes for
+	// glMultiDrawElements, or the instances of every level of detail
+	struct DrawList {
+		std::vector<GLint> first;
+		std::vector<GLsizei> count;
+		std::vector<const GLvoid*> offsets; // first in bytes
+		std::vector<std::vector<Instance> > lodInstances;
+		std::vector<size_t> lodFirstInstance; // of every level in m_instanceVBO
+		void clear();
+		void addSubMesh(const SubMesh &subMesh);
+		int instanceCount() const;
+	};
+	DrawList m_drawLists[2]; // without occlusion culling, only the first one
+
+	// Occlusion culling. The objects are the submeshes of the level of detail,
+	// or the instances of the stress test.
+	bool m_occlusionCulling;
+	std::vector<int> m_candidates; // objects in the frustum
+	std::vector<char> m_wasVisible; // of every object, in the last frame
+	int m_visibilityLOD; // level of the submeshes of m_wasVisible, -1 for the instances
+	HiZBuffer m_hiZ;
+	std::vector<float> m_hiZDepth; // read back
+	GLuint m_depthTexture; // depth attachment of the G-buffer
+	int m_occlusionDrawn, m_occlusionCulled;
+	int m_reportedDrawn, m_reportedCulled;
+
+	// Post-process anti-aliasing
+	int m_antialiasing;
+	bool m_highQualityAA;
+
+	// Timings
+	QElapsedTimer m_cpuTimer;
+	qint64 m_geometryCpuNs;
+
+	// Lights: the headlight (view coordinates), then the stress test ones
+	// (world coordinates). They are sent in view coordinates with the tiles
+	// that they reach.
+	glm::vec4 m_lightPos;
+	glm::vec3 m_lightCol;
+	std::vector<PointLight> m_lights;
+	std::vector<PointLight> m_viewLights;
+	LightGrid m_lightGrid;
+	bool m_lightsDirty;
+	bool m_reportLights;
+	GLuint m_lightBuffers[3]; // lights, tiles and indices
+	GLuint m_lightTextures[3]; // buffer textures of them
+
+	// Shaders
+	GLuint m_matAmbLoc, m_matDiffLoc, m_matSpecLoc, m_matShinLoc;
+
+	// GPass Shader
+	QOpenGLShaderProgram* gPass_program;
+	GLuint gp_aPos, gp_aNormal, gp_aTexCoords, gp_aTangent;	// vertex
+	FrameUniforms m_frameUniforms;	// vertex, blocks in m_uniforms
+	GLuint gp_aInstanceModel, gp_aInstanceDiffuse, gp_instanced, gp_diffuseOverride; // vertex
+	GLuint gp_quantized, gp_positionBoxes; // vertex
+	GLuint gp_normalMapped, gp_normalMap; // fragment
+
+	// Depth Shader
+	QOpenGLShaderProgram* depth_program;
+	GLuint dp_aPos, dp_aInstanceModel, dp_instanced;
+	GLuint dp_quantized, dp_positionBoxes;
+
+	// Uniform blocks of the depth and G-buffer passes
+	UniformRing m_uniforms;
+	int m_shaderGeneration; // of the last RenderSettings
+
+	// AO Shader
+	QOpenGLShaderProgram* ao_program;
+	GLuint gPositionTex, gNormalTex, texNoise, noiseTexture;
+	GLuint ao_projection, ao_screenWidth, ao_screenHeight;
+
+	// Light Shader
+	QOpenGLShaderProgram* light_program;
+	GLuint light_vertex, light_texcoords, gAlbedo, light_ssao;
+	GLuint light_gPosition, light_gNormal, light_gSpecular;
+	GLuint light_lights, light_tiles, light_indices, light_tileSize, light_tilesX;
+	GLuint light_gOverdraw, light_drawOverdraw;
+	GLuint useSSAO, ssaoIntensityLoc, drawSSAOLoc;
+
+	// Hi-Z Shader
+	QOpenGLShaderProgram* hiz_program;
+	GLuint hiz_depth, hiz_texelSize;
+
+	// Anti-aliasing Shaders: FXAA, and the edges, weights and blending passes of SMAA
+	QOpenGLShaderProgram* fxaa_program;
+	GLuint fxaa_image, fxaa_edgeThreshold, fxaa_searchSteps;
+	QOpenGLShaderProgram* smaaEdges_program;
+	GLuint smaaEdges_image, smaaEdges_threshold;
+	QOpenGLShaderProgram* smaaWeights_program;
+	GLuint smaaWeights_edges, smaaWeights_searchSteps;
+	QOpenGLShaderProgram* smaaBlend_program;
+	GLuint smaaBlend_image, smaaBlend_weights;
+
+	// Quad
+	GLuint quadVAO, quadVBOVert, quadVBOTexCoord;
+
+	// FBO
+	QOpenGLFramebufferObject* g_fbo;
+	QOpenGLFramebufferObject* ao_fbo;
+	QOpenGLFramebufferObject* hiz_fbo;
+	QOpenGLFramebufferObject* lit_fbo; // light pass output, with anti-aliasing
+	QOpenGLFramebufferObject* smaaEdges_fbo;
+	QOpenGLFramebufferObject* smaaWeights_fbo;
+
+	// Kernels
+	std::vector<glm::vec3> ssaoKernel;
+	std::vector<glm::vec3> ssaoNoise;
+
+	bool flag_ssao;
+	bool usingSSAO;
+	float ssao_intensity;
+	bool drawSSAO;
+};
+
+#endif
@@ -8,11 +8,14 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLShader>
 #include <QOpenGLShaderProgram>
+#include <QOpenGLTextureBlitter>
 #include <QColor>
+#include <QElapsedTimer>
 #include <QKeyEvent>
 #include <QMatrix4x4>
 #include <QMouseEvent>
 #include <QTime>
+#include <QTimer>
 #include <QWheelEvent>
 #include <qopenglframebufferobject.h>
 
@@ -21,6 +24,11 @@
 #include "definitions.h"
 #include "model.h"
 #include "Camera.h"
+#include "benchmark.h"
+#include "shaderlibrary.h"
+#include "ssaorenderer.h"
+#include "renderthread.h"
+#include "framecapture.h"
 
 class SSOWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
 {
@@ -33,16 +41,45 @@ public:
 	QSize minimumSizeHint() const override;
 	QSize sizeHint() const override;
 
+	// Render in a RenderThread, paintGL only presents its finished frames
+	static bool isThreaded() { return m_threaded; }
+	static void setThreaded(bool t) { m_threaded = t; }
+
+	// Switches the model in place, only its buffers are uploaded (once)
+	void setModel(QString modelFilename);
+
 	// Camera
 	void sceneCameraType(int type);
 	void activateSSAO(bool active);
 	void setSSAOIntensity(double value);
 	void activateDrawOnlySSAO(bool active);
 
+	// Point lights besides the headlight (stress test of the light pass)
+	void setLightCount(int count);
+	// Depth-only pass before the G-buffer pass
+	void setDepthPrepass(bool active);
+	// Two-phase occlusion culling of the geometry passes
+	void setOcclusionCulling(bool active);
+	// Tangent space normal map of the model, empty to remove it
+	void setNormalMap(const QString &filename);
+	// Post-process anti-aliasing (SSAORenderer::Antialiasing)
+	void setAntialiasing(int mode, bool highQuality);
+
+	// Replays path in frames frames, as fast as they render, then writes the
+	// percentiles of the frame and pass times to csvFile (not threaded). The
+	// frames are captured to capturePath if it is given (see FrameCapture).
+	void startBenchmark(const CameraPath &path, int frames, const QString &csvFile, const QString &capturePath = QString());
+
 	public slots:
 	void cleanup();
 
 signals:
+	void benchmarkFinished(bool ok);
+
+private slots:
+	void recordCameraKey();
+	// New model or stress test: the camera is placed again
+	void sceneChanged(float sceneRadius, int lodCount);
 
 protected:
 	void initializeGL() override;
@@ -57,48 +94,38 @@ protected:
 	void wheelEvent(QWheelEvent* event) override;
 
 private:
+	// Hands m_settings to the renderer: to the render thread, or to the next
+	// paintGL. applySettings() applies them right away (not threaded).
+	void requestFrame();
+	void applySettings();
+	void presentFrame();
+
 	// Shaders
-	void loadShaders();
 	void reloadShaders();
 
-	void loadGShader();
-	void loadLightShader();
-
 	// Camera
 	void initCamera();
-	void projectionTransform(bool useSSAO = false); // Type of camera
+	void projectionTransform(); // Type of camera
 	void resetCamera();
 	void viewTransform(); // Position of the camera
 
 						  // Scene
 	void changeBackgroundColor();
-	void computeCenterRadiusScene();
-
-	// Model
-	void createBuffersModel();
-	void cleanBuffersModel();
-	void computeBBoxModel();
-	void modelTransform(); // Position and orientation of the scene
-	bool m_modelLoaded;
+	void changeNormalMap();
 
-	// Quad
-	void createBuffersQuad(); 
+	// Stress test
+	void setInstanceCount(int count);
 
-	// SSAO
-	void createGBuffers();
-	void createSSAOKernels();
-
-	//Lighting
-	void setLighting();
+	// Benchmark: camera from the path and GPU timer queries around the passes
+	void beginBenchmarkFrame();
+	void endBenchmarkFrame(qint64 geometryCpuNs);
+	void readBenchmarkQueries(int frame);
+	void finishBenchmark();
 
 	// FPS
 	void computeFps();
 	void showFps();
 
-	// Draw
-	void GeometryPass(); // 1st Pass
-	void LightPass(); // 3rd Pass
-
 	/* Attributes */
 	// Screen
 	int m_width;
@@ -122,23 +149,18 @@ private:
 	int cam_type;
 	Camera* camera;
 
-	// Scene
-	glm::vec3 m_sceneCenter;
+	// Camera, model and options of the renderer
+	RenderSettings m_settings;
 	float m_sceneRadius;
-	QColor m_bkgColor;
-	bool m_backFaceCulling;
+	int m_lodCount; // 0 until the model is loaded
 
-	// Model
-	Model m_model;
-	QString m_modelFilename;
-	glm::vec3 m_modelCenter;
-	float m_modelRadius;
-	GLuint m_VAOModel, m_VBOModelVerts, m_VBOModelNorms;
-	GLuint m_VBOModelMatAmb, m_VBOModelMatDiff, m_VBOModelMatSpec, m_VBOModelMatShin;
+	// Renders into the framebuffer of the widget (not threaded)
+	SSAORenderer* m_renderer;
 
-	// Lights
-	glm::vec4 m_lightPos;
-	glm::vec3 m_lightCol;
+	// Renders in its own thread, the widget draws its frames with m_blitter
+	static bool m_threaded;
+	RenderThread* m_renderThread;
+	QOpenGLTextureBlitter m_blitter;
 
 	// Mouse
 	int m_xClick;
@@ -146,45 +168,31 @@ private:
 	float m_xRot;
 	float m_yRot;
 	int m_doingInteractive;
-	
 
-	// Shaders
-	GLuint m_matAmbLoc, m_matDiffLoc, m_matSpecLoc, m_matShinLoc;
-	GLuint m_lightPosLoc, m_lightColLoc;
-
-	// GPass Shader
-	QOpenGLShaderProgram* gPass_program;
-	GLuint gp_aPos, gp_aNormal, gp_aTexCoords;	// vertex
-	GLuint gp_model, gp_view, gp_projection;	// vertex
-
-	// Light Shader
-	QOpenGLShaderProgram* light_program;
-	GLuint light_vertex, light_texcoords, gPositionTex, gNormalTex, gAlbedo;
-	GLuint light_projection, light_trans, light_view;
-	GLuint texNoise, noiseTexture;
-	GLuint useSSAO, ssaoIntensityLoc, drawSSAOLoc;
-
-	// Quad
-	GLuint quadVAO, quadVBOVert, quadVBOTexCoord;
-
-	// FBO
-	QOpenGLFramebufferObject* g_fbo;
-
-	// Kernels
-	std::vector<glm::vec3> ssaoKernel;
-	std::vector<glm::vec3> ssaoNoise;
+	// Camera path recording (P key)
+	CameraPath m_recordedPath;
+	QTimer m_recordTimer;
+	QElapsedTimer m_recordClock;
+
+	// Benchmark
+	CameraPath m_benchmarkPath;
+	int m_benchmarkFrames;
+	int m_benchmarkFrame; // -1 if it is not running
+	QString m_benchmarkCSV;
+	QElapsedTimer m_benchmarkClock;
+	qint64 m_benchmarkFrameStart;
+	GLuint m_benchmarkQueries[BENCHMARK_QUERY_FRAMES * SSAORenderer::NUM_PASSES];
+	std::vector<TimingSeries> m_benchmarkTimes;
+	QString m_benchmarkCapture;
+
+	// Capture of the frames (G key)
+	FrameCapture m_capture;
 
 	// FPS
 	QTime m_time;
 	int m_frameCount;
 	float m_fps;
 	bool m_showFps;
-
-	bool flag_ssao = false;
-	bool usingSSAO = true;
-	float ssao_intensity = 0.2f;
-	bool drawSSAO = false;
-
 };
 
 #endif
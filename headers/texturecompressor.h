@@ -0,0 +1,59 @@
+#ifndef TEXTURECOMPRESSOR_H
+#define TEXTURECOMPRESSOR_H
+
+#include <string>
+#include <vector>
+
+// GL formats of the compressed textures (not in the 3.3 core headers)
+#define TEX_FORMAT_BC1 0x83F0 // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define TEX_FORMAT_BC3 0x83F3 // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define TEX_FORMAT_BC5 0x8DBD // GL_COMPRESSED_RG_RGTC2
+
+// One mip level: RGBA8 texels or compressed 4x4 blocks
+struct TextureLevel {
+	int width;
+	int height;
+	std::vector<unsigned char> data;
+};
+
+// Texture with its whole mip chain, as stored in a KTX file. glFormat is one
+// of the TEX_FORMAT_* values.
+struct CompressedTexture {
+	unsigned int glFormat;
+	unsigned int glBaseFormat;
+	std::vector<TextureLevel> levels;
+
+	bool isEmpty() const { return levels.empty(); }
+};
+
+// Block compression of textures into BC1 (RGB), BC3 (RGBA) and BC5 (two
+// channels, for the X and Y of normal maps) and KTX 1.1 files to store them.
+// It does not depend on Qt, so it is shared by the texture loader of the
+// widgets and the AGTexConv tool.
+// Images are RGBA8 with the bottom row first, as GL expects them.
+class TextureCompressor {
+public:
+	// Mip chain down to 1x1 (level 0 is the image itself). The texels of
+	// normal maps are averaged as vectors and normalized again.
+	static std::vector<TextureLevel> buildMipChain(const unsigned char *rgba, int width, int height, bool normalMap);
+
+	// Compresses every level into glFormat
+	static CompressedTexture compress(const std::vector<TextureLevel> &mipChain, unsigned int glFormat);
+
+	// RGBA8 texels of a compressed level. The Z of BC5 normals is rebuilt.
+	static TextureLevel decompress(const TextureLevel &level, unsigned int glFormat);
+
+	// Bytes of one level in glFormat
+	static int levelSize(int width, int height, unsigned int glFormat);
+
+	static bool saveKTX(const std::string &filename, const CompressedTexture &texture);
+	static bool loadKTX(const std::string &filename, CompressedTexture &texture);
+
+private:
+	static void compressColorBlock(const unsigned char block[64], unsigned char *out);
+	static void compressChannelBlock(const unsigned char block[64], int channel, unsigned char *out);
+	static void decompressColorBlock(const unsigned char *in, bool threeColorMode, unsigned char block[64]);
+	static void decompressChannelBlock(const unsigned char *in, int channel, unsigned char block[64]);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Lock-free hand-over of the latest value from one producer thread to one
+// consumer thread. Each side owns one of three slots and swaps it with the
+// middle one, so neither side ever waits: the consumer gets the newest
+// complete value and the older ones are dropped.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : m_middle(1), m_back(0), m_front(2) {}
+
+	// Producer: fill back(), then publish() it
+	T& back() { return m_slots[m_back]; }
+	void publish() { m_back = m_middle.exchange(m_back | NEW_BIT) & INDEX_MASK; }
+
+	// Consumer: update() takes the last published value into front(). false if
+	// nothing was published since the last call (front() is unchanged).
+	bool update()
+	{
+		if (!(m_middle.load() & NEW_BIT))
+			return false;
+		m_front = m_middle.exchange(m_front) & INDEX_MASK;
+		return true;
+	}
+	T& front() { return m_slots[m_front]; }
+
+	// Every slot, once neither thread uses them (to release them)
+	T& slot(int i) { return m_slots[i]; }
+
+private:
+	enum { INDEX_MASK = 3, NEW_BIT = 4 };
+
+	T m_slots[3];
+	std::atomic<int> m_middle;
+	int m_back;  // producer only
+	int m_front; // consumer only
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLContext>
+
+#include "../glm/glm.hpp"
+
+#define UNIFORM_RING_FRAMES 3 // Frames whose uniforms can be in flight
+#define UNIFORM_RING_FRAME_SIZE (256 * 1024) // Bytes of one frame segment
+
+// Binding points of the uniform blocks declared by the model shaders
+#define UBO_FRAME_BINDING 0
+#define UBO_OBJECT_BINDING 1
+
+// std140 block "Frame", once per frame
+struct FrameUniforms {
+	glm::mat4 projTransform;
+	glm::mat4 viewTransform;
+};
+
+// std140 block "Object", once per draw. The normal matrix is computed here,
+// once per object, instead of an inverse in every vertex.
+struct ObjectUniforms {
+	glm::mat4 sceneTransform;
+	glm::mat4 modelViewTransform;
+	glm::vec4 normalMatrix[3]; // mat3: std140 pads its columns to vec4
+
+	ObjectUniforms(const glm::mat4 &model, const glm::mat4 &view);
+};
+
+// Uniform buffer written as a ring: every frame uses its own segment, which
+// is only written again once a fence tells that the GPU finished that frame,
+// so uploads never wait for draws in flight. Blocks are bound with
+// glBindBufferRange at their offset. Like the pixel buffer of the
+// AsyncTextureLoader, the ring is persistently mapped with ARB_buffer_storage
+// and mapped block by block otherwise.
+class UniformRing : protected QOpenGLFunctions_3_3_Core
+{
+public:
+	UniformRing();
+
+	// Called from initializeGL and cleanup, with the context current
+	void initializeGL();
+	void cleanup();
+
+	// Assigns the Frame and Object blocks of program to their binding points
+	void bindBlocks(GLuint program);
+
+	// Every paintGL writes its blocks between these two calls
+	void beginFrame();
+	void endFrame();
+
+	void bind(GLuint binding, const void *data, GLsizeiptr size);
+	void bindFrame(const FrameUniforms &frame) { bind(UBO_FRAME_BINDING, &frame, sizeof(frame)); }
+	void bindObject(const ObjectUniforms &object) { bind(UBO_OBJECT_BINDING, &object, sizeof(object)); }
+
+private:
+	void waitSegment(int segment);
+
+	typedef void (QOPENGLF_APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+	GLuint m_ubo;
+	uchar* m_persistentPtr;
+	GLint m_alignment;
+	GLsync m_fences[UNIFORM_RING_FRAMES];
+	int m_segment;
+	GLintptr m_offset; // inside the segment
+	bool m_overflowReported;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef VERTEXQUANTIZER_H
+#define VERTEXQUANTIZER_H
+
+// Compact encodings of the vertex attributes, decoded by the vertex shaders
+// (positions and normals) or by the vertex fetch (the normalized and half
+// float ones). Every encoding has its decoding here too, to measure the
+// error it makes.
+class VertexQuantizer {
+public:
+	// 16-bit unsigned normalized coordinates of p inside the box, which must
+	// contain it. A flat axis of the box is 0.
+	static void quantizePosition(const float p[3], const float boxMin[3], const float boxMax[3], unsigned short q[3]);
+	static void dequantizePosition(const unsigned short q[3], const float boxMin[3], const float boxMax[3], float p[3]);
+
+	// Octahedral mapping of a unit vector, in two snorm16 (x / 32767). A null
+	// vector is encoded as +z.
+	static void encodeOctahedral(const float n[3], short e[2]);
+	static void decodeOctahedral(const short e[2], float n[3]);
+
+	// IEEE 754 half float, rounded to the nearest even
+	static unsigned short toHalf(float value);
+	static float fromHalf(unsigned short half);
+
+	// 8-bit unsigned normalized, clamped to [0, 1]
+	static unsigned char toUnorm8(float value);
+};
+
+#endif
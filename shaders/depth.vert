@@ -0,0 +1,49 @@
+#version 330 core
+layout (location = 0) in vec4 aPos;
+
+// Per instance (stress test)
+in mat4 instanceModel;
+
+layout (std140) uniform Frame {
+	mat4 projTransform;
+	mat4 viewTransform;
+};
+
+layout (std140) uniform Object {
+	mat4 sceneTransform;
+	mat4 modelViewTransform;
+	mat3 normalMatrix;
+};
+
+uniform bool instanced;
+
+// Quantized vertices (Model::quantizeVertices): 16-bit positions in the box
+// of their submesh, whose index is in w. Decoded as in gbuffer.vert.
+uniform bool quantized;
+uniform samplerBuffer positionBoxes; // min and extent texels of every box
+
+vec3 decodePosition(vec4 p)
+{
+	if (!quantized)
+		return p.xyz;
+	int box = int(p.w * 65535.0 + 0.5);
+	return texelFetch(positionBoxes, 2 * box).xyz + p.xyz * texelFetch(positionBoxes, 2 * box + 1).xyz;
+}
+
+// Depth pre-pass: the same transforms as gbuffer.vert, so the G-buffer pass
+// finds the same depths with its equal test
+invariant gl_Position;
+
+void main()
+{
+    vec3 position = decodePosition(aPos);
+    vec4 vertexOCS;
+    if (instanced) {
+        mat4 instanceView = viewTransform * instanceModel;
+        vertexOCS = instanceView * sceneTransform * vec4(position, 1.0);
+    }
+    else {
+        vertexOCS = modelViewTransform * vec4(position, 1.0);
+    }
+    gl_Position = projTransform * vertexOCS;
+}
@@ -0,0 +1,133 @@
+#version 330 core
+
+// FXAA on the lit image: the luma contrast around each pixel finds the
+// aliased edges, the edge is followed on both sides to find how far the
+// pixel is from the end of its staircase step, and the image is sampled
+// (bilinear) that far across the edge. Small features also blend with
+// their neighbours by how much they stand out (subpixel aliasing).
+in vec2 TexCoords;
+
+uniform sampler2D image;
+uniform float edgeThreshold; // contrast of an edge, relative to the brightest luma
+uniform int searchSteps;
+
+out vec4 FragColor;
+
+#define EDGE_THRESHOLD_MIN 0.0312 // dark areas are left alone
+#define SUBPIXEL_QUALITY 0.75
+
+float luma(vec4 color)
+{
+	return dot(color.rgb, vec3(0.299, 0.587, 0.114));
+}
+
+// The first steps follow the edge pixel by pixel, the next ones go faster
+float stepSize(int step)
+{
+	return step < 5 ? 1.0 : (step < 8 ? 2.0 : 4.0);
+}
+
+void main()
+{
+	vec2 texel = 1.0 / vec2(textureSize(image, 0));
+	vec4 center = texture(image, TexCoords);
+
+	float lumaM = luma(center);
+	float lumaS = luma(textureOffset(image, TexCoords, ivec2(0, -1)));
+	float lumaN = luma(textureOffset(image, TexCoords, ivec2(0, 1)));
+	float lumaW = luma(textureOffset(image, TexCoords, ivec2(-1, 0)));
+	float lumaE = luma(textureOffset(image, TexCoords, ivec2(1, 0)));
+
+	float lumaMin = min(lumaM, min(min(lumaS, lumaN), min(lumaW, lumaE)));
+	float lumaMax = max(lumaM, max(max(lumaS, lumaN), max(lumaW, lumaE)));
+	float range = lumaMax - lumaMin;
+	if (range < max(EDGE_THRESHOLD_MIN, lumaMax * edgeThreshold)) {
+		FragColor = center;
+		return;
+	}
+
+	float lumaSW = luma(textureOffset(image, TexCoords, ivec2(-1, -1)));
+	float lumaNE = luma(textureOffset(image, TexCoords, ivec2(1, 1)));
+	float lumaNW = luma(textureOffset(image, TexCoords, ivec2(-1, 1)));
+	float lumaSE = luma(textureOffset(image, TexCoords, ivec2(1, -1)));
+
+	// Horizontal or vertical edge
+	float lumaSN = lumaS + lumaN;
+	float lumaWE = lumaW + lumaE;
+	float lumaWCorners = lumaSW + lumaNW;
+	float lumaECorners = lumaSE + lumaNE;
+	float lumaSCorners = lumaSW + lumaSE;
+	float lumaNCorners = lumaNW + lumaNE;
+	float edgeHorizontal = abs(-2.0 * lumaW + lumaWCorners) + 2.0 * abs(-2.0 * lumaM + lumaSN) + abs(-2.0 * lumaE + lumaECorners);
+	float edgeVertical = abs(-2.0 * lumaN + lumaNCorners) + 2.0 * abs(-2.0 * lumaM + lumaWE) + abs(-2.0 * lumaS + lumaSCorners);
+	bool horizontal = edgeHorizontal >= edgeVertical;
+
+	// Side of the edge: the neighbour with the steepest gradient
+	float luma1 = horizontal ? lumaS : lumaW;
+	float luma2 = horizontal ? lumaN : lumaE;
+	float gradient1 = luma1 - lumaM;
+	float gradient2 = luma2 - lumaM;
+	bool steepest1 = abs(gradient1) >= abs(gradient2);
+	float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+
+	float stepLength = horizontal ? texel.y : texel.x;
+	float lumaLocalAverage;
+	if (steepest1) {
+		stepLength = -stepLength;
+		lumaLocalAverage = 0.5 * (luma1 + lumaM);
+	}
+	else {
+		lumaLocalAverage = 0.5 * (luma2 + lumaM);
+	}
+
+	// Follow the edge, half a pixel towards that side, until the luma
+	// changes on both ends
+	vec2 edgeUV = TexCoords;
+	if (horizontal)
+		edgeUV.y += 0.5 * stepLength;
+	else
+		edgeUV.x += 0.5 * stepLength;
+	vec2 offset = horizontal ? vec2(texel.x, 0.0) : vec2(0.0, texel.y);
+
+	vec2 uv1 = edgeUV - offset;
+	vec2 uv2 = edgeUV + offset;
+	float lumaEnd1 = luma(texture(image, uv1)) - lumaLocalAverage;
+	float lumaEnd2 = luma(texture(image, uv2)) - lumaLocalAverage;
+	bool reached1 = abs(lumaEnd1) >= gradientScaled;
+	bool reached2 = abs(lumaEnd2) >= gradientScaled;
+	for (int step = 1; step < searchSteps && !(reached1 && reached2); ++step) {
+		if (!reached1) {
+			uv1 -= offset * stepSize(step);
+			lumaEnd1 = luma(texture(image, uv1)) - lumaLocalAverage;
+			reached1 = abs(lumaEnd1) >= gradientScaled;
+		}
+		if (!reached2) {
+			uv2 += offset * stepSize(step);
+			lumaEnd2 = luma(texture(image, uv2)) - lumaLocalAverage;
+			reached2 = abs(lumaEnd2) >= gradientScaled;
+		}
+	}
+
+	// Offset across the edge from the nearest end, if the luma at that end
+	// goes the way of the center
+	float distance1 = horizontal ? TexCoords.x - uv1.x : TexCoords.y - uv1.y;
+	float distance2 = horizontal ? uv2.x - TexCoords.x : uv2.y - TexCoords.y;
+	bool nearest1 = distance1 < distance2;
+	float pixelOffset = 0.5 - min(distance1, distance2) / (distance1 + distance2);
+	bool centerSmaller = lumaM < lumaLocalAverage;
+	bool correctVariation = ((nearest1 ? lumaEnd1 : lumaEnd2) < 0.0) != centerSmaller;
+	float finalOffset = correctVariation ? pixelOffset : 0.0;
+
+	// Subpixel aliasing
+	float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaSN + lumaWE) + lumaWCorners + lumaECorners);
+	float subPixel = clamp(abs(lumaAverage - lumaM) / range, 0.0, 1.0);
+	subPixel = (-2.0 * subPixel + 3.0) * subPixel * subPixel;
+	finalOffset = max(finalOffset, subPixel * subPixel * SUBPIXEL_QUALITY);
+
+	vec2 finalUV = TexCoords;
+	if (horizontal)
+		finalUV.y += finalOffset * stepLength;
+	else
+		finalUV.x += finalOffset * stepLength;
+	FragColor = texture(image, finalUV);
+}
@@ -2,10 +2,13 @@
 
 layout (location = 0) out vec3 gPosition;
 layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoSpec;
+layout (location = 2) out vec4 gAlbedoSpec; // diffuse and shininess
+layout (location = 3) out vec4 gSpecular;
+layout (location = 4) out vec4 gOverdraw; // added up, if it is bound
 
 in vec2 TexCoords;
 in vec3 Normal;
+in vec4 Tangent;
 in mat4 fProjection;
 
 in vec4 vertexOCS;
@@ -14,51 +17,25 @@ in vec3 fmatdiff;
 in vec3 fmatspec;
 in float fmatshin;
 
-uniform vec4 lightPos;
-uniform vec3 lightCol;
-
-vec3 Lambert (vec3 NormOCS, vec3 L)
-{
-  // We assume that vectors are normalized
-
-  // Color initialization with the ambient color
-  vec3 resultCol = vec3(0.0);
-
-  // Add the diffuse component
-  if (dot (L, NormOCS) > 0)
-    resultCol += lightCol * fmatdiff * dot (L, NormOCS);
-
-  return (resultCol);
-}
-
-vec3 Phong (vec3 NormOCS, vec3 L, vec4 vertOCS)
-{
-  // We assume that vectors are normalized
-
-  // Color initialization with the Lambert color
-  vec3 resultCol = Lambert (NormOCS, L);
-
-  // R and V computation
-  if (dot(NormOCS, L) < 0)
-    // There is no specular component
-    return resultCol;
-
-  vec3 R = reflect(-L, NormOCS); // equivalent to: normalize (2.0*dot(NormOCS,L)*NormOCS - L);
-  vec3 V = normalize(-vertOCS.xyz);
-
-  if ((dot(R, V) < 0) || (fmatshin == 0))
-    // There is no specular component
-    return resultCol;
-
-  // We add the specular component
-  float shine = pow(max(0.0, dot(R, V)), fmatshin);
-  return (resultCol + fmatspec * lightCol * shine);
-}
+// Tangent space normal map, if the model has tangents (Model::VBO_tangents)
+uniform bool normalMapped;
+uniform sampler2D normalMap;
 
 void main()
 {	
+	// Lit by the light pass
 	gPosition = vertexOCS.xyz;
 	gNormal = normalize(Normal);
-	vec3 L = normalize(lightPos.xyz - vec3(vertexOCS).xyz);
-	gAlbedoSpec = vec4(Phong(normalize(Normal), L, vertexOCS), 1);
+	if (normalMapped) {
+		// The interpolated frame is orthonormalized again, the bitangent is
+		// rebuilt from the handedness as it was generated
+		vec3 N = gNormal;
+		vec3 T = normalize(Tangent.xyz - dot(Tangent.xyz, N) * N);
+		vec3 B = Tangent.w * cross(N, T);
+		vec3 n = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+		gNormal = normalize(T * n.x + B * n.y + N * n.z);
+	}
+	gAlbedoSpec = vec4(fmatdiff, fmatshin);
+	gSpecular = vec4(fmatspec, 1); // alpha: covered by geometry
+	gOverdraw = vec4(1.0);
 }
\ No newline at end of file
@@ -1,15 +1,21 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec4 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aTangent; // w: handedness of the bitangent
 
 in vec3 matamb;
 in vec3 matdiff;
 in vec3 matspec;
 in float matshin;
 
+// Per instance (stress test)
+in mat4 instanceModel;
+in vec4 instanceDiffuse;
+
 out vec2 TexCoords;
 out vec3 Normal;
+out vec4 Tangent;
 out mat4 fProjection;
 
 // Observer Coordinate System
@@ -19,23 +25,88 @@ out vec3 fmatdiff;
 out vec3 fmatspec;
 out float fmatshin;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Frame {
+	mat4 projTransform;
+	mat4 viewTransform;
+};
+
+// normalMatrix: inverse transpose of modelViewTransform, from the CPU
+layout (std140) uniform Object {
+	mat4 sceneTransform;
+	mat4 modelViewTransform;
+	mat3 normalMatrix;
+};
+
+uniform bool instanced;
+uniform vec4 diffuseOverride; // rgb, weighted by a (if not instanced)
+
+// Quantized vertices (Model::quantizeVertices): 16-bit positions in the box
+// of their submesh, whose index is in w, and octahedral normals and tangents
+uniform bool quantized;
+uniform samplerBuffer positionBoxes; // min and extent texels of every box
+
+vec3 decodePosition(vec4 p)
+{
+	if (!quantized)
+		return p.xyz;
+	int box = int(p.w * 65535.0 + 0.5);
+	return texelFetch(positionBoxes, 2 * box).xyz + p.xyz * texelFetch(positionBoxes, 2 * box + 1).xyz;
+}
 
+// The normals are fetched as integers: the snorm16 to float conversion of
+// the vertex fetch differs between GL versions
+vec3 decodeOctahedral(vec2 q)
+{
+	vec2 e = max(q / 32767.0, -1.0);
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
+vec3 decodeNormal(vec4 n)
+{
+	if (!quantized)
+		return n.xyz;
+	return decodeOctahedral(n.xy);
+}
+
+// The handedness is stored as +-32767
+vec4 decodeTangent(vec4 t)
+{
+	if (!quantized)
+		return t;
+	return vec4(decodeOctahedral(t.xy), t.z < 0.0 ? -1.0 : 1.0);
+}
 
+// Same depth as depth.vert, for the equal depth test after the pre-pass
+invariant gl_Position;
 
 void main()
 {
 	fmatamb = matamb;
-	fmatdiff = matdiff;
+	vec4 override = instanced ? instanceDiffuse : diffuseOverride;
+	fmatdiff = mix(matdiff, override.rgb, override.a);
 	fmatspec = matspec;
 	fmatshin = matshin;
 
-    vertexOCS = view * model * vec4(aPos, 1.0);
     TexCoords = aTexCoords;
-    fProjection = projection;
-    mat3 normalMatrix = transpose(inverse(mat3(view * model)));
-    Normal = normalMatrix * aNormal;
-    gl_Position = projection * vertexOCS;
+    vec3 position = decodePosition(aPos);
+    vec3 normal = decodeNormal(aNormal);
+    vec4 tangent = decodeTangent(aTangent);
+    fProjection = projTransform;
+    if (instanced) {
+        // The view and the instances are rigid, so the normal matrix of the
+        // object only has to be taken back to world space and placed again
+        mat4 instanceView = viewTransform * instanceModel;
+        vertexOCS = instanceView * sceneTransform * vec4(position, 1.0);
+        Normal = mat3(instanceView) * (transpose(mat3(viewTransform)) * (normalMatrix * normal));
+        Tangent = vec4(mat3(instanceView * sceneTransform) * tangent.xyz, tangent.w);
+    }
+    else {
+        vertexOCS = modelViewTransform * vec4(position, 1.0);
+        Normal = normalMatrix * normal;
+        Tangent = vec4(mat3(modelViewTransform) * tangent.xyz, tangent.w);
+    }
+    gl_Position = projTransform * vertexOCS;
 }
\ No newline at end of file
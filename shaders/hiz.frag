@@ -0,0 +1,21 @@
+#version 330 core
+
+// Low resolution copy of the depth buffer for the occlusion culling: every
+// texel keeps the farthest depth of the texelSize x texelSize pixels it covers
+uniform sampler2D depth;
+uniform int texelSize;
+
+out float FarDepth;
+
+void main()
+{
+	ivec2 size = textureSize(depth, 0);
+	ivec2 first = ivec2(gl_FragCoord.xy) * texelSize;
+	ivec2 last = min(first + texelSize, size);
+
+	float farthest = 0.0;
+	for (int y = first.y; y < last.y; ++y)
+		for (int x = first.x; x < last.x; ++x)
+			farthest = max(farthest, texelFetch(depth, ivec2(x, y), 0).r);
+	FarDepth = farthest;
+}
@@ -4,88 +4,119 @@ in vec2 TexCoords;
 
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
-uniform sampler2D gAlbedoSpec;
-uniform sampler2D texNoise;
-uniform vec3 samples[64];
+uniform sampler2D gAlbedoSpec; // diffuse and shininess
+uniform sampler2D gSpecular; // alpha 0 where there is no geometry
+uniform sampler2D ssao; // written by ssao.frag
 
-uniform mat4 projection;
+// Lights in view coordinates, two texels each: position and radius (0 for no
+// attenuation), then color
+uniform samplerBuffer lights;
 
-uniform int useSSAO;
-uniform int drawSSAO;
+// Screen tiles of tileSize pixels: first index and count of their lights in
+// lightIndices (see LightGrid)
+uniform usamplerBuffer lightTiles;
+uniform usamplerBuffer lightIndices;
+uniform int tileSize;
+uniform int tilesX;
 
-int kernelSize = 64;
-float radius = 0.5;
-float bias = 0.025;
+// Fragments shaded per pixel by the G-buffer pass
+uniform sampler2D gOverdraw;
+uniform int drawOverdraw;
 
-//Tile noise scale
-uniform float screenWidth;
-uniform float screenHeight;
-uniform float tileSize;
+uniform int useSSAO;
+uniform int drawSSAO;
 
-vec2 noiseScale = vec2(screenWidth / tileSize, screenHeight / tileSize);
 uniform float ssaoIntensity;
 
 out vec4 FragColor;
 
-float CalcOcclusion(vec2 texCoord)
+vec3 Phong (vec3 NormOCS, vec3 L, vec3 V, vec3 lightCol, vec3 matdiff, vec3 matspec, float matshin)
 {
-	vec3 pixelPos = texture(gPosition, texCoord).xyz;
-	vec3 pixelNormal = normalize(((texture(gNormal, texCoord).rgb) + 1.0) * 0.5);
-	vec3 randomVec = normalize(texture(texNoise, texCoord * noiseScale).xyz);
-	// TBN matrix
-	vec3 tangent = normalize(randomVec - pixelNormal * dot(randomVec, pixelNormal));
-	vec3 bitangent = cross(pixelNormal, tangent);
-	mat3 TBN = mat3(tangent, bitangent, pixelNormal);
-
-	float occlusion = 0.0;
-	for(int i = 0; i < kernelSize; ++i)
-	{
-		vec3 samp = TBN * samples[i];
-		samp = pixelPos + samp * radius;
+  // We assume that vectors are normalized
 
-		vec4 offset = vec4(samp, 1.0);
-		offset = projection * offset; // convert from view to screen-space
-		offset.xyz /= offset.w; // divide prespective
-		offset.xyz = offset.xyz * 0.5 + 0.5; // Range 0.0 to 1.0
+  // Diffuse component
+  if (dot (L, NormOCS) <= 0)
+    return vec3(0.0);
+  vec3 resultCol = lightCol * matdiff * dot (L, NormOCS);
 
-		float sampleDepth = texture(gPosition, offset.xy).z;
-		float rangeCheck = smoothstep(0.0, 1.0, radius / abs(pixelPos.z - sampleDepth));
-		occlusion += (sampleDepth >= samp.z + bias ? 1.0 : 0.0) * rangeCheck;
-	}
+  vec3 R = reflect(-L, NormOCS); // equivalent to: normalize (2.0*dot(NormOCS,L)*NormOCS - L);
 
-	occlusion = 1 - (occlusion / kernelSize);
+  if ((dot(R, V) < 0) || (matshin == 0))
+    // There is no specular component
+    return resultCol;
 
-	return occlusion;
+  // We add the specular component
+  float shine = pow(max(0.0, dot(R, V)), matshin);
+  return (resultCol + matspec * lightCol * shine);
 }
 
-void main()
+vec4 Shade()
 {
-	vec4 pixel = texture(gAlbedoSpec, TexCoords);
+	vec4 albedo = texture(gAlbedoSpec, TexCoords);
+	vec4 specular = texture(gSpecular, TexCoords);
+	if (specular.a < 0.5)
+		return albedo; // background
 
-	if(useSSAO == 1 || drawSSAO == 1)
+	vec3 position = texture(gPosition, TexCoords).xyz;
+	vec3 normal = normalize(texture(gNormal, TexCoords).xyz);
+	vec3 V = normalize(-position);
+
+	// Only the lights that reach the tile of this pixel
+	ivec2 tile = ivec2(gl_FragCoord.xy) / tileSize;
+	uvec2 range = texelFetch(lightTiles, tile.y * tilesX + tile.x).xy;
+
+	vec3 color = vec3(0.0);
+	for (uint i = range.x; i < range.x + range.y; ++i)
 	{
-		float occlusion = 0.0;
-		vec2 textelSize = 1.0 / vec2(screenWidth, screenHeight);
-		for(int x = -2; x < 2; ++x)
+		int light = int(texelFetch(lightIndices, int(i)).r);
+		vec4 positionRadius = texelFetch(lights, 2 * light);
+		vec3 lightCol = texelFetch(lights, 2 * light + 1).rgb;
+
+		vec3 toLight = positionRadius.xyz - position;
+		float dist = max(length(toLight), 1e-4);
+		float attenuation = 1.0;
+		if (positionRadius.w > 0.0)
 		{
-			for(int y = -2; y < 2; ++y)
-			{
-				vec2 offset = vec2(float(x), float(y)) * textelSize;
-				occlusion += CalcOcclusion(TexCoords + offset); 
-			}
+			attenuation = clamp(1.0 - dist / positionRadius.w, 0.0, 1.0);
+			attenuation *= attenuation;
 		}
-		occlusion = occlusion / 16.0;
+		if (attenuation > 0.0)
+			color += attenuation * Phong(normal, toLight / dist, V, lightCol, albedo.rgb, specular.rgb, albedo.a);
+	}
+	return vec4(color, 1.0);
+}
 
-		if(drawSSAO == 1)
-		{
-			FragColor = vec4(vec3(occlusion), 1.0);
-			return;
-		}
+// Green where each pixel was shaded once, to red from 4 times
+vec3 Heat(float count)
+{
+	if (count < 0.5)
+		return vec3(0.0);
+	return mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), clamp((count - 1.0) / 3.0, 0.0, 1.0));
+}
+
+void main()
+{
+	if(drawOverdraw == 1)
+	{
+		FragColor = vec4(Heat(texture(gOverdraw, TexCoords).r), 1.0);
+		return;
+	}
 
+	if(drawSSAO == 1)
+	{
+		FragColor = vec4(vec3(texture(ssao, TexCoords).r), 1.0);
+		return;
+	}
+
+	vec4 pixel = Shade();
+
+	if(useSSAO == 1)
+	{
+		float occlusion = texture(ssao, TexCoords).r;
 		pixel += vec4(vec3(1.0)*occlusion * ssaoIntensity, 1.0);
 	}
 	else
 		pixel += vec4(vec3(1.0)*ssaoIntensity, 1.0);
-	
+
 	FragColor = pixel;
 }
@@ -1,7 +1,8 @@
 #version 330 core
 
-in vec3 vertex;
-in vec2 vertTexCoords;
+// Fixed locations: the AO, light and Hi-Z programs share the quad VAO
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec2 vertTexCoords;
 
 out vec2 TexCoords;
 
@@ -1,15 +1,46 @@
 #version 330 core
 
-in vec3 vertex;
-in vec3 normal;
+in vec4 vertex;
+in vec4 normal;
 in vec3 matamb;
 in vec3 matdiff;
 in vec3 matspec;
 in float matshin;
 
-uniform mat4 projTransform;
-uniform mat4 viewTransform;
-uniform mat4 sceneTransform;
+layout (std140) uniform Frame {
+	mat4 projTransform;
+	mat4 viewTransform;
+};
+
+// normalMatrix: inverse transpose of modelViewTransform, from the CPU
+layout (std140) uniform Object {
+	mat4 sceneTransform;
+	mat4 modelViewTransform;
+	mat3 normalMatrix;
+};
+
+// Quantized vertices (Model::quantizeVertices), decoded as in gbuffer.vert
+uniform bool quantized;
+uniform samplerBuffer positionBoxes;
+
+vec3 decodePosition(vec4 p)
+{
+  if (!quantized)
+    return p.xyz;
+  int box = int(p.w * 65535.0 + 0.5);
+  return texelFetch(positionBoxes, 2 * box).xyz + p.xyz * texelFetch(positionBoxes, 2 * box + 1).xyz;
+}
+
+vec3 decodeNormal(vec4 n)
+{
+  if (!quantized)
+    return n.xyz;
+  vec2 e = max(n.xy / 32767.0, -1.0);
+  vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (v.z < 0.0)
+    v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+  return normalize(v);
+}
 
 // Observer Coordinate System
 out vec4 vertexOCS;
@@ -25,8 +56,7 @@ void main()
   fmatdiff = matdiff;
   fmatspec = matspec;
   fmatshin = matshin;
-  mat3 normalMatrix = inverse(transpose(mat3 (viewTransform * sceneTransform)));
-  normalOCS = normalize(vec3(normalMatrix * normal));
-  vertexOCS = viewTransform * sceneTransform * vec4(vertex, 1);
+  normalOCS = normalize(normalMatrix * decodeNormal(normal));
+  vertexOCS = modelViewTransform * vec4(decodePosition(vertex), 1);
   gl_Position = projTransform * vertexOCS;
 }
@@ -0,0 +1,45 @@
+#version 330 core
+
+// SMAA 1x, last pass: every pixel blends with its four neighbours by the
+// weights of smaaweights.frag, its own for its bottom and left edges and the
+// ones of the top and right neighbours for theirs
+uniform sampler2D image;
+uniform sampler2D weights;
+
+out vec4 FragColor;
+
+bool inside(ivec2 pixel)
+{
+	return all(greaterThanEqual(pixel, ivec2(0))) && all(lessThan(pixel, textureSize(image, 0)));
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 color = texelFetch(image, pixel, 0);
+
+	vec4 w = texelFetch(weights, pixel, 0);
+	ivec2 top = pixel + ivec2(0, 1);
+	ivec2 right = pixel + ivec2(1, 0);
+	float bottomWeight = w.x;
+	float leftWeight = w.z;
+	float topWeight = inside(top) ? texelFetch(weights, top, 0).y : 0.0;
+	float rightWeight = inside(right) ? texelFetch(weights, right, 0).w : 0.0;
+
+	float total = bottomWeight + leftWeight + topWeight + rightWeight;
+	if (total == 0.0) {
+		FragColor = color;
+		return;
+	}
+
+	// Several edges can pull the same pixel, their weights are then shared
+	float keep = max(1.0 - total, 0.0);
+	vec4 blended = keep * color;
+	blended += bottomWeight * texelFetch(image, pixel + ivec2(0, -1), 0);
+	blended += leftWeight * texelFetch(image, pixel + ivec2(-1, 0), 0);
+	if (topWeight > 0.0)
+		blended += topWeight * texelFetch(image, top, 0);
+	if (rightWeight > 0.0)
+		blended += rightWeight * texelFetch(image, right, 0);
+	FragColor = blended / (keep + total);
+}
@@ -0,0 +1,43 @@
+#version 330 core
+
+// SMAA 1x, first pass: luma edges between every pixel and its left and
+// bottom neighbours. An edge is only kept if it is not much weaker than the
+// other edges around it (local contrast adaptation), so the faint steps next
+// to a strong edge are not blended.
+uniform sampler2D image;
+uniform float threshold;
+
+out vec4 Edges; // left and bottom
+
+float lumaAt(ivec2 pixel)
+{
+	pixel = clamp(pixel, ivec2(0), textureSize(image, 0) - 1);
+	return dot(texelFetch(image, pixel, 0).rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float L = lumaAt(pixel);
+	float Lleft = lumaAt(pixel + ivec2(-1, 0));
+	float Lbottom = lumaAt(pixel + ivec2(0, -1));
+
+	vec2 delta = abs(L - vec2(Lleft, Lbottom));
+	vec2 edges = step(threshold, delta);
+	if (edges.x + edges.y == 0.0) {
+		Edges = vec4(0.0);
+		return;
+	}
+
+	float Lright = lumaAt(pixel + ivec2(1, 0));
+	float Ltop = lumaAt(pixel + ivec2(0, 1));
+	float Lleftleft = lumaAt(pixel + ivec2(-2, 0));
+	float Lbottombottom = lumaAt(pixel + ivec2(0, -2));
+
+	vec2 maxDelta = max(delta, abs(L - vec2(Lright, Ltop)));
+	maxDelta = max(maxDelta, abs(vec2(Lleft, Lbottom) - vec2(Lleftleft, Lbottombottom)));
+	float finalDelta = max(maxDelta.x, maxDelta.y);
+	edges *= step(finalDelta, 2.0 * delta);
+
+	Edges = vec4(edges, 0.0, 0.0);
+}
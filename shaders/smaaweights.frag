@@ -0,0 +1,93 @@
+#version 330 core
+
+// SMAA 1x, second pass: every edge of smaaedges.frag is followed to both
+// ends of its line (up to searchSteps pixels). The crossing edges at the
+// ends give the shape of the staircase step (L, Z or U), which is rebuilt as
+// lines from the middle of the crossing edges to the middle of the edge
+// line. The area of each pixel on both sides of that line is how much it
+// blends with the pixel across the edge. The areas are computed here instead
+// of read from the precomputed area texture of SMAA.
+uniform sampler2D edges;
+uniform int searchSteps;
+
+// Bottom edge: into this pixel, into the bottom one. Left edge: into this
+// pixel, into the left one.
+out vec4 Weights;
+
+vec2 edgesAt(ivec2 pixel)
+{
+	if (any(lessThan(pixel, ivec2(0))) || any(greaterThanEqual(pixel, textureSize(edges, 0))))
+		return vec2(0.0);
+	return texelFetch(edges, pixel, 0).rg;
+}
+
+// Height of the line at an end: half a pixel into this side if only its
+// crossing edge is there, into the other side if only the neighbour's is,
+// 0 for none, both, or an end that was not reached
+float endHeight(float crossingHere, float crossingNeighbour, bool reached)
+{
+	if (!reached)
+		return 0.0;
+	return 0.5 * (step(0.5, crossingHere) - step(0.5, crossingNeighbour));
+}
+
+// Signed area under the line from height h at an end to 0 at the middle of
+// the edge line, between distances a and b from that end
+float halfArea(float h, float middle, float a, float b)
+{
+	a = clamp(a, 0.0, middle);
+	b = clamp(b, 0.0, middle);
+	return h * ((b - a) - (b * b - a * a) / (2.0 * middle));
+}
+
+// Weights of the pixel d1 and d2 pixels away from the ends of its edge line
+vec2 lineWeights(int d1, int d2, float h1, float h2)
+{
+	float middle = 0.5 * float(d1 + d2 + 1);
+	float a1 = halfArea(h1, middle, float(d1), float(d1 + 1));
+	float a2 = halfArea(h2, middle, float(d2), float(d2 + 1));
+	return vec2(max(a1, 0.0) + max(a2, 0.0), -min(a1, 0.0) - min(a2, 0.0));
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec2 e = edgesAt(pixel);
+	Weights = vec4(0.0);
+
+	if (e.y > 0.5) {
+		// Horizontal line below this pixel. The crossing edges are the left
+		// edges of the pixels at its left end and past its right end, in
+		// this row and in the one below.
+		int d1 = 0;
+		while (d1 < searchSteps && edgesAt(pixel + ivec2(-d1 - 1, 0)).y > 0.5)
+			++d1;
+		int d2 = 0;
+		while (d2 < searchSteps && edgesAt(pixel + ivec2(d2 + 1, 0)).y > 0.5)
+			++d2;
+
+		ivec2 end1 = pixel + ivec2(-d1, 0);
+		ivec2 end2 = pixel + ivec2(d2 + 1, 0);
+		float h1 = endHeight(edgesAt(end1).x, edgesAt(end1 + ivec2(0, -1)).x, d1 < searchSteps);
+		float h2 = endHeight(edgesAt(end2).x, edgesAt(end2 + ivec2(0, -1)).x, d2 < searchSteps);
+		Weights.xy = lineWeights(d1, d2, h1, h2);
+	}
+
+	if (e.x > 0.5) {
+		// Vertical line left of this pixel. The crossing edges are the bottom
+		// edges of the pixels at its bottom end and past its top end, in this
+		// column and in the left one.
+		int d1 = 0;
+		while (d1 < searchSteps && edgesAt(pixel + ivec2(0, -d1 - 1)).x > 0.5)
+			++d1;
+		int d2 = 0;
+		while (d2 < searchSteps && edgesAt(pixel + ivec2(0, d2 + 1)).x > 0.5)
+			++d2;
+
+		ivec2 end1 = pixel + ivec2(0, -d1);
+		ivec2 end2 = pixel + ivec2(0, d2 + 1);
+		float h1 = endHeight(edgesAt(end1).y, edgesAt(end1 + ivec2(-1, 0)).y, d1 < searchSteps);
+		float h2 = endHeight(edgesAt(end2).y, edgesAt(end2 + ivec2(-1, 0)).y, d2 < searchSteps);
+		Weights.zw = lineWeights(d1, d2, h1, h2);
+	}
+}
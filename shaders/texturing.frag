@@ -11,6 +11,8 @@ uniform int tex1Loaded;
 uniform int tex2Loaded;
 uniform sampler2D tex1Texture;
 uniform sampler2D tex2Texture;
+uniform int tex1NormalXY; // Only X and Y of a normal map are stored (BC5)
+uniform int tex2NormalXY;
 uniform vec4 lightPos;
 uniform vec3 lightCol;
 
@@ -18,12 +20,24 @@ const float threshold = 0.02;
 const float mixVal = 0.5;
 const float white = 0.1; // Values greater than this will be considered white
 
+vec4 textureColor(sampler2D tex, int normalXY)
+{
+	vec4 col = texture2D(tex, vertexTexCoords);
+	if (normalXY == 1)
+	{
+		vec2 xy = col.rg * 2.0 - 1.0;
+		col.b = sqrt(max(0.0, 1.0 - dot(xy, xy))) * 0.5 + 0.5;
+		col.a = 1.0;
+	}
+	return col;
+}
+
 void main()
 {
 	 if(tex2Loaded == 1) // 2 textures
 	 {
-		vec4 tex1Col = texture2D(tex1Texture, vertexTexCoords);
-		vec4 tex2Col = texture2D(tex2Texture, vertexTexCoords);
+		vec4 tex1Col = textureColor(tex1Texture, tex1NormalXY);
+		vec4 tex2Col = textureColor(tex2Texture, tex2NormalXY);
 		
 		if(tex2Col.r > threshold)
 			if(tex2Col.r >= white)
@@ -35,7 +49,7 @@ void main()
 	 } 
 	 else if(tex1Loaded == 1) // 1 texture
 	 {
-		FragColor = texture2D(tex1Texture, vertexTexCoords);
+		FragColor = textureColor(tex1Texture, tex1NormalXY);
 	 } 
 	 else // 0 textures
 	 {
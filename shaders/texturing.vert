@@ -5,9 +5,17 @@ in vec3 normal;
 in vec4 color;
 in vec2 texCoords;
 
-uniform mat4 projTransform;
-uniform mat4 viewTransform;
-uniform mat4 sceneTransform;
+layout (std140) uniform Frame {
+	mat4 projTransform;
+	mat4 viewTransform;
+};
+
+// normalMatrix: inverse transpose of modelViewTransform, from the CPU
+layout (std140) uniform Object {
+	mat4 sceneTransform;
+	mat4 modelViewTransform;
+	mat3 normalMatrix;
+};
 
 // Observer Coordinate System
 out vec4 vertexOCS;
@@ -17,9 +25,8 @@ out vec2 vertexTexCoords;
 
 void main()
 {
-    vertexOCS = viewTransform * sceneTransform * vec4(vertex, 1);
-    mat3 normalMatrix = inverse(transpose(mat3 (viewTransform * sceneTransform)));
-    normalOCS = normalize(vec3(normalMatrix * normal));
+    vertexOCS = modelViewTransform * vec4(vertex, 1);
+    normalOCS = normalize(normalMatrix * normal);
     vertexColor = color;
     vertexTexCoords = texCoords;
 
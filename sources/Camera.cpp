@@ -91,6 +91,36 @@ const int Camera::GetType() const
 	return type;
 }
 
+float Camera::GetFov() const
+{
+	return m_fov;
+}
+
+CameraState Camera::GetState() const
+{
+	CameraState state;
+	state.position = m_camPos;
+	state.xRot = m_xRotCam;
+	state.yRot = m_yRotCam;
+	state.xPan = m_xPan;
+	state.yPan = m_yPan;
+	state.fov = m_fov;
+	return state;
+}
+
+void Camera::SetState(const CameraState &state)
+{
+	m_camPos = state.position;
+	m_xRotCam = state.xRot;
+	m_yRotCam = state.yRot;
+	m_xPan = state.xPan;
+	m_yPan = state.yPan;
+	m_fov = state.fov;
+
+	Update();
+	UpdateProjection();
+}
+
 void Camera::Update()
 {
 	if (type == 1)
@@ -0,0 +1,384 @@
+#include "asynctextureloader.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDateTime>
+#include <QFileInfo>
+
+#include <cstring>
+#include <iostream>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// Runs on a worker thread: QImage, unlike QPixmap, can be used there
+AsyncTextureLoader::DecodedTexture AsyncTextureLoader::decodeTexture(const QString &filename, const QString &ktxFilename)
+{
+	DecodedTexture decoded;
+	if (!ktxFilename.isEmpty() && TextureCompressor::loadKTX(ktxFilename.toStdString(), decoded.compressed)) {
+		// The preview shows the compressed texels
+		TextureLevel level = TextureCompressor::decompress(decoded.compressed.levels[0], decoded.compressed.glFormat);
+		decoded.image = QImage(level.width, level.height, QImage::Format_RGBA8888);
+		for (int y = 0; y < level.height; ++y)
+			memcpy(decoded.image.scanLine(y), &level.data[(size_t)y * level.width * 4], level.width * 4);
+		return decoded;
+	}
+
+	QImage image(filename);
+	if (!image.isNull())
+		decoded.image = image.mirrored().convertToFormat(QImage::Format_RGBA8888);
+	return decoded;
+}
+
+AsyncTextureLoader::AsyncTextureLoader(QOpenGLWidget *widget) : QObject(widget)
+{
+	m_widget = widget;
+	m_initialized = false;
+
+	m_bufferStorage = nullptr;
+	m_pbo = 0;
+	m_slotSize = 0;
+	m_persistentPtr = nullptr;
+	for (int i = 0; i < TEX_UPLOAD_SLOTS; ++i)
+		m_slotFences[i] = 0;
+	m_nextSlot = 0;
+	m_s3tcSupported = true;
+
+	m_clock.start();
+
+	// A few slices are copied on each pass of the event loop
+	m_uploadTimer.setInterval(0);
+	connect(&m_uploadTimer, &QTimer::timeout, this, &AsyncTextureLoader::uploadStep);
+}
+
+AsyncTextureLoader::~AsyncTextureLoader()
+{
+	// The GL objects are released by cleanup(), the watchers are children
+}
+
+void AsyncTextureLoader::initializeGL()
+{
+	initializeOpenGLFunctions();
+
+	// Persistent mapping (core since 4.4)
+	QOpenGLContext* context = m_widget->context();
+	m_bufferStorage = nullptr;
+	if (context->format().version() >= qMakePair(4, 4) ||
+		context->hasExtension(QByteArrayLiteral("GL_ARB_buffer_storage")))
+		m_bufferStorage = reinterpret_cast<BufferStorageProc>(context->getProcAddress("glBufferStorage"));
+
+	// BC1 and BC3 (BC5 is core since 3.0)
+	m_s3tcSupported = context->hasExtension(QByteArrayLiteral("GL_EXT_texture_compression_s3tc"));
+
+	m_initialized = true;
+
+	// Images decoded while there was no context
+	if (!m_jobs.isEmpty())
+		m_uploadTimer.start();
+}
+
+void AsyncTextureLoader::cleanup()
+{
+	if (!m_initialized)
+		return;
+
+	// Half-uploaded textures are lost with the context, their images are kept
+	// and uploaded again once there is a new one
+	for (int i = 0; i < m_jobs.size(); ++i) {
+		UploadJob &job = m_jobs[i];
+		if (job.done)
+			glDeleteSync(job.done);
+		if (job.texture)
+			glDeleteTextures(1, &job.texture);
+		job.done = 0;
+		job.texture = 0;
+		job.nextRow = 0;
+	}
+
+	deletePixelBuffer();
+	m_uploadTimer.stop();
+	m_initialized = false;
+}
+
+void AsyncTextureLoader::load(int slot, const QString &filename)
+{
+	cancel(slot);
+
+	// Compressed version written by AGTexConv, unless the image changed since
+	QFileInfo image(filename);
+	QFileInfo ktx(image.path() + "/" + image.completeBaseName() + ".ktx");
+	QString ktxFilename;
+	if (ktx.exists() && (!image.exists() || ktx.lastModified() >= image.lastModified()))
+		ktxFilename = ktx.filePath();
+
+	QFutureWatcher<DecodedTexture>* watcher = new QFutureWatcher<DecodedTexture>(this);
+	connect(watcher, &QFutureWatcher<DecodedTexture>::finished, this, &AsyncTextureLoader::decodeFinished);
+	m_decoding.insert(slot, watcher);
+	m_decodingFiles.insert(slot, ktxFilename.isEmpty() ? filename : ktxFilename);
+	m_requestTimes.insert(slot, m_clock.elapsed());
+
+	watcher->setFuture(QtConcurrent::run(decodeTexture, filename, ktxFilename));
+}
+
+void AsyncTextureLoader::cancel(int slot)
+{
+	// A decode cannot be stopped, but its result will be ignored
+	QFutureWatcher<DecodedTexture>* watcher = m_decoding.take(slot);
+	if (watcher) {
+		watcher->disconnect(this);
+		watcher->deleteLater();
+	}
+	m_decodingFiles.remove(slot);
+	m_requestTimes.remove(slot);
+
+	for (int i = m_jobs.size() - 1; i >= 0; --i) {
+		if (m_jobs[i].slot == slot)
+			dropJob(i);
+	}
+}
+
+void AsyncTextureLoader::decodeFinished()
+{
+	QFutureWatcher<DecodedTexture>* watcher = static_cast<QFutureWatcher<DecodedTexture>*>(sender());
+	int slot = m_decoding.key(watcher, -1);
+	watcher->deleteLater();
+	if (slot < 0)
+		return;
+
+	DecodedTexture decoded = watcher->result();
+	const QImage &image = decoded.image;
+	QString filename = m_decodingFiles.take(slot);
+	qint64 requestTime = m_requestTimes.take(slot);
+	m_decoding.remove(slot);
+
+	if (image.isNull()) {
+		std::cerr << "-- AGEn message --: Cannot load texture " << filename.toStdString() << std::endl;
+		return;
+	}
+
+	emit imageDecoded(slot, image);
+
+	UploadJob job;
+	job.slot = slot;
+	job.filename = filename;
+	job.image = image;
+	job.compressed = decoded.compressed;
+	job.texture = 0;
+	job.nextRow = 0;
+	job.done = 0;
+	job.requestTime = requestTime;
+	job.decodeTime = m_clock.elapsed();
+	m_jobs.append(job);
+
+	if (m_initialized)
+		m_uploadTimer.start();
+}
+
+void AsyncTextureLoader::uploadStep()
+{
+	if (m_jobs.isEmpty() || !m_initialized || !m_widget->isValid()) {
+		m_uploadTimer.stop();
+		return;
+	}
+
+	m_widget->makeCurrent();
+	glActiveTexture(GL_TEXTURE0);
+
+	struct ReadyTexture {
+		int slot;
+		GLuint texture;
+		bool normalXY;
+	};
+	QList<ReadyTexture> ready;
+	int slices = TEX_UPLOAD_SLICES_PER_STEP;
+	int i = 0;
+	while (i < m_jobs.size()) {
+		UploadJob &job = m_jobs[i];
+
+		// Without S3TC, the decompressed texels are uploaded instead
+		if (!job.compressed.isEmpty() && job.compressed.glFormat != TEX_FORMAT_BC5 && !m_s3tcSupported) {
+			std::cout << "-- AGEn message --: S3TC is not supported, " << job.filename.toStdString()
+				<< " is uploaded uncompressed" << std::endl;
+			job.compressed = CompressedTexture();
+		}
+
+		if (job.done == 0 && !job.compressed.isEmpty()) {
+			// Every level is ready, the upload is a copy
+			uploadCompressed(job);
+			job.done = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+			++i;
+		}
+		else if (job.done == 0) {
+			// Storage for the new texture, its rows are filled from the ring
+			if (job.texture == 0) {
+				int rowBytes = job.image.width() * 4;
+				if (m_pbo == 0 || m_slotSize < rowBytes) {
+					deletePixelBuffer();
+					createPixelBuffer(qMax(TEX_UPLOAD_SLOT_SIZE, rowBytes));
+				}
+
+				glGenTextures(1, &job.texture);
+				glBindTexture(GL_TEXTURE_2D, job.texture);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, job.image.width(), job.image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			}
+
+			while (slices > 0 && job.nextRow < job.image.height()) {
+				// The next slice of the ring is still being read by the GPU
+				if (!uploadSlice(job)) {
+					slices = 0;
+					break;
+				}
+				--slices;
+			}
+
+			if (job.nextRow < job.image.height())
+				break;
+
+			// All the rows are queued: build the mipmaps and wait for them
+			glBindTexture(GL_TEXTURE_2D, job.texture);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			job.done = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+			++i;
+		}
+		else {
+			GLenum status = glClientWaitSync(job.done, 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+				glDeleteSync(job.done);
+				std::cout << "-- AGEn message --: Texture " << job.filename.toStdString()
+					<< " decoded in " << job.decodeTime - job.requestTime << " ms, resident after "
+					<< m_clock.elapsed() - job.requestTime << " ms" << std::endl;
+
+				ReadyTexture texture = { job.slot, job.texture, job.compressed.glFormat == TEX_FORMAT_BC5 && !job.compressed.isEmpty() };
+				ready.append(texture);
+				m_jobs.removeAt(i);
+			}
+			else {
+				++i;
+			}
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (m_jobs.isEmpty())
+		m_uploadTimer.stop();
+
+	// The receivers may start new loads
+	for (int r = 0; r < ready.size(); ++r)
+		emit textureReady(ready[r].slot, ready[r].texture, ready[r].normalXY);
+}
+
+void AsyncTextureLoader::uploadCompressed(UploadJob &job)
+{
+	const CompressedTexture &compressed = job.compressed;
+	int levels = (int)compressed.levels.size();
+
+	glGenTextures(1, &job.texture);
+	glBindTexture(GL_TEXTURE_2D, job.texture);
+	for (int l = 0; l < levels; ++l) {
+		const TextureLevel &level = compressed.levels[l];
+		glCompressedTexImage2D(GL_TEXTURE_2D, l, compressed.glFormat, level.width, level.height, 0,
+			(GLsizei)level.data.size(), level.data.data());
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+bool AsyncTextureLoader::uploadSlice(UploadJob &job)
+{
+	GLsync &fence = m_slotFences[m_nextSlot];
+	if (fence) {
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			return false;
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	int width = job.image.width();
+	int rowBytes = width * 4;
+	int rows = qMin(m_slotSize / rowBytes, job.image.height() - job.nextRow);
+	GLintptr offset = (GLintptr)m_nextSlot * m_slotSize;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+
+	// The slice is not used by the GPU anymore, it can be written without sync
+	uchar* dst = m_persistentPtr ? m_persistentPtr + offset :
+		(uchar*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, rows * rowBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	for (int r = 0; r < rows; ++r)
+		memcpy(dst + r * rowBytes, job.image.constScanLine(job.nextRow + r), rowBytes);
+	if (!m_persistentPtr)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	glBindTexture(GL_TEXTURE_2D, job.texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.nextRow, width, rows, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glFlush();
+
+	job.nextRow += rows;
+	m_nextSlot = (m_nextSlot + 1) % TEX_UPLOAD_SLOTS;
+	return true;
+}
+
+void AsyncTextureLoader::dropJob(int index)
+{
+	UploadJob &job = m_jobs[index];
+	if (m_initialized && (job.texture || job.done)) {
+		m_widget->makeCurrent();
+		if (job.done)
+			glDeleteSync(job.done);
+		if (job.texture)
+			glDeleteTextures(1, &job.texture);
+	}
+	m_jobs.removeAt(index);
+}
+
+void AsyncTextureLoader::createPixelBuffer(int slotSize)
+{
+	m_slotSize = slotSize;
+	GLsizeiptr size = (GLsizeiptr)TEX_UPLOAD_SLOTS * slotSize;
+
+	glGenBuffers(1, &m_pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+	if (m_bufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		m_bufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+		m_persistentPtr = (uchar*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+	}
+	else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void AsyncTextureLoader::deletePixelBuffer()
+{
+	for (int i = 0; i < TEX_UPLOAD_SLOTS; ++i) {
+		if (m_slotFences[i])
+			glDeleteSync(m_slotFences[i]);
+		m_slotFences[i] = 0;
+	}
+	m_nextSlot = 0;
+
+	if (m_pbo == 0)
+		return;
+
+	if (m_persistentPtr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		m_persistentPtr = nullptr;
+	}
+	glDeleteBuffers(1, &m_pbo);
+	m_pbo = 0;
+	m_slotSize = 0;
+}
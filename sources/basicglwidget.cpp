@@ -42,6 +42,9 @@ BasicGLWidget::BasicGLWidget(QWidget *parent) : QOpenGLWidget(parent)
 	
 	// Shaders
 	m_program = nullptr;
+
+	// Reload the shaders when their files change
+	connect(&ShaderLibrary::instance(), &ShaderLibrary::shadersChanged, this, &BasicGLWidget::reloadShaders);
 }
 
 BasicGLWidget::~BasicGLWidget()
@@ -171,6 +174,7 @@ void BasicGLWidget::keyPressEvent(QKeyEvent *event)
 			std::cout << "-B:  change background color" << std::endl;
 			std::cout << "-F:  show frames per second (fps)" << std::endl;
 			std::cout << "-H:  show this help" << std::endl;
+			std::cout << "-F5: reload shaders" << std::endl;
 			std::cout << std::endl;
 			std::cout << "IMPORTANT: the focus must be set to the glwidget to work" << std::endl;
 			std::cout << std::endl;
@@ -179,6 +183,11 @@ void BasicGLWidget::keyPressEvent(QKeyEvent *event)
 			std::cout << "-- AGEn message --: Reset Camera View" << std::endl;
 			resetCamera();
 			break;
+		case Qt::Key_F5:
+			// Reload shaders
+			std::cout << "-- AGEn message --: Reload shaders" << std::endl;
+			reloadShaders();
+			break;
 		default:
 			event->ignore();
 			break;
@@ -260,28 +269,18 @@ void BasicGLWidget::wheelEvent(QWheelEvent* event)
 	event->accept();
 }
 
-void BasicGLWidget::loadShaders()
+bool BasicGLWidget::loadShaders()
 {
-	// Declaration of the shaders
-	QOpenGLShader vs(QOpenGLShader::Vertex, this);
-	QOpenGLShader fs(QOpenGLShader::Fragment, this);
-	QOpenGLShader gs(QOpenGLShader::Geometry, this);
-
-	// Load and compile the shaders
-	vs.compileSourceFile("./shaders/geomshaderdemo.vert");
-	fs.compileSourceFile("./shaders/geomshaderdemo.frag");
-	gs.compileSourceFile("./shaders/geomshaderdemo.geom");
-
-	// Create the program
-	m_program = new QOpenGLShaderProgram;
-
-	// Add the shaders
-	m_program->addShader(&fs);
-	m_program->addShader(&gs);
-	m_program->addShader(&vs);
+	// Geometry shader demo (see ShaderLibrary::programs on reloads)
+	QOpenGLShaderProgram* program = ShaderLibrary::instance().program(
+		ShaderFiles("./shaders/geomshaderdemo.vert", "./shaders/geomshaderdemo.frag", "./shaders/geomshaderdemo.geom"), m_program);
+	if (m_program != nullptr && !program->isLinked()) {
+		delete program;
+		return false;
+	}
 
-	// Link the program
-	m_program->link();
+	delete m_program;
+	m_program = program;
 
 	// Bind the program (we are gonna use this program)
 	m_program->bind();
@@ -295,6 +294,24 @@ void BasicGLWidget::loadShaders()
 	m_transLoc = glGetUniformLocation(m_program->programId(), "sceneTransform");
 	m_projLoc = glGetUniformLocation(m_program->programId(), "projTransform");
 	m_viewLoc = glGetUniformLocation(m_program->programId(), "viewTransform");
+
+	return true;
+}
+
+void BasicGLWidget::reloadShaders()
+{
+	if (!isValid())
+		return;
+
+	makeCurrent();
+
+	if (loadShaders()) {
+		projectionTransform();
+		viewTransform();
+	}
+
+	doneCurrent();
+	update();
 }
 
 void BasicGLWidget::projectionTransform()
@@ -0,0 +1,156 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+CameraPath::CameraPath()
+{
+	cameraType = 0;
+}
+
+void CameraPath::clear()
+{
+	m_keys.clear();
+	model.clear();
+	cameraType = 0;
+}
+
+void CameraPath::addKey(const CameraKey &key)
+{
+	m_keys.push_back(key);
+}
+
+double CameraPath::duration() const
+{
+	return m_keys.empty() ? 0.0 : m_keys.back().time - m_keys.front().time;
+}
+
+static float mix(float a, float b, float t)
+{
+	return a + (b - a) * t;
+}
+
+CameraKey CameraPath::sample(double time) const
+{
+	time += m_keys.front().time;
+	if (time <= m_keys.front().time)
+		return m_keys.front();
+	if (time >= m_keys.back().time)
+		return m_keys.back();
+
+	// First key after time, there is one before it
+	size_t next = 1;
+	while (m_keys[next].time < time)
+		++next;
+	const CameraKey &a = m_keys[next - 1];
+	const CameraKey &b = m_keys[next];
+	float t = b.time > a.time ? (float)((time - a.time) / (b.time - a.time)) : 1.0f;
+
+	CameraKey key;
+	key.time = time;
+	key.camera.position = a.camera.position + (b.camera.position - a.camera.position) * t;
+	key.camera.xRot = mix(a.camera.xRot, b.camera.xRot, t);
+	key.camera.yRot = mix(a.camera.yRot, b.camera.yRot, t);
+	key.camera.xPan = mix(a.camera.xPan, b.camera.xPan, t);
+	key.camera.yPan = mix(a.camera.yPan, b.camera.yPan, t);
+	key.camera.fov = mix(a.camera.fov, b.camera.fov, t);
+	key.modelXRot = mix(a.modelXRot, b.modelXRot, t);
+	key.modelYRot = mix(a.modelYRot, b.modelYRot, t);
+	return key;
+}
+
+bool CameraPath::save(const std::string &filename) const
+{
+	std::ofstream file(filename.c_str());
+	if (!file) {
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	file << "# time x y z xRot yRot xPan yPan fov modelXRot modelYRot" << std::endl;
+	file << "model " << model << std::endl;
+	file << "type " << cameraType << std::endl;
+	file.precision(9);
+	for (size_t k = 0; k < m_keys.size(); ++k) {
+		const CameraKey &key = m_keys[k];
+		file << "key " << key.time << " " << key.camera.position.x << " " << key.camera.position.y << " "
+			<< key.camera.position.z << " " << key.camera.xRot << " " << key.camera.yRot << " "
+			<< key.camera.xPan << " " << key.camera.yPan << " " << key.camera.fov << " "
+			<< key.modelXRot << " " << key.modelYRot << std::endl;
+	}
+	return (bool)file;
+}
+
+bool CameraPath::load(const std::string &filename)
+{
+	clear();
+
+	std::ifstream file(filename.c_str());
+	if (!file) {
+		std::cerr << "Cannot load camera path " << filename << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::stringstream ss(line);
+		std::string tag;
+		ss >> tag;
+		if (tag == "model") {
+			std::getline(ss >> std::ws, model);
+		}
+		else if (tag == "type") {
+			ss >> cameraType;
+		}
+		else if (tag == "key") {
+			CameraKey key;
+			ss >> key.time >> key.camera.position.x >> key.camera.position.y >> key.camera.position.z
+				>> key.camera.xRot >> key.camera.yRot >> key.camera.xPan >> key.camera.yPan
+				>> key.camera.fov >> key.modelXRot >> key.modelYRot;
+			if (!ss || (!m_keys.empty() && key.time < m_keys.back().time)) {
+				std::cerr << "Wrong key in camera path " << filename << ": " << line << std::endl;
+				return false;
+			}
+			m_keys.push_back(key);
+		}
+	}
+
+	if (m_keys.empty()) {
+		std::cerr << "Camera path " << filename << " has no keys" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+double percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t rank = (size_t)std::ceil(p * values.size());
+	return values[rank > 0 ? std::min(rank, values.size()) - 1 : 0];
+}
+
+bool writeTimingCSV(const std::string &filename, const std::vector<TimingSeries> &series)
+{
+	std::ofstream file(filename.c_str());
+	if (!file) {
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	file << "measure,frames,mean_ms,p50_ms,p90_ms,p95_ms,p99_ms,max_ms" << std::endl;
+	for (size_t s = 0; s < series.size(); ++s) {
+		const std::vector<double> &ms = series[s].ms;
+		double sum = 0.0;
+		for (size_t i = 0; i < ms.size(); ++i)
+			sum += ms[i];
+		file << series[s].name << "," << ms.size() << "," << (ms.empty() ? 0.0 : sum / ms.size()) << ","
+			<< percentile(ms, 0.5) << "," << percentile(ms, 0.9) << "," << percentile(ms, 0.95) << ","
+			<< percentile(ms, 0.99) << "," << percentile(ms, 1.0) << std::endl;
+	}
+	return (bool)file;
+}
@@ -0,0 +1,276 @@
+#include "framecapture.h"
+#include <QDir>
+#include <QImage>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::FrameCapture()
+{
+	m_format = PNG_SEQUENCE;
+	m_capturing = false;
+	for (int i = 0; i < CAPTURE_PBO_COUNT; ++i) {
+		m_pbos[i] = 0;
+		m_fences[i] = 0;
+		m_pboSizes[i] = 0;
+	}
+	m_nextSlot = 0;
+	m_frames = 0;
+	m_resolve = nullptr;
+	m_finish = false;
+	m_waits = 0;
+	m_videoWidth = 0;
+	m_videoHeight = 0;
+	m_written = 0;
+	m_skipped = 0;
+}
+
+FrameCapture::~FrameCapture()
+{
+	// Without a context the frames in the ring are lost, the queued ones are
+	// still written
+	if (isRunning()) {
+		{
+			QMutexLocker locker(&m_mutex);
+			m_finish = true;
+			m_queued.wakeOne();
+		}
+		wait();
+	}
+}
+
+bool FrameCapture::startCapture(const QString &path)
+{
+	if (m_capturing)
+		stopCapture();
+	initializeOpenGLFunctions();
+
+	m_path = path;
+	m_format = path.endsWith(".y4m", Qt::CaseInsensitive) ? Y4M : PNG_SEQUENCE;
+	if (m_format == Y4M) {
+		m_video.open(path.toStdString().c_str(), std::ios::binary | std::ios::trunc);
+		if (!m_video) {
+			std::cerr << "-- AGEn message --: Cannot write " << path.toStdString() << std::endl;
+			return false;
+		}
+	}
+	else if (!QDir().mkpath(path)) {
+		std::cerr << "-- AGEn message --: Cannot create " << path.toStdString() << std::endl;
+		return false;
+	}
+
+	glGenBuffers(CAPTURE_PBO_COUNT, m_pbos);
+	for (int i = 0; i < CAPTURE_PBO_COUNT; ++i) {
+		m_fences[i] = 0;
+		m_pboSizes[i] = 0;
+	}
+	m_nextSlot = 0;
+	m_frames = 0;
+	m_finish = false;
+	m_waits = 0;
+	m_videoWidth = 0;
+	m_videoHeight = 0;
+	m_written = 0;
+	m_skipped = 0;
+
+	// Encoding must not take the time of the render thread
+	QThread::start(QThread::LowPriority);
+	m_capturing = true;
+	std::cout << "-- AGEn message --: Capturing frames to " << path.toStdString() << std::endl;
+	return true;
+}
+
+void FrameCapture::stopCapture()
+{
+	if (!m_capturing)
+		return;
+
+	// The frames still in the ring, oldest first
+	for (int i = 0; i < CAPTURE_PBO_COUNT; ++i) {
+		int slot = (m_nextSlot + i) % CAPTURE_PBO_COUNT;
+		if (m_fences[slot])
+			readSlot(slot);
+	}
+	{
+		QMutexLocker locker(&m_mutex);
+		m_finish = true;
+		m_queued.wakeOne();
+	}
+	wait();
+
+	if (m_video.is_open())
+		m_video.close();
+	glDeleteBuffers(CAPTURE_PBO_COUNT, m_pbos);
+	for (int i = 0; i < CAPTURE_PBO_COUNT; ++i)
+		m_pbos[i] = 0;
+	delete m_resolve;
+	m_resolve = nullptr;
+	m_capturing = false;
+
+	std::cout << "-- AGEn message --: Captured " << m_written << " frames to " << m_path.toStdString();
+	if (m_skipped > 0)
+		std::cout << " (" << m_skipped << " of another size left out)";
+	if (m_waits > 0)
+		std::cout << ", " << m_waits << " frames waited for the writer";
+	std::cout << std::endl;
+}
+
+void FrameCapture::capture(GLuint framebuffer, int width, int height)
+{
+	if (!m_capturing || width <= 0 || height <= 0)
+		return;
+
+	// The frame read CAPTURE_PBO_COUNT frames ago leaves the ring first
+	int slot = m_nextSlot;
+	if (m_fences[slot])
+		readSlot(slot);
+
+	// Multisampled framebuffers cannot be read, they are resolved first
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	GLint sampleBuffers = 0;
+	glGetIntegerv(GL_SAMPLE_BUFFERS, &sampleBuffers);
+	if (sampleBuffers > 0) {
+		if (!m_resolve || m_resolve->size() != QSize(width, height)) {
+			delete m_resolve;
+			m_resolve = new QOpenGLFramebufferObject(width, height);
+		}
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolve->handle());
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_resolve->handle());
+	}
+
+	// Into the buffer: glReadPixels is queued after the frame and returns
+	size_t size = (size_t)width * height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+	if (m_pboSizes[slot] != size) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		m_pboSizes[slot] = size;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_slots[slot].index = m_frames++;
+	m_slots[slot].width = width;
+	m_slots[slot].height = height;
+	m_nextSlot = (slot + 1) % CAPTURE_PBO_COUNT;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void FrameCapture::readSlot(int slot)
+{
+	// Queued CAPTURE_PBO_COUNT frames ago, it is rarely waited for
+	glClientWaitSync(m_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	glDeleteSync(m_fences[slot]);
+	m_fences[slot] = 0;
+
+	Frame frame;
+	frame.index = m_slots[slot].index;
+	frame.width = m_slots[slot].width;
+	frame.height = m_slots[slot].height;
+	size_t size = (size_t)frame.width * frame.height * 4;
+	frame.pixels.resize(size);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+	const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (data) {
+		memcpy(frame.pixels.data(), data, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (data)
+		queueFrame(frame);
+}
+
+void FrameCapture::queueFrame(Frame &frame)
+{
+	QMutexLocker locker(&m_mutex);
+	if (m_queue.size() >= CAPTURE_QUEUE_FRAMES)
+		++m_waits;
+	while (m_queue.size() >= CAPTURE_QUEUE_FRAMES)
+		m_dequeued.wait(&m_mutex);
+	m_queue.enqueue(Frame());
+	m_queue.back().index = frame.index;
+	m_queue.back().width = frame.width;
+	m_queue.back().height = frame.height;
+	m_queue.back().pixels.swap(frame.pixels);
+	m_queued.wakeOne();
+}
+
+void FrameCapture::run()
+{
+	for (;;) {
+		Frame frame;
+		{
+			QMutexLocker locker(&m_mutex);
+			while (m_queue.isEmpty() && !m_finish)
+				m_queued.wait(&m_mutex);
+			if (m_queue.isEmpty())
+				break;
+			Frame &next = m_queue.head();
+			frame.index = next.index;
+			frame.width = next.width;
+			frame.height = next.height;
+			frame.pixels.swap(next.pixels);
+			m_queue.dequeue();
+			m_dequeued.wakeOne();
+		}
+		writeFrame(frame);
+	}
+}
+
+void FrameCapture::writeFrame(const Frame &frame)
+{
+	if (m_format == Y4M) {
+		writeY4M(frame);
+		return;
+	}
+
+	// The alpha of the widget is not part of the picture
+	QImage image(frame.pixels.data(), frame.width, frame.height, frame.width * 4, QImage::Format_RGBX8888);
+	QString filename = QString("%1/frame_%2.png").arg(m_path).arg(frame.index, 6, 10, QChar('0'));
+	if (image.mirrored().save(filename))
+		++m_written;
+	else
+		std::cerr << "-- AGEn message --: Cannot write " << filename.toStdString() << std::endl;
+}
+
+void FrameCapture::writeY4M(const Frame &frame)
+{
+	// The size of the video is the one of its first frame
+	if (m_videoWidth == 0) {
+		m_videoWidth = frame.width;
+		m_videoHeight = frame.height;
+		m_video << "YUV4MPEG2 W" << frame.width << " H" << frame.height << " F" << CAPTURE_FPS
+			<< ":1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+	}
+	if (frame.width != m_videoWidth || frame.height != m_videoHeight) {
+		++m_skipped;
+		return;
+	}
+
+	// Full range BT.601, one plane after the other, rows from the top
+	size_t pixels = (size_t)frame.width * frame.height;
+	m_planes.resize(3 * pixels);
+	uchar* y = &m_planes[0];
+	uchar* u = &m_planes[pixels];
+	uchar* v = &m_planes[2 * pixels];
+	for (int row = 0; row < frame.height; ++row) {
+		const uchar* src = &frame.pixels[(size_t)(frame.height - 1 - row) * frame.width * 4];
+		size_t dst = (size_t)row * frame.width;
+		for (int x = 0; x < frame.width; ++x, src += 4, ++dst) {
+			float r = src[0], g = src[1], b = src[2];
+			y[dst] = (uchar)std::min(std::max(0.299f * r + 0.587f * g + 0.114f * b + 0.5f, 0.0f), 255.0f);
+			u[dst] = (uchar)std::min(std::max(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 0.0f), 255.0f);
+			v[dst] = (uchar)std::min(std::max(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 0.0f), 255.0f);
+		}
+	}
+	m_video << "FRAME\n";
+	m_video.write((const char*)m_planes.data(), m_planes.size());
+	if (m_video)
+		++m_written;
+}
@@ -0,0 +1,91 @@
+#include "../headers/frustum.h"
+
+Frustum::Frustum()
+{
+	setMatrix(glm::mat4(1.0f));
+}
+
+Frustum::Frustum(const glm::mat4 &clip)
+{
+	setMatrix(clip);
+}
+
+void Frustum::setMatrix(const glm::mat4 &clip)
+{
+	// glm is column major: clip[c][r]
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; ++r)
+		rows[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+
+	m_planes[0] = rows[3] + rows[0];
+	m_planes[1] = rows[3] - rows[0];
+	m_planes[2] = rows[3] + rows[1];
+	m_planes[3] = rows[3] - rows[1];
+	m_planes[4] = rows[3] + rows[2];
+	m_planes[5] = rows[3] - rows[2];
+
+	// Normalized, so that the sphere test can use distances
+	for (int p = 0; p < 6; ++p) {
+		float len = glm::length(glm::vec3(m_planes[p]));
+		if (len > 0.0f)
+			m_planes[p] /= len;
+	}
+}
+
+bool Frustum::sphereVisible(const glm::vec3 &center, float radius) const
+{
+	for (int p = 0; p < 6; ++p) {
+		if (glm::dot(glm::vec3(m_planes[p]), center) + m_planes[p].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::boxVisible(const glm::vec3 &bboxMin, const glm::vec3 &bboxMax) const
+{
+	for (int p = 0; p < 6; ++p) {
+		// Corner of the box farthest along the plane normal
+		glm::vec3 corner(
+			m_planes[p].x >= 0.0f ? bboxMax.x : bboxMin.x,
+			m_planes[p].y >= 0.0f ? bboxMax.y : bboxMin.y,
+			m_planes[p].z >= 0.0f ? bboxMax.z : bboxMin.z);
+		if (glm::dot(glm::vec3(m_planes[p]), corner) + m_planes[p].w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::subMeshVisible(const SubMesh &subMesh) const
+{
+	// The sphere rejects most hidden submeshes, the box is tighter
+	glm::vec3 center(subMesh.center[0], subMesh.center[1], subMesh.center[2]);
+	if (!sphereVisible(center, subMesh.radius))
+		return false;
+
+	return boxVisible(
+		glm::vec3(subMesh.bboxMin[0], subMesh.bboxMin[1], subMesh.bboxMin[2]),
+		glm::vec3(subMesh.bboxMax[0], subMesh.bboxMax[1], subMesh.bboxMax[2]));
+}
+
+int Frustum::visibleRanges(const std::vector<SubMesh> &subMeshes, std::vector<int> &first, std::vector<int> &count) const
+{
+	first.clear();
+	count.clear();
+
+	int visible = 0;
+	for (size_t i = 0; i < subMeshes.size(); ++i) {
+		const SubMesh &subMesh = subMeshes[i];
+		if (!subMeshVisible(subMesh))
+			continue;
+
+		++visible;
+		int start = subMesh.firstFace * 3;
+		if (!first.empty() && first.back() + count.back() == start)
+			count.back() += subMesh.faceCount * 3;
+		else {
+			first.push_back(start);
+			count.push_back(subMesh.faceCount * 3);
+		}
+	}
+	return visible;
+}
@@ -0,0 +1,253 @@
+#include "glresourcecache.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QOpenGLFunctions>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QStandardPaths>
+
+#include <iostream>
+
+#include "definitions.h"
+#include "meshoptimizer.h"
+
+GLResourceCache& GLResourceCache::instance()
+{
+	// Never destroyed: the objects are released with the share group when the
+	// application ends, there is no context left to delete them from here
+	static GLResourceCache* cache = new GLResourceCache;
+	return *cache;
+}
+
+GLuint GLResourceCache::texture(const QString &key) const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_textures.value(key, 0);
+}
+
+void GLResourceCache::addTexture(const QString &key, GLuint id)
+{
+	QMutexLocker locker(&m_mutex);
+	m_textures.insert(key, id);
+}
+
+GLuint GLResourceCache::buffer(const QString &key) const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_buffers.value(key, 0);
+}
+
+void GLResourceCache::addBuffer(const QString &key, GLuint id)
+{
+	QMutexLocker locker(&m_mutex);
+	m_buffers.insert(key, id);
+}
+
+// Sizes and dates of the sources and of the executable (which holds the
+// parsing, LOD, tangent and optimizer code), and the parameters of the build
+static std::string modelStamp(const QString &filename, const std::vector<std::string> &materialLibraries)
+{
+	QStringList files;
+	files << filename << QCoreApplication::applicationFilePath();
+	for (size_t i = 0; i < materialLibraries.size(); ++i)
+		files << QString::fromStdString(materialLibraries[i]);
+
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	for (int i = 0; i < files.size(); ++i) {
+		QFileInfo info(files[i]);
+		hash.addData(info.absoluteFilePath().toUtf8());
+		hash.addData(QByteArray::number(info.exists() ? info.size() : -1));
+		hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+	}
+	hash.addData(QByteArray::number(MODEL_LOD_LEVELS) + " " + QByteArray::number(MODEL_LOD_MIN_FACES) + " "
+		+ QByteArray::number(OPTIMIZE_MODEL_INDICES) + " " + QByteArray::number(VERTEX_CACHE_SIZE));
+	return hash.result().toHex().toStdString();
+}
+
+bool GLResourceCache::loadModel(Model &model, const QString &filename)
+{
+	// Named after the OBJ path, so models with the same name do not collide
+	QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/models";
+	QByteArray pathHash = QCryptographicHash::hash(QFileInfo(filename).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+	std::string binary = (cacheDir + "/" + QString::fromLatin1(pathHash.toHex()) + ".agmesh").toStdString();
+
+	// The material libraries of the copy give the stamp it must have
+	std::vector<std::string> materialLibraries;
+	std::string stamp;
+	bool cached = QFileInfo::exists(QString::fromStdString(binary))
+		&& Model::readBinaryHeader(binary, materialLibraries, stamp)
+		&& model.loadBinary(binary, modelStamp(filename, materialLibraries));
+	if (!cached)
+		model.load(filename.toStdString());
+	if (model.VBO_faces() == 0)
+		return false;
+#if OPTIMIZE_MODEL_INDICES
+	model.optimizeIndices();
+#endif
+	if (!cached) {
+		QDir().mkpath(cacheDir);
+		model.saveBinary(binary, modelStamp(filename, model.materialLibraries()));
+	}
+	return true;
+}
+
+GLMesh* GLResourceCache::mesh(const QString &filename)
+{
+	QMutexLocker locker(&m_mutex);
+	QHash<QString, GLMesh*>::const_iterator it = m_meshes.constFind(filename);
+	if (it != m_meshes.constEnd())
+		return it.value();
+
+	// Load the OBJ model - BEFORE creating the buffers!
+	Model* model = new Model;
+	if (!loadModel(*model, filename)) {
+		std::cerr << "-- AGEn message --: Empty model " << filename.toStdString() << std::endl;
+		delete model;
+		return 0;
+	}
+#if QUANTIZE_VERTICES
+	model->quantizeVertices();
+#endif
+
+	QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+	int numVertices = model->VBO_numVertices();
+
+	GLMesh* mesh = new GLMesh;
+	mesh->model = model;
+	mesh->numVertices = numVertices;
+	mesh->numIndices = model->VBO_faces() * 3; // with the LOD levels
+
+	// Positions, normals, texture coordinates and materials, one value per
+	// vertex, in the formats described with GLMesh
+	mesh->quantized = model->VBO_quantized();
+	const void* verts = model->VBO_vertices();
+	const void* norms = model->VBO_normals();
+	const void* texCoords = model->VBO_texcoords();
+	const void* tangents = model->VBO_tangents();
+	const void* matAmb = model->VBO_matamb();
+	const void* matDiff = model->VBO_matdiff();
+	const void* matSpec = model->VBO_matspec();
+	const void* matShin = model->VBO_matshin();
+	int vertsSize = sizeof(GLfloat) * 3, normsSize = sizeof(GLfloat) * 3, texCoordsSize = sizeof(GLfloat) * 2;
+	int tangentsSize = sizeof(GLfloat) * 4;
+	int matSize = sizeof(GLfloat) * 3, matShinSize = sizeof(GLfloat);
+	if (mesh->quantized) {
+		verts = model->VBO_qpositions();
+		norms = model->VBO_qnormals();
+		texCoords = model->VBO_qtexcoords();
+		tangents = model->VBO_qtangents();
+		matAmb = model->VBO_qmatamb();
+		matDiff = model->VBO_qmatdiff();
+		matSpec = model->VBO_qmatspec();
+		matShin = model->VBO_qmatshin();
+		vertsSize = sizeof(GLushort) * 4;
+		normsSize = sizeof(GLshort) * 2;
+		texCoordsSize = sizeof(GLushort) * 2;
+		tangentsSize = sizeof(GLshort) * 4;
+		matSize = sizeof(GLubyte) * 4;
+		matShinSize = sizeof(GLushort);
+	}
+
+	f->glGenBuffers(1, &mesh->vboVerts);
+	f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboVerts);
+	f->glBufferData(GL_ARRAY_BUFFER, vertsSize * numVertices, verts, GL_STATIC_DRAW);
+
+	f->glGenBuffers(1, &mesh->vboNorms);
+	f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboNorms);
+	f->glBufferData(GL_ARRAY_BUFFER, normsSize * numVertices, norms, GL_STATIC_DRAW);
+
+	mesh->vboTexCoords = 0;
+	if (texCoords) {
+		f->glGenBuffers(1, &mesh->vboTexCoords);
+		f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboTexCoords);
+		f->glBufferData(GL_ARRAY_BUFFER, texCoordsSize * numVertices, texCoords, GL_STATIC_DRAW);
+	}
+
+	mesh->vboTangents = 0;
+	if (tangents) {
+		f->glGenBuffers(1, &mesh->vboTangents);
+		f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboTangents);
+		f->glBufferData(GL_ARRAY_BUFFER, tangentsSize * numVertices, tangents, GL_STATIC_DRAW);
+	}
+
+	f->glGenBuffers(1, &mesh->vboMatAmb);
+	f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboMatAmb);
+	f->glBufferData(GL_ARRAY_BUFFER, matSize * numVertices, matAmb, GL_STATIC_DRAW);
+
+	f->glGenBuffers(1, &mesh->vboMatDiff);
+	f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboMatDiff);
+	f->glBufferData(GL_ARRAY_BUFFER, matSize * numVertices, matDiff, GL_STATIC_DRAW);
+
+	f->glGenBuffers(1, &mesh->vboMatSpec);
+	f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboMatSpec);
+	f->glBufferData(GL_ARRAY_BUFFER, matSize * numVertices, matSpec, GL_STATIC_DRAW);
+
+	f->glGenBuffers(1, &mesh->vboMatShin);
+	f->glBindBuffer(GL_ARRAY_BUFFER, mesh->vboMatShin);
+	f->glBufferData(GL_ARRAY_BUFFER, matShinSize * numVertices, matShin, GL_STATIC_DRAW);
+
+	// Boxes of the quantized positions, a min and an extent texel each
+	mesh->boxBuffer = mesh->boxTexture = 0;
+	if (mesh->quantized) {
+		QOpenGLFunctions_3_3_Core* gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_3_Core>();
+		gl->glGenBuffers(1, &mesh->boxBuffer);
+		gl->glBindBuffer(GL_TEXTURE_BUFFER, mesh->boxBuffer);
+		gl->glBufferData(GL_TEXTURE_BUFFER, sizeof(GLfloat) * 8 * model->subMeshes().size(), model->VBO_boxes().data(), GL_STATIC_DRAW);
+		gl->glGenTextures(1, &mesh->boxTexture);
+		gl->glBindTexture(GL_TEXTURE_BUFFER, mesh->boxTexture);
+		gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mesh->boxBuffer);
+		gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+		gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	// Indices, uploaded through the array target: binding an element buffer
+	// would change the VAO bound by the caller
+	f->glGenBuffers(1, &mesh->ibo);
+	f->glBindBuffer(GL_ARRAY_BUFFER, mesh->ibo);
+	f->glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * mesh->numIndices, model->VBO_indices(), GL_STATIC_DRAW);
+
+	f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_meshes.insert(filename, mesh);
+	return mesh;
+}
+
+QOpenGLFramebufferObject* GLResourceCache::framebuffer(const QString &key, const QSize &size, int colorAttachments, GLenum internalFormat)
+{
+	QMutexLocker locker(&m_mutex);
+	QPair<QOpenGLContext*, QString> fboKey(QOpenGLContext::currentContext(), key);
+	QOpenGLFramebufferObject* fbo = m_framebuffers.value(fboKey, 0);
+	if (fbo && fbo->size() == size && fbo->format().internalTextureFormat() == internalFormat
+		&& fbo->textures().size() == colorAttachments)
+		return fbo;
+
+	delete fbo;
+
+	QOpenGLFramebufferObjectFormat format;
+	format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+	format.setInternalTextureFormat(internalFormat);
+	fbo = new QOpenGLFramebufferObject(size, format);
+	for (int i = 1; i < colorAttachments; ++i)
+		fbo->addColorAttachment(size, internalFormat);
+
+	m_framebuffers.insert(fboKey, fbo);
+	return fbo;
+}
+
+void GLResourceCache::releaseFramebuffers(QOpenGLContext *context)
+{
+	QMutexLocker locker(&m_mutex);
+	QMap<QPair<QOpenGLContext*, QString>, QOpenGLFramebufferObject*>::iterator it = m_framebuffers.begin();
+	while (it != m_framebuffers.end()) {
+		if (it.key().first == context) {
+			delete it.value();
+			it = m_framebuffers.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
@@ -0,0 +1,99 @@
+#include "../headers/hizbuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+HiZBuffer::HiZBuffer()
+{
+	m_texelSize = 1;
+	m_screenWidth = 0;
+	m_screenHeight = 0;
+}
+
+void HiZBuffer::build(const std::vector<float> &depth, int width, int height, int texelSize, int screenWidth, int screenHeight)
+{
+	m_texelSize = texelSize;
+	m_screenWidth = screenWidth;
+	m_screenHeight = screenHeight;
+	m_levels.clear();
+	m_sizes.clear();
+	if (width <= 0 || height <= 0)
+		return;
+
+	m_levels.push_back(depth);
+	m_sizes.push_back(glm::ivec2(width, height));
+
+	// Down to one texel. With an odd size, the last texel of a row or column
+	// only covers one of the previous level.
+	while (width > 1 || height > 1) {
+		int w = (width + 1) / 2;
+		int h = (height + 1) / 2;
+		const std::vector<float> &previous = m_levels.back();
+		std::vector<float> level(w * h);
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				int x1 = std::min(2 * x + 1, width - 1);
+				int y1 = std::min(2 * y + 1, height - 1);
+				level[y * w + x] = std::max(
+					std::max(previous[2 * y * width + 2 * x], previous[2 * y * width + x1]),
+					std::max(previous[y1 * width + 2 * x], previous[y1 * width + x1]));
+			}
+		}
+		m_levels.push_back(level);
+		m_sizes.push_back(glm::ivec2(w, h));
+		width = w;
+		height = h;
+	}
+}
+
+bool HiZBuffer::boxVisible(const glm::mat4 &clip, const glm::vec3 &bboxMin, const glm::vec3 &bboxMax) const
+{
+	if (m_levels.empty())
+		return true;
+
+	// Screen rectangle and nearest depth of the corners. A box that crosses
+	// the near plane covers the camera, it is not tested.
+	glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+	float nearest = 1.0f;
+	for (int i = 0; i < 8; ++i) {
+		glm::vec4 corner(i & 1 ? bboxMax.x : bboxMin.x, i & 2 ? bboxMax.y : bboxMin.y, i & 4 ? bboxMax.z : bboxMin.z, 1.0f);
+		glm::vec4 c = clip * corner;
+		if (c.w <= 1e-5f || c.z < -c.w)
+			return true;
+		glm::vec3 ndc = glm::vec3(c) / c.w;
+		ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+		ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Texels of the first level under the rectangle
+	ndcMin = glm::clamp(ndcMin, -1.0f, 1.0f);
+	ndcMax = glm::clamp(ndcMax, -1.0f, 1.0f);
+	if (ndcMin.x > ndcMax.x || ndcMin.y > ndcMax.y)
+		return false;
+	const glm::ivec2 &size = m_sizes[0];
+	float texelSize = (float)m_texelSize;
+	glm::ivec2 first(
+		(int)std::floor((ndcMin.x * 0.5f + 0.5f) * m_screenWidth / texelSize),
+		(int)std::floor((ndcMin.y * 0.5f + 0.5f) * m_screenHeight / texelSize));
+	glm::ivec2 last(
+		(int)std::floor((ndcMax.x * 0.5f + 0.5f) * m_screenWidth / texelSize),
+		(int)std::floor((ndcMax.y * 0.5f + 0.5f) * m_screenHeight / texelSize));
+	first = glm::clamp(first, glm::ivec2(0), size - 1);
+	last = glm::clamp(last, glm::ivec2(0), size - 1);
+
+	// Level where the rectangle spans two texels at most
+	int level = 0;
+	while (level + 1 < (int)m_levels.size() && ((last.x >> level) - (first.x >> level) > 1 || (last.y >> level) - (first.y >> level) > 1))
+		++level;
+
+	const std::vector<float> &depth = m_levels[level];
+	int width = m_sizes[level].x;
+	for (int y = first.y >> level; y <= last.y >> level; ++y) {
+		for (int x = first.x >> level; x <= last.x >> level; ++x) {
+			if (nearest <= depth[y * width + x])
+				return true;
+		}
+	}
+	return false;
+}
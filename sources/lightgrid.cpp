@@ -0,0 +1,97 @@
+#include "../headers/lightgrid.h"
+#include "../headers/definitions.h"
+
+#include <algorithm>
+#include <cmath>
+
+LightGrid::LightGrid()
+{
+	m_tilesX = 0;
+	m_tilesY = 0;
+	m_maxLights = 0;
+}
+
+void LightGrid::build(const std::vector<PointLight> &lights, const glm::mat4 &projection, int width, int height)
+{
+	m_tilesX = (width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	m_tilesY = (height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	int tileCount = m_tilesX * m_tilesY;
+
+	// Lights per tile, then the first index of every tile
+	std::vector<unsigned int> counts(tileCount, 0);
+	m_rects.resize(lights.size());
+	for (size_t l = 0; l < lights.size(); ++l) {
+		glm::ivec4 &rect = m_rects[l];
+		if (!tileRect(lights[l], projection, width, height, rect)) {
+			rect = glm::ivec4(0);
+			continue;
+		}
+		for (int y = rect.y; y < rect.w; ++y)
+			for (int x = rect.x; x < rect.z; ++x)
+				++counts[y * m_tilesX + x];
+	}
+
+	m_tiles.resize(2 * tileCount);
+	unsigned int first = 0;
+	m_maxLights = 0;
+	for (int t = 0; t < tileCount; ++t) {
+		m_tiles[2 * t] = first;
+		m_tiles[2 * t + 1] = 0; // incremented while filling
+		first += counts[t];
+		m_maxLights = std::max(m_maxLights, (int)counts[t]);
+	}
+
+	m_indices.resize(first);
+	for (size_t l = 0; l < lights.size(); ++l) {
+		const glm::ivec4 &rect = m_rects[l];
+		for (int y = rect.y; y < rect.w; ++y) {
+			for (int x = rect.x; x < rect.z; ++x) {
+				int t = y * m_tilesX + x;
+				m_indices[m_tiles[2 * t] + m_tiles[2 * t + 1]++] = (unsigned int)l;
+			}
+		}
+	}
+}
+
+float LightGrid::averageLights() const
+{
+	int tileCount = m_tilesX * m_tilesY;
+	return tileCount > 0 ? (float)m_indices.size() / tileCount : 0.0f;
+}
+
+bool LightGrid::tileRect(const PointLight &light, const glm::mat4 &projection, int width, int height, glm::ivec4 &rect) const
+{
+	const glm::vec3 &c = light.position;
+	float r = light.radius;
+	glm::vec2 ndcMin(-1.0f), ndcMax(1.0f);
+
+	if (r > 0.0f) {
+		// Behind the camera
+		if (c.z - r >= 0.0f)
+			return false;
+
+		// Around the camera the whole screen is lit. In front of it, the
+		// projection of the bounding box of the sphere bounds its projection.
+		if (c.z + r < 0.0f) {
+			ndcMin = glm::vec2(1.0f);
+			ndcMax = glm::vec2(-1.0f);
+			for (int i = 0; i < 8; ++i) {
+				glm::vec3 corner = c + r * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+				glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+		}
+	}
+
+	// Tiles from the bottom left corner, as gl_FragCoord
+	ndcMin = glm::clamp(ndcMin, -1.0f, 1.0f);
+	ndcMax = glm::clamp(ndcMax, -1.0f, 1.0f);
+	float tileSize = (float)LIGHT_TILE_SIZE;
+	rect.x = std::max((int)std::floor((ndcMin.x * 0.5f + 0.5f) * width / tileSize), 0);
+	rect.y = std::max((int)std::floor((ndcMin.y * 0.5f + 0.5f) * height / tileSize), 0);
+	rect.z = std::min((int)std::ceil((ndcMax.x * 0.5f + 0.5f) * width / tileSize), m_tilesX);
+	rect.w = std::min((int)std::ceil((ndcMax.y * 0.5f + 0.5f) * height / tileSize), m_tilesY);
+	return rect.x < rect.z && rect.y < rect.w;
+}
@@ -4,11 +4,17 @@
 #include <QCommandLineParser>
 #include <QCommandLineOption>
 
+#include <iostream>
+
 #include "glwidget.h"
 #include "MainWindow.h"
+#include "ssowidget.h"
+#include "benchmark.h"
 
 int main(int argc, char *argv[])
 {
+	// Every GL widget shares its objects, so the GLResourceCache can reuse them
+	QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 	QApplication app(argc, argv);
 
 	QCoreApplication::setApplicationName("AG Engine");
@@ -18,12 +24,34 @@ int main(int argc, char *argv[])
 	parser.setApplicationDescription(QCoreApplication::applicationName());
 	parser.addHelpOption();
 	parser.addVersionOption();
-	QCommandLineOption multipleSampleOption("multisample", "Multisampling");
+	QCommandLineOption multipleSampleOption("multisample", "Multisampling (not of the deferred SSAO tab, see --aa)");
 	parser.addOption(multipleSampleOption);
 	QCommandLineOption coreProfileOption("coreprofile", "Use core profile");
 	parser.addOption(coreProfileOption);
 	QCommandLineOption transparentOption("transparent", "Transparent window");
 	parser.addOption(transparentOption);
+	QCommandLineOption threadedOption("threaded", "Render the SSAO tab in its own thread");
+	parser.addOption(threadedOption);
+	QCommandLineOption benchmarkOption("benchmark", "Replay a camera path recorded with P in the SSAO tab, then exit", "path");
+	parser.addOption(benchmarkOption);
+	QCommandLineOption framesOption("frames", "Frames rendered by the benchmark", "n", QString::number(BENCHMARK_FRAMES));
+	parser.addOption(framesOption);
+	QCommandLineOption csvOption("csv", "Frame time percentiles of the benchmark", "file", "benchmark.csv");
+	parser.addOption(csvOption);
+	QCommandLineOption lightsOption("lights", "Point lights of the benchmark, besides the headlight", "n", "0");
+	parser.addOption(lightsOption);
+	QCommandLineOption depthPrepassOption("depth-prepass", "Depth pre-pass in the benchmark");
+	parser.addOption(depthPrepassOption);
+	QCommandLineOption occlusionOption("occlusion-culling", "Occlusion culling in the benchmark");
+	parser.addOption(occlusionOption);
+	QCommandLineOption aaOption("aa", "Anti-aliasing in the benchmark: none, fxaa or smaa", "mode", "none");
+	parser.addOption(aaOption);
+	QCommandLineOption aaQualityOption("aa-high-quality", "High quality anti-aliasing in the benchmark");
+	parser.addOption(aaQualityOption);
+	QCommandLineOption normalMapOption("normal-map", "Tangent space normal map of the model in the benchmark", "image");
+	parser.addOption(normalMapOption);
+	QCommandLineOption captureOption("capture", "Capture the frames of the benchmark: a .y4m file or a directory of PNG files", "path");
+	parser.addOption(captureOption);
 
 	parser.process(app);
 
@@ -35,11 +63,38 @@ int main(int argc, char *argv[])
 		fmt.setVersion(3, 2);
 		fmt.setProfile(QSurfaceFormat::CoreProfile);
 	}
+	if (parser.isSet(benchmarkOption))
+		fmt.setSwapInterval(0); // Frames as fast as they render
 	QSurfaceFormat::setDefaultFormat(fmt);
 
+	if (parser.isSet(benchmarkOption)) {
+		CameraPath path;
+		if (!path.load(parser.value(benchmarkOption).toStdString()))
+			return 1;
+
+		QString model = path.model.empty() ? "./models/Patricio.obj" : QString::fromStdString(path.model);
+		SSOWidget widget(model, false);
+		widget.resize(1280, 720);
+		widget.setLightCount(parser.value(lightsOption).toInt());
+		widget.setDepthPrepass(parser.isSet(depthPrepassOption));
+		widget.setOcclusionCulling(parser.isSet(occlusionOption));
+		int aa = SSAORenderer::antialiasingMode(parser.value(aaOption));
+		if (aa < 0) {
+			std::cerr << "Unknown anti-aliasing " << parser.value(aaOption).toStdString() << std::endl;
+			return 1;
+		}
+		widget.setAntialiasing(aa, parser.isSet(aaQualityOption));
+		widget.setNormalMap(parser.value(normalMapOption));
+		widget.show();
+		QObject::connect(&widget, &SSOWidget::benchmarkFinished, &app, [&app](bool ok) { app.exit(ok ? 0 : 1); });
+		widget.startBenchmark(path, parser.value(framesOption).toInt(), parser.value(csvOption), parser.value(captureOption));
+		return app.exec();
+	}
+
 	MainWindow mainWindow;
 
 	GLWidget::setTransparent(parser.isSet(transparentOption));
+	SSOWidget::setThreaded(parser.isSet(threadedOption));
 	if (GLWidget::isTransparent()) {
 		mainWindow.setAttribute(Qt::WA_TranslucentBackground);
 		mainWindow.setAttribute(Qt::WA_NoSystemBackground, false);
@@ -0,0 +1,283 @@
+#include "../headers/meshoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Vertex score of Forsyth's "Linear-Speed Vertex Cache Optimisation"
+const float CacheDecayPower = 1.5f;
+const float LastTriScore = 0.75f;
+const float ValenceBoostScale = 2.0f;
+const float ValenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, int remaining)
+{
+	if (remaining == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// The last triangle is scored lower, so that strips do not come back
+		if (cachePosition < 3)
+			score = LastTriScore;
+		else
+			score = std::pow(1.0f - (float)(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), CacheDecayPower);
+	}
+	// Vertices with few triangles left are finished first
+	return score + ValenceBoostScale * std::pow((float)remaining, -ValenceBoostPower);
+}
+
+// Local ids of the vertices of a range, so that the work does not depend on
+// the size of the whole vertex buffer
+int localVertices(const unsigned int *indices, int indexCount, std::vector<int> &local)
+{
+	std::vector<unsigned int> used(indices, indices + indexCount);
+	std::sort(used.begin(), used.end());
+	used.erase(std::unique(used.begin(), used.end()), used.end());
+
+	local.resize(indexCount);
+	for (int i = 0; i < indexCount; ++i)
+		local[i] = (int)(std::lower_bound(used.begin(), used.end(), indices[i]) - used.begin());
+	return (int)used.size();
+}
+
+// Vertices a FIFO cache transforms for one triangle (local ids)
+int fifoMisses(const int *triangle, std::vector<int> &fifo, int cacheSize)
+{
+	int misses = 0;
+	for (int k = 0; k < 3; ++k) {
+		if (std::find(fifo.begin(), fifo.end(), triangle[k]) != fifo.end())
+			continue;
+		++misses;
+		fifo.push_back(triangle[k]);
+		if ((int)fifo.size() > cacheSize)
+			fifo.erase(fifo.begin());
+	}
+	return misses;
+}
+
+struct Cluster {
+	int first, count;
+	float sortKey;
+};
+
+bool outerFirst(const Cluster &a, const Cluster &b)
+{
+	return a.sortKey > b.sortKey;
+}
+
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int *indices, int indexCount, int vertexCount)
+{
+	(void)vertexCount;
+	int triCount = indexCount / 3;
+	if (triCount < 2)
+		return;
+
+	std::vector<int> local;
+	int localCount = localVertices(indices, indexCount, local);
+
+	// Triangles of each vertex, the live ones first
+	std::vector<int> remaining(localCount, 0);
+	for (int i = 0; i < indexCount; ++i)
+		++remaining[local[i]];
+	std::vector<int> offset(localCount + 1, 0);
+	for (int v = 0; v < localCount; ++v)
+		offset[v + 1] = offset[v] + remaining[v];
+	std::vector<int> adjacency(indexCount);
+	std::vector<int> cursor(offset.begin(), offset.end() - 1);
+	for (int i = 0; i < indexCount; ++i)
+		adjacency[cursor[local[i]]++] = i / 3;
+
+	std::vector<int> cachePosition(localCount, -1);
+	std::vector<float> score(localCount);
+	for (int v = 0; v < localCount; ++v)
+		score[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> triScore(triCount);
+	std::vector<char> emitted(triCount, 0);
+	int best = 0;
+	for (int t = 0; t < triCount; ++t) {
+		triScore[t] = score[local[t * 3]] + score[local[t * 3 + 1]] + score[local[t * 3 + 2]];
+		if (triScore[t] > triScore[best])
+			best = t;
+	}
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	std::vector<int> cache, newCache;
+	cache.reserve(VERTEX_CACHE_SIZE + 3);
+	newCache.reserve(VERTEX_CACHE_SIZE + 3);
+	int nextInput = 0;
+
+	for (int done = 0; done < triCount; ++done) {
+		if (best < 0) {
+			// Nothing left around the cache: continue with the input order,
+			// which keeps this linear for triangle soups
+			while (emitted[nextInput])
+				++nextInput;
+			best = nextInput;
+		}
+
+		emitted[best] = 1;
+		const int *triangle = &local[best * 3];
+		for (int k = 0; k < 3; ++k) {
+			output.push_back(indices[best * 3 + k]);
+
+			int v = triangle[k];
+			int *live = &adjacency[offset[v]];
+			for (int j = 0; j < remaining[v]; ++j) {
+				if (live[j] == best) {
+					std::swap(live[j], live[remaining[v] - 1]);
+					break;
+				}
+			}
+			--remaining[v];
+		}
+
+		// The triangle goes to the front of the LRU cache
+		newCache.assign(triangle, triangle + 3);
+		for (size_t c = 0; c < cache.size(); ++c) {
+			if (cache[c] != triangle[0] && cache[c] != triangle[1] && cache[c] != triangle[2])
+				newCache.push_back(cache[c]);
+		}
+		cache.swap(newCache);
+
+		for (size_t c = 0; c < cache.size(); ++c) {
+			int v = cache[c];
+			cachePosition[v] = c < VERTEX_CACHE_SIZE ? (int)c : -1;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+
+		// Only the triangles around the cache change their score
+		best = -1;
+		float bestScore = -1.0f;
+		for (size_t c = 0; c < cache.size(); ++c) {
+			int v = cache[c];
+			for (int j = 0; j < remaining[v]; ++j) {
+				int t = adjacency[offset[v] + j];
+				triScore[t] = score[local[t * 3]] + score[local[t * 3 + 1]] + score[local[t * 3 + 2]];
+				if (triScore[t] > bestScore) {
+					bestScore = triScore[t];
+					best = t;
+				}
+			}
+		}
+		if (cache.size() > VERTEX_CACHE_SIZE)
+			cache.resize(VERTEX_CACHE_SIZE);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(unsigned int *indices, int indexCount, const float *positions, int vertexCount)
+{
+	(void)vertexCount;
+	int triCount = indexCount / 3;
+	if (triCount < 2)
+		return;
+
+	std::vector<int> local;
+	localVertices(indices, indexCount, local);
+
+	// Clusters start where the cache is cold anyway (the three vertices are
+	// missed), so sorting them keeps most of the vertex cache order
+	std::vector<Cluster> clusters;
+	std::vector<int> fifo;
+	for (int t = 0; t < triCount; ++t) {
+		if (fifoMisses(&local[t * 3], fifo, VERTEX_CACHE_FIFO) == 3 || t == 0) {
+			Cluster cluster = { t, 0, 0.0f };
+			clusters.push_back(cluster);
+		}
+		++clusters.back().count;
+	}
+	if (clusters.size() < 2)
+		return;
+
+	// Area weighted centroid and normal of every cluster and of the range
+	std::vector<float> centroids(clusters.size() * 3, 0.0f), normals(clusters.size() * 3, 0.0f);
+	std::vector<float> areas(clusters.size(), 0.0f);
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	float totalArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		for (int t = clusters[c].first; t < clusters[c].first + clusters[c].count; ++t) {
+			const float *p0 = &positions[indices[t * 3] * 3];
+			const float *p1 = &positions[indices[t * 3 + 1] * 3];
+			const float *p2 = &positions[indices[t * 3 + 2] * 3];
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; ++k) {
+				centroids[c * 3 + k] += area * (p0[k] + p1[k] + p2[k]) / 3.0f;
+				normals[c * 3 + k] += n[k];
+			}
+			areas[c] += area;
+		}
+		for (int k = 0; k < 3; ++k)
+			center[k] += centroids[c * 3 + k];
+		totalArea += areas[c];
+	}
+	if (totalArea <= 0.0f)
+		return;
+	for (int k = 0; k < 3; ++k)
+		center[k] /= totalArea;
+
+	// Clusters far from the center along their normal tend to occlude the rest
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		float length = std::sqrt(normals[c * 3] * normals[c * 3] + normals[c * 3 + 1] * normals[c * 3 + 1] + normals[c * 3 + 2] * normals[c * 3 + 2]);
+		if (areas[c] <= 0.0f || length <= 0.0f)
+			continue;
+		float key = 0.0f;
+		for (int k = 0; k < 3; ++k)
+			key += (centroids[c * 3 + k] / areas[c] - center[k]) * normals[c * 3 + k] / length;
+		clusters[c].sortKey = key;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), outerFirst);
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	for (size_t c = 0; c < clusters.size(); ++c)
+		output.insert(output.end(), indices + clusters[c].first * 3, indices + (clusters[c].first + clusters[c].count) * 3);
+	std::copy(output.begin(), output.end(), indices);
+}
+
+int MeshOptimizer::optimizeVertexFetch(unsigned int *indices, int indexCount, int vertexCount, std::vector<int> &remap)
+{
+	remap.assign(vertexCount, -1);
+	int next = 0;
+	for (int i = 0; i < indexCount; ++i) {
+		if (remap[indices[i]] < 0)
+			remap[indices[i]] = next++;
+		indices[i] = remap[indices[i]];
+	}
+	return next;
+}
+
+void MeshOptimizer::cacheStats(const unsigned int *indices, int indexCount, int vertexCount, int cacheSize, float &acmr, float &atvr)
+{
+	acmr = atvr = 0.0f;
+	if (indexCount < 3)
+		return;
+
+	// A vertex is in the FIFO if it was transformed less than cacheSize misses ago
+	std::vector<int> stamp(vertexCount, -cacheSize - 1);
+	std::vector<char> used(vertexCount, 0);
+	int misses = 0, usedCount = 0;
+	for (int i = 0; i < indexCount; ++i) {
+		unsigned int v = indices[i];
+		if (misses - stamp[v] > cacheSize) {
+			stamp[v] = misses;
+			++misses;
+		}
+		if (!used[v]) {
+			used[v] = 1;
+			++usedCount;
+		}
+	}
+	acmr = (float)misses / (indexCount / 3);
+	atvr = (float)misses / usedCount;
+}
@@ -12,10 +12,22 @@
 #include <sstream>
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
 #include <cassert>
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include "meshoptimizer.h"
+#include "vertexquantizer.h"
 using namespace std;
 // === Local stuff:
 static int material = 1;
+static int smoothing = 0;
 static void loadMTL(std::string filename);
 static int findMat(string material);
 static void omplenormals(vector<Face> &_faces, 
@@ -23,26 +35,38 @@ static void omplenormals(vector<Face> &_faces,
 static void ompleVBOs(vector<Face> &_faces, 
 	              vector<Vertex> const &_vertices,
 	              vector<Normal> const &_normals,
-		      float *&_VBO_vert, float *&_VBO_norm,
-		      float *&_VBO_mata, float *&_VBO_matd, float *&_VBO_matsp, float *&_VBO_matsh);
+	              vector<TexCoord> const &_texCoords,
+		      float *&_VBO_vert, float *&_VBO_norm, float *&_VBO_tex,
+		      float *&_VBO_mata, float *&_VBO_matd, float *&_VBO_matsp, float *&_VBO_matsh,
+		      unsigned int *&_VBO_ind, int &_VBO_nverts);
 
-static bool fvtn = false;
-static bool fvt = false;
-static bool texcoord = false;
 static string modelPath("");
 
 // ======== Constructors and Destructors =======
-Model::Model() : _vertices(0), _normals(0), _faces(0) {
-  _VBO_vertices = _VBO_normals = _VBO_matamb = _VBO_matdiff = _VBO_matspec = _VBO_matshin = NULL;
+Model::Model() : _vertices(0), _normals(0), _faces(0), _VBO_faces(0), _VBO_numVertices(0) {
+  _VBO_vertices = _VBO_normals = _VBO_texcoords = _VBO_tangents = _VBO_matamb = _VBO_matdiff = _VBO_matspec = _VBO_matshin = NULL;
+  _VBO_indices = NULL;
+  _indicesOptimized = false;
 }
 
 Model::~Model() {
-  if (_VBO_vertices != NULL) delete _VBO_vertices;
-  if (_VBO_normals != NULL) delete _VBO_normals;
-  if (_VBO_matamb != NULL) delete _VBO_matamb;
-  if (_VBO_matdiff != NULL) delete _VBO_matdiff;
-  if (_VBO_matspec != NULL) delete _VBO_matspec;
-  if (_VBO_matshin != NULL) delete _VBO_matshin;
+  releaseVBOs();
+}
+
+void Model::releaseVBOs() {
+  float **arrays[8] = { &_VBO_vertices, &_VBO_normals, &_VBO_texcoords, &_VBO_tangents,
+                        &_VBO_matamb, &_VBO_matdiff, &_VBO_matspec, &_VBO_matshin };
+  for (int a = 0; a < 8; ++a) {
+    delete[] *arrays[a];
+    *arrays[a] = NULL;
+  }
+  delete[] _VBO_indices;
+  _VBO_indices = NULL;
+  _VBO_faces = _VBO_numVertices = 0;
+  _indicesOptimized = false;
+  _VBO_qpositions.clear(); _VBO_qnormals.clear(); _VBO_qtexcoords.clear(); _VBO_qtangents.clear();
+  _VBO_qmatamb.clear(); _VBO_qmatdiff.clear(); _VBO_qmatspec.clear(); _VBO_qmatshin.clear();
+  _VBO_boxes.clear();
 }
 
 Material::Material() : name("__load_object_default_material__") {
@@ -58,8 +82,16 @@ void Model::load(std::string filename) {
     // unload previous model:
     _vertices.erase(_vertices.begin(), _vertices.end());
     _normals.erase(_normals.begin(), _normals.end());
+    _texCoords.clear();
     _faces.erase(_faces.begin(), _faces.end());
   }
+  releaseVBOs();
+  _subMeshes.clear();
+  _lods.clear();
+  _materialLibraries.clear();
+  smoothing = 0;
+  string group("default");
+  startSubMesh(group);
   size_t fiPath = filename.rfind("/");
   if (fiPath == string::npos) modelPath = "";
   else modelPath = filename.substr(0, fiPath+1);
@@ -99,11 +131,8 @@ void Model::load(std::string filename) {
       case 'n':  // normal components
 	for (int i = 0; i < 3; ++i) { ss >> coord; _normals.push_back(coord);}
 	break;
-      case 't':  // texture coords.
-	if (!texcoord) {
-	  cerr << "Found texture coordinates, which are not yet supported. Ignoring..." << endl;
-	  texcoord = true;
-	}
+      case 't':  // texture coords. (u, v; an optional w is ignored)
+	for (int i = 0; i < 2; ++i) { coord = 0; ss >> coord; _texCoords.push_back(coord);}
 	break;
       default:
 	cerr << "Seen unknown vertex info of type '" << c << "', ignoring it..." << endl;
@@ -130,6 +159,7 @@ void Model::load(std::string filename) {
 	break;
       }
       ss >> tail;
+      _materialLibraries.push_back(modelPath+tail);
       loadMTL(modelPath+tail);
       break;
       //-------------
@@ -141,24 +171,22 @@ void Model::load(std::string filename) {
       }
       ss >> tail;
       material = findMat(tail);
+      startSubMesh(group);
       break;
       //-------------
-    case 'g':
-#if DEBUGPARSER
-      cout << "[outer]:Seen line of type '" << c << "', which is not supported. Ignoring it..." << endl;
-#endif
+    case 'g':  // group: a new submesh
+      getline(ss >> ws, group);
+      startSubMesh(group);
       break;
       //-------------
-    case 's':
-#if DEBUGPARSER
-      cout << "[outer]:Seen line of type '" << c << "', which is not supported. Ignoring it..." << endl;
-#endif
+    case 's':  // smoothing group of the generated normals (off or 0 for none)
+      ss >> tail;
+      smoothing = tail == "off" ? 0 : atoi(tail.c_str());
       break;
       //-------------
-    case 'o':
-#if DEBUGPARSER
-      cout << "[outer]:Seen line of type '" << c << "', which is not supported. Ignoring it..." << endl;
-#endif
+    case 'o':  // object: a new submesh
+      getline(ss >> ws, group);
+      startSubMesh(group);
       break;
       //-------------
     default:
@@ -166,11 +194,172 @@ void Model::load(std::string filename) {
       break;
     }
   }
+  startSubMesh(group);  // tanquem l'ultim submesh
+  _subMeshes.pop_back();
+  computeSubMeshBounds();
+
   omplenormals(_faces, _vertices);  // afegim normals per cara...
+  generateNormals();  // i per vertex a les cares sense vn
+
+  // Nivells de detall, darrere de les cares originals als VBO
+  vector<Face> vboFaces(_faces);
+  buildLODs(vboFaces);
+  _VBO_faces = vboFaces.size();
 
   // Omplim els vectors per als VBO
-  ompleVBOs(_faces, _vertices, _normals, _VBO_vertices, _VBO_normals, 
-            _VBO_matamb, _VBO_matdiff, _VBO_matspec, _VBO_matshin);
+  ompleVBOs(vboFaces, _vertices, _normals, _texCoords, _VBO_vertices, _VBO_normals, _VBO_texcoords,
+            _VBO_matamb, _VBO_matdiff, _VBO_matspec, _VBO_matshin,
+            _VBO_indices, _VBO_numVertices);
+
+  // Marcs tangents per al normal mapping, si hi ha coordenades de textura
+  if (_VBO_texcoords != NULL) computeTangents();
+}
+
+void Model::optimizeIndices() {
+  if (_VBO_indices == NULL || _indicesOptimized) return;
+  _indicesOptimized = true;
+  int numIndices = 3*_VBO_faces;
+  float acmr, atvr;
+  MeshOptimizer::cacheStats(_VBO_indices, numIndices, _VBO_numVertices, VERTEX_CACHE_FIFO, acmr, atvr);
+  cout << "Index buffer before: ACMR " << acmr << ", ATVR " << atvr;
+
+  // Cada submesh de cada nivell per separat, perque els rangs no canvien
+  for (unsigned int l = 0; l < _lods.size(); ++l) {
+    const vector<SubMesh> &subs = _lods[l].subMeshes;
+    for (unsigned int s = 0; s < subs.size(); ++s) {
+      unsigned int *ind = _VBO_indices + 3*subs[s].firstFace;
+      MeshOptimizer::optimizeVertexCache(ind, 3*subs[s].faceCount, _VBO_numVertices);
+      MeshOptimizer::optimizeOverdraw(ind, 3*subs[s].faceCount, _VBO_vertices, _VBO_numVertices);
+    }
+  }
+
+  // Vertexs en l'ordre en que es llegeixen
+  vector<int> remap;
+  MeshOptimizer::optimizeVertexFetch(_VBO_indices, numIndices, _VBO_numVertices, remap);
+  float *arrays[5] = { _VBO_vertices, _VBO_normals, _VBO_matamb, _VBO_matdiff, _VBO_matspec };
+  vector<float> old;
+  for (int a = 0; a < 5; ++a) {
+    old.assign(arrays[a], arrays[a] + 3*_VBO_numVertices);
+    for (int v = 0; v < _VBO_numVertices; ++v)
+      if (remap[v] >= 0)
+        for (int j = 0; j < 3; ++j) arrays[a][3*remap[v]+j] = old[3*v+j];
+  }
+  old.assign(_VBO_matshin, _VBO_matshin + _VBO_numVertices);
+  for (int v = 0; v < _VBO_numVertices; ++v)
+    if (remap[v] >= 0) _VBO_matshin[remap[v]] = old[v];
+  if (_VBO_texcoords != NULL) {
+    old.assign(_VBO_texcoords, _VBO_texcoords + 2*_VBO_numVertices);
+    for (int v = 0; v < _VBO_numVertices; ++v)
+      if (remap[v] >= 0)
+        for (int j = 0; j < 2; ++j) _VBO_texcoords[2*remap[v]+j] = old[2*v+j];
+  }
+  if (_VBO_tangents != NULL) {
+    old.assign(_VBO_tangents, _VBO_tangents + 4*_VBO_numVertices);
+    for (int v = 0; v < _VBO_numVertices; ++v)
+      if (remap[v] >= 0)
+        for (int j = 0; j < 4; ++j) _VBO_tangents[4*remap[v]+j] = old[4*v+j];
+  }
+
+  MeshOptimizer::cacheStats(_VBO_indices, numIndices, _VBO_numVertices, VERTEX_CACHE_FIFO, acmr, atvr);
+  cout << ", after: ACMR " << acmr << ", ATVR " << atvr << " (" << _VBO_numVertices << " vertices, "
+       << _VBO_faces << " faces)" << endl;
+}
+
+void Model::quantizeVertices() {
+  if (_VBO_vertices == NULL) return;
+  int nv = _VBO_numVertices;
+
+  // Box of every vertex: the one of the first submesh that uses it, in any
+  // level (the boxes of level 0 hold the vertices of every level)
+  vector<int> box(nv, -1);
+  for (unsigned int l = 0; l < _lods.size(); ++l) {
+    const vector<SubMesh> &subs = _lods[l].subMeshes;
+    for (unsigned int s = 0; s < subs.size(); ++s)
+      for (int i = 3*subs[s].firstFace; i < 3*(subs[s].firstFace + subs[s].faceCount); ++i)
+        if (box[_VBO_indices[i]] < 0) box[_VBO_indices[i]] = s;
+  }
+  _VBO_boxes.assign(8*_subMeshes.size(), 0.0f);
+  for (unsigned int s = 0; s < _subMeshes.size(); ++s)
+    for (int j = 0; j < 3; ++j) {
+      _VBO_boxes[8*s+j] = _subMeshes[s].bboxMin[j];
+      _VBO_boxes[8*s+4+j] = _subMeshes[s].bboxMax[j] - _subMeshes[s].bboxMin[j];
+    }
+
+  _VBO_qpositions.resize(4*nv);
+  _VBO_qnormals.resize(2*nv);
+  _VBO_qmatamb.resize(4*nv);
+  _VBO_qmatdiff.resize(4*nv);
+  _VBO_qmatspec.resize(4*nv);
+  _VBO_qmatshin.resize(nv);
+  if (_VBO_texcoords != NULL) _VBO_qtexcoords.resize(2*nv);
+  else _VBO_qtexcoords.clear();
+  if (_VBO_tangents != NULL) _VBO_qtangents.resize(4*nv);
+  else _VBO_qtangents.clear();
+
+  // Largest difference with the float arrays, once decoded
+  float positionError = 0, normalError = 0, texcoordError = 0;
+  for (int v = 0; v < nv; ++v) {
+    int s = max(box[v], 0);   // unused vertices (none after optimizeIndices)
+    const SubMesh &sub = _subMeshes[s];
+    unsigned short *q = &_VBO_qpositions[4*v];
+    float p[3];
+    VertexQuantizer::quantizePosition(&_VBO_vertices[3*v], sub.bboxMin, sub.bboxMax, q);
+    q[3] = (unsigned short)s;
+    VertexQuantizer::dequantizePosition(q, sub.bboxMin, sub.bboxMax, p);
+    for (int j = 0; j < 3; ++j) positionError = max(positionError, fabs(p[j] - _VBO_vertices[3*v+j]));
+
+    float n[3], length = 0;
+    for (int j = 0; j < 3; ++j) length += _VBO_normals[3*v+j]*_VBO_normals[3*v+j];
+    length = sqrt(length);
+    VertexQuantizer::encodeOctahedral(&_VBO_normals[3*v], &_VBO_qnormals[2*v]);
+    VertexQuantizer::decodeOctahedral(&_VBO_qnormals[2*v], n);
+    if (length > 0) {
+      float dot = (n[0]*_VBO_normals[3*v] + n[1]*_VBO_normals[3*v+1] + n[2]*_VBO_normals[3*v+2]) / length;
+      normalError = max(normalError, (float)acos(min(dot, 1.0f)));
+    }
+
+    if (_VBO_texcoords != NULL)
+      for (int j = 0; j < 2; ++j) {
+        unsigned short h = VertexQuantizer::toHalf(_VBO_texcoords[2*v+j]);
+        _VBO_qtexcoords[2*v+j] = h;
+        texcoordError = max(texcoordError, fabs(VertexQuantizer::fromHalf(h) - _VBO_texcoords[2*v+j]));
+      }
+
+    if (_VBO_tangents != NULL) {
+      VertexQuantizer::encodeOctahedral(&_VBO_tangents[4*v], &_VBO_qtangents[4*v]);
+      _VBO_qtangents[4*v+2] = _VBO_tangents[4*v+3] < 0 ? -32767 : 32767;
+      _VBO_qtangents[4*v+3] = 0;
+    }
+
+    for (int j = 0; j < 3; ++j) {
+      _VBO_qmatamb[4*v+j] = VertexQuantizer::toUnorm8(_VBO_matamb[3*v+j]);
+      _VBO_qmatdiff[4*v+j] = VertexQuantizer::toUnorm8(_VBO_matdiff[3*v+j]);
+      _VBO_qmatspec[4*v+j] = VertexQuantizer::toUnorm8(_VBO_matspec[3*v+j]);
+    }
+    _VBO_qmatamb[4*v+3] = _VBO_qmatdiff[4*v+3] = _VBO_qmatspec[4*v+3] = 255;
+    _VBO_qmatshin[v] = VertexQuantizer::toHalf(_VBO_matshin[v]);
+  }
+
+  // Bytes per vertex of both formats
+  int tex = _VBO_texcoords != NULL ? 1 : 0;
+  int tangents = _VBO_tangents != NULL ? 1 : 0;
+  int floatBytes = 4*(3 + 3 + 2*tex + 4*tangents + 3*3 + 1);
+  int quantizedBytes = 8 + 4 + 4*tex + 8*tangents + 3*4 + 2;
+  double radius = 0;
+  for (unsigned int m = 0; m < _subMeshes.size(); ++m) radius = max(radius, (double)_subMeshes[m].radius);
+  cout << "Quantized vertices: " << quantizedBytes << " bytes instead of " << floatBytes << " ("
+       << (float)floatBytes/quantizedBytes << "x smaller, " << (size_t)nv*(floatBytes - quantizedBytes)/1024
+       << " KB saved), max error: position " << positionError << " (" << 100*positionError/radius
+       << "% of the radius), normal " << normalError*180/M_PI << " degrees";
+  if (tex) cout << ", texture coordinates " << texcoordError;
+  cout << endl;
+}
+
+int Model::selectLOD(double maxError) const {
+  int level = 0;
+  for (unsigned int l = 1; l < _lods.size(); ++l)
+    if (_lods[l].error <= maxError) level = l;
+  return level;
 }
 
 // ======= helper methods for checking and debugging ==========
@@ -178,6 +367,7 @@ void Model::dumpStats() const {
   cout << "Model Stats:" << endl;
   cout << "Vertices:   " << _vertices.size() << " components [" << _vertices.size()/3. << " vertices]" << endl;
   cout << "Normals:    " << _normals.size() << " components [" << _normals.size()/3. << " normals]" << endl;
+  cout << "TexCoords:  " << _texCoords.size() << " components [" << _texCoords.size()/2. << " texture coordinates]" << endl;
   cout << "Faces:      " << _faces.size() << endl;
 }
 
@@ -211,6 +401,52 @@ void Model::dumpModel() const {
 }
 
 //======== private methods and auxiliary functions ==========
+void Model::startSubMesh(const string & name) {
+  // Closes the current submesh (dropped if it has no faces)
+  if (!_subMeshes.empty()) {
+    SubMesh &last = _subMeshes.back();
+    last.faceCount = _faces.size() - last.firstFace;
+    if (last.faceCount == 0) _subMeshes.pop_back();
+  }
+  SubMesh s;
+  s.name = name;
+  s.firstFace = _faces.size();
+  s.faceCount = 0;
+  s.mat = material;
+  _subMeshes.push_back(s);
+}
+
+void Model::computeSubMeshBounds() {
+  for (unsigned int m = 0; m < _subMeshes.size(); ++m) {
+    SubMesh &s = _subMeshes[m];
+    for (int j = 0; j < 3; ++j) {
+      s.bboxMin[j] = 1e30f;
+      s.bboxMax[j] = -1e30f;
+    }
+    for (int f = s.firstFace; f < s.firstFace + s.faceCount; ++f)
+      for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j) {
+          float c = _vertices[_faces[f].v[i]+j];
+          if (c < s.bboxMin[j]) s.bboxMin[j] = c;
+          if (c > s.bboxMax[j]) s.bboxMax[j] = c;
+        }
+
+    // Sphere centered in the box, through the farthest vertex
+    double r2 = 0;
+    for (int j = 0; j < 3; ++j) s.center[j] = (s.bboxMin[j] + s.bboxMax[j]) / 2.0f;
+    for (int f = s.firstFace; f < s.firstFace + s.faceCount; ++f)
+      for (int i = 0; i < 3; ++i) {
+        double d2 = 0;
+        for (int j = 0; j < 3; ++j) {
+          double d = _vertices[_faces[f].v[i]+j] - s.center[j];
+          d2 += d*d;
+        }
+        if (d2 > r2) r2 = d2;
+      }
+    s.radius = sqrt(r2);
+  }
+}
+
 void Model::parseVOnly(stringstream & ss, string & block) {
 #if DEBUGPARSER
   cout << "Entering parseVOnly(..., \""<< block << "\")" << endl;
@@ -228,6 +464,7 @@ void Model::parseVOnly(stringstream & ss, string & block) {
   ss >> index;
   f.v.push_back(3*index-3);
   f.mat = material;
+  f.smooth = smoothing;
   _faces.push_back(f);
   Face fAnt(f);
   while(ss >> index) {
@@ -265,6 +502,7 @@ void Model::parseVN(stringstream & ss, string & block) {
   ssb >> n;
   f.v.push_back(3*index-3); f.n.push_back(3*n-3);
   f.mat = material;
+  f.smooth = smoothing;
   _faces.push_back(f);
   Face fAnt(f);
   while(ss >> block) {
@@ -284,36 +522,34 @@ void Model::parseVT(stringstream & ss, string & block) {
 #if DEBUGPARSER
   cout << "Entering parseVT(..., \""<< block << "\")" << endl;
 #endif
-  if (!fvt) {
-    cerr << "vt node found: Texture coords not supported yet. Ignoring texture part..." << endl;
-    fvt = true;
-  }
   Face f;
   stringstream ssb;
   ssb.str(block);
-  int index;
-  ssb >> index;
-  f.v.push_back(3*index-3);
+  int index, t;
+  char sep;
+  ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t;
+  f.v.push_back(3*index-3); f.t.push_back(2*t-2);
 
   ss >> block;
   ssb.clear(); ssb.str(block);
-  ssb >> index;
-  f.v.push_back(3*index-3);
+  ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t;
+  f.v.push_back(3*index-3); f.t.push_back(2*t-2);
   
   ss >> block;
   ssb.clear(); ssb.str(block);
-  ssb >> index;
-  f.v.push_back(3*index-3);
+  ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t;
+  f.v.push_back(3*index-3); f.t.push_back(2*t-2);
   f.mat = material;
+  f.smooth = smoothing;
   _faces.push_back(f);
   Face fAnt(f);
   while(ss >> block) {
-    f.v.clear();
+    f.v.clear(); f.t.clear();
     ssb.clear(); ssb.str(block);
-    ssb >> index;
-    f.v.push_back(fAnt.v[0]);
-    f.v.push_back(fAnt.v[2]);
-    f.v.push_back(3*index-3);
+    ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t;
+    f.v.push_back(fAnt.v[0]); f.t.push_back(fAnt.t[0]);
+    f.v.push_back(fAnt.v[2]); f.t.push_back(fAnt.t[2]);
+    f.v.push_back(3*index-3); f.t.push_back(2*t-2);
     _faces.push_back(f);
     fAnt = f;
   }
@@ -323,10 +559,6 @@ void Model::parseVTN(stringstream & ss, string & block) {
 #if DEBUGPARSER
   cout << "Entering parseVTN(..., \""<< block << "\")" << endl;
 #endif
-  if (!fvtn) {
-    cerr << "vtn node found: Texture coords not supported yet. Ignoring texture part..." << endl;
-    fvtn = true;
-  }
   Face f;
   stringstream ssb;
   ssb.str(block);
@@ -334,35 +566,708 @@ void Model::parseVTN(stringstream & ss, string & block) {
   char sep;
   ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t >> sep; assert(sep == '/');
   ssb >> n;
-  f.v.push_back(3*index-3); f.n.push_back(3*n-3);
+  f.v.push_back(3*index-3); f.n.push_back(3*n-3); f.t.push_back(2*t-2);
 
   ss >> block;
   ssb.clear(); ssb.str(block);
   ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t >> sep; assert(sep == '/');
   ssb >> n;
-  f.v.push_back(3*index-3); f.n.push_back(3*n-3);
+  f.v.push_back(3*index-3); f.n.push_back(3*n-3); f.t.push_back(2*t-2);
   
   ss >> block;
   ssb.clear(); ssb.str(block);
   ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t >> sep; assert(sep == '/');
   ssb >> n;
-  f.v.push_back(3*index-3); f.n.push_back(3*n-3);
+  f.v.push_back(3*index-3); f.n.push_back(3*n-3); f.t.push_back(2*t-2);
   f.mat = material;
+  f.smooth = smoothing;
   _faces.push_back(f);
   Face fAnt(f);
   while(ss >> block) {
-    f.v.clear(); f.n.clear();
+    f.v.clear(); f.n.clear(); f.t.clear();
     ssb.clear(); ssb.str(block);
     ssb >> index; ssb >> sep; assert(sep == '/'); ssb >> t >>sep; assert(sep == '/');
     ssb >> n;
-    f.v.push_back(fAnt.v[0]); f.n.push_back(fAnt.n[0]);
-    f.v.push_back(fAnt.v[2]); f.n.push_back(fAnt.n[2]);
-    f.v.push_back(3*index-3); f.n.push_back(3*n-3);
+    f.v.push_back(fAnt.v[0]); f.n.push_back(fAnt.n[0]); f.t.push_back(fAnt.t[0]);
+    f.v.push_back(fAnt.v[2]); f.n.push_back(fAnt.n[2]); f.t.push_back(fAnt.t[2]);
+    f.v.push_back(3*index-3); f.n.push_back(3*n-3); f.t.push_back(2*t-2);
     _faces.push_back(f);
     fAnt = f;
   }
 }
 
+// ======== Tangent frames ==========
+// Runs body(first, last) over [0, count) in chunks, on every core. Returns
+// the number of threads.
+static int parallelFor(int count, const function<void(int, int)> &body) {
+  const int chunk = 4096;
+  int numThreads = max(1, min((int)thread::hardware_concurrency(), (count + chunk - 1)/chunk));
+  atomic<int> next(0);
+  auto worker = [&]() {
+    int first;
+    while ((first = next.fetch_add(chunk)) < count) body(first, min(first + chunk, count));
+  };
+  vector<thread> workers;
+  for (int t = 1; t < numThreads; ++t) workers.push_back(thread(worker));
+  worker();
+  for (unsigned int t = 0; t < workers.size(); ++t) workers[t].join();
+  return numThreads;
+}
+
+// Grows a VBO array with copies of the vertices sources, after the others
+static void appendVertices(float *&array, int components, int numVertices, const vector<int> &sources) {
+  float *grown = new float[components*(numVertices + sources.size())];
+  copy(array, array + components*numVertices, grown);
+  for (unsigned int k = 0; k < sources.size(); ++k)
+    copy(array + components*sources[k], array + components*(sources[k] + 1), grown + components*(numVertices + k));
+  delete[] array;
+  array = grown;
+}
+
+// As MikkTSpace: the tangent of every face (the direction in which u grows)
+// is projected on the plane of the normal of each corner and added with the
+// angle of the corner as weight. The faces whose texture is mirrored have the
+// other handedness, so the vertices shared by both kinds are split (the
+// texture seams already are, by ompleVBOs). The levels of detail reuse the
+// vertices of level 0, which are the only ones accumulated.
+void Model::computeTangents() {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  int nf = _VBO_faces, nf0 = _faces.size();
+
+  // Tangent and handedness of every face, 0 if it has no texture area
+  vector<float> faceTangents(3*nf);
+  vector<signed char> faceSigns(nf);
+  int numThreads = parallelFor(nf, [&](int first, int last) {
+    for (int f = first; f < last; ++f) {
+      const unsigned int *ind = &_VBO_indices[3*f];
+      const float *t0 = &_VBO_texcoords[2*ind[0]], *t1 = &_VBO_texcoords[2*ind[1]], *t2 = &_VBO_texcoords[2*ind[2]];
+      float du1 = t1[0] - t0[0], dv1 = t1[1] - t0[1];
+      float du2 = t2[0] - t0[0], dv2 = t2[1] - t0[1];
+      float det = du1*dv2 - du2*dv1;
+      faceSigns[f] = det > 0 ? 1 : (det < 0 ? -1 : 0);
+      for (int j = 0; j < 3; ++j) {
+        float e1 = _VBO_vertices[3*ind[1]+j] - _VBO_vertices[3*ind[0]+j];
+        float e2 = _VBO_vertices[3*ind[2]+j] - _VBO_vertices[3*ind[0]+j];
+        faceTangents[3*f+j] = det != 0 ? (e1*dv2 - e2*dv1) / det : 0.0f;
+      }
+    }
+  });
+
+  // Handedness of every vertex, the one of most of its faces. The others
+  // move to a copy of the vertex, in every level.
+  int nv = _VBO_numVertices;
+  vector<int> positive(nv, 0), negative(nv, 0);
+  for (int i = 0; i < 3*nf0; ++i) {
+    if (faceSigns[i/3] > 0) ++positive[_VBO_indices[i]];
+    else if (faceSigns[i/3] < 0) ++negative[_VBO_indices[i]];
+  }
+  vector<signed char> signs(nv);
+  vector<int> copies(nv, -1), sources;
+  for (int v = 0; v < nv; ++v) {
+    signs[v] = positive[v] >= negative[v] ? 1 : -1;
+    if (positive[v] > 0 && negative[v] > 0) {
+      copies[v] = nv + sources.size();
+      sources.push_back(v);
+      signs.push_back(-signs[v]);
+    }
+  }
+  for (int i = 0; i < 3*nf; ++i) {
+    unsigned int v = _VBO_indices[i];
+    if (v < (unsigned int)nv && copies[v] >= 0 && faceSigns[i/3] != 0 && faceSigns[i/3] != signs[v])
+      _VBO_indices[i] = copies[v];
+  }
+  if (!sources.empty()) {
+    float **arrays[5] = { &_VBO_vertices, &_VBO_normals, &_VBO_matamb, &_VBO_matdiff, &_VBO_matspec };
+    for (int a = 0; a < 5; ++a) appendVertices(*arrays[a], 3, nv, sources);
+    appendVertices(_VBO_texcoords, 2, nv, sources);
+    appendVertices(_VBO_matshin, 1, nv, sources);
+    nv = _VBO_numVertices = nv + sources.size();
+  }
+
+  // Corners of level 0 of every vertex
+  vector<int> offsets(nv + 1, 0), corners(3*nf0);
+  for (int i = 0; i < 3*nf0; ++i) ++offsets[_VBO_indices[i] + 1];
+  for (int v = 0; v < nv; ++v) offsets[v + 1] += offsets[v];
+  vector<int> fill(offsets.begin(), offsets.end() - 1);
+  for (int i = 0; i < 3*nf0; ++i) corners[fill[_VBO_indices[i]]++] = i;
+
+  _VBO_tangents = new float[4*nv];
+  parallelFor(nv, [&](int first, int last) {
+    for (int v = first; v < last; ++v) {
+      float n[3], t[3] = { 0, 0, 0 };
+      float length = sqrt(_VBO_normals[3*v]*_VBO_normals[3*v] + _VBO_normals[3*v+1]*_VBO_normals[3*v+1] + _VBO_normals[3*v+2]*_VBO_normals[3*v+2]);
+      for (int j = 0; j < 3; ++j) n[j] = length > 0 ? _VBO_normals[3*v+j] / length : (j == 2 ? 1.0f : 0.0f);
+
+      for (int c = offsets[v]; c < offsets[v + 1]; ++c) {
+        int f = corners[c]/3, i = corners[c]%3;
+        if (faceSigns[f] == 0) continue;
+        const unsigned int *ind = &_VBO_indices[3*f];
+        const float *p = &_VBO_vertices[3*ind[i]];
+        const float *a = &_VBO_vertices[3*ind[(i+1)%3]], *b = &_VBO_vertices[3*ind[(i+2)%3]];
+        float ea[3], eb[3], la = 0, lb = 0, dot = 0;
+        for (int j = 0; j < 3; ++j) {
+          ea[j] = a[j] - p[j]; eb[j] = b[j] - p[j];
+          la += ea[j]*ea[j]; lb += eb[j]*eb[j]; dot += ea[j]*eb[j];
+        }
+        if (la == 0 || lb == 0) continue;
+        float angle = acos(max(-1.0f, min(1.0f, dot / sqrt(la*lb))));
+
+        const float *ft = &faceTangents[3*f];
+        float nt = n[0]*ft[0] + n[1]*ft[1] + n[2]*ft[2], proj[3], lp = 0;
+        for (int j = 0; j < 3; ++j) { proj[j] = ft[j] - n[j]*nt; lp += proj[j]*proj[j]; }
+        if (lp == 0) continue;
+        lp = sqrt(lp);
+        for (int j = 0; j < 3; ++j) t[j] += proj[j] / lp * angle;
+      }
+
+      // Without texture area around, any tangent of the plane will do
+      length = sqrt(t[0]*t[0] + t[1]*t[1] + t[2]*t[2]);
+      if (length == 0) {
+        float axis[3] = { 0, 0, 0 };
+        axis[fabs(n[0]) < 0.9f ? 0 : 1] = 1;
+        float na = n[0]*axis[0] + n[1]*axis[1] + n[2]*axis[2];
+        for (int j = 0; j < 3; ++j) t[j] = axis[j] - n[j]*na;
+        length = sqrt(t[0]*t[0] + t[1]*t[1] + t[2]*t[2]);
+      }
+      for (int j = 0; j < 3; ++j) _VBO_tangents[4*v+j] = t[j] / length;
+      _VBO_tangents[4*v+3] = signs[v];
+    }
+  });
+
+  double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  cout << "Tangents: " << nv << " vertices (" << sources.size() << " split where the texture is mirrored) in "
+       << ms << " ms, " << numThreads << " threads" << endl;
+}
+
+// ======== Generated normals ==========
+// Faces without vn: every corner gets the normal of its face or, inside a
+// smoothing group, the angle-weighted average of the faces of the group
+// around it. The vertices at the same position are welded and the equal
+// normals shared (flat faces in a plane share theirs), so ompleVBOs shares
+// the corners of neighbouring faces instead of making each one a vertex.
+void Model::generateNormals() {
+  vector<int> faces;
+  for (unsigned int f = 0; f < _faces.size(); ++f)
+    if (_faces[f].n.empty()) faces.push_back(f);
+  if (faces.empty()) return;
+
+  int nv = _vertices.size() / 3;
+  vector<int> weld(nv);
+  map<vector<Vertex>, int> positions;
+  for (int i = 0; i < nv; ++i) {
+    vector<Vertex> p(_vertices.begin() + 3*i, _vertices.begin() + 3*i + 3);
+    weld[i] = positions.insert(make_pair(p, i)).first->second;
+  }
+
+  // Degenerate faces have no normal of their own
+  for (unsigned int k = 0; k < faces.size(); ++k) {
+    double *n = _faces[faces[k]].normalC;
+    if (!isfinite(n[0]) || !isfinite(n[1]) || !isfinite(n[2])) {
+      n[0] = n[1] = 0; n[2] = 1;
+    }
+  }
+
+  // Sums of the smoothing groups, by welded vertex and group
+  map<pair<int, int>, vector<double> > sums;
+  for (unsigned int k = 0; k < faces.size(); ++k) {
+    const Face &face = _faces[faces[k]];
+    if (face.smooth == 0) continue;
+    for (int i = 0; i < 3; ++i) {
+      const Vertex *p = &_vertices[face.v[i]];
+      const Vertex *a = &_vertices[face.v[(i+1)%3]];
+      const Vertex *b = &_vertices[face.v[(i+2)%3]];
+      double e0[3], e1[3], l0 = 0, l1 = 0, dot = 0;
+      for (int j = 0; j < 3; ++j) {
+        e0[j] = a[j] - p[j]; e1[j] = b[j] - p[j];
+        l0 += e0[j]*e0[j]; l1 += e1[j]*e1[j]; dot += e0[j]*e1[j];
+      }
+      double angle = (l0 > 0 && l1 > 0) ? acos(max(-1.0, min(1.0, dot / sqrt(l0*l1)))) : 0;
+      vector<double> &sum = sums[make_pair(weld[face.v[i]/3], face.smooth)];
+      sum.resize(3);
+      for (int j = 0; j < 3; ++j) sum[j] += angle*face.normalC[j];
+    }
+  }
+
+  // Normals equal to 1e-5 are one
+  map<vector<long long>, int> ids;
+  vector<long long> key(3);
+  for (unsigned int k = 0; k < faces.size(); ++k) {
+    Face &face = _faces[faces[k]];
+    face.n.resize(3);
+    for (int i = 0; i < 3; ++i) {
+      int v = weld[face.v[i]/3];
+      double n[3] = { face.normalC[0], face.normalC[1], face.normalC[2] };
+      if (face.smooth != 0) {
+        const vector<double> &sum = sums[make_pair(v, face.smooth)];
+        double length = sqrt(sum[0]*sum[0] + sum[1]*sum[1] + sum[2]*sum[2]);
+        if (length > 0) for (int j = 0; j < 3; ++j) n[j] = sum[j] / length;
+      }
+      for (int j = 0; j < 3; ++j) key[j] = llround(n[j]*1e5);
+      map<vector<long long>, int>::iterator it = ids.find(key);
+      if (it == ids.end()) {
+        it = ids.insert(make_pair(key, (int)_normals.size())).first;
+        _normals.insert(_normals.end(), n, n + 3);
+      }
+      face.v[i] = 3*v;
+      face.n[i] = it->second;
+    }
+  }
+}
+
+// ======== Binary model ==========
+static const char binaryMagic[8] = { 'A', 'G', 'M', 'E', 'S', 'H', '\r', '\n' };
+
+template <class T> static void writeValue(ofstream &file, const T &value) {
+  file.write((const char*)&value, sizeof(T));
+}
+
+template <class T> static void writeArray(ofstream &file, const T *data, size_t count) {
+  if (count > 0) file.write((const char*)data, sizeof(T)*count);
+}
+
+template <class T> static void writeVector(ofstream &file, const vector<T> &v) {
+  writeValue(file, (unsigned int)v.size());
+  writeArray(file, v.data(), v.size());
+}
+
+static void writeString(ofstream &file, const string &s) {
+  writeValue(file, (unsigned int)s.size());
+  writeArray(file, s.data(), s.size());
+}
+
+static void writeSubMeshes(ofstream &file, const vector<SubMesh> &subs) {
+  writeValue(file, (unsigned int)subs.size());
+  for (unsigned int s = 0; s < subs.size(); ++s) {
+    writeString(file, subs[s].name);
+    writeValue(file, subs[s].firstFace); writeValue(file, subs[s].faceCount); writeValue(file, subs[s].mat);
+    writeArray(file, subs[s].bboxMin, 3); writeArray(file, subs[s].bboxMax, 3);
+    writeArray(file, subs[s].center, 3); writeValue(file, subs[s].radius);
+  }
+}
+
+// The sizes are checked against the file, so a damaged one does not ask for
+// huge allocations
+template <class T> static bool readValue(ifstream &file, T &value) {
+  return (bool)file.read((char*)&value, sizeof(T));
+}
+
+template <class T> static bool readArray(ifstream &file, size_t fileSize, T *&data, size_t count) {
+  if (sizeof(T)*count > fileSize) return false;
+  data = new T[count];
+  return count == 0 || file.read((char*)data, sizeof(T)*count);
+}
+
+template <class T> static bool readVector(ifstream &file, size_t fileSize, vector<T> &v) {
+  unsigned int size;
+  if (!readValue(file, size) || sizeof(T)*size > fileSize) return false;
+  v.resize(size);
+  return size == 0 || file.read((char*)v.data(), sizeof(T)*size);
+}
+
+static bool readString(ifstream &file, size_t fileSize, string &s) {
+  unsigned int length;
+  if (!readValue(file, length) || length > fileSize) return false;
+  s.resize(length);
+  return length == 0 || file.read(&s[0], length);
+}
+
+static bool readSubMeshes(ifstream &file, size_t fileSize, vector<SubMesh> &subs) {
+  unsigned int count;
+  if (!readValue(file, count) || count > fileSize) return false;
+  subs.resize(count);
+  for (unsigned int s = 0; s < count; ++s) {
+    if (!readString(file, fileSize, subs[s].name)) return false;
+    readValue(file, subs[s].firstFace); readValue(file, subs[s].faceCount); readValue(file, subs[s].mat);
+    file.read((char*)subs[s].bboxMin, sizeof(subs[s].bboxMin)); file.read((char*)subs[s].bboxMax, sizeof(subs[s].bboxMax));
+    file.read((char*)subs[s].center, sizeof(subs[s].center)); readValue(file, subs[s].radius);
+  }
+  return (bool)file;
+}
+
+// Magic, version, material libraries and stamp
+static bool readHeader(ifstream &file, size_t fileSize, const string &filename, vector<string> &libraries, string &stamp) {
+  char magic[sizeof(binaryMagic)];
+  unsigned int version = 0;
+  file.read(magic, sizeof(magic));
+  readValue(file, version);
+  if (!file || !equal(magic, magic + sizeof(magic), binaryMagic)) {
+    cerr << filename << " is not a binary model" << endl;
+    return false;
+  }
+  if (version != MODEL_BINARY_VERSION) {
+    cerr << filename << " was written by another version (" << version << ")" << endl;
+    return false;
+  }
+
+  unsigned int count = 0;
+  bool ok = readValue(file, count) && count <= fileSize;
+  if (ok) libraries.resize(count);
+  for (unsigned int i = 0; ok && i < count; ++i) ok = readString(file, fileSize, libraries[i]);
+  if (!ok || !readString(file, fileSize, stamp)) {
+    cerr << filename << " is truncated or damaged" << endl;
+    return false;
+  }
+  return true;
+}
+
+bool Model::readBinaryHeader(const std::string &filename, std::vector<std::string> &materialLibraries, std::string &stamp) {
+  ifstream file(filename.c_str(), ios::binary | ios::ate);
+  if (!file) return false;
+  size_t fileSize = file.tellg();
+  file.seekg(0);
+  return readHeader(file, fileSize, filename, materialLibraries, stamp);
+}
+
+bool Model::saveBinary(const std::string &filename, const std::string &stamp) const {
+  if (_VBO_indices == NULL) return false;
+  ofstream file(filename.c_str(), ios::binary);
+  if (!file) {
+    cerr << "Cannot open " << filename << " for writing" << endl;
+    return false;
+  }
+
+  int nv = _VBO_numVertices;
+  file.write(binaryMagic, sizeof(binaryMagic));
+  writeValue(file, (unsigned int)MODEL_BINARY_VERSION);
+  writeValue(file, (unsigned int)_materialLibraries.size());
+  for (unsigned int i = 0; i < _materialLibraries.size(); ++i) writeString(file, _materialLibraries[i]);
+  writeString(file, stamp);
+  writeValue(file, (unsigned char)(_VBO_texcoords != NULL));
+  writeValue(file, (unsigned char)(_VBO_tangents != NULL));
+  writeValue(file, (unsigned char)_indicesOptimized);
+  writeVector(file, _vertices);
+  writeVector(file, _normals);
+  writeVector(file, _texCoords);
+  writeSubMeshes(file, _subMeshes);
+  writeValue(file, (unsigned int)_lods.size());
+  for (unsigned int l = 0; l < _lods.size(); ++l) {
+    writeValue(file, _lods[l].firstFace); writeValue(file, _lods[l].faceCount); writeValue(file, _lods[l].error);
+    writeSubMeshes(file, _lods[l].subMeshes);
+  }
+
+  writeValue(file, _VBO_faces);
+  writeValue(file, nv);
+  writeArray(file, _VBO_vertices, 3*nv);
+  writeArray(file, _VBO_normals, 3*nv);
+  if (_VBO_texcoords != NULL) writeArray(file, _VBO_texcoords, 2*nv);
+  if (_VBO_tangents != NULL) writeArray(file, _VBO_tangents, 4*nv);
+  writeArray(file, _VBO_matamb, 3*nv);
+  writeArray(file, _VBO_matdiff, 3*nv);
+  writeArray(file, _VBO_matspec, 3*nv);
+  writeArray(file, _VBO_matshin, nv);
+  writeArray(file, _VBO_indices, 3*_VBO_faces);
+  return file.good();
+}
+
+bool Model::loadBinary(const std::string &filename, const std::string &stamp) {
+  _vertices.clear(); _normals.clear(); _texCoords.clear(); _faces.clear();
+  _subMeshes.clear(); _lods.clear(); _materialLibraries.clear();
+  releaseVBOs();
+
+  ifstream file(filename.c_str(), ios::binary | ios::ate);
+  if (!file) {
+    cerr << "Cannot open " << filename << endl;
+    return false;
+  }
+  size_t fileSize = file.tellg();
+  file.seekg(0);
+
+  string fileStamp;
+  if (!readHeader(file, fileSize, filename, _materialLibraries, fileStamp)) return false;
+  if (fileStamp != stamp) {
+    cerr << filename << " is out of date" << endl;
+    _materialLibraries.clear();
+    return false;
+  }
+
+  unsigned char hasTexCoords = 0, hasTangents = 0, optimized = 0;
+  unsigned int numLODs = 0;
+  bool ok = readValue(file, hasTexCoords) && readValue(file, hasTangents) && readValue(file, optimized)
+    && readVector(file, fileSize, _vertices) && readVector(file, fileSize, _normals)
+    && readVector(file, fileSize, _texCoords) && readSubMeshes(file, fileSize, _subMeshes)
+    && readValue(file, numLODs) && numLODs <= fileSize;
+  if (ok) _lods.resize(numLODs);
+  for (unsigned int l = 0; ok && l < numLODs; ++l)
+    ok = readValue(file, _lods[l].firstFace) && readValue(file, _lods[l].faceCount) && readValue(file, _lods[l].error)
+      && readSubMeshes(file, fileSize, _lods[l].subMeshes);
+
+  int nv = 0;
+  ok = ok && readValue(file, _VBO_faces) && readValue(file, nv)
+    && _VBO_faces >= 0 && nv >= 0 && (size_t)_VBO_faces <= fileSize && (size_t)nv <= fileSize
+    && readArray(file, fileSize, _VBO_vertices, 3*nv) && readArray(file, fileSize, _VBO_normals, 3*nv)
+    && (!hasTexCoords || readArray(file, fileSize, _VBO_texcoords, 2*nv))
+    && (!hasTangents || readArray(file, fileSize, _VBO_tangents, 4*nv))
+    && readArray(file, fileSize, _VBO_matamb, 3*nv) && readArray(file, fileSize, _VBO_matdiff, 3*nv)
+    && readArray(file, fileSize, _VBO_matspec, 3*nv) && readArray(file, fileSize, _VBO_matshin, nv)
+    && readArray(file, fileSize, _VBO_indices, 3*_VBO_faces);
+  if (ok)
+    for (int i = 0; i < 3*_VBO_faces; ++i) ok = ok && _VBO_indices[i] < (unsigned int)nv;
+  if (!ok) {
+    cerr << filename << " is truncated or damaged" << endl;
+    _vertices.clear(); _normals.clear(); _texCoords.clear();
+    _subMeshes.clear(); _lods.clear(); _materialLibraries.clear();
+    releaseVBOs();
+    return false;
+  }
+  _VBO_numVertices = nv;
+  _indicesOptimized = optimized != 0;
+  return true;
+}
+
+// ======== LOD generation ==========
+// Symmetric 4x4 error quadric (Garland-Heckbert), upper triangle
+struct Quadric {
+  double a[10];
+  Quadric() { for (int i = 0; i < 10; ++i) a[i] = 0; }
+  Quadric(const double n[3], double d) {
+    a[0] = n[0]*n[0]; a[1] = n[0]*n[1]; a[2] = n[0]*n[2]; a[3] = n[0]*d;
+    a[4] = n[1]*n[1]; a[5] = n[1]*n[2]; a[6] = n[1]*d;
+    a[7] = n[2]*n[2]; a[8] = n[2]*d;
+    a[9] = d*d;
+  }
+  void add(const Quadric &q) { for (int i = 0; i < 10; ++i) a[i] += q.a[i]; }
+  // Sum of the squared distances from p to the planes
+  double error(const double p[3]) const {
+    double x = p[0], y = p[1], z = p[2];
+    return a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+         + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+         + a[7]*z*z + 2*a[8]*z
+         + a[9];
+  }
+};
+
+// Candidate collapse of vertex from into vertex to. The stamps detect
+// candidates made stale by later collapses.
+struct Collapse {
+  double cost;
+  int from, to;
+  int stampFrom, stampTo;
+  bool operator>(const Collapse &c) const { return cost > c.cost; }
+};
+
+static void faceNormal(const vector<Vertex> &vertices, int p0, int p1, int p2, double n[3]) {
+  double v0[3], v1[3];
+  for (int j = 0; j < 3; ++j) {
+    v0[j] = vertices[3*p1+j] - vertices[3*p0+j];
+    v1[j] = vertices[3*p2+j] - vertices[3*p0+j];
+  }
+  n[0] = v0[1]*v1[2] - v0[2]*v1[1];
+  n[1] = v0[2]*v1[0] - v0[0]*v1[2];
+  n[2] = v0[0]*v1[1] - v0[1]*v1[0];
+}
+
+// Edge collapses to one of the two vertices (subset placement), so the faces
+// keep indexing _vertices and _normals. Vertices on open borders or shared by
+// several submeshes (and so on material boundaries) are never removed.
+void Model::buildLODs(vector<Face> &lodFaces) {
+  LODLevel base;
+  base.firstFace = 0;
+  base.faceCount = _faces.size();
+  base.error = 0;
+  base.subMeshes = _subMeshes;
+  _lods.push_back(base);
+  if (_faces.size() < 2*MODEL_LOD_MIN_FACES) return;
+
+  int nv = _vertices.size() / 3;
+  int nf = _faces.size();
+  vector<Face> work(_faces);
+  vector<int> faceSub(nf);
+
+  // Vertices at the same position are welded, faces use the first one
+  vector<int> weld(nv);
+  map<vector<Vertex>, int> positions;
+  for (int i = 0; i < nv; ++i) {
+    vector<Vertex> p(_vertices.begin() + 3*i, _vertices.begin() + 3*i + 3);
+    weld[i] = positions.insert(make_pair(p, i)).first->second;
+  }
+  for (int f = 0; f < nf; ++f)
+    for (int k = 0; k < 3; ++k) work[f].v[k] = 3*weld[work[f].v[k]/3];
+  for (unsigned int m = 0; m < _subMeshes.size(); ++m)
+    for (int f = _subMeshes[m].firstFace; f < _subMeshes[m].firstFace + _subMeshes[m].faceCount; ++f)
+      faceSub[f] = m;
+
+  // Quadrics of the face planes, faces of each vertex
+  vector<Quadric> quadrics(nv);
+  vector<vector<int> > vertexFaces(nv);
+  vector<int> vertexSub(nv, -1);
+  vector<bool> locked(nv, false);
+  unordered_map<long long, int> edgeUse;
+  for (int f = 0; f < nf; ++f) {
+    int p[3] = { work[f].v[0]/3, work[f].v[1]/3, work[f].v[2]/3 };
+    double n[3];
+    faceNormal(_vertices, p[0], p[1], p[2], n);
+    double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    if (len > 0) {
+      for (int j = 0; j < 3; ++j) n[j] /= len;
+      double d = -(n[0]*_vertices[3*p[0]] + n[1]*_vertices[3*p[0]+1] + n[2]*_vertices[3*p[0]+2]);
+      Quadric q(n, d);
+      for (int i = 0; i < 3; ++i) quadrics[p[i]].add(q);
+    }
+    for (int i = 0; i < 3; ++i) {
+      vertexFaces[p[i]].push_back(f);
+      if (vertexSub[p[i]] == -1) vertexSub[p[i]] = faceSub[f];
+      else if (vertexSub[p[i]] != faceSub[f]) locked[p[i]] = true;
+      int a = min(p[i], p[(i+1)%3]), b = max(p[i], p[(i+1)%3]);
+      edgeUse[(long long)a*nv + b]++;
+    }
+  }
+  for (unordered_map<long long, int>::const_iterator it = edgeUse.begin(); it != edgeUse.end(); ++it)
+    if (it->second != 2) {
+      locked[it->first / nv] = true;
+      locked[it->first % nv] = true;
+    }
+
+  vector<bool> faceAlive(nf, true);
+  vector<bool> vertexAlive(nv, true);
+  vector<int> stamps(nv, 0);
+  priority_queue<Collapse, vector<Collapse>, greater<Collapse> > heap;
+
+  // Cheapest allowed direction of the edge (a, b)
+  struct Candidates {
+    static void push(int a, int b, const vector<Vertex> &vertices, const vector<Quadric> &quadrics,
+                     const vector<bool> &locked, const vector<int> &stamps,
+                     priority_queue<Collapse, vector<Collapse>, greater<Collapse> > &heap) {
+      Quadric q = quadrics[a];
+      q.add(quadrics[b]);
+      Collapse c;
+      c.cost = -1;
+      if (!locked[a]) {
+        c.cost = q.error(&vertices[3*b]);
+        c.from = a; c.to = b;
+      }
+      if (!locked[b]) {
+        double cost = q.error(&vertices[3*a]);
+        if (c.cost < 0 || cost < c.cost) {
+          c.cost = cost;
+          c.from = b; c.to = a;
+        }
+      }
+      if (c.cost < 0) return;
+      c.cost = max(c.cost, 0.0);
+      c.stampFrom = stamps[c.from];
+      c.stampTo = stamps[c.to];
+      heap.push(c);
+    }
+  };
+  for (unordered_map<long long, int>::const_iterator it = edgeUse.begin(); it != edgeUse.end(); ++it)
+    Candidates::push(it->first / nv, it->first % nv, _vertices, quadrics, locked, stamps, heap);
+
+  int liveFaces = nf;
+  double maxCost = 0;
+  int target = nf / 2;
+  vector<int> neighbors, otherNeighbors;
+  while (_lods.size() < MODEL_LOD_LEVELS && target >= MODEL_LOD_MIN_FACES && !heap.empty()) {
+    Collapse c = heap.top();
+    heap.pop();
+    int u = c.from, v = c.to;
+    if (!vertexAlive[u] || !vertexAlive[v] || c.stampFrom != stamps[u] || c.stampTo != stamps[v]) continue;
+
+    // Link condition: the vertices only share the neighbors of the faces of the edge
+    neighbors.clear(); otherNeighbors.clear();
+    int sharedFaces = 0;
+    for (unsigned int i = 0; i < vertexFaces[u].size(); ++i) {
+      const Face &f = work[vertexFaces[u][i]];
+      if (!faceAlive[vertexFaces[u][i]]) continue;
+      bool hasV = false;
+      for (int k = 0; k < 3; ++k) {
+        neighbors.push_back(f.v[k]/3);
+        if (f.v[k]/3 == v) hasV = true;
+      }
+      if (hasV) ++sharedFaces;
+    }
+    for (unsigned int i = 0; i < vertexFaces[v].size(); ++i) {
+      if (!faceAlive[vertexFaces[v][i]]) continue;
+      for (int k = 0; k < 3; ++k) otherNeighbors.push_back(work[vertexFaces[v][i]].v[k]/3);
+    }
+    sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    sort(otherNeighbors.begin(), otherNeighbors.end());
+    otherNeighbors.erase(unique(otherNeighbors.begin(), otherNeighbors.end()), otherNeighbors.end());
+    int common = 0;
+    for (unsigned int i = 0, j = 0; i < neighbors.size() && j < otherNeighbors.size(); ) {
+      if (neighbors[i] < otherNeighbors[j]) ++i;
+      else if (neighbors[i] > otherNeighbors[j]) ++j;
+      else { if (neighbors[i] != u && neighbors[i] != v) ++common; ++i; ++j; }
+    }
+    if (common != sharedFaces) continue;
+
+    // The remaining faces of u must not flip nor degenerate
+    bool valid = true;
+    for (unsigned int i = 0; i < vertexFaces[u].size() && valid; ++i) {
+      int f = vertexFaces[u][i];
+      if (!faceAlive[f]) continue;
+      int p[3] = { work[f].v[0]/3, work[f].v[1]/3, work[f].v[2]/3 };
+      if (p[0] == v || p[1] == v || p[2] == v) continue;
+      double n0[3], n1[3];
+      faceNormal(_vertices, p[0], p[1], p[2], n0);
+      for (int k = 0; k < 3; ++k) if (p[k] == u) p[k] = v;
+      faceNormal(_vertices, p[0], p[1], p[2], n1);
+      double dot = n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2];
+      double len0 = n0[0]*n0[0] + n0[1]*n0[1] + n0[2]*n0[2];
+      double len1 = n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2];
+      if (dot <= 0.2*sqrt(len0*len1) || len1 < 1e-12*len0) valid = false;
+    }
+    if (!valid) continue;
+
+    // Collapse: the faces of the edge disappear, the others move to v
+    for (unsigned int i = 0; i < vertexFaces[u].size(); ++i) {
+      int f = vertexFaces[u][i];
+      if (!faceAlive[f]) continue;
+      bool hasV = false;
+      for (int k = 0; k < 3; ++k) if (work[f].v[k]/3 == v) hasV = true;
+      if (hasV) {
+        faceAlive[f] = false;
+        --liveFaces;
+      }
+      else {
+        for (int k = 0; k < 3; ++k) if (work[f].v[k]/3 == u) work[f].v[k] = 3*v;
+        vertexFaces[v].push_back(f);
+      }
+    }
+    vertexAlive[u] = false;
+    quadrics[v].add(quadrics[u]);
+    ++stamps[v];
+    maxCost = max(maxCost, c.cost);
+
+    // New candidates around v
+    neighbors.clear();
+    for (unsigned int i = 0; i < vertexFaces[v].size(); ++i) {
+      if (!faceAlive[vertexFaces[v][i]]) continue;
+      for (int k = 0; k < 3; ++k) neighbors.push_back(work[vertexFaces[v][i]].v[k]/3);
+    }
+    sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    for (unsigned int i = 0; i < neighbors.size(); ++i)
+      if (neighbors[i] != v) Candidates::push(v, neighbors[i], _vertices, quadrics, locked, stamps, heap);
+
+    if (liveFaces > target) continue;
+
+    // New level, its faces sorted by submesh
+    LODLevel level;
+    level.firstFace = lodFaces.size();
+    level.faceCount = liveFaces;
+    level.error = sqrt(maxCost);
+    level.subMeshes = _subMeshes;
+    vector<Face> faces;
+    for (unsigned int m = 0; m < _subMeshes.size(); ++m) {
+      level.subMeshes[m].firstFace = lodFaces.size() + faces.size();
+      for (int f = _subMeshes[m].firstFace; f < _subMeshes[m].firstFace + _subMeshes[m].faceCount; ++f)
+        if (faceAlive[f]) faces.push_back(work[f]);
+      level.subMeshes[m].faceCount = lodFaces.size() + faces.size() - level.subMeshes[m].firstFace;
+    }
+    omplenormals(faces, _vertices);
+    lodFaces.insert(lodFaces.end(), faces.begin(), faces.end());
+    _lods.push_back(level);
+    target = liveFaces / 2;
+  }
+
+  double radius = 0;
+  for (unsigned int m = 0; m < _subMeshes.size(); ++m) radius = max(radius, (double)_subMeshes[m].radius);
+  for (unsigned int l = 1; l < _lods.size(); ++l)
+    cout << "LOD " << l << ": " << _lods[l].faceCount << " faces (" << 100*_lods[l].faceCount/nf
+         << "%), error " << _lods[l].error << " (" << 100*_lods[l].error/radius << "% of the radius)" << endl;
+}
+
 static void loadMTL(std::string filename) {
   fstream input(filename.data(), ios::in);
   if (input.rdstate() != ios::goodbit) {
@@ -458,36 +1363,63 @@ static void omplenormals(vector<Face> &_faces,
 static void ompleVBOs(vector<Face> &_faces, 
 		      const vector<Vertex> &_vertices,
                       const vector<Normal> &_normals,
-		      float *&_VBO_vert, float *&_VBO_norm, 
-                      float *&_VBO_mata, float *&_VBO_matd, float *&_VBO_matsp, float *&_VBO_matsh) 
+                      const vector<TexCoord> &_texCoords,
+		      float *&_VBO_vert, float *&_VBO_norm, float *&_VBO_tex,
+                      float *&_VBO_mata, float *&_VBO_matd, float *&_VBO_matsp, float *&_VBO_matsh,
+                      unsigned int *&_VBO_ind, int &_VBO_nverts) 
 {
-  // Creem els VBOs amb 3*3*faces.size() doubles cadascun
-  _VBO_vert = new float[3*3*_faces.size()];  
-  _VBO_norm = new float[3*3*_faces.size()];
-  _VBO_mata = new float[3*3*_faces.size()];
-  _VBO_matd = new float[3*3*_faces.size()];
-  _VBO_matsp = new float[3*3*_faces.size()];
-  _VBO_matsh = new float[3*_faces.size()];
-
-  int index = 0;
+  // Un vertex per cada combinacio de posicio, normal, coordenada de textura i
+  // material; les normals per cara no es comparteixen
+  map<vector<int>, unsigned int> ids;
+  vector<int> key(4);
+  vector<int> corners;  // cara*3 + i del primer us de cada vertex
+  _VBO_ind = new unsigned int[3*_faces.size()];
   for (unsigned int f = 0; f < _faces.size(); ++f) {
-    Material &mat = Materials[_faces[f].mat];
     for (int i = 0; i < 3; ++i) {
-      int P =_faces[f].v[i];
-      for (int j = 0; j < 3; ++j) {
-        _VBO_vert[index+j] = _vertices[P+j];
-	if (_normals.size() != 0) {
-          _VBO_norm[index+j] = _normals[_faces[f].n[i]+j];
-        }
-	else {
-          _VBO_norm[index+j] = _faces[f].normalC[j];
-        }	
-        _VBO_mata[index+j] = mat.ambient[j];
-        _VBO_matd[index+j] = mat.diffuse[j];
-        _VBO_matsp[index+j] = mat.specular[j];
+      key[0] = _faces[f].v[i];
+      key[1] = _normals.size() != 0 ? _faces[f].n[i] : -1 - (int)f;
+      key[2] = _faces[f].mat;
+      key[3] = _faces[f].t.empty() ? -1 : _faces[f].t[i];
+      map<vector<int>, unsigned int>::iterator it = ids.find(key);
+      if (it == ids.end()) {
+        it = ids.insert(make_pair(key, (unsigned int)corners.size())).first;
+        corners.push_back(3*f + i);
       }
-      _VBO_matsh[index/3] = mat.shininess;
-      index += 3;
+      _VBO_ind[3*f + i] = it->second;
+    }
+  }
+  _VBO_nverts = corners.size();
+
+  // Creem els VBOs amb 3*nverts floats cadascun
+  _VBO_vert = new float[3*_VBO_nverts];  
+  _VBO_norm = new float[3*_VBO_nverts];
+  _VBO_mata = new float[3*_VBO_nverts];
+  _VBO_matd = new float[3*_VBO_nverts];
+  _VBO_matsp = new float[3*_VBO_nverts];
+  _VBO_matsh = new float[_VBO_nverts];
+  // Les cares sense coordenades de textura tenen (0, 0)
+  _VBO_tex = NULL;
+  if (_texCoords.size() != 0) _VBO_tex = new float[2*_VBO_nverts];
+
+  for (int v = 0; v < _VBO_nverts; ++v) {
+    int f = corners[v]/3, i = corners[v]%3, index = 3*v;
+    Material &mat = Materials[_faces[f].mat];
+    int P =_faces[f].v[i];
+    for (int j = 0; j < 3; ++j) {
+      _VBO_vert[index+j] = _vertices[P+j];
+      if (_normals.size() != 0) {
+        _VBO_norm[index+j] = _normals[_faces[f].n[i]+j];
+      }
+      else {
+        _VBO_norm[index+j] = _faces[f].normalC[j];
+      }	
+      _VBO_mata[index+j] = mat.ambient[j];
+      _VBO_matd[index+j] = mat.diffuse[j];
+      _VBO_matsp[index+j] = mat.specular[j];
     }
+    _VBO_matsh[v] = mat.shininess;
+    if (_VBO_tex != NULL)
+      for (int j = 0; j < 2; ++j)
+        _VBO_tex[2*v+j] = _faces[f].t.empty() ? 0.0f : _texCoords[_faces[f].t[i]+j];
   }
 }
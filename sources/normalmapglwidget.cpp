@@ -44,11 +44,22 @@ NormalMapGLWidget::NormalMapGLWidget(QWidget *parent) : QOpenGLWidget(parent)
 	// Shaders
 	m_program = nullptr;
 
+	// Reload the shaders when their files change
+	connect(&ShaderLibrary::instance(), &ShaderLibrary::shadersChanged, this, &NormalMapGLWidget::reloadShaders);
+
 	// Color and Normal map
-	m_tex1Tex = nullptr; 
-	m_tex2Tex = nullptr;
+	m_tex1Tex = 0;
+	m_tex2Tex = 0;
 	m_tex1Loaded = false; 
 	m_tex2Loaded = false;
+	m_tex1NormalXY = false;
+	m_tex2NormalXY = false;
+
+	// Decoded and uploaded in the background, the previous texture stays bound
+	// until the new one is complete
+	m_textureLoader = new AsyncTextureLoader(this);
+	connect(m_textureLoader, &AsyncTextureLoader::imageDecoded, this, &NormalMapGLWidget::textureDecoded);
+	connect(m_textureLoader, &AsyncTextureLoader::textureReady, this, &NormalMapGLWidget::setTexture);
 }
 
 NormalMapGLWidget::~NormalMapGLWidget()
@@ -79,17 +90,14 @@ void NormalMapGLWidget::cleanup()
 	glDeleteBuffers(1, &m_VBOBitangents);
 	glDeleteVertexArrays(1, &m_VAO);
 	
-	if (m_tex1Tex != nullptr)
-	{
-		m_tex1Tex->destroy();
-		m_tex1Tex = nullptr;
-	}
-
-	if (m_tex2Tex != nullptr)
-	{
-		m_tex2Tex->destroy();
-		m_tex2Tex = nullptr;
-	}
+	glDeleteTextures(1, &m_tex1Tex);
+	glDeleteTextures(1, &m_tex2Tex);
+	m_tex1Tex = 0;
+	m_tex2Tex = 0;
+	m_tex1Loaded = false;
+	m_tex2Loaded = false;
+	m_textureLoader->cleanup();
+	m_uniforms.cleanup();
 
 	if (m_program == nullptr)
         return;
@@ -111,6 +119,8 @@ void NormalMapGLWidget::initializeGL()
     // can recreate all resources.
     connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &NormalMapGLWidget::cleanup);
     initializeOpenGLFunctions();
+	m_uniforms.initializeGL();
+	m_textureLoader->initializeGL();
  	loadShaders();
 	createBuffersScene();
 	computeBBoxScene();
@@ -129,6 +139,10 @@ void NormalMapGLWidget::paintGL()
 	if (m_backFaceCulling)
 		glEnable(GL_CULL_FACE);
 
+	// Uniforms of this frame, in their own segment of the ring
+	m_uniforms.beginFrame();
+	m_uniforms.bindFrame(m_frameUniforms);
+
 	// Bind the VAO to draw the scene
 	glBindVertexArray(m_VAO);
 
@@ -140,6 +154,7 @@ void NormalMapGLWidget::paintGL()
 
 	// Unbind the vertex array
 	glBindVertexArray(0);
+	m_uniforms.endFrame();
 
 }
 
@@ -179,6 +194,7 @@ void NormalMapGLWidget::keyPressEvent(QKeyEvent *event)
 			std::cout << std::endl;
 			std::cout << "-B:  change background color" << std::endl;
 			std::cout << "-H:  show this help" << std::endl;
+			std::cout << "-F5: reload shaders" << std::endl;
 			std::cout << "-R:  reset the camera parameters" << std::endl;
 			std::cout << std::endl;
 			std::cout << "IMPORTANT: the focus must be set to the glwidget to work" << std::endl;
@@ -189,6 +205,11 @@ void NormalMapGLWidget::keyPressEvent(QKeyEvent *event)
 			std::cout << "-- AGEn message --: Reset camera" << std::endl;
 			resetCamera();
 			break;
+		case Qt::Key_F5:
+			// Reload shaders
+			std::cout << "-- AGEn message --: Reload shaders" << std::endl;
+			reloadShaders();
+			break;
 		default:
 			event->ignore();
 			break;
@@ -270,25 +291,18 @@ void NormalMapGLWidget::wheelEvent(QWheelEvent* event)
 	event->accept();
 }
 
-void NormalMapGLWidget::loadShaders()
+bool NormalMapGLWidget::loadShaders()
 {
-	// Declaration of the shaders
-	QOpenGLShader vs(QOpenGLShader::Vertex, this);
-	QOpenGLShader fs(QOpenGLShader::Fragment, this);
-
-	// Load and compile the shaders
-	vs.compileSourceFile("./shaders/phongnormal.vert");
-	fs.compileSourceFile("./shaders/phongnormal.frag");
-
-	// Create the program
-	m_program = new QOpenGLShaderProgram;
-
-	// Add the shaders
-	m_program->addShader(&fs);
-	m_program->addShader(&vs);
+	// Normal mapped quad (see ShaderLibrary::programs on reloads)
+	QOpenGLShaderProgram* program = ShaderLibrary::instance().program(
+		ShaderFiles("./shaders/phongnormal.vert", "./shaders/phongnormal.frag"), m_program);
+	if (m_program != nullptr && !program->isLinked()) {
+		delete program;
+		return false;
+	}
 
-	// Link the program
-	m_program->link();
+	delete m_program;
+	m_program = program;
 
 	// Bind the program (we are gonna use this program)
 	m_program->bind();
@@ -303,17 +317,49 @@ void NormalMapGLWidget::loadShaders()
 	m_bitangentLoc = glGetAttribLocation(m_program->programId(), "bitangent");
 
 	// Get the uniforms locations of the vertex shader
-	m_transLoc = glGetUniformLocation(m_program->programId(), "sceneTransform");
-	m_projLoc = glGetUniformLocation(m_program->programId(), "projTransform");
-	m_viewLoc = glGetUniformLocation(m_program->programId(), "viewTransform");
+	// Transforms are in uniform blocks
+	m_uniforms.bindBlocks(m_program->programId());
 
 	// Get the uniforms locations of the fragmenr shader
 	m_tex1LoadedLoc = glGetUniformLocation(m_program->programId(), "tex1Loaded");
-	m_tex1TextureLoc = glGetUniformLocation(m_program->programId(), "colorTexture");
+	m_tex1TextureLoc = glGetUniformLocation(m_program->programId(), "tex1Texture");
 	m_tex2LoadedLoc = glGetUniformLocation(m_program->programId(), "tex2Loaded");
-	m_tex2TextureLoc = glGetUniformLocation(m_program->programId(), "normalTexture");
+	m_tex2TextureLoc = glGetUniformLocation(m_program->programId(), "tex2Texture");
+	m_tex1NormalXYLoc = glGetUniformLocation(m_program->programId(), "tex1NormalXY");
+	m_tex2NormalXYLoc = glGetUniformLocation(m_program->programId(), "tex2NormalXY");
 	m_lightPosLoc = glGetUniformLocation(m_program->programId(), "lightPos");
 	m_lightColLoc = glGetUniformLocation(m_program->programId(), "lightCol");
+
+	return true;
+}
+
+void NormalMapGLWidget::reloadShaders()
+{
+	if (!isValid())
+		return;
+
+	makeCurrent();
+
+	if (loadShaders()) {
+		projectionTransform();
+		viewTransform();
+		setLighting();
+
+		// Texture units
+		if (m_tex1Loaded) {
+			glUniform1i(m_tex1TextureLoc, 10);
+			glUniform1i(m_tex1LoadedLoc, 1);
+			glUniform1i(m_tex1NormalXYLoc, m_tex1NormalXY);
+		}
+		if (m_tex2Loaded) {
+			glUniform1i(m_tex2TextureLoc, 11);
+			glUniform1i(m_tex2LoadedLoc, 1);
+			glUniform1i(m_tex2NormalXYLoc, m_tex2NormalXY);
+		}
+	}
+
+	doneCurrent();
+	update();
 }
 
 void NormalMapGLWidget::projectionTransform()
@@ -325,8 +371,8 @@ void NormalMapGLWidget::projectionTransform()
 
 	proj = glm::perspective(m_fov, m_ar, m_zNear, m_zFar);
 
-	// Send the matrix to the shader
-	glUniformMatrix4fv(m_projLoc, 1, GL_FALSE, &proj[0][0]);
+	// Sent with the frame block by paintGL
+	m_frameUniforms.projTransform = proj;
 
 }
 
@@ -368,8 +414,8 @@ void NormalMapGLWidget::viewTransform()
 		view = glm::lookAt(obs, vrp, vup);
 	}*/
 	
-	// Send the matrix to the shader
-	glUniformMatrix4fv(m_viewLoc, 1, GL_FALSE, &view[0][0]);
+	// Sent with the frame block by paintGL
+	m_frameUniforms.viewTransform = view;
 }
 
 void NormalMapGLWidget::changeBackgroundColor() {
@@ -519,35 +565,30 @@ void NormalMapGLWidget::sceneTransform()
 	geomTransform = glm::rotate(geomTransform, m_yRot, glm::vec3(0.0f, 1.0f, 0.0f));
 	geomTransform = glm::translate(geomTransform, -m_sceneCenter);
 
-	// Send the matrix to the shader
-	glUniformMatrix4fv(m_transLoc, 1, GL_FALSE, &geomTransform[0][0]);
+	// Send the matrices to the shader, with the normal matrix
+	m_uniforms.bindObject(ObjectUniforms(geomTransform, m_frameUniforms.viewTransform));
 }
 
 void NormalMapGLWidget::loadTex1Texture(QString filename)
 {
-	makeCurrent();
-	m_tex1Tex = new QOpenGLTexture(QImage(filename).mirrored());
-	m_tex1Tex->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
-	m_tex1Tex->setMagnificationFilter(QOpenGLTexture::Linear);
-
-	m_tex1Tex->bind(10);
-	glUniform1i(m_tex1TextureLoc, 10);
-	
-	m_tex1Loaded = true;
-	glUniform1i(m_tex1LoadedLoc, 1);
-	
-	update();
+	// The texture is bound by setTexture() once it is on the GPU
+	m_textureLoader->load(1, filename);
 }
 
 void NormalMapGLWidget::deleteTex1Texture()
 {
-	if (m_tex1Tex != nullptr)
+	m_textureLoader->cancel(1);
+
+	if (m_tex1Tex != 0)
 	{
 		makeCurrent();
-		m_tex1Tex->release(10);
-		m_tex1Tex->destroy();
-		m_tex1Tex = nullptr;
-	
+		glActiveTexture(GL_TEXTURE10);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glDeleteTextures(1, &m_tex1Tex);
+		m_tex1Tex = 0;
+
+		m_program->bind();
 		m_tex1Loaded = false;
 		glUniform1i(m_tex1LoadedLoc, 0);
 		update();
@@ -556,35 +597,61 @@ void NormalMapGLWidget::deleteTex1Texture()
 
 void NormalMapGLWidget::loadTex2Texture(QString filename)
 {
-	makeCurrent();
-	m_tex2Tex = new QOpenGLTexture(QImage(filename).mirrored());
-	m_tex2Tex->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
-	m_tex2Tex->setMagnificationFilter(QOpenGLTexture::Linear);
-
-	m_tex2Tex->bind(11);
-	glUniform1i(m_tex2TextureLoc, 11);
-
-	m_tex2Loaded = true;
-	glUniform1i(m_tex2LoadedLoc, 1);
-	update();
+	// The texture is bound by setTexture() once it is on the GPU
+	m_textureLoader->load(2, filename);
 }
 
 void NormalMapGLWidget::deleteTex2Texture()
 {
-	if (m_tex2Tex != nullptr)
+	m_textureLoader->cancel(2);
+
+	if (m_tex2Tex != 0)
 	{
 		makeCurrent();
+		glActiveTexture(GL_TEXTURE11);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glDeleteTextures(1, &m_tex2Tex);
+		m_tex2Tex = 0;
 
-		m_tex2Tex->release(11);
-		m_tex2Tex->destroy();
-		m_tex2Tex = nullptr;
-		
+		m_program->bind();
 		m_tex2Loaded = false;
 		glUniform1i(m_tex2LoadedLoc, 0);
 		update();
 	}
 }
 
+void NormalMapGLWidget::setTexture(int slot, GLuint texture, bool normalXY)
+{
+	GLuint &current = (slot == 1) ? m_tex1Tex : m_tex2Tex;
+	int unit = (slot == 1) ? 10 : 11;
+
+	makeCurrent();
+	glDeleteTextures(1, &current);
+	current = texture;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glActiveTexture(GL_TEXTURE0);
+
+	m_program->bind();
+	if (slot == 1) {
+		m_tex1Loaded = true;
+		m_tex1NormalXY = normalXY;
+		glUniform1i(m_tex1TextureLoc, unit);
+		glUniform1i(m_tex1LoadedLoc, 1);
+		glUniform1i(m_tex1NormalXYLoc, normalXY);
+	}
+	else {
+		m_tex2Loaded = true;
+		m_tex2NormalXY = normalXY;
+		glUniform1i(m_tex2TextureLoc, unit);
+		glUniform1i(m_tex2LoadedLoc, 1);
+		glUniform1i(m_tex2NormalXYLoc, normalXY);
+	}
+	update();
+}
+
 void NormalMapGLWidget::setLighting()
 {
 	// Light source attached to the camera
@@ -7,6 +7,8 @@
 #include <QTimer>
 #include <math.h>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 PhongGLWidget::PhongGLWidget(QString modelFilename, bool showFps, QWidget *parent) : QOpenGLWidget(parent)
@@ -32,6 +34,10 @@ PhongGLWidget::PhongGLWidget(QString modelFilename, bool showFps, QWidget *paren
 	m_modelCenter = glm::vec3(0.0f, 0.0f, 0.0f);
 	m_modelRadius = 0.0f;
 	m_modelFilename = modelFilename;
+	m_frustumCulling = true;
+	m_visibleSubMeshes = 0;
+	m_forcedLOD = -1;
+	m_currentLOD = -1;
 
 	// Mouse
 	m_xRot = 0.0f;
@@ -50,6 +56,9 @@ PhongGLWidget::PhongGLWidget(QString modelFilename, bool showFps, QWidget *paren
 	// Shaders
 	m_program = nullptr;
 
+	// Reload the shaders when their files change
+	connect(&ShaderLibrary::instance(), &ShaderLibrary::shadersChanged, this, &PhongGLWidget::reloadShaders);
+
 }
 
 PhongGLWidget::~PhongGLWidget()
@@ -93,6 +102,8 @@ void PhongGLWidget::cleanup()
         return;
     
 	makeCurrent();
+	m_uniforms.cleanup();
+	m_capture.stopCapture();
     
 	delete m_program;
     m_program = 0;
@@ -111,6 +122,7 @@ void PhongGLWidget::initializeGL()
     // can recreate all resources.
     connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &PhongGLWidget::cleanup);
     initializeOpenGLFunctions();
+	m_uniforms.initializeGL();
  	loadShaders();
 	createBuffersModel();
 	computeBBoxModel ();
@@ -149,17 +161,41 @@ void PhongGLWidget::paintGL()
 	if (m_backFaceCulling)
 		glEnable(GL_CULL_FACE);
 
+	// Uniforms of this frame, in their own segment of the ring
+	m_uniforms.beginFrame();
+	m_uniforms.bindFrame(m_frameUniforms);
+
+	// Boxes of the quantized positions
+	glUniform1i(m_quantizedLoc, m_model.VBO_quantized());
+	glActiveTexture(GL_TEXTURE14);
+	glBindTexture(GL_TEXTURE_BUFFER, m_modelBoxTexture);
+
 	// Bind the VAO to draw the model
 	glBindVertexArray(m_VAOModel);
 
 	// Apply the geometric transforms to the model (position/orientation)
-	modelTransform();
-
-	// Draw the model
-	glDrawArrays(GL_TRIANGLES, 0, m_model.faces().size() * 3);
+	glm::mat4 model = modelTransform();
+
+	// Draw the submeshes of the model inside the view frustum
+	const LODLevel &lod = m_model.lods()[selectLOD(model)];
+	if (m_frustumCulling) {
+		Frustum frustum(cam->GetProj() * cam->GetView() * model);
+		m_visibleSubMeshes = frustum.visibleRanges(lod.subMeshes, m_drawFirst, m_drawCount);
+		m_drawOffsets.resize(m_drawFirst.size());
+		for (size_t r = 0; r < m_drawFirst.size(); ++r)
+			m_drawOffsets[r] = (const GLvoid*)(sizeof(GLuint) * m_drawFirst[r]);
+		if (!m_drawFirst.empty())
+			glMultiDrawElements(GL_TRIANGLES, m_drawCount.data(), GL_UNSIGNED_INT, m_drawOffsets.data(), (GLsizei)m_drawFirst.size());
+	}
+	else {
+		m_visibleSubMeshes = (int)lod.subMeshes.size();
+		glDrawElements(GL_TRIANGLES, lod.faceCount * 3, GL_UNSIGNED_INT, (const GLvoid*)(sizeof(GLuint) * lod.firstFace * 3));
+	}
 
 	// Unbind the vertex array
 	glBindVertexArray(0);
+	m_uniforms.endFrame();
+	m_capture.capture(defaultFramebufferObject(), m_width, m_height);
 
 	// Show FPS if they are enabled 
 	m_frameCount++;
@@ -257,6 +293,9 @@ void PhongGLWidget::keyPressEvent(QKeyEvent *event)
 			std::cout << "-F:  show frames per second (fps)" << std::endl;
 			std::cout << "-H:  show this help" << std::endl;
 			std::cout << "-R:  reset the camera parameters" << std::endl;
+			std::cout << "-L:  next level of detail (automatic after the last one)" << std::endl;
+			std::cout << "-V:  enable/disable frustum culling" << std::endl;
+			std::cout << "-G:  start/stop capturing the frames to " << CAPTURE_DEFAULT_PATH << std::endl;
 			std::cout << "-F5: reload shaders" << std::endl;
 			std::cout << std::endl;
 			std::cout << "IMPORTANT: the focus must be set to the glwidget to work" << std::endl;
@@ -267,6 +306,25 @@ void PhongGLWidget::keyPressEvent(QKeyEvent *event)
 			std::cout << "-- AGEn message --: Reset camera" << std::endl;
 			resetCamera();
 			break;
+		case Qt::Key_L:
+			// Cycle the forced level of detail, then back to automatic
+			m_forcedLOD = m_forcedLOD + 1 < (int)m_model.lods().size() ? m_forcedLOD + 1 : -1;
+			if (m_forcedLOD < 0)
+				std::cout << "-- AGEn message --: Automatic LOD" << std::endl;
+			break;
+		case Qt::Key_V:
+			// Enable/Disable frustum culling
+			m_frustumCulling = !m_frustumCulling;
+			std::cout << "-- AGEn message --: Frustum culling " << (m_frustumCulling ? "enabled" : "disabled")
+				<< " (" << m_visibleSubMeshes << " of " << m_model.subMeshes().size() << " submeshes drawn)" << std::endl;
+			break;
+		case Qt::Key_G:
+			// Start/Stop capturing the frames (PNG sequence)
+			if (m_capture.isCapturing())
+				m_capture.stopCapture();
+			else
+				m_capture.startCapture(CAPTURE_DEFAULT_PATH);
+			break;
 		case Qt::Key_F5: 
 			// Reload shaders
 			std::cout << "-- AGEn message --: Reload shaders" << std::endl;
@@ -368,25 +426,18 @@ void PhongGLWidget::wheelEvent(QWheelEvent* event)
 	event->accept();
 }
 
-void PhongGLWidget::loadShaders()
+bool PhongGLWidget::loadShaders()
 {
-	// Declaration of the shaders
-	QOpenGLShader vs(QOpenGLShader::Vertex, this);
-	QOpenGLShader fs(QOpenGLShader::Fragment, this);
-
-	// Load and compile the shaders
-	vs.compileSourceFile("./shaders/phong.vert");
-	fs.compileSourceFile("./shaders/phong.frag");
-
-	// Create the program
-	m_program = new QOpenGLShaderProgram;
-
-	// Add the shaders
-	m_program->addShader(&fs);
-	m_program->addShader(&vs);
+	// Phong shading of the model (see ShaderLibrary::programs on reloads)
+	QOpenGLShaderProgram* program = ShaderLibrary::instance().program(
+		ShaderFiles("./shaders/phong.vert", "./shaders/phong.frag"), m_program);
+	if (m_program != nullptr && !program->isLinked()) {
+		delete program;
+		return false;
+	}
 
-	// Link the program
-	m_program->link();
+	delete m_program;
+	m_program = program;
 
 	// Bind the program (we are gonna use this program)
 	m_program->bind();
@@ -400,23 +451,38 @@ void PhongGLWidget::loadShaders()
 	m_matShinLoc = glGetAttribLocation(m_program->programId(), "matshin");
 
 	// Get the uniforms locations of the vertex shader
-	m_transLoc = glGetUniformLocation(m_program->programId(), "sceneTransform");
-	m_projLoc = glGetUniformLocation(m_program->programId(), "projTransform");
-	m_viewLoc = glGetUniformLocation(m_program->programId(), "viewTransform");
+	// Transforms are in uniform blocks
+	m_uniforms.bindBlocks(m_program->programId());
 	m_lightPosLoc = glGetUniformLocation(m_program->programId(), "lightPos");
 	m_lightColLoc = glGetUniformLocation(m_program->programId(), "lightCol");
-	
+	m_quantizedLoc = glGetUniformLocation(m_program->programId(), "quantized");
+	m_positionBoxesLoc = glGetUniformLocation(m_program->programId(), "positionBoxes");
+	glUniform1i(m_positionBoxesLoc, 14);
+
+	return true;
 }
 
 void PhongGLWidget::reloadShaders()
 {
-	// TO DO: Insert your code here to reload the shaders and update the view
+	if (!isValid())
+		return;
+
+	makeCurrent();
+
+	if (loadShaders()) {
+		projectionTransform();
+		viewTransform();
+		setLighting();
+	}
 
+	doneCurrent();
+	update();
 }
 
 void PhongGLWidget::projectionTransform()
 {
-	glUniformMatrix4fv(m_projLoc, 1, GL_FALSE, &cam->GetProj()[0][0]);
+	// Sent with the frame block by paintGL
+	m_frameUniforms.projTransform = cam->GetProj();
 }
 
 void PhongGLWidget::resetCamera()
@@ -432,9 +498,8 @@ void PhongGLWidget::resetCamera()
 
 void PhongGLWidget::viewTransform()
 {
-
-	// Send the matrix to the shader
-	glUniformMatrix4fv(m_viewLoc, 1, GL_FALSE, &cam->GetView()[0][0]);
+	// Sent with the frame block by paintGL
+	m_frameUniforms.viewTransform = cam->GetView();
 }
 
 void PhongGLWidget::changeBackgroundColor() {
@@ -453,68 +518,116 @@ void PhongGLWidget::computeCenterRadiusScene()
 
 void PhongGLWidget::createBuffersModel()
 {
-	// Load the OBJ model - BEFORE creating the buffers!
-	m_model.load(m_modelFilename.toStdString());
+	// Load the OBJ model - BEFORE creating the buffers! (from its binary copy
+	// if it is up to date)
+	GLResourceCache::loadModel(m_model, m_modelFilename);
+#if QUANTIZE_VERTICES
+	m_model.quantizeVertices();
+#endif
 
 	// VAO creation
 	glGenVertexArrays(1, &m_VAOModel);
 	glBindVertexArray(m_VAOModel);
 
+	// Quantized or float attributes, the quantized normals are fetched as
+	// integers and decoded by the shader
+	bool quantized = m_model.VBO_quantized();
+	int numVertices = m_model.VBO_numVertices();
+	GLint posSize = quantized ? 4 : 3, normSize = quantized ? 2 : 3, matSize = quantized ? 4 : 3;
+	GLenum matType = quantized ? GL_UNSIGNED_BYTE : GL_FLOAT;
+	GLboolean normalized = quantized ? GL_TRUE : GL_FALSE;
+
 	// VBO Vertices
 	glGenBuffers(1, &m_VBOModelVerts);
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelVerts);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_vertices(), GL_STATIC_DRAW);
+	if (quantized)
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLushort) * numVertices * 4, m_model.VBO_qpositions(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numVertices * 3, m_model.VBO_vertices(), GL_STATIC_DRAW);
 
 	// Enable the attribute m_vertexLoc
-	glVertexAttribPointer(m_vertexLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(m_vertexLoc, posSize, quantized ? GL_UNSIGNED_SHORT : GL_FLOAT, normalized, 0, 0);
 	glEnableVertexAttribArray(m_vertexLoc);
 
 	// VBO Normals
 	glGenBuffers(1, &m_VBOModelNorms);
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelNorms);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_normals(), GL_STATIC_DRAW);
+	if (quantized)
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLshort) * numVertices * 2, m_model.VBO_qnormals(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numVertices * 3, m_model.VBO_normals(), GL_STATIC_DRAW);
 
 	// Enable the attribute m_normalLoc
-	glVertexAttribPointer(m_normalLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(m_normalLoc, normSize, quantized ? GL_SHORT : GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(m_normalLoc);
 
 	// Instead of colors, we pass the materials 
 	// VBO Ambient component
 	glGenBuffers(1, &m_VBOModelMatAmb);
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatAmb);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_matamb(), GL_STATIC_DRAW);
+	if (quantized)
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLubyte) * numVertices * 4, m_model.VBO_qmatamb(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numVertices * 3, m_model.VBO_matamb(), GL_STATIC_DRAW);
 
 	// Enable the attribute m_matAmbLoc
-	glVertexAttribPointer(m_matAmbLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(m_matAmbLoc, matSize, matType, normalized, 0, 0);
 	glEnableVertexAttribArray(m_matAmbLoc);
 
 	// VBO Diffuse component
 	glGenBuffers(1, &m_VBOModelMatDiff);
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatDiff);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_matdiff(), GL_STATIC_DRAW);
+	if (quantized)
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLubyte) * numVertices * 4, m_model.VBO_qmatdiff(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numVertices * 3, m_model.VBO_matdiff(), GL_STATIC_DRAW);
 
 	// Enable the attribute m_matDiffLoc
-	glVertexAttribPointer(m_matDiffLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(m_matDiffLoc, matSize, matType, normalized, 0, 0);
 	glEnableVertexAttribArray(m_matDiffLoc);
 
 	// VBO Specular component
 	glGenBuffers(1, &m_VBOModelMatSpec);
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatSpec);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_matspec(), GL_STATIC_DRAW);
+	if (quantized)
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLubyte) * numVertices * 4, m_model.VBO_qmatspec(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numVertices * 3, m_model.VBO_matspec(), GL_STATIC_DRAW);
 
 	// Enable the attribute m_matSpecLoc
-	glVertexAttribPointer(m_matSpecLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(m_matSpecLoc, matSize, matType, normalized, 0, 0);
 	glEnableVertexAttribArray(m_matSpecLoc);
 
 	// VBO Shininess component
 	glGenBuffers(1, &m_VBOModelMatShin);
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatShin);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3, m_model.VBO_matshin(), GL_STATIC_DRAW);
+	if (quantized)
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLushort) * numVertices, m_model.VBO_qmatshin(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numVertices, m_model.VBO_matshin(), GL_STATIC_DRAW);
 
 	// Enable the attribute m_matShinLoc
-	glVertexAttribPointer(m_matShinLoc, 1, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(m_matShinLoc, 1, quantized ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(m_matShinLoc);
 
+	// Boxes of the quantized positions, a min and an extent texel each
+	m_modelBoxBuffer = m_modelBoxTexture = 0;
+	if (quantized) {
+		glGenBuffers(1, &m_modelBoxBuffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, m_modelBoxBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(GLfloat) * m_model.VBO_boxes().size(), m_model.VBO_boxes().data(), GL_STATIC_DRAW);
+		glGenTextures(1, &m_modelBoxTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, m_modelBoxTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_modelBoxBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	// Indices of the triangles of every LOD level
+	glGenBuffers(1, &m_IBOModel);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBOModel);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*m_model.VBO_faces() * 3, m_model.VBO_indices(), GL_STATIC_DRAW);
+
 	glBindVertexArray(0);
 
 	// The model has been loaded
@@ -532,6 +645,9 @@ void PhongGLWidget::cleanBuffersModel()
 	glDeleteBuffers(1, &m_VBOModelMatDiff);
 	glDeleteBuffers(1, &m_VBOModelMatSpec);
 	glDeleteBuffers(1, &m_VBOModelMatShin);
+	glDeleteBuffers(1, &m_IBOModel);
+	glDeleteBuffers(1, &m_modelBoxBuffer);
+	glDeleteTextures(1, &m_modelBoxTexture);
 	glDeleteVertexArrays(1, &m_VAOModel);
 
 	m_modelLoaded = false;
@@ -569,7 +685,7 @@ void PhongGLWidget::computeBBoxModel()
 	m_modelRadius = sqrt(radiusModel.x*radiusModel.x + radiusModel.y*radiusModel.y + radiusModel.z*radiusModel.z);
 }
 
-void PhongGLWidget::modelTransform()
+glm::mat4 PhongGLWidget::modelTransform()
 {
 	glm::mat4 geomTransform(1.0f);
 
@@ -578,8 +694,32 @@ void PhongGLWidget::modelTransform()
 	geomTransform = glm::rotate(geomTransform, m_yRot, glm::vec3(0.0f, 1.0f, 0.0f));
 	geomTransform = glm::translate(geomTransform, -m_modelCenter);
 
-	// Send the matrix to the shader
-	glUniformMatrix4fv(m_transLoc, 1, GL_FALSE, &geomTransform[0][0]);
+	// Send the matrices to the shader, with the normal matrix
+	m_uniforms.bindObject(ObjectUniforms(geomTransform, m_frameUniforms.viewTransform));
+	return geomTransform;
+}
+
+int PhongGLWidget::selectLOD(const glm::mat4 &model)
+{
+	const std::vector<LODLevel> &lods = m_model.lods();
+	int level;
+	if (m_forcedLOD >= 0) {
+		level = std::min(m_forcedLOD, (int)lods.size() - 1);
+	}
+	else {
+		// Error allowed at the nearest point of the model, in model units
+		glm::vec4 center = cam->GetView() * model * glm::vec4(m_modelCenter, 1.0f);
+		float distance = std::max(glm::length(glm::vec3(center)) - m_modelRadius, 1e-3f * m_modelRadius);
+		float pixelsPerUnit = height() / (2.0f * std::tan(cam->GetFov() / 2.0f) * distance);
+		level = m_model.selectLOD(LOD_PIXEL_ERROR / pixelsPerUnit);
+	}
+
+	if (level != m_currentLOD) {
+		m_currentLOD = level;
+		std::cout << "-- AGEn message --: LOD " << level << " (" << lods[level].faceCount
+			<< " faces, error " << lods[level].error << ")" << std::endl;
+	}
+	return level;
 }
 
 void PhongGLWidget::computeFps() 
@@ -0,0 +1,166 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+
+#include <cmath>
+#include <iostream>
+
+#include "raytracer.h"
+
+// Headless ray tracer: renders a scene file to an image without any window,
+// and reports timings so it can be used for benchmarks on build servers.
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCoreApplication::setApplicationName("AG Ray Tracer");
+	QCoreApplication::setOrganizationName(" ");
+	QCoreApplication::setApplicationVersion(QT_VERSION_STR);
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QCoreApplication::applicationName());
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addPositionalArgument("scene", "Scene file to render (the default glass scene if omitted)");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Output image (.png, .pfm or .exr)", "file", "render.png");
+	parser.addOption(outputOption);
+	QCommandLineOption widthOption("width", "Image width", "pixels");
+	parser.addOption(widthOption);
+	QCommandLineOption heightOption("height", "Image height", "pixels");
+	parser.addOption(heightOption);
+	QCommandLineOption samplesOption("spp", "Maximum samples per pixel", "samples");
+	parser.addOption(samplesOption);
+	QCommandLineOption minSamplesOption("min-spp", "Minimum samples per pixel of adaptive sampling", "samples");
+	parser.addOption(minSamplesOption);
+	QCommandLineOption thresholdOption("threshold", "Relative error that stops adaptive sampling (0 to disable it)", "error");
+	parser.addOption(thresholdOption);
+	QCommandLineOption threadsOption("threads", "Number of threads (0 for all the cores)", "threads", "0");
+	parser.addOption(threadsOption);
+	QCommandLineOption compareOption("compare-recursive", "Also render with the recursive traversal and compare timings");
+	parser.addOption(compareOption);
+
+	parser.process(app);
+
+	QElapsedTimer timer;
+	RayTracer rayTracer;
+
+	// Scene
+	timer.start();
+	const QStringList args = parser.positionalArguments();
+	if (args.isEmpty()) {
+		rayTracer.loadDefaultScene();
+	}
+	else if (!rayTracer.loadScene(args[0].toStdString())) {
+		return 1;
+	}
+	double sceneTime = timer.nsecsElapsed() / 1.0e6;
+
+	int width = rayTracer.sceneWidth() > 0 ? rayTracer.sceneWidth() : 640;
+	int height = rayTracer.sceneHeight() > 0 ? rayTracer.sceneHeight() : 480;
+	int samples = rayTracer.sceneSamples() > 0 ? rayTracer.sceneSamples() : 1;
+	if (parser.isSet(widthOption))
+		width = parser.value(widthOption).toInt();
+	if (parser.isSet(heightOption))
+		height = parser.value(heightOption).toInt();
+	if (parser.isSet(samplesOption))
+		samples = parser.value(samplesOption).toInt();
+	int threads = parser.value(threadsOption).toInt();
+
+	if (parser.isSet(minSamplesOption) || parser.isSet(thresholdOption)) {
+		int minSamples = parser.isSet(minSamplesOption) ? parser.value(minSamplesOption).toInt() : 4;
+		float threshold = parser.isSet(thresholdOption) ? parser.value(thresholdOption).toFloat() : 0.02f;
+		rayTracer.setAdaptiveSampling(minSamples, threshold);
+	}
+
+	if (width <= 0 || height <= 0) {
+		std::cerr << "Invalid resolution " << width << "x" << height << std::endl;
+		return 1;
+	}
+
+	// Trace
+	std::vector<glm::vec3> image;
+	timer.restart();
+	rayTracer.render(width, height, samples, threads, image);
+	double traceTime = timer.nsecsElapsed() / 1.0e6;
+	long long numRays = rayTracer.numRays();
+	long long numSamples = rayTracer.numSamples();
+
+	// Same render with the recursive traversal, the image is not written. The
+	// paths are random, so both images only agree on average.
+	double recursiveTime = 0.0;
+	long long recursiveRays = 0;
+	glm::vec3 meanRadiance(0.0f), recursiveMeanRadiance(0.0f);
+	if (parser.isSet(compareOption)) {
+		std::vector<glm::vec3> recursiveImage;
+		rayTracer.setRecursiveTraversal(true);
+		timer.restart();
+		rayTracer.render(width, height, samples, threads, recursiveImage);
+		recursiveTime = timer.nsecsElapsed() / 1.0e6;
+		recursiveRays = rayTracer.numRays();
+		rayTracer.setRecursiveTraversal(false);
+
+		glm::dvec3 sum(0.0), recursiveSum(0.0);
+		for (size_t i = 0; i < image.size(); ++i) {
+			sum += glm::dvec3(image[i]);
+			recursiveSum += glm::dvec3(recursiveImage[i]);
+		}
+		meanRadiance = glm::vec3(sum / (double)image.size());
+		recursiveMeanRadiance = glm::vec3(recursiveSum / (double)image.size());
+	}
+
+	// Write
+	timer.restart();
+	QString output = parser.value(outputOption);
+	QString suffix = QFileInfo(output).suffix().toLower();
+	bool written = false;
+	if (suffix == "pfm") {
+		written = RayTracer::savePFM(output.toStdString(), width, height, image);
+	}
+	else if (suffix == "exr") {
+		written = RayTracer::saveEXR(output.toStdString(), width, height, image);
+	}
+	else {
+		QImage img(width, height, QImage::Format_RGB32);
+		for (int j = 0; j < height; ++j) {
+			QRgb *line = (QRgb*)img.scanLine(j);
+			for (int i = 0; i < width; ++i) {
+				const glm::vec3 &pixel = image[j * width + i];
+				glm::vec3 col = glm::clamp(pixel, 0.0f, 1.0f) * 255.0f;
+				line[i] = qRgb((int)col.x, (int)col.y, (int)col.z);
+			}
+		}
+		written = img.save(output);
+	}
+	double writeTime = timer.nsecsElapsed() / 1.0e6;
+
+	if (!written) {
+		std::cerr << "Cannot write image " << output.toStdString() << std::endl;
+		return 1;
+	}
+
+	std::cout << "Rendered " << width << "x" << height << " at " << samples << " spp with "
+		<< rayTracer.spheres().size() << " spheres (" << rayTracer.spheres().lights().size() << " lights)" << std::endl;
+	std::cout << "Scene:   " << sceneTime << " ms" << std::endl;
+	std::cout << "Trace:   " << traceTime << " ms" << std::endl;
+	std::cout << "Write:   " << writeTime << " ms" << std::endl;
+	std::cout << "Rays:    " << numRays << " ("
+		<< numRays / (traceTime / 1000.0) / 1.0e6 << " Mrays/s)" << std::endl;
+	std::cout << "Samples: " << (double)numSamples / (width * height) << " per pixel on average" << std::endl;
+
+	if (parser.isSet(compareOption)) {
+		// Relative difference of the mean radiance, 1% is within the noise
+		float mean = (meanRadiance.x + meanRadiance.y + meanRadiance.z) / 3.0f;
+		float recursiveMean = (recursiveMeanRadiance.x + recursiveMeanRadiance.y + recursiveMeanRadiance.z) / 3.0f;
+		float difference = mean > 0.0f ? std::fabs(recursiveMean - mean) / mean : std::fabs(recursiveMean);
+		std::cout << "Recursive traversal:" << std::endl;
+		std::cout << "Trace:   " << recursiveTime << " ms (recursive/iterative time ratio " << recursiveTime / traceTime << ")" << std::endl;
+		std::cout << "Rays:    " << recursiveRays << " ("
+			<< recursiveRays / (recursiveTime / 1000.0) / 1.0e6 << " Mrays/s)" << std::endl;
+		std::cout << "Mean radiance: " << recursiveMean << " recursive, " << mean << " iterative ("
+			<< difference * 100.0f << "% apart, " << (difference <= 0.01f ? "they agree" : "they differ") << ")" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,666 @@
+#include "../headers/raytracer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+// Per-thread state, so that render() can run traceRay on several threads
+static thread_local std::default_random_engine t_generator;
+static thread_local std::vector<float> t_lightCdf;
+static thread_local long long t_numRays = 0;
+
+RayTracer::RayTracer() : m_numRays(0), m_numSamples(0)
+{
+	m_bkgColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	m_sceneWidth = 0;
+	m_sceneHeight = 0;
+	m_sceneSamples = 0;
+
+	m_minSamples = 4;
+	m_varianceThreshold = 0.02f;
+	m_recursive = false;
+
+	m_camPos = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_camTarget = glm::vec3(0.0f, 0.0f, -1.0f);
+	m_fov = 30.0f;
+}
+
+RayTracer::~RayTracer() { }
+
+void RayTracer::loadDefaultScene()
+{
+	m_spheres.clear();
+
+	// Lights
+	m_spheres.add(Sphere(glm::vec3(10.0f, 20.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
+	m_spheres.add(Sphere(glm::vec3(-10.0f, 20.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
+	m_spheres.add(Sphere(glm::vec3(0.0f, 10.0f, 0.0f), 2, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, 2.0f, glm::vec3(1.0f, 1.0f, 1.0f)));
+
+	// Spheres of the scene
+	m_spheres.add(Sphere(glm::vec3(0.0, -10004, -30), 10000, glm::vec3(0.0f, 0.2f, 0.5f), false, 0.0, 0.0));
+	m_spheres.add(Sphere(glm::vec3(0.0f, 0.0f, -20.0f), 2, glm::vec3(1.0f, 1.0f, 1.0f), true, 0.9f, 1.1f));
+	m_spheres.add(Sphere(glm::vec3(4.0f, 0.0f, -32.5f), 4, glm::vec3(0.0f, 0.5f, 0.0f), true, 0.0f, 0.0f));
+	m_spheres.add(Sphere(glm::vec3(-5.0f, 0.0f, -35.0f), 3, glm::vec3(0.5f, 0.5f, 0.5f), true, 0.0f, 0.0f));
+	m_spheres.add(Sphere(glm::vec3(-4.5f, -1.0f, -19.0f), 1.5f, glm::vec3(0.5f, 0.1f, 0.0f), true, 0.0f, 0.0f));
+
+	m_bkgColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	setCamera(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 30.0f);
+}
+
+// Scene files are text files with one element per line:
+//   # comment
+//   camera px py pz tx ty tz fov
+//   background r g b
+//   resolution width height
+//   samples spp
+//   adaptive minSamples threshold
+//   sphere cx cy cz radius r g b [reflective transparency refractionIndex]
+//   light cx cy cz radius emission r g b
+bool RayTracer::loadScene(std::string filename)
+{
+	std::fstream input(filename.data(), std::ios::in);
+	if (input.rdstate() != std::ios::goodbit) {
+		std::cerr << "Cannot load scene file " << filename << std::endl;
+		return false;
+	}
+
+	m_spheres.clear();
+	m_sceneWidth = m_sceneHeight = m_sceneSamples = 0;
+
+	std::string line;
+	std::stringstream ss;
+	int lineNumber = 0;
+	while (std::getline(input, line)) {
+		lineNumber++;
+		ss.clear(); ss.str(line);
+
+		std::string wrd;
+		if (!(ss >> wrd) || wrd[0] == '#')
+			continue;
+
+		if (wrd == "camera") {
+			glm::vec3 pos, target;
+			float fov;
+			ss >> pos.x >> pos.y >> pos.z >> target.x >> target.y >> target.z >> fov;
+			setCamera(pos, target, fov);
+		}
+		else if (wrd == "background") {
+			ss >> m_bkgColor.x >> m_bkgColor.y >> m_bkgColor.z;
+		}
+		else if (wrd == "resolution") {
+			ss >> m_sceneWidth >> m_sceneHeight;
+		}
+		else if (wrd == "samples") {
+			ss >> m_sceneSamples;
+		}
+		else if (wrd == "adaptive") {
+			ss >> m_minSamples >> m_varianceThreshold;
+		}
+		else if (wrd == "sphere") {
+			glm::vec3 center, color;
+			float radius;
+			int reflective = 0;
+			float transparency = 0.0f, refrIndex = 0.0f;
+			ss >> center.x >> center.y >> center.z >> radius >> color.x >> color.y >> color.z;
+			ss >> reflective >> transparency >> refrIndex;
+			m_spheres.add(Sphere(center, radius, color, reflective != 0, transparency, refrIndex));
+		}
+		else if (wrd == "light") {
+			glm::vec3 center, color;
+			float radius, emission;
+			ss >> center.x >> center.y >> center.z >> radius >> emission >> color.x >> color.y >> color.z;
+			m_spheres.add(Sphere(center, radius, glm::vec3(0.0f, 0.0f, 0.0f), false, 0.0f, 0.0f, emission, color));
+		}
+		else if (wrd == "mesh") {
+			std::cerr << "Scene line " << lineNumber << ": meshes are not supported by the ray tracer yet. Ignoring..." << std::endl;
+			continue;
+		}
+		else {
+			std::cerr << "Scene line " << lineNumber << ": unknown element '" << wrd << "'. Ignoring..." << std::endl;
+			continue;
+		}
+
+		if (ss.fail() && !ss.eof())
+			std::cerr << "Scene line " << lineNumber << ": could not parse '" << line << "'" << std::endl;
+	}
+
+	return true;
+}
+
+void RayTracer::setCamera(const glm::vec3 &pos, const glm::vec3 &target, float fov)
+{
+	m_camPos = pos;
+	m_camTarget = target;
+	m_fov = fov;
+}
+
+void RayTracer::setAdaptiveSampling(int minSamples, float threshold)
+{
+	m_minSamples = std::max(1, minSamples);
+	m_varianceThreshold = threshold;
+}
+
+void RayTracer::render(
+	int width,
+	int height,
+	int samplesPerPixel,
+	int numThreads,
+	std::vector<glm::vec3> &image,
+	std::function<void(int)> progress)
+{
+	image.assign(width * height, glm::vec3(0.0f, 0.0f, 0.0f));
+	m_numRays = 0;
+	m_numSamples = 0;
+
+	if (samplesPerPixel < 1)
+		samplesPerPixel = 1;
+	if (numThreads <= 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	bool adaptive = (m_varianceThreshold > 0.0f && samplesPerPixel > m_minSamples);
+	int minSamples = adaptive ? m_minSamples : samplesPerPixel;
+
+	float invWidth = 1 / float(width), invHeight = 1 / float(height);
+	float aspectratio = width / float(height);
+	float angle = tan(PI * 0.5 * m_fov / 180.);
+
+	// Camera basis
+	glm::vec3 forward = glm::normalize(m_camTarget - m_camPos);
+	glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	glm::vec3 up = glm::cross(right, forward);
+
+	std::atomic<int> nextRow(0);
+	std::atomic<int> rowsDone(0);
+
+	// Every worker has its own sequence, or the rows of all of them would get
+	// the same jitter, lights and roulette
+	unsigned int baseSeed = std::default_random_engine::default_seed;
+
+	auto worker = [&](int threadIndex) {
+		t_generator.seed(baseSeed + threadIndex);
+		bool reportProgress = threadIndex == 0;
+		std::uniform_real_distribution<float> jitter(0.0f, 1.0f);
+		long long numSamples = 0;
+		t_numRays = 0;
+
+		int y;
+		while ((y = nextRow++) < height) {
+			glm::vec3 *pixel = &image[y * width];
+			for (int x = 0; x < width; ++x, ++pixel) {
+				glm::vec3 color(0.0f, 0.0f, 0.0f);
+
+				// Running mean and variance of the sample luminance (Welford)
+				float mean = 0.0f, m2 = 0.0f;
+				int s = 0;
+
+				// One sample goes through the center of the pixel, more samples are jittered
+				while (s < samplesPerPixel) {
+					float dx = (samplesPerPixel == 1) ? 0.5f : jitter(t_generator);
+					float dy = (samplesPerPixel == 1) ? 0.5f : jitter(t_generator);
+
+					float xx = (2 * ((x + dx) * invWidth) - 1) * angle * aspectratio;
+					float yy = (1 - 2 * ((y + dy) * invHeight)) * angle;
+					glm::vec3 rayDir = glm::normalize(right * xx + up * yy + forward);
+					glm::vec3 sample = m_recursive ?
+						traceRayRecursive(m_camPos, rayDir, glm::vec3(1.0f, 1.0f, 1.0f), 0) :
+						traceRay(m_camPos, rayDir);
+					color += sample;
+					s++;
+
+					if (!adaptive)
+						continue;
+
+					float luminance = 0.2126f * sample.x + 0.7152f * sample.y + 0.0722f * sample.z;
+					float delta = luminance - mean;
+					mean += delta / s;
+					m2 += delta * (luminance - mean);
+
+					// Stop once the error of the mean is small relative to the mean itself
+					if (s >= minSamples) {
+						float stdError = sqrt(m2 / (s - 1) / s);
+						if (stdError <= m_varianceThreshold * (mean + 0.01f))
+							break;
+					}
+				}
+
+				*pixel = color / (float)s;
+				numSamples += s;
+			}
+
+			int done = ++rowsDone;
+			if (reportProgress && progress)
+				progress((int)((float)done / (float)height * 100));
+		}
+
+		m_numRays += t_numRays;
+		m_numSamples += numSamples;
+	};
+
+	// The calling thread also traces rows, and is the one reporting progress
+	std::vector<std::thread> workers;
+	for (int i = 1; i < numThreads; ++i)
+		workers.push_back(std::thread(worker, i));
+
+	worker(0);
+
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	if (progress)
+		progress(100);
+}
+
+glm::vec3 RayTracer::traceRay(
+	const glm::vec3 &rayOrig,
+	const glm::vec3 &rayDir) const
+{
+	// Same estimate as traceRayRecursive, but every hit adds its own term to the
+	// pixel color scaled by its weight, and pushes the reflected and refracted
+	// rays on a fixed-size stack instead of recursing
+	RayTask stack[RAY_STACK_SIZE];
+	int stackSize = 0;
+
+	RayTask &primary = stack[stackSize++];
+	primary.orig = rayOrig;
+	primary.dir = rayDir;
+	primary.weight = glm::vec3(1.0f, 1.0f, 1.0f);
+	primary.throughput = glm::vec3(1.0f, 1.0f, 1.0f);
+	primary.depth = 0;
+
+	glm::vec3 color(0.0f, 0.0f, 0.0f);
+	std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+
+	// Add some bias to the point from which we will be tracing
+	float bias = 1e-4f;
+
+	while (stackSize > 0) {
+		RayTask ray = stack[--stackSize];
+
+		// Russian roulette
+		if (ray.depth >= RR_MIN_DEPTH) {
+			float survival = std::min(0.95f, std::max(ray.throughput.x, std::max(ray.throughput.y, ray.throughput.z)));
+			if (randomFloats(t_generator) >= survival)
+				continue;
+			ray.weight /= survival;
+		}
+
+		t_numRays++;
+
+		float distHit = INFINITY;
+		int sphereId = m_spheres.closestHit(ray.orig, ray.dir, distHit);
+
+		// No intersection: add the background color
+		if (sphereId < 0) {
+			color += ray.weight * m_bkgColor;
+			continue;
+		}
+
+		glm::vec3 posHit, normalHit, colorHit;
+		bool isInside = false;
+		intersection(sphereId, ray.orig, ray.dir, distHit, posHit, normalHit, colorHit, isInside);
+
+		const SphereMaterial &material = m_spheres.getMaterial(sphereId);
+		color += ray.weight * material.getLightColor() * material.emissionFactor();
+
+		if ((material.transparencyFactor() > 0.0f || material.reflectsLight()) && ray.depth < MAX_RAY_DEPTH) {
+			float kr = fresnel(ray.dir, normalHit);
+
+			// Refraction (only if the sphere is also transparent)
+			if (material.transparencyFactor() > 0.0f && material.refractsLight()) {
+				float ior = material.getRefractionIndex();
+				float eta = isInside ? ior : 1.0f / ior;
+				float cosi = -glm::dot(normalHit, ray.dir);
+				float k = 1.0f - eta * eta * (1.0f - cosi * cosi);
+
+				// k < 0 means total internal reflection: there is no refracted ray
+				if (k >= 0.0f) {
+					float factor = (1.0f - kr) * material.transparencyFactor();
+
+					assert(stackSize < RAY_STACK_SIZE);
+					RayTask &refr = stack[stackSize++];
+					refr.orig = posHit - normalHit * bias;
+					refr.dir = glm::normalize(ray.dir * eta + normalHit * (eta * cosi - std::sqrt(k)));
+					refr.weight = ray.weight * material.getSurfaceColor() * factor;
+					refr.throughput = ray.throughput * material.getSurfaceColor() * factor;
+					refr.depth = ray.depth + 1;
+				}
+			}
+
+			// Reflection
+			assert(stackSize < RAY_STACK_SIZE);
+			RayTask &refl = stack[stackSize++];
+			refl.orig = posHit + normalHit * bias;
+			refl.dir = glm::normalize(ray.dir - normalHit * 2.0f * glm::dot(ray.dir, normalHit));
+			refl.weight = ray.weight * material.getSurfaceColor() * kr;
+			refl.throughput = ray.throughput * material.getSurfaceColor() * kr;
+			refl.depth = ray.depth + 1;
+		}
+		else {
+			// Diffuse object: add the contribution of the lights that are not shadowed
+			color += ray.weight * directLighting(posHit, normalHit, colorHit);
+		}
+	}
+
+	return color;
+}
+
+glm::vec3 RayTracer::traceRayRecursive(
+	const glm::vec3 &rayOrig,
+	const glm::vec3 &rayDir,
+	const glm::vec3 &throughput,
+	const int &depth) const
+{
+	// Russian roulette: paths that carry little energy are likely to be ended,
+	// and the ones that survive are weighted up to keep the estimate unbiased
+	float survival = 1.0f;
+	if (depth >= RR_MIN_DEPTH) {
+		std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+		survival = std::min(0.95f, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+		if (randomFloats(t_generator) >= survival)
+			return glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+
+	t_numRays++;
+
+	// Find the closest sphere along the ray. Only the packed bounds are read here.
+	float distHit = INFINITY;
+	int sphereId = m_spheres.closestHit(rayOrig, rayDir, distHit);
+
+	// No intersection: return the background color, weighted as every other
+	// return of a survivor
+	if (sphereId < 0)
+		return m_bkgColor / survival;
+
+	glm::vec3 posHit, normalHit, colorHit;
+	bool isInside = false;
+	intersection(sphereId, rayOrig, rayDir, distHit, posHit, normalHit, colorHit, isInside);
+
+	const SphereMaterial &material = m_spheres.getMaterial(sphereId);
+	glm::vec3 surfaceColor(0.0f, 0.0f, 0.0f);
+
+	// Add some bias to the point from which we will be tracing
+	float bias = 1e-4f;
+
+	if ((material.transparencyFactor() > 0.0f || material.reflectsLight()) && depth < MAX_RAY_DEPTH) {
+		float kr = fresnel(rayDir, normalHit);
+
+		// Reflection
+		glm::vec3 reflDir = glm::normalize(rayDir - normalHit * 2.0f * glm::dot(rayDir, normalHit));
+		glm::vec3 reflThroughput = throughput * material.getSurfaceColor() * kr;
+		glm::vec3 reflColor = traceRayRecursive(posHit + normalHit * bias, reflDir, reflThroughput, depth + 1);
+
+		// Refraction (only if the sphere is also transparent)
+		glm::vec3 refrColor(0.0f, 0.0f, 0.0f);
+		if (material.transparencyFactor() > 0.0f && material.refractsLight()) {
+			float ior = material.getRefractionIndex();
+			float eta = isInside ? ior : 1.0f / ior;
+			float cosi = -glm::dot(normalHit, rayDir);
+			float k = 1.0f - eta * eta * (1.0f - cosi * cosi);
+
+			// k < 0 means total internal reflection: there is no refracted ray
+			if (k >= 0.0f) {
+				glm::vec3 refrDir = glm::normalize(rayDir * eta + normalHit * (eta * cosi - std::sqrt(k)));
+				glm::vec3 refrThroughput = throughput * material.getSurfaceColor() * (1.0f - kr) * material.transparencyFactor();
+				refrColor = traceRayRecursive(posHit - normalHit * bias, refrDir, refrThroughput, depth + 1);
+			}
+		}
+
+		surfaceColor = blendReflRefrColors(material, rayDir, normalHit, reflColor, refrColor);
+	}
+	else {
+		// Diffuse object: add the contribution of the lights that are not shadowed
+		surfaceColor = directLighting(posHit, normalHit, colorHit);
+	}
+
+	return (surfaceColor + material.getLightColor() * material.emissionFactor()) / survival;
+}
+
+float RayTracer::fresnel(
+	const glm::vec3 &raydir,
+	const glm::vec3 &normalHit) const
+{
+	float facingRatio = -glm::dot(raydir, normalHit);
+	return 0.5f + pow(1 - facingRatio, 3) * 0.5;
+}
+
+glm::vec3 RayTracer::lightContribution(
+	const int &lightId,
+	const glm::vec3 &posHit,
+	const glm::vec3 &normalHit,
+	const glm::vec3 &colorHit) const
+{
+	const SphereMaterial &light = m_spheres.getMaterial(lightId);
+
+	glm::vec3 toLight = m_spheres.getCenter(lightId) - posHit;
+	float lightDist = glm::length(toLight);
+	glm::vec3 lightDir = toLight / lightDist;
+
+	float cosTheta = glm::dot(normalHit, lightDir);
+	if (cosTheta <= 0.0f)
+		return glm::vec3(0.0f, 0.0f, 0.0f);
+
+	// Shadow ray: any occluder before the light is enough, no need for the closest one
+	float bias = 1e-4f;
+	t_numRays++;
+	if (m_spheres.occluded(posHit + normalHit * bias, lightDir, lightDist, lightId))
+		return glm::vec3(0.0f, 0.0f, 0.0f);
+
+	return colorHit * cosTheta * light.getLightColor() * light.emissionFactor();
+}
+
+glm::vec3 RayTracer::directLighting(
+	const glm::vec3 &posHit,
+	const glm::vec3 &normalHit,
+	const glm::vec3 &colorHit) const
+{
+	const std::vector<int> &lights = m_spheres.lights();
+	glm::vec3 color(0.0f, 0.0f, 0.0f);
+
+	// Few lights: evaluate all of them
+	if ((int)lights.size() <= MAX_SHADOW_LIGHTS) {
+		for (size_t i = 0; i < lights.size(); ++i)
+			color += lightContribution(lights[i], posHit, normalHit, colorHit);
+
+		return color;
+	}
+
+	// Many lights: trace MAX_SHADOW_LIGHTS shadow rays towards lights chosen with
+	// a probability proportional to their unshadowed contribution
+	std::vector<float> &lightCdf = t_lightCdf;
+	lightCdf.resize(lights.size());
+	float totalWeight = 0.0f;
+	for (size_t i = 0; i < lights.size(); ++i) {
+		const SphereMaterial &light = m_spheres.getMaterial(lights[i]);
+		glm::vec3 lightDir = glm::normalize(m_spheres.getCenter(lights[i]) - posHit);
+		glm::vec3 power = light.getLightColor() * light.emissionFactor();
+
+		float luminance = 0.2126f * power.x + 0.7152f * power.y + 0.0722f * power.z;
+		totalWeight += luminance * std::max(0.0f, glm::dot(normalHit, lightDir));
+		lightCdf[i] = totalWeight;
+	}
+
+	if (totalWeight <= 0.0f)
+		return color;
+
+	std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+	for (int s = 0; s < MAX_SHADOW_LIGHTS; ++s) {
+		float u = randomFloats(t_generator) * totalWeight;
+		size_t id = std::upper_bound(lightCdf.begin(), lightCdf.end(), u) - lightCdf.begin();
+		id = std::min(id, lights.size() - 1);
+
+		float weight = lightCdf[id] - (id > 0 ? lightCdf[id - 1] : 0.0f);
+		if (weight <= 0.0f)
+			continue;
+
+		float pdf = weight / totalWeight;
+		color += lightContribution(lights[id], posHit, normalHit, colorHit) / (pdf * MAX_SHADOW_LIGHTS);
+	}
+
+	return color;
+}
+
+bool RayTracer::intersection(
+	const int &sphereId,
+	const glm::vec3 &rayOrig,
+	const glm::vec3 &rayDir,
+	float &distHit,
+	glm::vec3 &posHit,
+	glm::vec3 &normalHit,
+	glm::vec3 &colorHit,
+	bool &isInside) const
+{
+	float inter0 = INFINITY;
+	float inter1 = INFINITY;
+
+	if (m_spheres.intersect(sphereId, rayOrig, rayDir, inter0, inter1)) {
+		if (inter0 < 0)
+			inter0 = inter1;
+
+		distHit = inter0;
+		posHit = rayOrig + rayDir * inter0;
+		normalHit = posHit - m_spheres.getCenter(sphereId);
+		normalHit = glm::normalize(normalHit);
+
+		// If the normal and the view direction are not opposite to each other
+		// reverse the normal direction. That also means we are inside the sphere so set
+		// the inside bool to true.
+		isInside = false;
+		float dotProd = glm::dot(rayDir, normalHit);
+
+		if (dotProd > 0) {
+			normalHit = -normalHit;
+			isInside = true;
+		}
+
+		colorHit = m_spheres.getMaterial(sphereId).getSurfaceColor();
+
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+glm::vec3 RayTracer::blendReflRefrColors(
+	const SphereMaterial &material,
+	const glm::vec3 &raydir,
+	const glm::vec3 &normalHit,
+	const glm::vec3 &reflColor,
+	const glm::vec3 &refrColor) const
+{
+	float kr = fresnel(raydir, normalHit);
+
+	glm::vec3 blendedColor = (reflColor * kr + refrColor * (1 - kr) * material.transparencyFactor())*material.getSurfaceColor();
+	return blendedColor;
+}
+
+bool RayTracer::savePFM(const std::string &filename, int width, int height, const std::vector<glm::vec3> &image)
+{
+	std::ofstream output(filename.data(), std::ios::out | std::ios::binary);
+	if (!output) {
+		std::cerr << "Cannot write PFM file " << filename << std::endl;
+		return false;
+	}
+
+	// Negative scale means little endian. PFM stores the bottom row first.
+	output << "PF\n" << width << " " << height << "\n-1.0\n";
+	for (int y = height - 1; y >= 0; --y)
+		output.write((const char*)&image[y * width], sizeof(float) * 3 * width);
+
+	return output.good();
+}
+
+// Uncompressed scanline OpenEXR with 32-bit float B, G, R channels
+bool RayTracer::saveEXR(const std::string &filename, int width, int height, const std::vector<glm::vec3> &image)
+{
+	std::ofstream output(filename.data(), std::ios::out | std::ios::binary);
+	if (!output) {
+		std::cerr << "Cannot write EXR file " << filename << std::endl;
+		return false;
+	}
+
+	std::vector<char> header;
+	auto putBytes = [&header](const void *data, size_t size) {
+		header.insert(header.end(), (const char*)data, (const char*)data + size);
+	};
+	auto putInt = [&putBytes](int32_t value) { putBytes(&value, 4); };
+	auto putFloat = [&putBytes](float value) { putBytes(&value, 4); };
+	auto putAttribute = [&putBytes, &putInt](const char *name, const char *type, int32_t size) {
+		putBytes(name, strlen(name) + 1);
+		putBytes(type, strlen(type) + 1);
+		putInt(size);
+	};
+
+	// Magic number and version 2 (single part scanline file)
+	putInt(20000630);
+	putInt(2);
+
+	// Channels, in alphabetical order
+	const char *channels[3] = { "B", "G", "R" };
+	putAttribute("channels", "chlist", 3 * 18 + 1);
+	for (int c = 0; c < 3; ++c) {
+		putBytes(channels[c], 2);
+		putInt(2); // FLOAT
+		int32_t linearAndReserved = 0;
+		putBytes(&linearAndReserved, 4);
+		putInt(1); // x sampling
+		putInt(1); // y sampling
+	}
+	header.push_back(0);
+
+	putAttribute("compression", "compression", 1);
+	header.push_back(0); // NO_COMPRESSION
+
+	putAttribute("dataWindow", "box2i", 16);
+	putInt(0); putInt(0); putInt(width - 1); putInt(height - 1);
+
+	putAttribute("displayWindow", "box2i", 16);
+	putInt(0); putInt(0); putInt(width - 1); putInt(height - 1);
+
+	putAttribute("lineOrder", "lineOrder", 1);
+	header.push_back(0); // INCREASING_Y
+
+	putAttribute("pixelAspectRatio", "float", 4);
+	putFloat(1.0f);
+
+	putAttribute("screenWindowCenter", "v2f", 8);
+	putFloat(0.0f); putFloat(0.0f);
+
+	putAttribute("screenWindowWidth", "float", 4);
+	putFloat(1.0f);
+
+	header.push_back(0);
+
+	// Offset table: one scanline per block
+	uint64_t lineSize = 4 + 4 + 3 * 4 * (uint64_t)width;
+	uint64_t firstLine = header.size() + 8 * (uint64_t)height;
+	for (int y = 0; y < height; ++y) {
+		uint64_t offset = firstLine + y * lineSize;
+		putBytes(&offset, 8);
+	}
+
+	output.write(&header[0], header.size());
+
+	std::vector<float> line(3 * width);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const glm::vec3 &pixel = image[y * width + x];
+			line[x] = pixel.z;
+			line[width + x] = pixel.y;
+			line[2 * width + x] = pixel.x;
+		}
+
+		int32_t dataSize = 3 * 4 * width;
+		output.write((const char*)&y, 4);
+		output.write((const char*)&dataSize, 4);
+		output.write((const char*)&line[0], dataSize);
+	}
+
+	return output.good();
+}
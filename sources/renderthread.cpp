@@ -0,0 +1,120 @@
+#include "renderthread.h"
+#include <QOpenGLFunctions_3_3_Core>
+
+#include <iostream>
+
+RenderThread::RenderThread(QOpenGLContext *shareContext, const RenderSettings &settings)
+{
+	m_quit = false;
+
+	m_context = new QOpenGLContext;
+	m_context->setFormat(shareContext->format());
+	m_context->setShareContext(shareContext);
+	m_context->create();
+	m_context->moveToThread(this);
+
+	// Surfaces can only be created in the GUI thread
+	m_surface = new QOffscreenSurface;
+	m_surface->setFormat(m_context->format());
+	m_surface->create();
+
+	m_settings.back() = settings;
+	m_settings.publish();
+}
+
+RenderThread::~RenderThread()
+{
+	stop();
+	delete m_context; // if the thread never ran
+	delete m_surface;
+}
+
+void RenderThread::setSettings(const RenderSettings &settings)
+{
+	m_settings.back() = settings;
+	m_settings.publish();
+	m_wake.release();
+}
+
+void RenderThread::stop()
+{
+	if (!isRunning())
+		return;
+
+	m_quit = true;
+	m_wake.release();
+	wait();
+}
+
+void RenderThread::run()
+{
+	if (!m_context->makeCurrent(m_surface)) {
+		std::cerr << "-- AGEn message --: Cannot make the render thread context current" << std::endl;
+		return;
+	}
+	QOpenGLFunctions_3_3_Core* gl = m_context->versionFunctions<QOpenGLFunctions_3_3_Core>();
+	gl->initializeOpenGLFunctions();
+
+	m_settings.update();
+	RenderSettings settings = m_settings.front();
+	SSAORenderer renderer(settings.modelFilename);
+	renderer.initialize(settings.width, settings.height);
+	renderer.apply(settings);
+	emit sceneChanged(renderer.sceneRadius(), renderer.lodCount());
+
+	while (!m_quit) {
+		// Only the last settings matter. The stress test renders continuously.
+		if (renderer.instanceCount() == 0)
+			m_wake.acquire();
+		m_wake.tryAcquire(m_wake.available());
+		if (m_quit)
+			break;
+
+		if (m_settings.update()) {
+			settings = m_settings.front();
+			if (renderer.apply(settings))
+				emit sceneChanged(renderer.sceneRadius(), renderer.lodCount());
+		}
+		if (renderer.instanceCount() > 0)
+			renderer.invalidate();
+
+		// The slot after the last published one is never being presented, but
+		// the GPU may still be blitting it for the widget
+		Frame &frame = m_frames.back();
+		if (frame.presented) {
+			gl->glWaitSync(frame.presented, 0, GL_TIMEOUT_IGNORED);
+			gl->glDeleteSync(frame.presented);
+			frame.presented = 0;
+		}
+		QSize size(settings.width, settings.height);
+		if (!frame.fbo || frame.fbo->size() != size) {
+			delete frame.fbo;
+			frame.fbo = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+		}
+		renderer.render(frame.fbo->handle());
+
+		if (frame.fence)
+			gl->glDeleteSync(frame.fence);
+		frame.fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		gl->glFlush(); // the fence must reach the GPU before another context waits on it
+		m_frames.publish();
+		emit frameReady();
+	}
+
+	// The widget is not presenting anymore
+	renderer.cleanup();
+	for (int i = 0; i < 3; ++i) {
+		Frame &frame = m_frames.slot(i);
+		if (frame.presented)
+			gl->glClientWaitSync(frame.presented, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		delete frame.fbo;
+		if (frame.fence)
+			gl->glDeleteSync(frame.fence);
+		if (frame.presented)
+			gl->glDeleteSync(frame.presented);
+		frame = Frame();
+	}
+	m_context->doneCurrent();
+	delete m_context;
+	m_context = nullptr;
+}
@@ -0,0 +1,340 @@
+#include "shaderlibrary.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <QVector>
+
+#include <iostream>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_GEOMETRY_SHADER
+#define GL_GEOMETRY_SHADER 0x8DD9
+#endif
+
+ShaderLibrary& ShaderLibrary::instance()
+{
+	// Created on first use, once the application exists
+	static ShaderLibrary* library = new ShaderLibrary;
+	return *library;
+}
+
+ShaderLibrary::ShaderLibrary()
+{
+	m_functionsResolved = false;
+	m_getProgramBinary = nullptr;
+	m_programBinary = nullptr;
+	m_programParameteri = nullptr;
+	m_maxShaderCompilerThreads = nullptr;
+
+	m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders";
+
+	// Editors usually write a file several times when saving it
+	m_changeTimer.setSingleShot(true);
+	m_changeTimer.setInterval(200);
+	connect(&m_changeTimer, &QTimer::timeout, this, &ShaderLibrary::shadersChanged);
+	connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &ShaderLibrary::fileChanged);
+}
+
+QOpenGLShaderProgram* ShaderLibrary::program(const ShaderFiles &files, const QOpenGLShaderProgram *previous)
+{
+	QList<ShaderFiles> filesList;
+	filesList << files;
+	QList<QOpenGLShaderProgram*> previousList;
+	previousList << const_cast<QOpenGLShaderProgram*>(previous);
+
+	return programs(filesList, previousList).first();
+}
+
+QList<QOpenGLShaderProgram*> ShaderLibrary::programs(
+	const QList<ShaderFiles> &files,
+	const QList<QOpenGLShaderProgram*> &previous)
+{
+	// The render thread of the SSOWidget builds its programs too
+	QMutexLocker locker(&m_mutex);
+
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+	QOpenGLFunctions* f = context->functions();
+	initFunctions(context);
+
+	QElapsedTimer timer;
+	timer.start();
+
+	// Let the driver use its own threads for the compilations issued below
+	if (m_maxShaderCompilerThreads)
+		m_maxShaderCompilerThreads(0xFFFFFFFF);
+
+	// First issue every binary upload or compilation, without waiting for them
+	QVector<PendingProgram> pending(files.size());
+	for (int i = 0; i < files.size(); ++i) {
+		PendingProgram &p = pending[i];
+		p.files = files[i];
+		p.sources[0] = readSource(files[i].vertex);
+		p.sources[1] = readSource(files[i].fragment);
+		if (!files[i].geometry.isEmpty())
+			p.sources[2] = readSource(files[i].geometry);
+
+		// Attribute locations of the program being replaced
+		QByteArray bindings;
+		const QOpenGLShaderProgram* prev = (i < previous.size()) ? previous[i] : nullptr;
+		if (prev && prev->programId()) {
+			GLuint prevId = prev->programId();
+			GLint numAttribs = 0, maxLength = 0;
+			f->glGetProgramiv(prevId, GL_ACTIVE_ATTRIBUTES, &numAttribs);
+			f->glGetProgramiv(prevId, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+
+			QByteArray name(maxLength + 1, '\0');
+			for (GLint a = 0; a < numAttribs; ++a) {
+				GLsizei length = 0;
+				GLint size = 0;
+				GLenum type = 0;
+				f->glGetActiveAttrib(prevId, a, name.size(), &length, &size, &type, name.data());
+				QByteArray attrib(name.constData(), length);
+				if (attrib.startsWith("gl_"))
+					continue;
+
+				GLint location = f->glGetAttribLocation(prevId, attrib.constData());
+				p.bindings.append(qMakePair(attrib, location));
+				bindings += attrib + "=" + QByteArray::number(location) + ";";
+			}
+		}
+
+		p.key = programKey(p.sources, bindings);
+		p.program = new QOpenGLShaderProgram;
+		p.program->create();
+
+		ProgramBinary binary;
+		p.fromBinary = false;
+		if (m_programBinary && loadBinary(p.key, binary)) {
+			m_programBinary(p.program->programId(), binary.format, binary.data.constData(), binary.data.size());
+			p.fromBinary = true;
+		}
+		else {
+			compile(f, p);
+		}
+	}
+
+	// Then wait for the results. link() only reads the link status here, as
+	// no QOpenGLShader was added to the programs.
+	QList<QOpenGLShaderProgram*> result;
+	int numFromBinary = 0;
+	for (int i = 0; i < pending.size(); ++i) {
+		PendingProgram &p = pending[i];
+		bool linked = p.program->link();
+
+		// A binary from an older driver is rejected: build it from the sources
+		if (p.fromBinary && !linked) {
+			m_binaries.remove(p.key);
+			QFile::remove(binaryFilename(p.key));
+			p.fromBinary = false;
+			compile(f, p);
+			linked = p.program->link();
+		}
+
+		if (!linked) {
+			std::cerr << "-- AGEn message --: Cannot link " << p.files.vertex.toStdString()
+				<< " + " << p.files.fragment.toStdString() << std::endl;
+			for (int s = 0; s < p.shaders.size(); ++s) {
+				GLint compiled = 0, logLength = 0;
+				f->glGetShaderiv(p.shaders[s], GL_COMPILE_STATUS, &compiled);
+				f->glGetShaderiv(p.shaders[s], GL_INFO_LOG_LENGTH, &logLength);
+				if (!compiled && logLength > 0) {
+					QByteArray log(logLength, '\0');
+					f->glGetShaderInfoLog(p.shaders[s], logLength, nullptr, log.data());
+					std::cerr << log.constData() << std::endl;
+				}
+			}
+			std::cerr << p.program->log().toStdString() << std::endl;
+		}
+		else if (p.fromBinary) {
+			++numFromBinary;
+		}
+		else if (m_getProgramBinary) {
+			GLint length = 0;
+			f->glGetProgramiv(p.program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length > 0) {
+				ProgramBinary binary;
+				binary.data.resize(length);
+				GLsizei written = 0;
+				m_getProgramBinary(p.program->programId(), length, &written, &binary.format, binary.data.data());
+				binary.data.resize(written);
+				m_binaries.insert(p.key, binary);
+				saveBinary(p.key, binary);
+			}
+		}
+
+		for (int s = 0; s < p.shaders.size(); ++s) {
+			f->glDetachShader(p.program->programId(), p.shaders[s]);
+			f->glDeleteShader(p.shaders[s]);
+		}
+
+		result << p.program;
+	}
+
+	std::cout << "-- AGEn message --: " << result.size() << " shader program(s), " << numFromBinary
+		<< " from the binary cache, in " << timer.elapsed() << " ms" << std::endl;
+
+	return result;
+}
+
+void ShaderLibrary::fileChanged(const QString &path)
+{
+	// Files saved by replacing them are no longer watched
+	if (!m_watcher.files().contains(path) && QFileInfo(path).exists())
+		m_watcher.addPath(path);
+
+	m_changeTimer.start();
+}
+
+void ShaderLibrary::initFunctions(QOpenGLContext *context)
+{
+	// The contexts share the same driver, resolving them once is enough
+	if (m_functionsResolved)
+		return;
+	m_functionsResolved = true;
+
+	QOpenGLFunctions* f = context->functions();
+	m_driver = QByteArray((const char*)f->glGetString(GL_VENDOR)) + "|"
+		+ QByteArray((const char*)f->glGetString(GL_RENDERER)) + "|"
+		+ QByteArray((const char*)f->glGetString(GL_VERSION));
+
+	// Program binaries (core since 4.1)
+	bool binaries = context->format().version() >= qMakePair(4, 1) ||
+		context->hasExtension(QByteArrayLiteral("GL_ARB_get_program_binary"));
+	if (binaries) {
+		GLint numFormats = 0;
+		f->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		binaries = (numFormats > 0);
+	}
+	if (binaries) {
+		m_getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(context->getProcAddress("glGetProgramBinary"));
+		m_programBinary = reinterpret_cast<ProgramBinaryProc>(context->getProcAddress("glProgramBinary"));
+		m_programParameteri = reinterpret_cast<ProgramParameteriProc>(context->getProcAddress("glProgramParameteri"));
+	}
+	if (!m_getProgramBinary || !m_programBinary) {
+		m_getProgramBinary = nullptr;
+		m_programBinary = nullptr;
+		std::cout << "-- AGEn message --: Program binaries not supported, shaders are always compiled" << std::endl;
+	}
+
+	// Parallel compilation
+	if (context->hasExtension(QByteArrayLiteral("GL_KHR_parallel_shader_compile")))
+		m_maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(context->getProcAddress("glMaxShaderCompilerThreadsKHR"));
+	else if (context->hasExtension(QByteArrayLiteral("GL_ARB_parallel_shader_compile")))
+		m_maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(context->getProcAddress("glMaxShaderCompilerThreadsARB"));
+}
+
+void ShaderLibrary::compile(QOpenGLFunctions *f, PendingProgram &p)
+{
+	static const GLenum types[3] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+	GLuint programId = p.program->programId();
+
+	for (int s = 0; s < 3; ++s) {
+		if (s == 2 && p.files.geometry.isEmpty())
+			continue;
+
+		GLuint shader = f->glCreateShader(types[s]);
+		const char* source = p.sources[s].constData();
+		GLint length = p.sources[s].size();
+		f->glShaderSource(shader, 1, &source, &length);
+		f->glCompileShader(shader);
+		f->glAttachShader(programId, shader);
+		p.shaders.append(shader);
+	}
+
+	for (int b = 0; b < p.bindings.size(); ++b)
+		f->glBindAttribLocation(programId, p.bindings[b].second, p.bindings[b].first.constData());
+
+	if (m_programParameteri)
+		m_programParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	f->glLinkProgram(programId);
+}
+
+void ShaderLibrary::watch(const QString &filename)
+{
+	// The watcher lives in the GUI thread
+	if (QThread::currentThread() != thread()) {
+		QMetaObject::invokeMethod(this, [this, filename]() { watch(filename); }, Qt::QueuedConnection);
+		return;
+	}
+	if (!m_watcher.files().contains(filename) && QFileInfo(filename).exists())
+		m_watcher.addPath(filename);
+}
+
+QByteArray ShaderLibrary::readSource(const QString &filename)
+{
+	watch(filename);
+
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly)) {
+		std::cerr << "-- AGEn message --: Cannot open shader " << filename.toStdString() << std::endl;
+		return QByteArray();
+	}
+	return file.readAll();
+}
+
+QByteArray ShaderLibrary::programKey(const QByteArray sources[3], const QByteArray &bindings) const
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	for (int s = 0; s < 3; ++s) {
+		hash.addData(sources[s]);
+		hash.addData("\0", 1);
+	}
+	hash.addData(bindings);
+	hash.addData(m_driver);
+	return hash.result().toHex();
+}
+
+bool ShaderLibrary::loadBinary(const QByteArray &key, ProgramBinary &binary)
+{
+	QHash<QByteArray, ProgramBinary>::const_iterator it = m_binaries.constFind(key);
+	if (it != m_binaries.constEnd()) {
+		binary = it.value();
+		return true;
+	}
+
+	QFile file(binaryFilename(key));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	quint32 format = 0;
+	in >> format >> binary.data;
+	if (in.status() != QDataStream::Ok || binary.data.isEmpty())
+		return false;
+
+	binary.format = format;
+	m_binaries.insert(key, binary);
+	return true;
+}
+
+void ShaderLibrary::saveBinary(const QByteArray &key, const ProgramBinary &binary)
+{
+	QDir().mkpath(m_cacheDir);
+
+	QFile file(binaryFilename(key));
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream out(&file);
+	out << (quint32)binary.format << binary.data;
+}
+
+QString ShaderLibrary::binaryFilename(const QByteArray &key) const
+{
+	return m_cacheDir + "/" + QString::fromLatin1(key) + ".bin";
+}
@@ -0,0 +1,224 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QSurfaceFormat>
+#include <qopenglframebufferobject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Camera.h"
+#include "benchmark.h"
+#include "ssaorenderer.h"
+
+// Headless SSAO renderer: renders a model with the pipeline of the SSOWidget
+// into an FBO of a QOffscreenSurface, writes the last frame to an image and
+// prints the time of every pass. Without a display it runs on Mesa's llvmpipe
+// with -platform offscreen (or under xvfb-run, LIBGL_ALWAYS_SOFTWARE=1).
+int main(int argc, char *argv[])
+{
+	QGuiApplication app(argc, argv);
+
+	QCoreApplication::setApplicationName("AG SSAO Renderer");
+	QCoreApplication::setOrganizationName(" ");
+	QCoreApplication::setApplicationVersion(QT_VERSION_STR);
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QCoreApplication::applicationName());
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addPositionalArgument("model", "OBJ model (the camera path's one, or Patricio, if omitted)");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Output image", "file", "ssao.png");
+	parser.addOption(outputOption);
+	QCommandLineOption widthOption("width", "Image width", "pixels", "1280");
+	parser.addOption(widthOption);
+	QCommandLineOption heightOption("height", "Image height", "pixels", "720");
+	parser.addOption(heightOption);
+	QCommandLineOption cameraOption("camera", "Camera path recorded with P in the SSAO tab", "path");
+	parser.addOption(cameraOption);
+	QCommandLineOption timeOption("time", "Time of the camera path, in seconds from its start", "seconds", "0");
+	parser.addOption(timeOption);
+	QCommandLineOption rotationOption("rotation", "Rotation of the model in degrees, without a camera path", "x,y");
+	parser.addOption(rotationOption);
+	QCommandLineOption framesOption("frames", "Frames rendered to time the passes", "n", "10");
+	parser.addOption(framesOption);
+	QCommandLineOption noSSAOOption("no-ssao", "Disable the ambient occlusion");
+	parser.addOption(noSSAOOption);
+	QCommandLineOption onlySSAOOption("only-ssao", "Write the ambient occlusion term only");
+	parser.addOption(onlySSAOOption);
+	QCommandLineOption intensityOption("intensity", "Ambient intensity", "value", "0.2");
+	parser.addOption(intensityOption);
+	QCommandLineOption lightsOption("lights", "Point lights besides the headlight", "n", "0");
+	parser.addOption(lightsOption);
+	QCommandLineOption depthPrepassOption("depth-prepass", "Depth-only pass before the G-buffer pass");
+	parser.addOption(depthPrepassOption);
+	QCommandLineOption overdrawOption("overdraw", "Write the fragments shaded per pixel by the G-buffer pass");
+	parser.addOption(overdrawOption);
+	QCommandLineOption occlusionOption("occlusion-culling", "Two-phase occlusion culling of the submeshes");
+	parser.addOption(occlusionOption);
+	QCommandLineOption aaOption("aa", "Post-process anti-aliasing: none, fxaa or smaa", "mode", "none");
+	parser.addOption(aaOption);
+	QCommandLineOption aaQualityOption("aa-high-quality", "High quality anti-aliasing");
+	parser.addOption(aaQualityOption);
+	QCommandLineOption normalMapOption("normal-map", "Tangent space normal map of the model", "image");
+	parser.addOption(normalMapOption);
+
+	parser.process(app);
+
+	int width = parser.value(widthOption).toInt();
+	int height = parser.value(heightOption).toInt();
+	int frames = std::max(parser.value(framesOption).toInt(), 1);
+	if (width <= 0 || height <= 0) {
+		std::cerr << "Invalid resolution " << width << "x" << height << std::endl;
+		return 1;
+	}
+	int aa = SSAORenderer::antialiasingMode(parser.value(aaOption));
+	if (aa < 0) {
+		std::cerr << "Unknown anti-aliasing " << parser.value(aaOption).toStdString() << std::endl;
+		return 1;
+	}
+
+	CameraPath path;
+	if (parser.isSet(cameraOption) && !path.load(parser.value(cameraOption).toStdString()))
+		return 1;
+
+	QString model = "./models/Patricio.obj";
+	const QStringList args = parser.positionalArguments();
+	if (!args.isEmpty())
+		model = args[0];
+	else if (!path.model.empty())
+		model = QString::fromStdString(path.model);
+
+	// Context and surface, without any window
+	QElapsedTimer timer;
+	timer.start();
+
+	QSurfaceFormat fmt;
+	fmt.setVersion(3, 3);
+	fmt.setProfile(QSurfaceFormat::CoreProfile);
+	fmt.setDepthBufferSize(24);
+
+	QOpenGLContext context;
+	context.setFormat(fmt);
+	if (!context.create() || context.format().version() < qMakePair(3, 3)) {
+		std::cerr << "Cannot create an OpenGL 3.3 core context" << std::endl;
+		return 1;
+	}
+	QOffscreenSurface surface;
+	surface.setFormat(context.format());
+	surface.create();
+	if (!surface.isValid() || !context.makeCurrent(&surface)) {
+		std::cerr << "Cannot make the offscreen surface current" << std::endl;
+		return 1;
+	}
+	QOpenGLFunctions_3_3_Core* gl = context.versionFunctions<QOpenGLFunctions_3_3_Core>();
+	gl->initializeOpenGLFunctions();
+	std::cout << "Renderer: " << (const char*)gl->glGetString(GL_RENDERER) << std::endl;
+
+	// Target of the light pass, read back at the end
+	QOpenGLFramebufferObject* target = new QOpenGLFramebufferObject(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+	double contextTime = timer.nsecsElapsed() / 1.0e6;
+
+	// Model, shaders and buffers
+	timer.restart();
+	SSAORenderer renderer(model);
+	if (!renderer.initialize(width, height)) {
+		std::cerr << "Cannot load model " << model.toStdString() << std::endl;
+		renderer.cleanup();
+		delete target;
+		return 1;
+	}
+	renderer.setSSAO(!parser.isSet(noSSAOOption));
+	renderer.setDrawOnlySSAO(parser.isSet(onlySSAOOption));
+	renderer.setSSAOIntensity(parser.value(intensityOption).toFloat());
+	renderer.setLightCount(parser.value(lightsOption).toInt());
+	renderer.setDepthPrepass(parser.isSet(depthPrepassOption));
+	renderer.setDrawOverdraw(parser.isSet(overdrawOption));
+	renderer.setOcclusionCulling(parser.isSet(occlusionOption));
+	renderer.setAntialiasing(aa);
+	renderer.setHighQualityAA(parser.isSet(aaQualityOption));
+	renderer.setNormalMap(parser.value(normalMapOption));
+	double loadTime = timer.nsecsElapsed() / 1.0e6;
+
+	// Same camera as the SSOWidget, with the fov it would get at this size
+	float ar = (float)width / (float)height;
+	float fov = ar < 1.0f ? 2.0f * atan(tan(PI / 6.0f) / ar) : PI / 3.0f;
+	Camera camera(width, height, glm::vec3(0.0f, 0.0f, -2.0f * renderer.sceneRadius()), renderer.sceneRadius(), path.cameraType);
+	camera.ResizeCamera(fov, width, height);
+	if (!path.empty()) {
+		CameraKey key = path.sample(parser.value(timeOption).toDouble());
+		camera.SetState(key.camera);
+		renderer.setModelRotation(key.modelXRot, key.modelYRot);
+	}
+	else if (parser.isSet(rotationOption)) {
+		QStringList angles = parser.value(rotationOption).split(',');
+		float xRot = DEG2RAD(angles[0].toFloat());
+		float yRot = angles.size() > 1 ? DEG2RAD(angles[1].toFloat()) : 0.0f;
+		renderer.setModelRotation(xRot, yRot);
+	}
+	renderer.setProjection(camera.GetProj(), camera.GetFov());
+	renderer.setView(camera.GetView());
+
+	// The first frame compiles the shaders in the driver, it is not timed
+	renderer.render(target->handle());
+	gl->glFinish();
+
+	// Timed frames: the queries are read right away, nothing else is in flight
+	GLuint queries[SSAORenderer::NUM_PASSES];
+	gl->glGenQueries(SSAORenderer::NUM_PASSES, queries);
+	std::vector<TimingSeries> times(2 + SSAORenderer::NUM_PASSES);
+	times[0].name = "frame";
+	times[1].name = "geometry_pass_cpu";
+	for (int pass = 0; pass < SSAORenderer::NUM_PASSES; ++pass)
+		times[2 + pass].name = std::string(SSAORenderer::passName(pass)) + "_gpu";
+	for (int f = 0; f < frames; ++f) {
+		// The camera does not move: without it, only the light and
+		// anti-aliasing passes would run
+		renderer.invalidate();
+		timer.restart();
+		renderer.render(target->handle(), queries);
+		gl->glFinish();
+		times[0].ms.push_back(timer.nsecsElapsed() / 1.0e6);
+		times[1].ms.push_back(renderer.geometryCpuNs() / 1.0e6);
+		for (int pass = 0; pass < SSAORenderer::NUM_PASSES; ++pass) {
+			GLuint64 ns = 0;
+			gl->glGetQueryObjectui64v(queries[pass], GL_QUERY_RESULT, &ns);
+			times[2 + pass].ms.push_back(ns / 1.0e6);
+		}
+	}
+	gl->glDeleteQueries(SSAORenderer::NUM_PASSES, queries);
+
+	// Write
+	timer.restart();
+	QString output = parser.value(outputOption);
+	bool written = target->toImage().save(output);
+	double writeTime = timer.nsecsElapsed() / 1.0e6;
+
+	renderer.cleanup();
+	delete target;
+	context.doneCurrent();
+
+	if (!written) {
+		std::cerr << "Cannot write image " << output.toStdString() << std::endl;
+		return 1;
+	}
+
+	std::cout << "Rendered " << model.toStdString() << " at " << width << "x" << height << ", "
+		<< frames << " frames" << std::endl;
+	if (renderer.occlusionCulling())
+		std::cout << "Occlusion culling: " << renderer.occlusionDrawn() << " drawn, " << renderer.occlusionCulled() << " culled" << std::endl;
+	std::cout << "Context: " << contextTime << " ms" << std::endl;
+	std::cout << "Load:    " << loadTime << " ms" << std::endl;
+	for (size_t s = 0; s < times.size(); ++s)
+		std::cout << times[s].name << ": p50 " << percentile(times[s].ms, 0.5) << " ms, max "
+			<< percentile(times[s].ms, 1.0) << " ms" << std::endl;
+	std::cout << "Write:   " << writeTime << " ms" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,1716 @@
+#include "ssaorenderer.h"
+
+#include <QImage>
+#include <QOpenGLContext>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+const char* SSAORenderer::passName(int pass)
+{
+	static const char* names[NUM_PASSES] = { "depth_pass", "geometry_pass", "ao_pass", "light_pass", "aa_pass" };
+	return names[pass];
+}
+
+const char* SSAORenderer::antialiasingName(int mode)
+{
+	static const char* names[NUM_ANTIALIASING] = { "none", "fxaa", "smaa" };
+	return names[mode];
+}
+
+int SSAORenderer::antialiasingMode(const QString &name)
+{
+	for (int mode = 0; mode < NUM_ANTIALIASING; ++mode)
+		if (name.compare(antialiasingName(mode), Qt::CaseInsensitive) == 0)
+			return mode;
+	return -1;
+}
+
+RenderSettings::RenderSettings()
+{
+	projection = glm::mat4(1.0f);
+	fov = PI / 3.0f;
+	view = glm::mat4(1.0f);
+	xRot = 0.0f;
+	yRot = 0.0f;
+
+	width = 500;
+	height = 500;
+	instanceCount = 0;
+	instancing = true;
+	lightCount = 0;
+	depthPrepass = false;
+	drawOverdraw = false;
+
+	background = Qt::green;
+	ssao = true;
+	drawOnlySSAO = false;
+	ssaoIntensity = 0.2f;
+	frustumCulling = true;
+	occlusionCulling = false;
+	antialiasing = SSAORenderer::AA_NONE;
+	highQualityAA = false;
+	forcedLOD = -1;
+	shaderGeneration = 0;
+}
+
+SSAORenderer::SSAORenderer(const QString &modelFilename)
+{
+	// Screen
+	m_width = 500;
+	m_height = 500;
+
+	// Camera
+	m_projection = glm::mat4(1.0f);
+	m_fov = PI / 3.0f;
+	m_xRot = 0.0f;
+	m_yRot = 0.0f;
+	m_frameUniforms.projTransform = glm::mat4(1.0f);
+	m_frameUniforms.viewTransform = glm::mat4(1.0f);
+
+	// Scene
+	m_sceneCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_sceneRadius = 50.0f;
+	m_bkgColor = Qt::green;
+	m_backFaceCulling = true;
+
+	// Model
+	m_modelLoaded = false;
+	m_mesh = nullptr;
+	m_modelCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_modelRadius = 0.0f;
+	m_modelBBoxMin = glm::vec3(0.0f);
+	m_modelBBoxMax = glm::vec3(0.0f);
+	m_modelFilename = modelFilename;
+	m_VAOModel = 0;
+	m_VAODepth = 0;
+	m_depthPrepass = false;
+	m_drawOverdraw = false;
+	m_normalMapTex = 0;
+	m_frustumCulling = true;
+	m_visibleSubMeshes = 0;
+	m_forcedLOD = -1;
+	m_currentLOD = -1;
+	m_instanceVBO = 0;
+	m_instancing = true;
+	m_visibleInstances = 0;
+	m_drawCalls = 0;
+	m_stressFrames = 0;
+	m_stressCpuNs = 0;
+	m_occlusionCulling = false;
+	m_visibilityLOD = -1;
+	m_depthTexture = 0;
+	m_occlusionDrawn = 0;
+	m_occlusionCulled = 0;
+	m_reportedDrawn = -1;
+	m_reportedCulled = -1;
+	m_antialiasing = AA_NONE;
+	m_highQualityAA = false;
+	m_geometryCpuNs = 0;
+	m_geometryDirty = true;
+	m_aoDirty = true;
+
+	// Lights
+	m_lightsDirty = true;
+	m_reportLights = false;
+	for (int i = 0; i < 3; ++i) {
+		m_lightBuffers[i] = 0;
+		m_lightTextures[i] = 0;
+	}
+
+	// SSAO
+	flag_ssao = true;
+	usingSSAO = true;
+	ssao_intensity = 0.2f;
+	drawSSAO = false;
+
+	// GL resources
+	m_shaderGeneration = 0;
+	quadVAO = 0;
+	gPass_program = nullptr;
+	ao_program = nullptr;
+	light_program = nullptr;
+	depth_program = nullptr;
+	hiz_program = nullptr;
+	fxaa_program = nullptr;
+	smaaEdges_program = nullptr;
+	smaaWeights_program = nullptr;
+	smaaBlend_program = nullptr;
+	g_fbo = nullptr;
+	ao_fbo = nullptr;
+	hiz_fbo = nullptr;
+	lit_fbo = nullptr;
+	smaaEdges_fbo = nullptr;
+	smaaWeights_fbo = nullptr;
+}
+
+bool SSAORenderer::initialize(int width, int height)
+{
+	initializeOpenGLFunctions();
+	m_width = width;
+	m_height = height;
+
+	m_uniforms.initializeGL();
+	loadShaders();
+
+	createBuffersQuad();
+	createGBuffers();
+	createLightBuffers();
+
+	gPass_program->bind();
+
+	createBuffersModel();
+	computeBBoxModel();
+	computeCenterRadiusScene();
+	if (!m_normalMapFilename.isEmpty())
+		loadNormalMap();
+
+	setLighting();
+	return m_modelLoaded;
+}
+
+void SSAORenderer::cleanup()
+{
+	if (m_modelLoaded)
+		cleanBuffersModel();
+
+	delete gPass_program;
+	gPass_program = nullptr;
+	delete ao_program;
+	ao_program = nullptr;
+	delete light_program;
+	light_program = nullptr;
+	delete depth_program;
+	depth_program = nullptr;
+	delete hiz_program;
+	hiz_program = nullptr;
+	delete fxaa_program;
+	fxaa_program = nullptr;
+	delete smaaEdges_program;
+	smaaEdges_program = nullptr;
+	delete smaaWeights_program;
+	smaaWeights_program = nullptr;
+	delete smaaBlend_program;
+	smaaBlend_program = nullptr;
+
+	// Buffers and textures stay in the shared cache for the next widget, only
+	// the objects of this context are released
+	if (QOpenGLContext::currentContext())
+		GLResourceCache::instance().releaseFramebuffers(QOpenGLContext::currentContext());
+	g_fbo = nullptr;
+	ao_fbo = nullptr;
+	hiz_fbo = nullptr;
+	lit_fbo = nullptr;
+	smaaEdges_fbo = nullptr;
+	smaaWeights_fbo = nullptr;
+	m_geometryDirty = true;
+
+	if (m_depthTexture) {
+		glDeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+	}
+
+	m_uniforms.cleanup();
+
+	if (m_lightBuffers[0]) {
+		glDeleteTextures(3, m_lightTextures);
+		glDeleteBuffers(3, m_lightBuffers);
+		for (int i = 0; i < 3; ++i) {
+			m_lightBuffers[i] = 0;
+			m_lightTextures[i] = 0;
+		}
+	}
+	m_lightsDirty = true;
+
+	if (quadVAO) {
+		glDeleteVertexArrays(1, &quadVAO);
+		quadVAO = 0;
+	}
+}
+
+bool SSAORenderer::loadShaders()
+{
+	// The programs are requested together, so the driver can compile them in
+	// parallel. On a reload they keep the attribute locations of the VAOs, and
+	// the current ones are kept if a new one does not link.
+	QList<ShaderFiles> files;
+	files << ShaderFiles("./shaders/gbuffer.vert", "./shaders/gbuffer.frag")
+		<< ShaderFiles("./shaders/light.vert", "./shaders/ssao.frag")
+		<< ShaderFiles("./shaders/light.vert", "./shaders/light.frag")
+		<< ShaderFiles("./shaders/depth.vert", "./shaders/depth.frag")
+		<< ShaderFiles("./shaders/light.vert", "./shaders/hiz.frag")
+		<< ShaderFiles("./shaders/light.vert", "./shaders/fxaa.frag")
+		<< ShaderFiles("./shaders/light.vert", "./shaders/smaaedges.frag")
+		<< ShaderFiles("./shaders/light.vert", "./shaders/smaaweights.frag")
+		<< ShaderFiles("./shaders/light.vert", "./shaders/smaablend.frag");
+	QList<QOpenGLShaderProgram*> previous;
+	previous << gPass_program << ao_program << light_program << depth_program << hiz_program
+		<< fxaa_program << smaaEdges_program << smaaWeights_program << smaaBlend_program;
+
+	QList<QOpenGLShaderProgram*> programs = ShaderLibrary::instance().programs(files, previous);
+	if (gPass_program != nullptr) {
+		for (int p = 0; p < programs.size(); ++p) {
+			if (!programs[p]->isLinked()) {
+				qDeleteAll(programs);
+				return false;
+			}
+		}
+	}
+
+	delete gPass_program;
+	delete ao_program;
+	delete light_program;
+	delete depth_program;
+	delete hiz_program;
+	delete fxaa_program;
+	delete smaaEdges_program;
+	delete smaaWeights_program;
+	delete smaaBlend_program;
+	gPass_program = programs[0];
+	ao_program = programs[1];
+	light_program = programs[2];
+	depth_program = programs[3];
+	hiz_program = programs[4];
+	fxaa_program = programs[5];
+	smaaEdges_program = programs[6];
+	smaaWeights_program = programs[7];
+	smaaBlend_program = programs[8];
+
+	loadDepthShader();
+	loadGShader();
+	loadAOShader();
+	loadLightShader();
+	loadHiZShader();
+	loadAAShaders();
+	m_geometryDirty = true;
+	return true;
+}
+
+bool SSAORenderer::reloadShaders()
+{
+	// The new programs start with default uniforms, the next frame sends them
+	return loadShaders();
+}
+
+void SSAORenderer::loadDepthShader()
+{
+	depth_program->bind();
+
+	dp_aPos = glGetAttribLocation(depth_program->programId(), "aPos");
+	dp_aInstanceModel = glGetAttribLocation(depth_program->programId(), "instanceModel");
+	dp_instanced = glGetUniformLocation(depth_program->programId(), "instanced");
+	dp_quantized = glGetUniformLocation(depth_program->programId(), "quantized");
+	dp_positionBoxes = glGetUniformLocation(depth_program->programId(), "positionBoxes");
+	glUniform1i(dp_positionBoxes, 14);
+	m_uniforms.bindBlocks(depth_program->programId());
+}
+
+void SSAORenderer::loadGShader()
+{
+	// Bind the program (we are gonna use this program)
+	gPass_program->bind();
+
+	// Get the attribs locations of the vertex shader
+	gp_aPos = glGetAttribLocation(gPass_program->programId(), "aPos");
+	gp_aNormal = glGetAttribLocation(gPass_program->programId(), "aNormal");
+	gp_aTexCoords = glGetAttribLocation(gPass_program->programId(), "aTexCoords");
+	gp_aTangent = glGetAttribLocation(gPass_program->programId(), "aTangent");
+	m_uniforms.bindBlocks(gPass_program->programId());
+	gp_aInstanceModel = glGetAttribLocation(gPass_program->programId(), "instanceModel");
+	gp_aInstanceDiffuse = glGetAttribLocation(gPass_program->programId(), "instanceDiffuse");
+	gp_instanced = glGetUniformLocation(gPass_program->programId(), "instanced");
+	gp_diffuseOverride = glGetUniformLocation(gPass_program->programId(), "diffuseOverride");
+	gp_quantized = glGetUniformLocation(gPass_program->programId(), "quantized");
+	gp_positionBoxes = glGetUniformLocation(gPass_program->programId(), "positionBoxes");
+	glUniform1i(gp_positionBoxes, 14);
+	gp_normalMapped = glGetUniformLocation(gPass_program->programId(), "normalMapped");
+	gp_normalMap = glGetUniformLocation(gPass_program->programId(), "normalMap");
+	glUniform1i(gp_normalMap, 15);
+
+	m_matAmbLoc = glGetAttribLocation(gPass_program->programId(), "matamb");
+	m_matDiffLoc = glGetAttribLocation(gPass_program->programId(), "matdiff");
+	m_matSpecLoc = glGetAttribLocation(gPass_program->programId(), "matspec");
+	m_matShinLoc = glGetAttribLocation(gPass_program->programId(), "matshin");
+}
+
+void SSAORenderer::loadAOShader()
+{
+	ao_program->bind();
+
+	gPositionTex = glGetUniformLocation(ao_program->programId(), "gPosition");
+	gNormalTex = glGetUniformLocation(ao_program->programId(), "gNormal");
+	ao_projection = glGetUniformLocation(ao_program->programId(), "projection");
+
+	ao_screenWidth = glGetUniformLocation(ao_program->programId(), "screenWidth");
+	ao_screenHeight = glGetUniformLocation(ao_program->programId(), "screenHeight");
+	GLuint tileSize = glGetUniformLocation(ao_program->programId(), "tileSize");
+	GLuint samples = glGetUniformLocation(ao_program->programId(), "samples");
+	texNoise = glGetUniformLocation(ao_program->programId(), "texNoise");
+
+	glUniform1f(ao_screenWidth, m_width);
+	glUniform1f(ao_screenHeight, m_height);
+
+	glUniform1f(tileSize, 4.0);
+
+	if (ssaoKernel.empty())
+		createSSAOKernels();
+	glUniform3fv(samples, 64, &ssaoKernel[0][0]);
+
+	// Noise Texture, shared by every renderer
+	noiseTexture = GLResourceCache::instance().texture("ssao.noise");
+	if (noiseTexture == 0) {
+		glGenTextures(1, &noiseTexture);
+		glBindTexture(GL_TEXTURE_2D, noiseTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 4, 4, 0, GL_RGB, GL_FLOAT, &ssaoNoise[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		GLResourceCache::instance().addTexture("ssao.noise", noiseTexture);
+	}
+}
+
+void SSAORenderer::loadLightShader()
+{
+	// Bind the program (we are gonna use this program)
+	light_program->bind();
+
+	// Get the attribs locations of the vertex shader
+	light_vertex = glGetAttribLocation(light_program->programId(), "vertex");
+	light_texcoords = glGetAttribLocation(light_program->programId(), "vertTexCoords");
+
+	light_gPosition = glGetUniformLocation(light_program->programId(), "gPosition");
+	light_gNormal = glGetUniformLocation(light_program->programId(), "gNormal");
+	gAlbedo = glGetUniformLocation(light_program->programId(), "gAlbedoSpec");
+	light_gSpecular = glGetUniformLocation(light_program->programId(), "gSpecular");
+	light_ssao = glGetUniformLocation(light_program->programId(), "ssao");
+
+	light_lights = glGetUniformLocation(light_program->programId(), "lights");
+	light_tiles = glGetUniformLocation(light_program->programId(), "lightTiles");
+	light_indices = glGetUniformLocation(light_program->programId(), "lightIndices");
+	light_tileSize = glGetUniformLocation(light_program->programId(), "tileSize");
+	light_tilesX = glGetUniformLocation(light_program->programId(), "tilesX");
+	light_gOverdraw = glGetUniformLocation(light_program->programId(), "gOverdraw");
+	light_drawOverdraw = glGetUniformLocation(light_program->programId(), "drawOverdraw");
+
+	useSSAO = glGetUniformLocation(light_program->programId(), "useSSAO");
+	drawSSAOLoc = glGetUniformLocation(light_program->programId(), "drawSSAO");
+	ssaoIntensityLoc = glGetUniformLocation(light_program->programId(), "ssaoIntensity");
+	flag_ssao = true; // sent by the next light pass
+}
+
+void SSAORenderer::loadHiZShader()
+{
+	hiz_program->bind();
+
+	hiz_depth = glGetUniformLocation(hiz_program->programId(), "depth");
+	hiz_texelSize = glGetUniformLocation(hiz_program->programId(), "texelSize");
+}
+
+void SSAORenderer::loadAAShaders()
+{
+	fxaa_image = glGetUniformLocation(fxaa_program->programId(), "image");
+	fxaa_edgeThreshold = glGetUniformLocation(fxaa_program->programId(), "edgeThreshold");
+	fxaa_searchSteps = glGetUniformLocation(fxaa_program->programId(), "searchSteps");
+
+	smaaEdges_image = glGetUniformLocation(smaaEdges_program->programId(), "image");
+	smaaEdges_threshold = glGetUniformLocation(smaaEdges_program->programId(), "threshold");
+
+	smaaWeights_edges = glGetUniformLocation(smaaWeights_program->programId(), "edges");
+	smaaWeights_searchSteps = glGetUniformLocation(smaaWeights_program->programId(), "searchSteps");
+
+	smaaBlend_image = glGetUniformLocation(smaaBlend_program->programId(), "image");
+	smaaBlend_weights = glGetUniformLocation(smaaBlend_program->programId(), "weights");
+}
+
+void SSAORenderer::resize(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+
+	// The G-buffer follows the size of the target
+	createGBuffers();
+
+	ao_program->bind();
+	glUniform1f(ao_screenWidth, m_width);
+	glUniform1f(ao_screenHeight, m_height);
+}
+
+bool SSAORenderer::setModel(const QString &modelFilename)
+{
+	m_modelFilename = modelFilename;
+	m_currentLOD = -1;
+	m_instances.clear(); // the stress tests are sized for the previous model
+	m_wasVisible.clear();
+	m_lights.clear();
+	m_lightsDirty = true;
+
+	// Not initialized yet: initialize will load it
+	if (!gPass_program)
+		return false;
+
+	if (m_modelLoaded)
+		cleanBuffersModel();
+
+	// Shaders, G-buffer, quad and noise texture are kept, only the model changes
+	gPass_program->bind();
+	createBuffersModel();
+	computeBBoxModel();
+	computeCenterRadiusScene();
+
+	m_xRot = 0.0f;
+	m_yRot = 0.0f;
+	m_geometryDirty = true;
+	return m_modelLoaded;
+}
+
+bool SSAORenderer::apply(const RenderSettings &settings)
+{
+	bool sceneChanged = false;
+	if (settings.width != m_width || settings.height != m_height)
+		resize(settings.width, settings.height);
+	if (settings.modelFilename != m_modelFilename) {
+		setModel(settings.modelFilename);
+		sceneChanged = true;
+	}
+	if (m_modelLoaded && settings.instanceCount != instanceCount()) {
+		setInstanceCount(settings.instanceCount);
+		sceneChanged = true;
+	}
+	if (m_modelLoaded && settings.lightCount != lightCount())
+		setLightCount(settings.lightCount);
+	if (settings.shaderGeneration != m_shaderGeneration) {
+		m_shaderGeneration = settings.shaderGeneration;
+		reloadShaders();
+	}
+
+	// The setters only mark the passes dirty if a value changed
+	setProjection(settings.projection, settings.fov);
+	setView(settings.view);
+	setModelRotation(settings.xRot, settings.yRot);
+	if (settings.background != m_bkgColor)
+		setBackgroundColor(settings.background);
+	if (settings.frustumCulling != m_frustumCulling)
+		setFrustumCulling(settings.frustumCulling);
+	if (settings.occlusionCulling != m_occlusionCulling)
+		setOcclusionCulling(settings.occlusionCulling);
+	if (settings.antialiasing != m_antialiasing)
+		setAntialiasing(settings.antialiasing);
+	if (settings.highQualityAA != m_highQualityAA)
+		setHighQualityAA(settings.highQualityAA);
+	if (settings.forcedLOD != m_forcedLOD)
+		setForcedLOD(settings.forcedLOD);
+	if (settings.normalMapFilename != m_normalMapFilename)
+		setNormalMap(settings.normalMapFilename);
+	if (settings.instancing != m_instancing)
+		setInstancing(settings.instancing);
+	if (settings.depthPrepass != m_depthPrepass)
+		setDepthPrepass(settings.depthPrepass);
+	if (settings.drawOverdraw != m_drawOverdraw)
+		setDrawOverdraw(settings.drawOverdraw);
+	if (settings.ssao != usingSSAO)
+		setSSAO(settings.ssao);
+	if (settings.drawOnlySSAO != drawSSAO)
+		setDrawOnlySSAO(settings.drawOnlySSAO);
+	if (settings.ssaoIntensity != ssao_intensity)
+		setSSAOIntensity(settings.ssaoIntensity);
+	return sceneChanged;
+}
+
+void SSAORenderer::setDrawOverdraw(bool active)
+{
+	m_drawOverdraw = active;
+
+	// The counts need their own attachment
+	if (g_fbo)
+		createGBuffers();
+	m_geometryDirty = true;
+}
+
+void SSAORenderer::setOcclusionCulling(bool active)
+{
+	m_occlusionCulling = active;
+
+	// The last frame without it tells nothing: everything is drawn first
+	m_wasVisible.clear();
+	m_reportedDrawn = -1;
+	m_reportedCulled = -1;
+	m_geometryDirty = true;
+}
+
+void SSAORenderer::setAntialiasing(int mode)
+{
+	m_antialiasing = mode;
+
+	// The light pass needs its intermediate image
+	if (g_fbo)
+		createAABuffers();
+}
+
+void SSAORenderer::setNormalMap(const QString &filename)
+{
+	m_normalMapFilename = filename;
+	m_normalMapTex = 0;
+	m_geometryDirty = true;
+
+	// Not initialized yet: initialize will load it
+	if (!gPass_program || filename.isEmpty())
+		return;
+	loadNormalMap();
+}
+
+void SSAORenderer::loadNormalMap()
+{
+	// Shared by every renderer, as the noise texture
+	QString key = "normalmap:" + m_normalMapFilename;
+	m_normalMapTex = GLResourceCache::instance().texture(key);
+	if (m_normalMapTex != 0)
+		return;
+
+	QImage image(m_normalMapFilename);
+	if (image.isNull()) {
+		std::cerr << "-- AGEn message --: Cannot load normal map " << m_normalMapFilename.toStdString() << std::endl;
+		return;
+	}
+	image = image.mirrored().convertToFormat(QImage::Format_RGBA8888);
+
+	// Linear, not sRGB: the texels are directions
+	glGenTextures(1, &m_normalMapTex);
+	glBindTexture(GL_TEXTURE_2D, m_normalMapTex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width(), image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	GLResourceCache::instance().addTexture(key, m_normalMapTex);
+
+	if (m_modelLoaded && !m_mesh->vboTangents)
+		std::cout << "-- AGEn message --: The model has no texture coordinates, the normal map is not applied" << std::endl;
+}
+
+void SSAORenderer::setProjection(const glm::mat4 &projection, float fov)
+{
+	// Sent with the next frame
+	if (projection == m_projection && fov == m_fov)
+		return;
+	m_projection = projection;
+	m_fov = fov;
+	m_frameUniforms.projTransform = projection;
+	m_geometryDirty = true;
+}
+
+void SSAORenderer::setView(const glm::mat4 &view)
+{
+	if (view == m_frameUniforms.viewTransform)
+		return;
+	m_frameUniforms.viewTransform = view;
+	m_geometryDirty = true;
+}
+
+void SSAORenderer::setModelRotation(float xRot, float yRot)
+{
+	if (xRot == m_xRot && yRot == m_yRot)
+		return;
+	m_xRot = xRot;
+	m_yRot = yRot;
+	m_geometryDirty = true;
+}
+
+int SSAORenderer::subMeshCount() const
+{
+	return m_modelLoaded ? (int)m_mesh->model->subMeshes().size() : 0;
+}
+
+int SSAORenderer::lodCount() const
+{
+	return m_modelLoaded ? (int)m_mesh->model->lods().size() : 0;
+}
+
+void SSAORenderer::computeCenterRadiusScene()
+{
+	m_sceneCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	// In this case, we just load one model
+	m_sceneRadius = m_modelRadius;
+}
+
+void SSAORenderer::createBuffersModel()
+{
+	// Load the OBJ model and upload its buffers, unless it was already loaded
+	m_mesh = GLResourceCache::instance().mesh(m_modelFilename);
+	if (!m_mesh)
+		return;
+
+	// VAO creation (VAOs are not shared between contexts)
+	glGenVertexArrays(1, &m_VAOModel);
+	glBindVertexArray(m_VAOModel);
+
+	// Formats of the vertex buffers (see GLMesh). The quantized normals are
+	// fetched as integers and decoded by the shader.
+	bool quantized = m_mesh->quantized;
+	GLint posSize = quantized ? 4 : 3, normSize = quantized ? 2 : 3, matSize = quantized ? 4 : 3;
+	GLenum posType = quantized ? GL_UNSIGNED_SHORT : GL_FLOAT;
+	GLenum normType = quantized ? GL_SHORT : GL_FLOAT;
+	GLenum texType = quantized ? GL_HALF_FLOAT : GL_FLOAT;
+	GLenum matType = quantized ? GL_UNSIGNED_BYTE : GL_FLOAT;
+	GLenum shinType = quantized ? GL_HALF_FLOAT : GL_FLOAT;
+	GLboolean normalized = quantized ? GL_TRUE : GL_FALSE;
+
+	// VBO Vertices
+	glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboVerts);
+
+	// Enable the attribute m_vertexLoc
+	glVertexAttribPointer(gp_aPos, posSize, posType, normalized, 0, 0);
+	glEnableVertexAttribArray(gp_aPos);
+
+	// VBO Normals
+	glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboNorms);
+
+	// Enable the attribute m_normalLoc
+	glVertexAttribPointer(gp_aNormal, normSize, normType, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(gp_aNormal);
+
+	// VBO Texture coordinates, if the model has them
+	if (m_mesh->vboTexCoords) {
+		glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboTexCoords);
+		glVertexAttribPointer(gp_aTexCoords, 2, texType, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(gp_aTexCoords);
+	}
+
+	// VBO Tangents, if it has texture coordinates. The quantized ones are
+	// octahedral too, with the handedness in z.
+	if (m_mesh->vboTangents) {
+		glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboTangents);
+		glVertexAttribPointer(gp_aTangent, 4, normType, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(gp_aTangent);
+	}
+
+	// Instead of colors, we pass the materials
+	// VBO Ambient component
+	glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboMatAmb);
+
+	// Enable the attribute m_matAmbLoc
+	glVertexAttribPointer(m_matAmbLoc, matSize, matType, normalized, 0, 0);
+	glEnableVertexAttribArray(m_matAmbLoc);
+
+	// VBO Diffuse component
+	glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboMatDiff);
+
+	// Enable the attribute m_matDiffLoc
+	glVertexAttribPointer(m_matDiffLoc, matSize, matType, normalized, 0, 0);
+	glEnableVertexAttribArray(m_matDiffLoc);
+
+	// VBO Specular component
+	glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboMatSpec);
+
+	// Enable the attribute m_matSpecLoc
+	glVertexAttribPointer(m_matSpecLoc, matSize, matType, normalized, 0, 0);
+	glEnableVertexAttribArray(m_matSpecLoc);
+
+	// VBO Shininess component
+	glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboMatShin);
+
+	// Enable the attribute m_matShinLoc
+	glVertexAttribPointer(m_matShinLoc, 1, shinType, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(m_matShinLoc);
+
+	// Index buffer, part of the VAO state
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_mesh->ibo);
+
+	// Instance buffer of the stress test (one matrix and one color each),
+	// filled every frame with the visible instances
+	glGenBuffers(1, &m_instanceVBO);
+	setInstanceAttributes(0, gp_aInstanceModel, gp_aInstanceDiffuse);
+	for (int c = 0; c < 4; ++c) {
+		glEnableVertexAttribArray(gp_aInstanceModel + c);
+		glVertexAttribDivisor(gp_aInstanceModel + c, 1);
+	}
+	glEnableVertexAttribArray(gp_aInstanceDiffuse);
+	glVertexAttribDivisor(gp_aInstanceDiffuse, 1);
+
+	// Depth pre-pass: only the positions (and the instance matrices) are
+	// fetched, from the same buffers
+	glGenVertexArrays(1, &m_VAODepth);
+	glBindVertexArray(m_VAODepth);
+	glBindBuffer(GL_ARRAY_BUFFER, m_mesh->vboVerts);
+	glVertexAttribPointer(dp_aPos, posSize, posType, normalized, 0, 0);
+	glEnableVertexAttribArray(dp_aPos);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_mesh->ibo);
+	setInstanceAttributes(0, dp_aInstanceModel, -1);
+	for (int c = 0; c < 4; ++c) {
+		glEnableVertexAttribArray(dp_aInstanceModel + c);
+		glVertexAttribDivisor(dp_aInstanceModel + c, 1);
+	}
+
+	glBindVertexArray(0);
+
+	// The model has been loaded
+	m_modelLoaded = true;
+}
+
+void SSAORenderer::cleanBuffersModel()
+{
+	// The buffers belong to the cache, other widgets may be using them
+	glDeleteVertexArrays(1, &m_VAOModel);
+	glDeleteVertexArrays(1, &m_VAODepth);
+	glDeleteBuffers(1, &m_instanceVBO);
+	m_VAOModel = 0;
+	m_VAODepth = 0;
+	m_instanceVBO = 0;
+
+	m_modelLoaded = false;
+}
+
+void SSAORenderer::computeBBoxModel()
+{
+	if (!m_mesh)
+		return;
+
+	const std::vector<Vertex> &vertices = m_mesh->model->vertices();
+	float minX, minY, minZ;
+	float maxX, maxY, maxZ;
+
+	minX = maxX = vertices[0];
+	minY = maxY = vertices[1];
+	minZ = maxZ = vertices[2];
+
+	for (size_t i = 3; i < vertices.size(); i += 3)
+	{
+		if (vertices[i + 0] < minX)
+			minX = vertices[i + 0];
+		if (vertices[i + 0] > maxX)
+			maxX = vertices[i + 0];
+		if (vertices[i + 1] < minY)
+			minY = vertices[i + 1];
+		if (vertices[i + 1] > maxY)
+			maxY = vertices[i + 1];
+		if (vertices[i + 2] < minZ)
+			minZ = vertices[i + 2];
+		if (vertices[i + 2] > maxZ)
+			maxZ = vertices[i + 2];
+	}
+
+	m_modelBBoxMin = glm::vec3(minX, minY, minZ);
+	m_modelBBoxMax = glm::vec3(maxX, maxY, maxZ);
+	m_modelCenter = glm::vec3((maxX + minX) / 2.0f, (maxY + minY) / 2.0f, (maxZ + minZ) / 2.0f);
+	glm::vec3 radiusModel(maxX - m_modelCenter.x, maxY - m_modelCenter.y, maxZ - m_modelCenter.z);
+	m_modelRadius = sqrt(radiusModel.x*radiusModel.x + radiusModel.y*radiusModel.y + radiusModel.z*radiusModel.z);
+}
+
+glm::mat4 SSAORenderer::modelTransform()
+{
+	glm::mat4 geomTransform(1.0f);
+
+	geomTransform = glm::translate(geomTransform, m_sceneCenter);
+	geomTransform = glm::rotate(geomTransform, m_xRot, glm::vec3(1.0f, 0.0f, 0.0f));
+	geomTransform = glm::rotate(geomTransform, m_yRot, glm::vec3(0.0f, 1.0f, 0.0f));
+	geomTransform = glm::translate(geomTransform, -m_modelCenter);
+	return geomTransform;
+}
+
+int SSAORenderer::lodLevel(const glm::mat4 &model) const
+{
+	if (m_forcedLOD >= 0)
+		return std::min(m_forcedLOD, (int)m_mesh->model->lods().size() - 1);
+
+	// Error allowed at the nearest point of the model, in model units
+	glm::vec4 center = m_frameUniforms.viewTransform * model * glm::vec4(m_modelCenter, 1.0f);
+	float distance = std::max(glm::length(glm::vec3(center)) - m_modelRadius, 1e-3f * m_modelRadius);
+	float pixelsPerUnit = m_height / (2.0f * std::tan(m_fov / 2.0f) * distance);
+	return m_mesh->model->selectLOD(LOD_PIXEL_ERROR / pixelsPerUnit);
+}
+
+int SSAORenderer::selectLOD(const glm::mat4 &model)
+{
+	const std::vector<LODLevel> &lods = m_mesh->model->lods();
+	int level = lodLevel(model);
+
+	if (level != m_currentLOD) {
+		m_currentLOD = level;
+		std::cout << "-- AGEn message --: LOD " << level << " (" << lods[level].faceCount
+			<< " faces, error " << lods[level].error << ")" << std::endl;
+	}
+	return level;
+}
+
+void SSAORenderer::render(GLuint target, const GLuint *timerQueries)
+{
+	m_cpuTimer.start();
+
+	// The tiles follow the camera and the lights
+	if (m_geometryDirty || m_lightsDirty)
+		updateLights();
+
+	// The G-buffer and the AO texture are kept while their inputs do not change.
+	// Both geometry passes draw the same culled submeshes and instances.
+	m_uniforms.beginFrame();
+	bool geometry = m_geometryDirty;
+	if (geometry)
+		cullScene();
+
+	// The occlusion culling runs after the first phase of the first geometry
+	// pass, its Hi-Z pass is timed with it
+	bool occlusion = geometry && m_occlusionCulling && m_modelLoaded;
+
+	if (timerQueries)
+		glBeginQuery(GL_TIME_ELAPSED, timerQueries[DEPTH_PASS]);
+	if (geometry && m_depthPrepass) {
+		DepthPass(0);
+		if (occlusion) {
+			occlusionCull();
+			DepthPass(1);
+		}
+	}
+	if (timerQueries)
+		glEndQuery(GL_TIME_ELAPSED);
+
+	if (timerQueries)
+		glBeginQuery(GL_TIME_ELAPSED, timerQueries[GEOMETRY_PASS]);
+	if (geometry) {
+		if (m_depthPrepass) {
+			GeometryPass(0, 1);
+		}
+		else {
+			GeometryPass(0, 0);
+			if (occlusion) {
+				occlusionCull();
+				GeometryPass(1, 1);
+			}
+		}
+		m_geometryDirty = false;
+		m_aoDirty = true;
+	}
+	if (timerQueries)
+		glEndQuery(GL_TIME_ELAPSED);
+
+	m_geometryCpuNs = m_cpuTimer.nsecsElapsed();
+
+	if (timerQueries)
+		glBeginQuery(GL_TIME_ELAPSED, timerQueries[AO_PASS]);
+	if (m_aoDirty && (usingSSAO || drawSSAO)) {
+		AOPass();
+		m_aoDirty = false;
+	}
+	if (timerQueries)
+		glEndQuery(GL_TIME_ELAPSED);
+
+	// With anti-aliasing, the light pass lights the intermediate image
+	bool antialiasing = m_antialiasing != AA_NONE;
+	if (timerQueries)
+		glBeginQuery(GL_TIME_ELAPSED, timerQueries[LIGHT_PASS]);
+	LightPass(antialiasing ? lit_fbo->handle() : target);
+	if (timerQueries)
+		glEndQuery(GL_TIME_ELAPSED);
+
+	if (timerQueries)
+		glBeginQuery(GL_TIME_ELAPSED, timerQueries[AA_PASS]);
+	if (antialiasing)
+		AAPass(target);
+	if (timerQueries)
+		glEndQuery(GL_TIME_ELAPSED);
+	m_uniforms.endFrame();
+
+	// The stress test reports once per second
+	if (!m_instances.empty()) {
+		++m_stressFrames;
+		m_stressCpuNs += m_geometryCpuNs;
+		if (m_stressTimer.elapsed() >= 1000) {
+			std::cout << "-- AGEn message --: " << m_instances.size() << " instances (" << m_visibleInstances
+				<< " visible";
+			if (m_occlusionCulling)
+				std::cout << ", " << m_occlusionCulled << " occluded";
+			std::cout << "), " << m_drawCalls << " draw calls, " << m_stressFrames * 1000.0f / m_stressTimer.elapsed()
+				<< " fps, geometry pass CPU " << m_stressCpuNs / 1.0e6 / m_stressFrames << " ms" << std::endl;
+			m_stressTimer.restart();
+			m_stressFrames = 0;
+			m_stressCpuNs = 0;
+		}
+	}
+}
+
+void SSAORenderer::DepthPass(int phase)
+{
+	// Depth only: the fragment shader is empty and the vertices only have
+	// their positions
+	g_fbo->bind();
+	glViewport(0, 0, m_width, m_height);
+	glDrawBuffer(GL_NONE);
+	if (phase == 0)
+		glClear(GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+
+	if (m_backFaceCulling)
+		glEnable(GL_CULL_FACE);
+
+	depth_program->bind();
+	m_uniforms.bindFrame(m_frameUniforms);
+	bool quantized = m_modelLoaded && m_mesh->quantized;
+	glUniform1i(dp_quantized, quantized);
+	if (quantized) {
+		glActiveTexture(GL_TEXTURE14);
+		glBindTexture(GL_TEXTURE_BUFFER, m_mesh->boxTexture);
+	}
+
+	glBindVertexArray(m_VAODepth);
+	drawScene(m_drawLists[phase], dp_aInstanceModel, -1, dp_instanced, -1);
+	glBindVertexArray(0);
+}
+
+void SSAORenderer::GeometryPass(int firstPhase, int lastPhase)
+{
+	g_fbo->bind();
+	glViewport(0, 0, m_width, m_height);
+	GLenum bufs[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
+	glDrawBuffers(m_drawOverdraw ? 5 : 4, bufs);
+
+	// Paint the scene. Without geometry, the albedo is the background and the
+	// specular alpha is 0, so the light pass leaves the pixel unlit. The
+	// second phase of the occlusion culling draws over the first one.
+	if (firstPhase == 0) {
+		GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		GLfloat background[] = { m_bkgColor.red() / 255.0f, m_bkgColor.green() / 255.0f, m_bkgColor.blue() / 255.0f, 1.0f };
+		glClearBufferfv(GL_COLOR, 0, zero);
+		glClearBufferfv(GL_COLOR, 1, zero);
+		glClearBufferfv(GL_COLOR, 2, background);
+		glClearBufferfv(GL_COLOR, 3, zero);
+		if (m_drawOverdraw)
+			glClearBufferfv(GL_COLOR, 4, zero);
+	}
+	glEnable(GL_DEPTH_TEST);
+
+	// After the pre-pass, only the nearest fragment of every pixel passes
+	// (both vertex shaders compute an invariant gl_Position)
+	if (m_depthPrepass) {
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	else if (firstPhase == 0) {
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	// Every shaded fragment adds 1 to the overdraw attachment
+	if (m_drawOverdraw) {
+		glBlendFunc(GL_ONE, GL_ONE);
+		glEnablei(GL_BLEND, 4);
+	}
+
+	if (m_backFaceCulling)
+		glEnable(GL_CULL_FACE);
+
+	gPass_program->bind();
+	m_uniforms.bindFrame(m_frameUniforms);
+	bool quantized = m_modelLoaded && m_mesh->quantized;
+	glUniform1i(gp_quantized, quantized);
+	if (quantized) {
+		glActiveTexture(GL_TEXTURE14);
+		glBindTexture(GL_TEXTURE_BUFFER, m_mesh->boxTexture);
+	}
+	bool normalMapped = m_modelLoaded && m_normalMapTex && m_mesh->vboTangents;
+	glUniform1i(gp_normalMapped, normalMapped);
+	if (normalMapped) {
+		glActiveTexture(GL_TEXTURE15);
+		glBindTexture(GL_TEXTURE_2D, m_normalMapTex);
+	}
+
+	// Bind the VAO to draw the model
+	glBindVertexArray(m_VAOModel);
+	for (int phase = firstPhase; phase <= lastPhase; ++phase)
+		drawScene(m_drawLists[phase], gp_aInstanceModel, gp_aInstanceDiffuse, gp_instanced, gp_diffuseOverride);
+
+	// Unbind the vertex array
+	glBindVertexArray(0);
+
+	glDisablei(GL_BLEND, 4);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+void SSAORenderer::cullScene()
+{
+	// Apply the geometric transforms to the model (position/orientation)
+	m_sceneTransform = modelTransform();
+	m_drawCalls = 0;
+	m_drawLists[0].clear();
+	m_drawLists[1].clear();
+	m_candidates.clear();
+	if (!m_modelLoaded)
+		return;
+
+	if (!m_instances.empty()) {
+		cullInstances();
+		return;
+	}
+
+	int level = selectLOD(m_sceneTransform);
+	const LODLevel &lod = m_mesh->model->lods()[level];
+	if (!m_frustumCulling && !m_occlusionCulling) {
+		m_visibleSubMeshes = (int)lod.subMeshes.size();
+		DrawList &list = m_drawLists[0];
+		list.first.assign(1, lod.firstFace * 3);
+		list.count.assign(1, lod.faceCount * 3);
+		list.offsets.assign(1, (const GLvoid*)(sizeof(GLuint) * lod.firstFace * 3));
+		return;
+	}
+
+	// Submeshes of the model inside the view frustum
+	Frustum frustum(m_projection * m_frameUniforms.viewTransform * m_sceneTransform);
+	for (size_t s = 0; s < lod.subMeshes.size(); ++s) {
+		if (!m_frustumCulling || frustum.subMeshVisible(lod.subMeshes[s]))
+			m_candidates.push_back((int)s);
+	}
+	m_visibleSubMeshes = (int)m_candidates.size();
+
+	// First phase of the occlusion culling: the ones visible in the last frame
+	if (m_occlusionCulling && (m_visibilityLOD != level || m_wasVisible.size() != lod.subMeshes.size())) {
+		m_wasVisible.assign(lod.subMeshes.size(), 1);
+		m_visibilityLOD = level;
+	}
+	for (size_t c = 0; c < m_candidates.size(); ++c) {
+		if (!m_occlusionCulling || m_wasVisible[m_candidates[c]])
+			m_drawLists[0].addSubMesh(lod.subMeshes[m_candidates[c]]);
+	}
+}
+
+void SSAORenderer::occlusionCull()
+{
+	HiZPass();
+
+	// Every object in the frustum is tested. The ones drawn in the first phase
+	// only keep the result for the next frame, the others are drawn now.
+	DrawList &list = m_drawLists[1];
+	glm::mat4 viewProjection = m_projection * m_frameUniforms.viewTransform;
+	m_occlusionDrawn = 0;
+	for (size_t c = 0; c < m_candidates.size(); ++c) {
+		int object = m_candidates[c];
+		bool visible;
+		if (!m_instances.empty()) {
+			glm::mat4 transform = m_instances[object].transform * m_sceneTransform;
+			visible = m_hiZ.boxVisible(viewProjection * transform, m_modelBBoxMin, m_modelBBoxMax);
+			if (visible && !m_wasVisible[object])
+				list.lodInstances[lodLevel(transform)].push_back(m_instances[object]);
+		}
+		else {
+			const SubMesh &subMesh = m_mesh->model->lods()[m_visibilityLOD].subMeshes[object];
+			visible = m_hiZ.boxVisible(viewProjection * m_sceneTransform,
+				glm::vec3(subMesh.bboxMin[0], subMesh.bboxMin[1], subMesh.bboxMin[2]),
+				glm::vec3(subMesh.bboxMax[0], subMesh.bboxMax[1], subMesh.bboxMax[2]));
+			if (visible && !m_wasVisible[object])
+				list.addSubMesh(subMesh);
+		}
+		if (visible || m_wasVisible[object])
+			++m_occlusionDrawn;
+		m_wasVisible[object] = visible;
+	}
+	m_occlusionCulled = (int)m_candidates.size() - m_occlusionDrawn;
+
+	if (!m_instances.empty() && m_instancing)
+		uploadInstances(list, m_drawLists[0].instanceCount());
+
+	if (m_occlusionDrawn != m_reportedDrawn || m_occlusionCulled != m_reportedCulled) {
+		m_reportedDrawn = m_occlusionDrawn;
+		m_reportedCulled = m_occlusionCulled;
+		std::cout << "-- AGEn message --: Occlusion culling: " << m_occlusionDrawn << " drawn, "
+			<< m_occlusionCulled << " culled" << std::endl;
+	}
+}
+
+void SSAORenderer::HiZPass()
+{
+	// Farthest depth of every HIZ_TEXEL_SIZE pixels square of the first phase,
+	// read back for the tests on the CPU. The read waits for the first phase.
+	QSize size = hiz_fbo->size();
+	hiz_fbo->bind();
+	glViewport(0, 0, size.width(), size.height());
+	glDisable(GL_DEPTH_TEST);
+
+	hiz_program->bind();
+	glActiveTexture(GL_TEXTURE13);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glUniform1i(hiz_depth, 13);
+	glUniform1i(hiz_texelSize, HIZ_TEXEL_SIZE);
+
+	glBindVertexArray(quadVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glBindVertexArray(0);
+
+	// The second phase draws into it again
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_hiZDepth.resize(size.width() * size.height());
+	glReadPixels(0, 0, size.width(), size.height(), GL_RED, GL_FLOAT, m_hiZDepth.data());
+	m_hiZ.build(m_hiZDepth, size.width(), size.height(), HIZ_TEXEL_SIZE, m_width, m_height);
+}
+
+void SSAORenderer::DrawList::clear()
+{
+	first.clear();
+	count.clear();
+	offsets.clear();
+	for (size_t l = 0; l < lodInstances.size(); ++l)
+		lodInstances[l].clear();
+	lodFirstInstance.clear();
+}
+
+void SSAORenderer::DrawList::addSubMesh(const SubMesh &subMesh)
+{
+	// Consecutive submeshes are merged into one range
+	GLint start = subMesh.firstFace * 3;
+	if (!first.empty() && first.back() + count.back() == start) {
+		count.back() += subMesh.faceCount * 3;
+		return;
+	}
+	first.push_back(start);
+	count.push_back(subMesh.faceCount * 3);
+	offsets.push_back((const GLvoid*)(sizeof(GLuint) * start));
+}
+
+int SSAORenderer::DrawList::instanceCount() const
+{
+	int instances = 0;
+	for (size_t l = 0; l < lodInstances.size(); ++l)
+		instances += (int)lodInstances[l].size();
+	return instances;
+}
+
+void SSAORenderer::drawScene(const DrawList &list, GLint instanceModelLoc, GLint instanceDiffuseLoc, GLint instancedLoc, GLint diffuseOverrideLoc)
+{
+	if (!m_modelLoaded)
+		return;
+
+	// Send the matrices to the shader
+	m_uniforms.bindObject(ObjectUniforms(m_sceneTransform, m_frameUniforms.viewTransform));
+
+	if (m_instances.empty()) {
+		if (!list.first.empty())
+			glMultiDrawElements(GL_TRIANGLES, list.count.data(), GL_UNSIGNED_INT, list.offsets.data(), (GLsizei)list.first.size());
+		return;
+	}
+
+	const std::vector<LODLevel> &lods = m_mesh->model->lods();
+	if (m_instancing) {
+		glUniform1i(instancedLoc, 1);
+		for (size_t l = 0; l < list.lodInstances.size(); ++l) {
+			const std::vector<Instance> &instances = list.lodInstances[l];
+			if (instances.empty())
+				continue;
+			setInstanceAttributes(list.lodFirstInstance[l], instanceModelLoc, instanceDiffuseLoc);
+			glDrawElementsInstanced(GL_TRIANGLES, lods[l].faceCount * 3, GL_UNSIGNED_INT,
+				(const GLvoid*)(sizeof(GLuint) * lods[l].firstFace * 3), (GLsizei)instances.size());
+			++m_drawCalls;
+		}
+		glUniform1i(instancedLoc, 0);
+	}
+	else {
+		for (size_t l = 0; l < list.lodInstances.size(); ++l) {
+			const std::vector<Instance> &instances = list.lodInstances[l];
+			for (size_t i = 0; i < instances.size(); ++i) {
+				glm::mat4 transform = instances[i].transform * m_sceneTransform;
+				m_uniforms.bindObject(ObjectUniforms(transform, m_frameUniforms.viewTransform));
+				if (diffuseOverrideLoc >= 0)
+					glUniform4fv(diffuseOverrideLoc, 1, &instances[i].diffuse[0]);
+				glDrawElements(GL_TRIANGLES, lods[l].faceCount * 3, GL_UNSIGNED_INT, (const GLvoid*)(sizeof(GLuint) * lods[l].firstFace * 3));
+				++m_drawCalls;
+			}
+		}
+		if (diffuseOverrideLoc >= 0)
+			glUniform4f(diffuseOverrideLoc, 0.0f, 0.0f, 0.0f, 0.0f);
+	}
+}
+
+void SSAORenderer::setInstanceCount(int count)
+{
+	m_instances.clear();
+	if (!m_modelLoaded)
+		return;
+
+	// Square grid on the XZ plane, around the center of the scene
+	int side = (int)std::ceil(std::sqrt((float)count));
+	float spacing = 2.5f * m_modelRadius;
+	std::mt19937 generator(count);
+	std::uniform_real_distribution<float> random(0.0f, 1.0f);
+	for (int i = 0; i < count; ++i) {
+		Instance instance;
+		glm::vec3 position((i % side - (side - 1) / 2.0f) * spacing, 0.0f, (i / side - (side - 1) / 2.0f) * spacing);
+		instance.transform = glm::translate(glm::mat4(1.0f), position);
+		instance.transform = glm::rotate(instance.transform, 2.0f * PI * random(generator), glm::vec3(0.0f, 1.0f, 0.0f));
+		QColor color = QColor::fromHsvF(random(generator), 0.6, 0.9);
+		instance.diffuse = glm::vec4(color.redF(), color.greenF(), color.blueF(), 0.5f);
+		m_instances.push_back(instance);
+	}
+
+	// Radius of the whole grid
+	computeCenterRadiusScene();
+	if (count > 0)
+		m_sceneRadius = std::max(m_modelRadius, std::sqrt(2.0f) * side * spacing / 2.0f);
+	m_geometryDirty = true;
+
+	// The lights are spread over the new scene
+	setLightCount(lightCount());
+
+	m_stressTimer.start();
+	m_stressFrames = 0;
+	m_stressCpuNs = 0;
+}
+
+void SSAORenderer::setInstanceAttributes(size_t firstInstance, GLint modelLoc, GLint diffuseLoc)
+{
+	// There is no base instance in GL 3.3: the pointers start at the first one
+	const char* offset = (const char*)(sizeof(Instance) * firstInstance);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	for (int c = 0; c < 4; ++c)
+		glVertexAttribPointer(modelLoc + c, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), offset + sizeof(glm::vec4) * c);
+	if (diffuseLoc >= 0)
+		glVertexAttribPointer(diffuseLoc, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), offset + sizeof(glm::mat4));
+}
+
+void SSAORenderer::cullInstances()
+{
+	// Visible instances, grouped by level of detail. Whole levels are drawn,
+	// the submeshes are only culled without the stress test.
+	Frustum frustum(m_projection * m_frameUniforms.viewTransform);
+	size_t levels = m_mesh->model->lods().size();
+	m_drawLists[0].lodInstances.resize(levels);
+	m_drawLists[1].lodInstances.resize(levels);
+	if (m_occlusionCulling && (m_visibilityLOD != -1 || m_wasVisible.size() != m_instances.size())) {
+		m_wasVisible.assign(m_instances.size(), 1);
+		m_visibilityLOD = -1;
+	}
+	m_visibleInstances = 0;
+	for (size_t i = 0; i < m_instances.size(); ++i) {
+		glm::mat4 transform = m_instances[i].transform * m_sceneTransform;
+		glm::vec3 center(transform * glm::vec4(m_modelCenter, 1.0f));
+		if (m_frustumCulling && !frustum.sphereVisible(center, m_modelRadius))
+			continue;
+		m_candidates.push_back((int)i);
+		++m_visibleInstances;
+
+		// First phase of the occlusion culling: the ones visible in the last frame
+		if (!m_occlusionCulling || m_wasVisible[i])
+			m_drawLists[0].lodInstances[lodLevel(transform)].push_back(m_instances[i]);
+	}
+
+	if (!m_instancing)
+		return;
+
+	// Orphaned every frame, so it is not waiting for the previous draws
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Instance) * m_instances.size(), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	uploadInstances(m_drawLists[0], 0);
+}
+
+void SSAORenderer::uploadInstances(DrawList &list, size_t first)
+{
+	// One range of the instance buffer per level, for the draws of both passes
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	list.lodFirstInstance.assign(list.lodInstances.size(), 0);
+	for (size_t l = 0; l < list.lodInstances.size(); ++l) {
+		const std::vector<Instance> &instances = list.lodInstances[l];
+		list.lodFirstInstance[l] = first;
+		if (!instances.empty())
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(Instance) * first, sizeof(Instance) * instances.size(), instances.data());
+		first += instances.size();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SSAORenderer::AOPass()
+{
+	ao_fbo->bind();
+	glViewport(0, 0, m_width, m_height);
+	glDisable(GL_DEPTH_TEST);
+
+	ao_program->bind();
+	glUniformMatrix4fv(ao_projection, 1, GL_FALSE, &m_projection[0][0]);
+
+	QVector<GLuint> texIds = g_fbo->textures();
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texIds[0]);
+	glUniform1i(gPositionTex, 1);
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, texIds[1]);
+	glUniform1i(gNormalTex, 2);
+
+	glActiveTexture(GL_TEXTURE8);
+	glBindTexture(GL_TEXTURE_2D, noiseTexture);
+	glUniform1i(texNoise, 8);
+
+	glBindVertexArray(quadVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glBindVertexArray(0);
+}
+
+void SSAORenderer::LightPass(GLuint target)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, m_width, m_height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_DEPTH_TEST);
+
+	light_program->bind();
+
+	QVector<GLuint> texIds = g_fbo->textures();
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texIds[0]);
+	glUniform1i(light_gPosition, 1);
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, texIds[1]);
+	glUniform1i(light_gNormal, 2);
+
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, texIds[2]);
+	glUniform1i(gAlbedo, 3);
+
+	glActiveTexture(GL_TEXTURE4);
+	glBindTexture(GL_TEXTURE_2D, ao_fbo->texture());
+	glUniform1i(light_ssao, 4);
+
+	glActiveTexture(GL_TEXTURE5);
+	glBindTexture(GL_TEXTURE_2D, texIds[3]);
+	glUniform1i(light_gSpecular, 5);
+
+	// Lights and tiles
+	glActiveTexture(GL_TEXTURE9);
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightTextures[0]);
+	glUniform1i(light_lights, 9);
+
+	glActiveTexture(GL_TEXTURE10);
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightTextures[1]);
+	glUniform1i(light_tiles, 10);
+
+	glActiveTexture(GL_TEXTURE11);
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightTextures[2]);
+	glUniform1i(light_indices, 11);
+
+	glUniform1i(light_tileSize, LIGHT_TILE_SIZE);
+	glUniform1i(light_tilesX, m_lightGrid.tilesX());
+
+	// Fragments shaded by the G-buffer pass
+	if (m_drawOverdraw) {
+		glActiveTexture(GL_TEXTURE12);
+		glBindTexture(GL_TEXTURE_2D, texIds[4]);
+		glUniform1i(light_gOverdraw, 12);
+	}
+	glUniform1i(light_drawOverdraw, m_drawOverdraw ? 1 : 0);
+
+	if (flag_ssao)
+	{
+		int ssaoVal = usingSSAO ? 1 : 0;
+		int drawssaoVal = drawSSAO ? 1 : 0;
+		glUniform1i(useSSAO, ssaoVal);
+		glUniform1f(ssaoIntensityLoc, ssao_intensity);
+		glUniform1i(drawSSAOLoc, drawssaoVal);
+		flag_ssao = false;
+	}
+
+	// Bind the VAO to draw the model
+	glBindVertexArray(quadVAO);
+
+	// Draw the model
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glBindVertexArray(0);
+}
+
+void SSAORenderer::AAPass(GLuint target)
+{
+	float threshold = m_highQualityAA ? 0.5f * AA_EDGE_THRESHOLD : AA_EDGE_THRESHOLD;
+	int searchSteps = m_highQualityAA ? 2 * AA_SEARCH_STEPS : AA_SEARCH_STEPS;
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(quadVAO);
+
+	if (m_antialiasing == AA_SMAA) {
+		// Edges of the lit image
+		smaaEdges_fbo->bind();
+		glViewport(0, 0, m_width, m_height);
+		smaaEdges_program->bind();
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, lit_fbo->texture());
+		glUniform1i(smaaEdges_image, 1);
+		glUniform1f(smaaEdges_threshold, threshold);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+		// Blending weights along them
+		smaaWeights_fbo->bind();
+		smaaWeights_program->bind();
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, smaaEdges_fbo->texture());
+		glUniform1i(smaaWeights_edges, 2);
+		glUniform1i(smaaWeights_searchSteps, searchSteps);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+
+	// Into the target, cleared as the light pass does without anti-aliasing
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, m_width, m_height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, lit_fbo->texture());
+	if (m_antialiasing == AA_SMAA) {
+		smaaBlend_program->bind();
+		glUniform1i(smaaBlend_image, 1);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, smaaWeights_fbo->texture());
+		glUniform1i(smaaBlend_weights, 2);
+	}
+	else {
+		fxaa_program->bind();
+		glUniform1i(fxaa_image, 1);
+		glUniform1f(fxaa_edgeThreshold, threshold);
+		glUniform1i(fxaa_searchSteps, searchSteps);
+	}
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glBindVertexArray(0);
+}
+
+void SSAORenderer::createBuffersQuad()
+{
+	// VAO creation
+	glGenVertexArrays(1, &quadVAO);
+	glBindVertexArray(quadVAO);
+
+	// VBO vertices positions
+	glm::vec3 verts[6] = {
+		glm::vec3(-1.0f, -1.0f, 0.0f),
+		glm::vec3(1.0f, -1.0f, 0.0f),
+		glm::vec3(-1.0f, 1.0f, 0.0f),
+		glm::vec3(-1.0f, 1.0f, 0.0f),
+		glm::vec3(1.0f, -1.0f, 0.0f),
+		glm::vec3(1.0f, 1.0f, 0.0f)
+	};
+
+	glm::vec2 texCoords[6] = {
+		glm::vec2(0.0f, 0.0f),
+		glm::vec2(1.0f, 0.0f),
+		glm::vec2(0.0f, 1.0f),
+		glm::vec2(0.0f, 1.0f),
+		glm::vec2(1.0f, 0.0f),
+		glm::vec2(1.0f, 1.0f)
+	};
+
+	// The quad buffers are shared, they are only filled by the first renderer
+	GLResourceCache &cache = GLResourceCache::instance();
+	quadVBOVert = cache.buffer("quad.vertices");
+	quadVBOTexCoord = cache.buffer("quad.texcoords");
+	bool createBuffers = (quadVBOVert == 0);
+
+	// VBO Vertices
+	if (createBuffers) {
+		glGenBuffers(1, &quadVBOVert);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBOVert);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+		cache.addBuffer("quad.vertices", quadVBOVert);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBOVert);
+
+	glVertexAttribPointer(light_vertex, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(light_vertex);
+
+	// VBO Tex Coords
+	if (createBuffers) {
+		glGenBuffers(1, &quadVBOTexCoord);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBOTexCoord);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
+		cache.addBuffer("quad.texcoords", quadVBOTexCoord);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBOTexCoord);
+
+	// Enable the attribute m_vertexLoc
+	glVertexAttribPointer(light_texcoords, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(light_texcoords);
+
+	glBindVertexArray(0);
+
+}
+void SSAORenderer::createGBuffers()
+{
+	// Position, normal, albedo with shininess and specular attachments (and
+	// the overdraw count), in floating point for the light pass, and the
+	// ambient occlusion. FBOs are not shared, the cache keeps one per context.
+	g_fbo = GLResourceCache::instance().framebuffer("gbuffer", QSize(m_width, m_height), m_drawOverdraw ? 5 : 4, GL_RGBA16F);
+	ao_fbo = GLResourceCache::instance().framebuffer("ssao", QSize(m_width, m_height), 1);
+
+	// Sampled by the AO and light passes
+	QVector<GLuint> texIds = g_fbo->textures();
+	texIds << ao_fbo->texture();
+	for (int t = 0; t < texIds.size(); ++t) {
+		glBindTexture(GL_TEXTURE_2D, texIds[t]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// The depth attachment is a texture instead, read by the Hi-Z pass of the
+	// occlusion culling into a low resolution copy
+	if (m_depthTexture == 0)
+		glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, m_width, m_height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	g_fbo->bind();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+	g_fbo->release();
+
+	QSize hiZSize((m_width + HIZ_TEXEL_SIZE - 1) / HIZ_TEXEL_SIZE, (m_height + HIZ_TEXEL_SIZE - 1) / HIZ_TEXEL_SIZE);
+	hiz_fbo = GLResourceCache::instance().framebuffer("hiz", hiZSize, 1, GL_R32F);
+
+	createAABuffers();
+
+	m_geometryDirty = true;
+	m_lightsDirty = true;
+}
+
+void SSAORenderer::createAABuffers()
+{
+	// The lit image is sampled between its texels by FXAA, the edges and
+	// weights of SMAA are only fetched
+	if (m_antialiasing == AA_NONE)
+		return;
+	QSize size(m_width, m_height);
+	lit_fbo = GLResourceCache::instance().framebuffer("aa.lit", size, 1);
+	glBindTexture(GL_TEXTURE_2D, lit_fbo->texture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (m_antialiasing == AA_SMAA) {
+		smaaEdges_fbo = GLResourceCache::instance().framebuffer("smaa.edges", size, 1);
+		smaaWeights_fbo = GLResourceCache::instance().framebuffer("smaa.weights", size, 1);
+	}
+}
+
+void SSAORenderer::createSSAOKernels()
+{
+	ssaoKernel.clear();
+	ssaoNoise.clear();
+
+	std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
+	std::default_random_engine generator;
+	for (unsigned int i = 0; i < 64; ++i)
+	{
+		glm::vec3 sample(
+			randomFloats(generator) * 2.0 - 1.0,
+			randomFloats(generator) * 2.0 - 1.0,
+			randomFloats(generator)
+		);
+		sample = glm::normalize(sample);
+		sample *= randomFloats(generator);
+		float scale = (float)i / 64.0f;
+		scale = 0.1f + (scale * scale) * (1.0f - 0.1f); //lerp
+		sample *= scale;
+		ssaoKernel.push_back(sample);
+	}
+
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		glm::vec3 noise(
+			randomFloats(generator) * 2.0f - 1.0f,
+			randomFloats(generator) * 2.0f - 1.0f,
+			0.0f);
+		ssaoNoise.push_back(noise);
+	}
+}
+
+void SSAORenderer::setLighting()
+{
+	// Light source attached to the camera
+	m_lightPos = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	m_lightCol = glm::vec3(1.0f, 1.0f, 1.0f);
+	m_lightsDirty = true;
+}
+
+void SSAORenderer::setLightCount(int count)
+{
+	m_lights.clear();
+	m_lightsDirty = true;
+	if (!m_modelLoaded)
+		return;
+
+	// Around the model, in a slab as high as the model, with a fraction of
+	// its radius as range. The same count always gives the same lights.
+	std::mt19937 generator(count);
+	std::uniform_real_distribution<float> random(0.0f, 1.0f);
+	for (int i = 0; i < count; ++i) {
+		PointLight light;
+		float angle = 2.0f * PI * random(generator);
+		float distance = m_sceneRadius * std::sqrt(random(generator));
+		light.position = m_sceneCenter + glm::vec3(distance * std::cos(angle), m_modelRadius * (2.0f * random(generator) - 1.0f), distance * std::sin(angle));
+		light.radius = LIGHT_RADIUS * m_modelRadius;
+		QColor color = QColor::fromHsvF(random(generator), 0.7, 1.0);
+		light.color = glm::vec3(color.redF(), color.greenF(), color.blueF());
+		m_lights.push_back(light);
+	}
+	m_reportLights = true;
+}
+
+void SSAORenderer::createLightBuffers()
+{
+	// Lights (two texels each: position and radius, then color), first index
+	// and count of every tile, and the light indices of the tiles
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	glGenBuffers(3, m_lightBuffers);
+	glGenTextures(3, m_lightTextures);
+	for (int i = 0; i < 3; ++i) {
+		glBindBuffer(GL_TEXTURE_BUFFER, m_lightBuffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, m_lightTextures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_lightBuffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	m_lightsDirty = true;
+}
+
+void SSAORenderer::updateLights()
+{
+	// The headlight first, it reaches every tile
+	m_viewLights.resize(m_lights.size() + 1);
+	m_viewLights[0].position = glm::vec3(m_lightPos);
+	m_viewLights[0].radius = 0.0f;
+	m_viewLights[0].color = m_lightCol;
+	for (size_t l = 0; l < m_lights.size(); ++l) {
+		m_viewLights[l + 1] = m_lights[l];
+		m_viewLights[l + 1].position = glm::vec3(m_frameUniforms.viewTransform * glm::vec4(m_lights[l].position, 1.0f));
+	}
+	m_lightGrid.build(m_viewLights, m_projection, m_width, m_height);
+
+	std::vector<glm::vec4> texels(2 * m_viewLights.size());
+	for (size_t l = 0; l < m_viewLights.size(); ++l) {
+		texels[2 * l] = glm::vec4(m_viewLights[l].position, m_viewLights[l].radius);
+		texels[2 * l + 1] = glm::vec4(m_viewLights[l].color, 0.0f);
+	}
+
+	// Orphaned, the previous frame may still read them
+	const std::vector<unsigned int> &tiles = m_lightGrid.tiles();
+	const std::vector<unsigned int> &indices = m_lightGrid.indices();
+	glBindBuffer(GL_TEXTURE_BUFFER, m_lightBuffers[0]);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * texels.size(), texels.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_lightBuffers[1]);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(unsigned int) * tiles.size(), tiles.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_lightBuffers[2]);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	m_lightsDirty = false;
+
+	if (m_reportLights) {
+		std::cout << "-- AGEn message --: " << m_lights.size() << " lights, " << m_lightGrid.averageLights()
+			<< " per tile on average, " << m_lightGrid.maxLights() << " at most (headlight included)" << std::endl;
+		m_reportLights = false;
+	}
+}
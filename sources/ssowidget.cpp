@@ -2,12 +2,16 @@
 #include <QOpenGLShaderProgram>
 #include <QCoreApplication>
 #include <QColorDialog>
+#include <QFileDialog>
 #include <QMessageBox>
 #include <QPainter>
 #include <math.h>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <random>
+
+bool SSOWidget::m_threaded = false;
 
 SSOWidget::SSOWidget(QString modelFilename, bool showFps, QWidget *parent) : QOpenGLWidget(parent)
 {
@@ -30,18 +34,21 @@ SSOWidget::SSOWidget(QString modelFilename, bool showFps, QWidget *parent) : QOp
 	m_yPan = 0.0f;
 
 	cam_type = 0;
+	camera = nullptr;
 	m_xRotPoint = m_yRotPoint = 0;
-	// Scene
-	m_sceneCenter = glm::vec3(0.0f, 0.0f, 0.0f);
-	m_sceneRadius = 50.0f;
-	m_bkgColor = Qt::green;
-	m_backFaceCulling = true;
-
-	// Model
-	m_modelLoaded = false;
-	m_modelCenter = glm::vec3(0.0f, 0.0f, 0.0f);
-	m_modelRadius = 0.0f;
-	m_modelFilename = modelFilename;
+
+	// Renderer
+	m_settings.modelFilename = modelFilename;
+	m_sceneRadius = 1.0f;
+	m_lodCount = 0;
+	m_renderer = nullptr;
+	m_renderThread = nullptr;
+
+	// Camera path and benchmark
+	connect(&m_recordTimer, &QTimer::timeout, this, &SSOWidget::recordCameraKey);
+	m_benchmarkFrames = 0;
+	m_benchmarkFrame = -1;
+	m_benchmarkFrameStart = 0;
 
 	// Mouse
 	m_xRot = 0.0f;
@@ -57,11 +64,14 @@ SSOWidget::SSOWidget(QString modelFilename, bool showFps, QWidget *parent) : QOp
 	m_fps = 0.0f;
 	m_showFps = showFps;
 
+	// Reload the shaders when their files change
+	connect(&ShaderLibrary::instance(), &ShaderLibrary::shadersChanged, this, &SSOWidget::reloadShaders);
 }
 
 SSOWidget::~SSOWidget()
 {
 	cleanup();
+	delete camera;
 }
 
 QSize SSOWidget::minimumSizeHint() const
@@ -74,10 +84,33 @@ QSize SSOWidget::sizeHint() const
 	return QSize(m_width, m_height);
 }
 
-void SSOWidget::sceneCameraType(int type)
+void SSOWidget::setModel(QString modelFilename)
 {
-	makeCurrent();
+	m_settings.modelFilename = modelFilename;
+	m_xRot = 0.0f;
+	m_yRot = 0.0f;
+
+	// Not initialized yet: initializeGL will load it
+	if (!isValid())
+		return;
+
+	// The render thread loads it and sends sceneChanged
+	if (m_renderThread) {
+		requestFrame();
+		return;
+	}
+
+	QTime loadTime;
+	loadTime.start();
+
+	// Shaders, G-buffer, quad and noise texture are kept, only the model changes
+	applySettings();
 
+	std::cout << "-- AGEn message --: Model loaded in " << loadTime.elapsed() << " ms" << std::endl;
+}
+
+void SSOWidget::sceneCameraType(int type)
+{
 	if (camera)
 	{
 		camera->SetType(type);
@@ -85,44 +118,79 @@ void SSOWidget::sceneCameraType(int type)
 		cam_type = type;
 	}
 		
-	update();
+	requestFrame();
 }
 
 void SSOWidget::activateSSAO(bool active)
 {
-	usingSSAO = active;
-	flag_ssao = true;
-	repaint();
+	m_settings.ssao = active;
+	requestFrame();
 }
 
 void SSOWidget::setSSAOIntensity(double value)
 {
-	flag_ssao = true;
-	ssao_intensity = (float)value;
-	repaint();
+	m_settings.ssaoIntensity = (float)value;
+	requestFrame();
 }
 
 void SSOWidget::activateDrawOnlySSAO(bool active)
 {
-	drawSSAO = active;
-	flag_ssao = true;
-	repaint();
+	m_settings.drawOnlySSAO = active;
+	requestFrame();
+}
+
+void SSOWidget::setLightCount(int count)
+{
+	m_settings.lightCount = count;
+	requestFrame();
+}
+
+void SSOWidget::setDepthPrepass(bool active)
+{
+	m_settings.depthPrepass = active;
+	requestFrame();
+}
+
+void SSOWidget::setOcclusionCulling(bool active)
+{
+	m_settings.occlusionCulling = active;
+	requestFrame();
+}
+
+void SSOWidget::setNormalMap(const QString &filename)
+{
+	m_settings.normalMapFilename = filename;
+	requestFrame();
+}
+
+void SSOWidget::setAntialiasing(int mode, bool highQuality)
+{
+	m_settings.antialiasing = mode;
+	m_settings.highQualityAA = highQuality;
+	requestFrame();
 }
 
 void SSOWidget::cleanup()
 {
-	if (m_modelLoaded)
-		cleanBuffersModel();
+	// Its context is shared with this one
+	delete m_renderThread;
+	m_renderThread = nullptr;
 
 	makeCurrent();
 
-	/*if (light_program)
-		delete light_program;
-	if (gPass_program)
-		delete gPass_program;
+	if (m_renderer) {
+		m_renderer->cleanup();
+		delete m_renderer;
+		m_renderer = nullptr;
+	}
+	if (m_blitter.isCreated())
+		m_blitter.destroy();
+	m_capture.stopCapture();
 
-	if (g_fbo)
-		delete g_fbo;*/
+	// An interrupted benchmark
+	if (m_benchmarkFrame > 0)
+		glDeleteQueries(BENCHMARK_QUERY_FRAMES * SSAORenderer::NUM_PASSES, m_benchmarkQueries);
+	m_benchmarkFrame = -1;
 
 	doneCurrent();
 }
@@ -138,30 +206,54 @@ void SSOWidget::initializeGL()
 	// can recreate all resources.
 	connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &SSOWidget::cleanup);
 	initializeOpenGLFunctions();
-	loadShaders();
 
+	m_settings.width = m_width;
+	m_settings.height = m_height;
+	if (m_threaded) {
+		// The camera is placed when the thread has loaded the model
+		m_blitter.create();
+		m_renderThread = new RenderThread(context(), m_settings);
+		connect(m_renderThread, &RenderThread::frameReady, this, static_cast<void (QWidget::*)()>(&QWidget::update));
+		connect(m_renderThread, &RenderThread::sceneChanged, this, &SSOWidget::sceneChanged);
+		m_renderThread->start();
+	}
+	else {
+		m_renderer = new SSAORenderer(m_settings.modelFilename);
+		m_renderer->initialize(m_width, m_height);
+		sceneChanged(m_renderer->sceneRadius(), m_renderer->lodCount());
+	}
+}
 
-	createBuffersQuad();
-	createGBuffers();
+void SSOWidget::paintGL()
+{
+	if (m_renderThread) {
+		presentFrame();
+		m_capture.capture(defaultFramebufferObject(), m_width * devicePixelRatio(), m_height * devicePixelRatio());
+		return;
+	}
 
-	gPass_program->bind();
+	bool benchmark = m_benchmarkFrame >= 0;
+	int querySlot = benchmark ? (m_benchmarkFrame % BENCHMARK_QUERY_FRAMES) * SSAORenderer::NUM_PASSES : 0;
+	if (benchmark)
+		beginBenchmarkFrame();
 
-	createBuffersModel();
-	computeBBoxModel();
-	computeCenterRadiusScene();
-	initCamera();
+	// The stress test and the benchmark measure every pass, even with a still
+	// camera or two equal samples of the path
+	if (benchmark || m_renderer->instanceCount() > 0)
+		m_renderer->invalidate();
 
-	projectionTransform();
-	viewTransform();
-	setLighting();
-}
+	m_settings.xRot = m_xRot;
+	m_settings.yRot = m_yRot;
+	m_renderer->apply(m_settings);
+	m_renderer->render(defaultFramebufferObject(), benchmark ? &m_benchmarkQueries[querySlot] : nullptr);
+	m_capture.capture(defaultFramebufferObject(), m_width, m_height);
 
-void SSOWidget::paintGL()
-{
-	GeometryPass();
-		
-	LightPass();
+	if (benchmark)
+		endBenchmarkFrame(m_renderer->geometryCpuNs());
 
+	// The stress test draws continuously, the renderer reports once per second
+	if (m_renderer->instanceCount() > 0)
+		update();
 }
 
 void SSOWidget::resizeGL(int w, int h)
@@ -169,7 +261,8 @@ void SSOWidget::resizeGL(int w, int h)
 	m_width = w;
 	m_height = h;
 
-	glViewport(0, 0, m_width, m_height);
+	m_settings.width = m_width;
+	m_settings.height = m_height;
 	m_ar = (float)m_width / (float)m_height;
 
 	// We do this if we want to preserve the initial fov when resizing
@@ -181,14 +274,22 @@ void SSOWidget::resizeGL(int w, int h)
 	}
 
 
-	camera->ResizeCamera(m_fov, m_width, m_height);
-	// After modifying the parameters, we update the camera projection
-	projectionTransform();
+	if (camera) {
+		camera->ResizeCamera(m_fov, m_width, m_height);
+		// After modifying the parameters, we update the camera projection
+		projectionTransform();
+	}
+	requestFrame();
 }
 
 void SSOWidget::keyPressEvent(QKeyEvent *event)
 {
-	makeCurrent();
+	// The render thread has not loaded the model yet
+	if (!camera) {
+		event->ignore();
+		return;
+	}
+
 	switch (event->key()) {
 	case Qt::Key_W:
 		std::cout << "-- AGEn message --: Going forward" << std::endl;
@@ -226,6 +327,11 @@ void SSOWidget::keyPressEvent(QKeyEvent *event)
 		std::cout << "-- AGEn message --: Change background color" << std::endl;
 		changeBackgroundColor();
 		break;
+	case Qt::Key_M:
+		// Change the normal map of the model
+		std::cout << "-- AGEn message --: Change normal map" << std::endl;
+		changeNormalMap();
+		break;
 	case Qt::Key_C:
 		// Set the camera at the center of the scene
 		camera->Center();
@@ -236,7 +342,6 @@ void SSOWidget::keyPressEvent(QKeyEvent *event)
 	case Qt::Key_F:
 		// Enable/Disable frames per second
 		m_showFps = !m_showFps;
-		repaint();
 		break;
 	case Qt::Key_H:
 		// Show the help message
@@ -248,7 +353,20 @@ void SSOWidget::keyPressEvent(QKeyEvent *event)
 		std::cout << "-C:  set the camera at the center of the scene" << std::endl;
 		std::cout << "-F:  show frames per second (fps)" << std::endl;
 		std::cout << "-H:  show this help" << std::endl;
+		std::cout << "-M:  normal map of the model (cancel to remove it)" << std::endl;
 		std::cout << "-R:  reset the camera parameters" << std::endl;
+		std::cout << "-L:  next level of detail (automatic after the last one)" << std::endl;
+		std::cout << "-V:  enable/disable frustum culling" << std::endl;
+		std::cout << "-K:  enable/disable occlusion culling" << std::endl;
+		std::cout << "-I:  stress test, more instances of the model (off after the last step)" << std::endl;
+		std::cout << "-U:  stress test, instanced draws or one draw call per instance" << std::endl;
+		std::cout << "-N:  stress test, more point lights (off after the last step)" << std::endl;
+		std::cout << "-Z:  enable/disable the depth pre-pass" << std::endl;
+		std::cout << "-O:  show the overdraw of the G-buffer pass" << std::endl;
+		std::cout << "-X:  anti-aliasing: none, FXAA or SMAA" << std::endl;
+		std::cout << "-Q:  normal/high quality anti-aliasing" << std::endl;
+		std::cout << "-P:  start/stop recording a camera path (for --benchmark)" << std::endl;
+		std::cout << "-G:  start/stop capturing the frames to " << CAPTURE_DEFAULT_PATH << std::endl;
 		std::cout << "-F5: reload shaders" << std::endl;
 		std::cout << std::endl;
 		std::cout << "IMPORTANT: the focus must be set to the glwidget to work" << std::endl;
@@ -259,6 +377,97 @@ void SSOWidget::keyPressEvent(QKeyEvent *event)
 		std::cout << "-- AGEn message --: Reset camera" << std::endl;
 		resetCamera();
 		break;
+	case Qt::Key_L:
+		// Cycle the forced level of detail, then back to automatic
+		if (m_lodCount > 0) {
+			int level = m_settings.forcedLOD + 1 < m_lodCount ? m_settings.forcedLOD + 1 : -1;
+			m_settings.forcedLOD = level;
+			if (level < 0)
+				std::cout << "-- AGEn message --: Automatic LOD" << std::endl;
+		}
+		break;
+	case Qt::Key_V:
+		// Enable/Disable frustum culling
+		m_settings.frustumCulling = !m_settings.frustumCulling;
+		std::cout << "-- AGEn message --: Frustum culling " << (m_settings.frustumCulling ? "enabled" : "disabled");
+		if (m_renderer && m_renderer->modelLoaded())
+			std::cout << " (" << m_renderer->visibleSubMeshes() << " of " << m_renderer->subMeshCount() << " submeshes drawn)";
+		std::cout << std::endl;
+		break;
+	case Qt::Key_K:
+		// Enable/Disable occlusion culling, its counts are printed when they change
+		m_settings.occlusionCulling = !m_settings.occlusionCulling;
+		std::cout << "-- AGEn message --: Occlusion culling " << (m_settings.occlusionCulling ? "enabled" : "disabled") << std::endl;
+		break;
+	case Qt::Key_I:
+		// Cycle the stress test: 16, 64, ... instances, then off
+		if (m_lodCount > 0) {
+			int count = m_settings.instanceCount;
+			setInstanceCount(count == 0 ? 16 : (count < 4096 ? count * 4 : 0));
+		}
+		break;
+	case Qt::Key_U:
+		// Instanced draws or one draw call per instance
+		m_settings.instancing = !m_settings.instancing;
+		std::cout << "-- AGEn message --: Stress test " << (m_settings.instancing ? "instanced" : "with one draw call per instance") << std::endl;
+		break;
+	case Qt::Key_N:
+		// Cycle the point lights: 16, 64, ... lights, then the headlight only
+		if (m_lodCount > 0) {
+			int count = m_settings.lightCount;
+			m_settings.lightCount = count == 0 ? 16 : (count < 1024 ? count * 4 : 0);
+			if (m_settings.lightCount == 0)
+				std::cout << "-- AGEn message --: Headlight only" << std::endl;
+		}
+		break;
+	case Qt::Key_Z:
+		// Enable/Disable the depth pre-pass
+		m_settings.depthPrepass = !m_settings.depthPrepass;
+		std::cout << "-- AGEn message --: Depth pre-pass " << (m_settings.depthPrepass ? "enabled" : "disabled") << std::endl;
+		break;
+	case Qt::Key_O:
+		// Fragments shaded per pixel: green once, red 4 times or more
+		m_settings.drawOverdraw = !m_settings.drawOverdraw;
+		std::cout << "-- AGEn message --: Overdraw " << (m_settings.drawOverdraw ? "shown" : "hidden") << std::endl;
+		break;
+	case Qt::Key_X:
+		// Cycle the post-process anti-aliasing
+		m_settings.antialiasing = (m_settings.antialiasing + 1) % SSAORenderer::NUM_ANTIALIASING;
+		std::cout << "-- AGEn message --: Anti-aliasing " << SSAORenderer::antialiasingName(m_settings.antialiasing) << std::endl;
+		break;
+	case Qt::Key_Q:
+		// Normal/High quality anti-aliasing
+		m_settings.highQualityAA = !m_settings.highQualityAA;
+		std::cout << "-- AGEn message --: " << (m_settings.highQualityAA ? "High" : "Normal") << " quality anti-aliasing" << std::endl;
+		break;
+	case Qt::Key_P:
+		// Start/Stop recording the camera path replayed by the benchmark
+		if (m_recordTimer.isActive()) {
+			m_recordTimer.stop();
+			recordCameraKey();
+			if (m_recordedPath.save(CAMERA_PATH_FILE))
+				std::cout << "-- AGEn message --: Camera path of " << m_recordedPath.duration() << " s saved to "
+					<< CAMERA_PATH_FILE << std::endl;
+		}
+		else {
+			m_recordedPath.clear();
+			m_recordedPath.model = m_settings.modelFilename.toStdString();
+			m_recordedPath.cameraType = cam_type;
+			m_recordClock.start();
+			recordCameraKey();
+			m_recordTimer.start(1000 / CAMERA_PATH_RATE);
+			std::cout << "-- AGEn message --: Recording the camera path (P to stop)" << std::endl;
+		}
+		break;
+	case Qt::Key_G:
+		// Start/Stop capturing the frames (PNG sequence)
+		makeCurrent();
+		if (m_capture.isCapturing())
+			m_capture.stopCapture();
+		else
+			m_capture.startCapture(CAPTURE_DEFAULT_PATH);
+		doneCurrent();
+		break;
 	case Qt::Key_F5:
 		// Reload shaders
 		std::cout << "-- AGEn message --: Reload shaders" << std::endl;
@@ -268,7 +477,7 @@ void SSOWidget::keyPressEvent(QKeyEvent *event)
 		event->ignore();
 		break;
 	}
-	update();
+	requestFrame();
 }
 
 void SSOWidget::mousePressEvent(QMouseEvent *event)
@@ -286,7 +495,8 @@ void SSOWidget::mousePressEvent(QMouseEvent *event)
 
 void SSOWidget::mouseMoveEvent(QMouseEvent *event)
 {
-	makeCurrent();
+	if (!camera)
+		return;
 
 	if (camera->GetType() == 1)
 	{
@@ -314,7 +524,7 @@ void SSOWidget::mouseMoveEvent(QMouseEvent *event)
 		m_xClick = event->x();
 		m_yClick = event->y();
 	}
-	update();
+	requestFrame();
 }
 
 void SSOWidget::mouseReleaseEvent(QMouseEvent *event)
@@ -337,9 +547,7 @@ void SSOWidget::wheelEvent(QWheelEvent* event)
 	float maxFov = DEG2RAD(175.0f);
 	float minFov = DEG2RAD(15.0f);
 
-	if (m_fov >= minFov && m_fov <= maxFov) {
-
-		makeCurrent();
+	if (camera && m_fov >= minFov && m_fov <= maxFov) {
 
 		float fovBeforeZoom = m_fov;
 
@@ -353,493 +561,249 @@ void SSOWidget::wheelEvent(QWheelEvent* event)
 		camera->ResizeCamera(m_fov, m_width, m_height);
 		// After modifying the parameters, we update the camera projection
 		projectionTransform();
-		update();
+		requestFrame();
 	}
 
 	event->accept();
 }
 
-void SSOWidget::loadShaders()
+void SSOWidget::requestFrame()
 {
-	loadGShader();
-	loadLightShader();
+	m_settings.xRot = m_xRot;
+	m_settings.yRot = m_yRot;
 
+	// The thread drops the settings it had no time to render
+	if (m_renderThread)
+		m_renderThread->setSettings(m_settings);
+	else
+		update();
 }
 
-void SSOWidget::reloadShaders()
+void SSOWidget::applySettings()
 {
+	if (!m_renderer)
+		return;
 
-	// TO DO: Insert your code here to reload the shaders and update the view
-
+	makeCurrent();
+	if (m_renderer->apply(m_settings))
+		sceneChanged(m_renderer->sceneRadius(), m_renderer->lodCount());
+	doneCurrent();
 }
 
-void SSOWidget::loadGShader()
+void SSOWidget::presentFrame()
 {
-	// Declaration of the shaders
-	QOpenGLShader vs(QOpenGLShader::Vertex, this);
-	QOpenGLShader fs(QOpenGLShader::Fragment, this);
-
-	// Load and compile the shaders
-	vs.compileSourceFile("./shaders/gbuffer.vert");
-	fs.compileSourceFile("./shaders/gbuffer.frag");
-
-	// Create the program
-	gPass_program = new QOpenGLShaderProgram;
-
-	// Add the shaders
-	gPass_program->addShader(&fs);
-	gPass_program->addShader(&vs);
+	TripleBuffer<RenderThread::Frame> &frames = m_renderThread->frames();
+	frames.update();
+	RenderThread::Frame &frame = frames.front();
 
-	// Link the program
-	gPass_program->link();
-		
-	// Bind the program (we are gonna use this program)
-	gPass_program->bind();
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (!frame.fbo)
+		return;
 
-	// Get the attribs locations of the vertex shader
-	gp_aPos = glGetAttribLocation(gPass_program->programId(), "aPos");
-	gp_aNormal = glGetAttribLocation(gPass_program->programId(), "aNormal");
-	gp_aTexCoords = glGetAttribLocation(gPass_program->programId(), "aTexCoords");
-	gp_model = glGetUniformLocation(gPass_program->programId(), "model");
-	gp_view = glGetUniformLocation(gPass_program->programId(), "view");
-	gp_projection = glGetUniformLocation(gPass_program->programId(), "projection");
+	// The GPU waits for the thread's frame, the GUI thread does not
+	glWaitSync(frame.fence, 0, GL_TIMEOUT_IGNORED);
 
-	m_matAmbLoc = glGetAttribLocation(gPass_program->programId(), "matamb");
-	m_matDiffLoc = glGetAttribLocation(gPass_program->programId(), "matdiff");
-	m_matSpecLoc = glGetAttribLocation(gPass_program->programId(), "matspec");
-	m_matShinLoc = glGetAttribLocation(gPass_program->programId(), "matshin");
+	glViewport(0, 0, m_width * devicePixelRatio(), m_height * devicePixelRatio());
+	glDisable(GL_DEPTH_TEST);
+	m_blitter.bind();
+	m_blitter.blit(frame.fbo->texture(), QMatrix4x4(), QOpenGLTextureBlitter::OriginBottomLeft);
+	m_blitter.release();
 
-	m_lightPosLoc = glGetUniformLocation(gPass_program->programId(), "lightPos");
-	m_lightColLoc = glGetUniformLocation(gPass_program->programId(), "lightCol");
+	// The thread waits for the blit before it reuses the frame (the same frame
+	// can be presented again, the last blit is the one that matters)
+	if (frame.presented)
+		glDeleteSync(frame.presented);
+	frame.presented = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush(); // the fence must reach the GPU before another context waits on it
 }
 
-void SSOWidget::loadLightShader()
+void SSOWidget::sceneChanged(float sceneRadius, int lodCount)
 {
-	QOpenGLShader vs2(QOpenGLShader::Vertex, this);
-	QOpenGLShader fs2(QOpenGLShader::Fragment, this);
-
-	// Load and compile the shaders
-	vs2.compileSourceFile("./shaders/light.vert");
-	fs2.compileSourceFile("./shaders/light.frag");
-
-	// Create the program
-	light_program = new QOpenGLShaderProgram;
-
-	// Add the shaders
-	light_program->addShader(&fs2);
-	light_program->addShader(&vs2);
-
-	// Link the program
-	light_program->link();
-
-	// Bind the program (we are gonna use this program)
-	light_program->bind();
-
-	// Get the attribs locations of the vertex shader
-	light_vertex = glGetAttribLocation(light_program->programId(), "vertex");
-	light_texcoords = glGetAttribLocation(light_program->programId(), "vertTexCoords");
-
-	gPositionTex = glGetUniformLocation(light_program->programId(), "gPosition");
-	gNormalTex = glGetUniformLocation(light_program->programId(), "gNormal");
-	gAlbedo = glGetUniformLocation(light_program->programId(), "gAlbedoSpec");
-	light_projection = glGetUniformLocation(light_program->programId(), "projection");
-
-	useSSAO = glGetUniformLocation(light_program->programId(), "useSSAO");
-	glUniform1i(useSSAO, 0.2);
-
-	drawSSAOLoc = glGetUniformLocation(light_program->programId(), "drawSSAO");
-	glUniform1i(drawSSAO, 0);
-
-	ssaoIntensityLoc = glGetUniformLocation(light_program->programId(), "ssaoIntensity");
-	glUniform1f(ssaoIntensityLoc, ssao_intensity);
+	m_sceneRadius = sceneRadius;
+	m_lodCount = lodCount;
 
-	GLuint screen_width = glGetUniformLocation(light_program->programId(), "screenWidth");
-	GLuint screenHeight = glGetUniformLocation(light_program->programId(), "screenHeight");
-	GLuint tileSize = glGetUniformLocation(light_program->programId(), "tileSize");
-	GLuint samples = glGetUniformLocation(light_program->programId(), "samples");
-	texNoise = glGetUniformLocation(light_program->programId(), "texNoise");
-
-	glUniform1f(screen_width, m_width);
-	glUniform1f(screenHeight, m_height);
-	glUniform1f(tileSize, 4.0);
-
-	createSSAOKernels();
-
-	// Noise Texture
-	glGenTextures(1, &noiseTexture);
-	glBindTexture(GL_TEXTURE_2D, noiseTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 4, 4, 0, GL_RGB, GL_FLOAT, &ssaoNoise[0]);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	initCamera();
+	camera->ResizeCamera(m_fov, m_width, m_height);
+	projectionTransform();
+	viewTransform();
+	requestFrame();
+}
 
-	glUniform3fv(samples, 64, &ssaoKernel[0][0]);
+void SSOWidget::reloadShaders()
+{
+	// Built again by the next frame
+	++m_settings.shaderGeneration;
+	requestFrame();
 }
 
 void SSOWidget::initCamera()
 {
+	delete camera;
 	camera = new Camera(m_width, m_height, glm::vec3(0.0f, 0.0f, -2.0f * m_sceneRadius), m_sceneRadius, cam_type);
 }
 
-void SSOWidget::projectionTransform(bool useSSAO)
+void SSOWidget::projectionTransform()
 {
-	// Send the matrix to the shader
-
-	light_program->bind();
-	glUniformMatrix4fv(light_projection, 1, GL_FALSE, &camera->GetProj()[0][0]);
-
-	gPass_program->bind();
-	glUniformMatrix4fv(gp_projection, 1, GL_FALSE, &camera->GetProj()[0][0]);
+	// Sent to the shaders by the next frame
+	m_settings.projection = camera->GetProj();
+	m_settings.fov = camera->GetFov();
 }
 
 void SSOWidget::resetCamera()
 {
-	makeCurrent();
 	camera->Reset();
 
 	projectionTransform();
 	viewTransform();
-	update();
+	requestFrame();
 }
 
 void SSOWidget::viewTransform()
 {
-	// Send the matrix to the shader
-
-	light_program->bind();
-	glUniformMatrix4fv(light_view, 1, GL_FALSE, &camera->GetView()[0][0]);
-
-	gPass_program->bind();
-	glUniformMatrix4fv(gp_view, 1, GL_FALSE, &camera->GetView()[0][0]);
+	// Sent to the shaders by the next frame
+	m_settings.view = camera->GetView();
 }
 
 void SSOWidget::changeBackgroundColor() {
 
-	m_bkgColor = QColorDialog::getColor();
-	repaint();
+	m_settings.background = QColorDialog::getColor();
+	requestFrame();
 }
 
-void SSOWidget::computeCenterRadiusScene()
+void SSOWidget::changeNormalMap()
 {
-	m_sceneCenter = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	// In this case, we just load one model
-	m_sceneRadius = m_modelRadius;
+	setNormalMap(QFileDialog::getOpenFileName(this, "Normal map", m_settings.normalMapFilename, "Images (*.png *.jpg *.bmp *.tga)"));
 }
 
-void SSOWidget::createBuffersModel()
+void SSOWidget::setInstanceCount(int count)
 {
-	// Load the OBJ model - BEFORE creating the buffers!
-	m_model.load(m_modelFilename.toStdString());
-
-	// VAO creation
-	glGenVertexArrays(1, &m_VAOModel);
-	glBindVertexArray(m_VAOModel);
-
-	// VBO Vertices
-	glGenBuffers(1, &m_VBOModelVerts);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelVerts);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_vertices(), GL_STATIC_DRAW);
-
-	// Enable the attribute m_vertexLoc
-	glVertexAttribPointer(gp_aPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(gp_aPos);
-
-	// VBO Normals
-	glGenBuffers(1, &m_VBOModelNorms);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelNorms);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_normals(), GL_STATIC_DRAW);
-
-	// Enable the attribute m_normalLoc
-	glVertexAttribPointer(gp_aNormal, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(gp_aNormal);
-
-	// Instead of colors, we pass the materials 
-	// VBO Ambient component
-	glGenBuffers(1, &m_VBOModelMatAmb);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatAmb);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_matamb(), GL_STATIC_DRAW);
-
-	// Enable the attribute m_matAmbLoc
-	glVertexAttribPointer(m_matAmbLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(m_matAmbLoc);
-
-	// VBO Diffuse component
-	glGenBuffers(1, &m_VBOModelMatDiff);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatDiff);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_matdiff(), GL_STATIC_DRAW);
-
-	// Enable the attribute m_matDiffLoc
-	glVertexAttribPointer(m_matDiffLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(m_matDiffLoc);
-
-	// VBO Specular component
-	glGenBuffers(1, &m_VBOModelMatSpec);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatSpec);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3 * 3, m_model.VBO_matspec(), GL_STATIC_DRAW);
-
-	// Enable the attribute m_matSpecLoc
-	glVertexAttribPointer(m_matSpecLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(m_matSpecLoc);
-
-	// VBO Shininess component
-	glGenBuffers(1, &m_VBOModelMatShin);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBOModelMatShin);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_model.faces().size() * 3, m_model.VBO_matshin(), GL_STATIC_DRAW);
-
-	// Enable the attribute m_matShinLoc
-	glVertexAttribPointer(m_matShinLoc, 1, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(m_matShinLoc);
-
-	glBindVertexArray(0);
+	// The camera is placed again to see the whole grid (sceneChanged)
+	m_settings.instanceCount = count;
+	if (m_renderThread)
+		requestFrame();
+	else
+		applySettings();
 
-	// The model has been loaded
-	m_modelLoaded = true;
+	if (count > 0)
+		std::cout << "-- AGEn message --: Stress test with " << count << " instances" << std::endl;
+	else
+		std::cout << "-- AGEn message --: Stress test disabled" << std::endl;
 }
 
-void SSOWidget::cleanBuffersModel()
+void SSOWidget::startBenchmark(const CameraPath &path, int frames, const QString &csvFile, const QString &capturePath)
 {
-	makeCurrent();
-
-	glDisableVertexAttribArray(0);
-	glDeleteBuffers(1, &m_VBOModelVerts);
-	glDeleteBuffers(1, &m_VBOModelNorms);
-	glDeleteBuffers(1, &m_VBOModelMatAmb);
-	glDeleteBuffers(1, &m_VBOModelMatDiff);
-	glDeleteBuffers(1, &m_VBOModelMatSpec);
-	glDeleteBuffers(1, &m_VBOModelMatShin);
-	glDeleteVertexArrays(1, &m_VAOModel);
-
-	m_modelLoaded = false;
+	// The GPU timer queries are issued around the passes of paintGL
+	if (m_threaded) {
+		std::cerr << "-- AGEn message --: The benchmark does not run with a render thread" << std::endl;
+		emit benchmarkFinished(false);
+		return;
+	}
 
-	doneCurrent();
+	m_benchmarkPath = path;
+	m_benchmarkFrames = std::max(frames, 1);
+	m_benchmarkFrame = 0;
+	m_benchmarkCSV = csvFile;
+	m_benchmarkCapture = capturePath;
+
+	// Frame, geometry pass CPU, then the GPU time of every pass
+	m_benchmarkTimes.assign(2 + SSAORenderer::NUM_PASSES, TimingSeries());
+	m_benchmarkTimes[0].name = "frame";
+	m_benchmarkTimes[1].name = "geometry_pass_cpu";
+	for (int pass = 0; pass < SSAORenderer::NUM_PASSES; ++pass)
+		m_benchmarkTimes[2 + pass].name = std::string(SSAORenderer::passName(pass)) + "_gpu";
+	for (size_t s = 0; s < m_benchmarkTimes.size(); ++s)
+		m_benchmarkTimes[s].ms.assign(m_benchmarkFrames, 0.0);
+
+	std::cout << "-- AGEn message --: Benchmark of " << m_benchmarkFrames << " frames along a camera path of "
+		<< path.duration() << " s" << std::endl;
+	update();
 }
 
-void SSOWidget::computeBBoxModel()
+void SSOWidget::recordCameraKey()
 {
-	float minX, minY, minZ;
-	float maxX, maxY, maxZ;
-
-	minX = maxX = m_model.vertices()[0];
-	minY = maxY = m_model.vertices()[1];
-	minZ = maxZ = m_model.vertices()[2];
+	if (!camera)
+		return;
 
-	for (size_t i = 3; i < m_model.vertices().size(); i += 3)
-	{
-		if (m_model.vertices()[i + 0] < minX)
-			minX = m_model.vertices()[i + 0];
-		if (m_model.vertices()[i + 0] > maxX)
-			maxX = m_model.vertices()[i + 0];
-		if (m_model.vertices()[i + 1] < minY)
-			minY = m_model.vertices()[i + 1];
-		if (m_model.vertices()[i + 1] > maxY)
-			maxY = m_model.vertices()[i + 1];
-		if (m_model.vertices()[i + 2] < minZ)
-			minZ = m_model.vertices()[i + 2];
-		if (m_model.vertices()[i + 2] > maxZ)
-			maxZ = m_model.vertices()[i + 2];
-	}
-
-	m_modelCenter = glm::vec3((maxX + minX) / 2.0f, (maxY + minY) / 2.0f, (maxZ + minZ) / 2.0f);
-	glm::vec3 radiusModel(maxX - m_modelCenter.x, maxY - m_modelCenter.y, maxZ - m_modelCenter.z);
-	m_modelRadius = sqrt(radiusModel.x*radiusModel.x + radiusModel.y*radiusModel.y + radiusModel.z*radiusModel.z);
+	CameraKey key;
+	key.time = m_recordClock.nsecsElapsed() / 1.0e9;
+	key.camera = camera->GetState();
+	key.modelXRot = m_xRot;
+	key.modelYRot = m_yRot;
+	m_recordedPath.addKey(key);
 }
 
-void SSOWidget::modelTransform()
+void SSOWidget::beginBenchmarkFrame()
 {
-	glm::mat4 geomTransform(1.0f);
-
-	geomTransform = glm::translate(geomTransform, m_sceneCenter);
-	geomTransform = glm::rotate(geomTransform, m_xRot, glm::vec3(1.0f, 0.0f, 0.0f));
-	geomTransform = glm::rotate(geomTransform, m_yRot, glm::vec3(0.0f, 1.0f, 0.0f));
-	geomTransform = glm::translate(geomTransform, -m_modelCenter);
-
-	// Send the matrix to the shader
-	glUniformMatrix4fv(gp_model, 1, GL_FALSE, &geomTransform[0][0]);
+	if (m_benchmarkFrame == 0) {
+		glGenQueries(BENCHMARK_QUERY_FRAMES * SSAORenderer::NUM_PASSES, m_benchmarkQueries);
+		cam_type = m_benchmarkPath.cameraType;
+		camera->SetType(cam_type);
+		if (!m_benchmarkCapture.isEmpty())
+			m_capture.startCapture(m_benchmarkCapture);
+		m_benchmarkClock.start();
+	}
+	else {
+		// From the start of the previous frame, so it includes the swap
+		m_benchmarkTimes[0].ms[m_benchmarkFrame - 1] = (m_benchmarkClock.nsecsElapsed() - m_benchmarkFrameStart) / 1.0e6;
+	}
+	m_benchmarkFrameStart = m_benchmarkClock.nsecsElapsed();
+
+	// The queries of this slot were issued BENCHMARK_QUERY_FRAMES frames ago
+	if (m_benchmarkFrame >= BENCHMARK_QUERY_FRAMES)
+		readBenchmarkQueries(m_benchmarkFrame - BENCHMARK_QUERY_FRAMES);
+
+	// Even times along the path: the same views whatever the frame rate
+	double time = m_benchmarkFrames > 1 ? m_benchmarkPath.duration() * m_benchmarkFrame / (m_benchmarkFrames - 1) : 0.0;
+	CameraKey key = m_benchmarkPath.sample(time);
+	camera->SetState(key.camera);
+	m_xRot = key.modelXRot;
+	m_yRot = key.modelYRot;
+	projectionTransform();
+	viewTransform();
 }
 
-void SSOWidget::GeometryPass()
+void SSOWidget::endBenchmarkFrame(qint64 geometryCpuNs)
 {
-	g_fbo->bind();
-	GLenum bufs[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-	glDrawBuffers(3, bufs);
-
-	// Paint the scene
-	glClearColor(m_bkgColor.red() / 255.0f, m_bkgColor.green() / 255.0f, m_bkgColor.blue() / 255.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
+	m_benchmarkTimes[1].ms[m_benchmarkFrame] = geometryCpuNs / 1.0e6;
 
-	if (m_backFaceCulling)
-		glEnable(GL_CULL_FACE);
-
-	gPass_program->bind();
-	// Bind the VAO to draw the model
-	glBindVertexArray(m_VAOModel);
-
-	// Apply the geometric transforms to the model (position/orientation)
-	modelTransform();
-
-	// Draw the model
-	glDrawArrays(GL_TRIANGLES, 0, m_model.faces().size() * 3);
-
-	// Unbind the vertex array
-	glBindVertexArray(0);
-	g_fbo->bindDefault();
+	++m_benchmarkFrame;
+	if (m_benchmarkFrame < m_benchmarkFrames)
+		update();
+	else
+		finishBenchmark();
 }
 
-void SSOWidget::LightPass()
+void SSOWidget::readBenchmarkQueries(int frame)
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	light_program->bind();
-
-	QVector<GLuint> texIds = g_fbo->textures();
-
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, texIds[0]);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP);
-
-	glUniform1i(gPositionTex, 1);
-
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, texIds[1]);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP);
-
-	glUniform1i(gNormalTex, 2);
-
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, texIds[2]);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP);
-
-	glUniform1i(gAlbedo, 3);
-
-	glActiveTexture(GL_TEXTURE8);
-	glBindTexture(GL_TEXTURE_2D, noiseTexture);
-	glUniform1i(texNoise, 8);
-
-	if (flag_ssao)
-	{	
-		int ssaoVal = usingSSAO ? 1 : 0;
-		int drawssaoVal = drawSSAO ? 1 : 0;
-		glUniform1i(useSSAO, ssaoVal);
-		glUniform1f(ssaoIntensityLoc, ssao_intensity);
-		glUniform1i(drawSSAOLoc, drawssaoVal);
-		flag_ssao = false;
+	int slot = (frame % BENCHMARK_QUERY_FRAMES) * SSAORenderer::NUM_PASSES;
+	for (int pass = 0; pass < SSAORenderer::NUM_PASSES; ++pass) {
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(m_benchmarkQueries[slot + pass], GL_QUERY_RESULT, &ns);
+		m_benchmarkTimes[2 + pass].ms[frame] = ns / 1.0e6;
 	}
-	
-	// Bind the VAO to draw the model
-	glBindVertexArray(quadVAO);
-
-	// Draw the model
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
 }
 
-void SSOWidget::createBuffersQuad()
+void SSOWidget::finishBenchmark()
 {
-	// VAO creation
-	glGenVertexArrays(1, &quadVAO);
-	glBindVertexArray(quadVAO);
-
-	// VBO vertices positions
-	glm::vec3 verts[6] = {
-		glm::vec3(-1.0f, -1.0f, 0.0f),
-		glm::vec3(1.0f, -1.0f, 0.0f),
-		glm::vec3(-1.0f, 1.0f, 0.0f),
-		glm::vec3(-1.0f, 1.0f, 0.0f),
-		glm::vec3(1.0f, -1.0f, 0.0f),
-		glm::vec3(1.0f, 1.0f, 0.0f)
-	};
-
-	glm::vec2 texCoords[6] = {
-		glm::vec2(0.0f, 0.0f),
-		glm::vec2(1.0f, 0.0f),
-		glm::vec2(0.0f, 1.0f),
-		glm::vec2(0.0f, 1.0f),
-		glm::vec2(1.0f, 0.0f),
-		glm::vec2(1.0f, 1.0f)
-	};
+	for (int f = std::max(0, m_benchmarkFrames - BENCHMARK_QUERY_FRAMES); f < m_benchmarkFrames; ++f)
+		readBenchmarkQueries(f);
+	m_benchmarkTimes[0].ms.back() = (m_benchmarkClock.nsecsElapsed() - m_benchmarkFrameStart) / 1.0e6;
+	glDeleteQueries(BENCHMARK_QUERY_FRAMES * SSAORenderer::NUM_PASSES, m_benchmarkQueries);
+	m_benchmarkFrame = -1;
+	m_capture.stopCapture();
 
-	// VBO Vertices
-	glGenBuffers(1, &quadVBOVert);
-	glBindBuffer(GL_ARRAY_BUFFER, quadVBOVert);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(light_vertex, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(light_vertex);
-
-	// VBO Tex Coords
-	glGenBuffers(1, &quadVBOTexCoord);
-	glBindBuffer(GL_ARRAY_BUFFER, quadVBOTexCoord);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
-
-	// Enable the attribute m_vertexLoc
-	glVertexAttribPointer(light_texcoords, 2, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(light_texcoords);
-
-	glBindVertexArray(0);
-
-}
-void SSOWidget::createGBuffers()
-{
-	// Init fbo
-	QOpenGLFramebufferObjectFormat format;
-	format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
-	g_fbo = new QOpenGLFramebufferObject(m_width, m_height, format);
-	g_fbo->addColorAttachment(m_width, m_height);
-	g_fbo->addColorAttachment(m_width, m_height);
-	g_fbo->addColorAttachment(m_width, m_height);
-
-}
-
-void SSOWidget::createSSAOKernels()
-{
-	std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
-	std::default_random_engine generator;
-	for (unsigned int i = 0; i < 64; ++i)
-	{
-		glm::vec3 sample(
-			randomFloats(generator) * 2.0 - 1.0,
-			randomFloats(generator) * 2.0 - 1.0,
-			randomFloats(generator)
-		);
-		sample = glm::normalize(sample);
-		sample *= randomFloats(generator);
-		float scale = (float)i / 64.0f;
-		scale = 0.1f + (scale * scale) * (1.0f - 0.1f); //lerp
-		sample *= scale;
-		ssaoKernel.push_back(sample);
+	// Shader compilation and first uploads are left out
+	int warmup = m_benchmarkFrames > BENCHMARK_WARMUP_FRAMES ? BENCHMARK_WARMUP_FRAMES : 0;
+	for (size_t s = 0; s < m_benchmarkTimes.size(); ++s) {
+		std::vector<double> &ms = m_benchmarkTimes[s].ms;
+		ms.erase(ms.begin(), ms.begin() + warmup);
+		std::cout << "-- AGEn message --: " << m_benchmarkTimes[s].name << ": p50 " << percentile(ms, 0.5)
+			<< " ms, p95 " << percentile(ms, 0.95) << " ms, p99 " << percentile(ms, 0.99) << " ms" << std::endl;
 	}
 
-	for (unsigned int i = 0; i < 16; ++i)
-	{
-		glm::vec3 noise(
-			randomFloats(generator) * 2.0f - 1.0f,
-			randomFloats(generator) * 2.0f - 1.0f,
-			0.0f);
-		ssaoNoise.push_back(noise);
-	}
+	bool ok = writeTimingCSV(m_benchmarkCSV.toStdString(), m_benchmarkTimes);
+	if (ok)
+		std::cout << "-- AGEn message --: Benchmark written to " << m_benchmarkCSV.toStdString() << std::endl;
+	emit benchmarkFinished(ok);
 }
-
-void SSOWidget::setLighting()
-{
-	// Light source attached to the camera
-	m_lightPos = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-	glUniform4fv(m_lightPosLoc, 1, &m_lightPos[0]);
-
-	m_lightCol = glm::vec3(1.0f, 1.0f, 1.0f);
-	glUniform3fv(m_lightColLoc, 1, &m_lightCol[0]);
-}
\ No newline at end of file
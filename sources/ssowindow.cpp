@@ -72,23 +72,9 @@ void SSOWindow::loadModel()
 	QString filename = QFileDialog::getOpenFileName(this, tr("Load Model"),
 		"./models/", tr("3D Models (*.obj)"));
 
-	bool showFps = false;
-	if (filename.size() != 0)
-	{
-		// We delete the glWidget and create another one to restart the GLContext
-		// Otherwise, the painter does not work and the fps are not shown
-		if (m_glWidget != nullptr) {
-			delete m_glWidget;
-			m_glWidget = nullptr;
-		}
-
-		m_glWidget = new SSOWidget(filename, showFps);
-		layoutFrame->addWidget(m_glWidget);
-		m_glWidget->show();
-	}
-
-
-
+	// The widget keeps its shaders, G-buffer and SSAO kernel, only the model is changed
+	if (filename.size() != 0 && m_glWidget != nullptr)
+		m_glWidget->setModel(filename);
 }
 
 void SSOWindow::loadCamera(QString cam_type) {
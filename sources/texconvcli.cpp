@@ -0,0 +1,124 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+
+#include <cmath>
+#include <iostream>
+
+#include "texturecompressor.h"
+
+// Texture converter: compresses images into KTX files with their mip chain,
+// which the texturing widgets load instead of the images next to them.
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCoreApplication::setApplicationName("AG Texture Converter");
+	QCoreApplication::setOrganizationName(" ");
+	QCoreApplication::setApplicationVersion(QT_VERSION_STR);
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QCoreApplication::applicationName());
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addPositionalArgument("images", "Images to convert, each one is written next to it with the .ktx suffix", "images...");
+	QCommandLineOption formatOption("format",
+		"bc1, bc3 or bc5 (default: bc5 for normal maps, bc3 for images with alpha, bc1 otherwise)", "format");
+	parser.addOption(formatOption);
+	QCommandLineOption normalOption("normal", "Treat the images as normal maps (default: if their name contains \"normal\")");
+	parser.addOption(normalOption);
+
+	parser.process(app);
+
+	const QStringList images = parser.positionalArguments();
+	if (images.isEmpty())
+		parser.showHelp(1);
+
+	QString format = parser.value(formatOption).toLower();
+	if (!format.isEmpty() && format != "bc1" && format != "bc3" && format != "bc5") {
+		std::cerr << "Unknown format " << format.toStdString() << std::endl;
+		return 1;
+	}
+
+	int failed = 0;
+	for (int i = 0; i < images.size(); ++i) {
+		QElapsedTimer timer;
+		timer.start();
+
+		QImage image(images[i]);
+		if (image.isNull()) {
+			std::cerr << "Cannot load " << images[i].toStdString() << std::endl;
+			++failed;
+			continue;
+		}
+
+		// Bottom row first, as the widgets upload them
+		image = image.mirrored().convertToFormat(QImage::Format_RGBA8888);
+		bool normalMap = parser.isSet(normalOption) || QFileInfo(images[i]).fileName().contains("normal", Qt::CaseInsensitive);
+
+		unsigned int glFormat = TEX_FORMAT_BC1;
+		if (format == "bc3" || (format.isEmpty() && !normalMap && image.hasAlphaChannel())) {
+			// Images without any translucent texel do not need the alpha block
+			bool opaque = true;
+			for (int y = 0; y < image.height() && opaque && format.isEmpty(); ++y) {
+				const uchar *line = image.constScanLine(y);
+				for (int x = 0; x < image.width(); ++x) {
+					if (line[x * 4 + 3] != 255) {
+						opaque = false;
+						break;
+					}
+				}
+			}
+			if (!opaque || format == "bc3")
+				glFormat = TEX_FORMAT_BC3;
+		}
+		if (format == "bc5" || (format.isEmpty() && normalMap))
+			glFormat = TEX_FORMAT_BC5;
+
+		// The scan lines of a QImage are 4-byte aligned, RGBA8888 has no padding
+		std::vector<TextureLevel> chain = TextureCompressor::buildMipChain(
+			image.constBits(), image.width(), image.height(), glFormat == TEX_FORMAT_BC5);
+		CompressedTexture texture = TextureCompressor::compress(chain, glFormat);
+		double compressTime = timer.nsecsElapsed() / 1.0e6;
+
+		QFileInfo info(images[i]);
+		QString output = info.path() + "/" + info.completeBaseName() + ".ktx";
+		if (!TextureCompressor::saveKTX(output.toStdString(), texture)) {
+			++failed;
+			continue;
+		}
+
+		// Error of the first level against the image (X and Y only for normals)
+		TextureLevel decoded = TextureCompressor::decompress(texture.levels[0], glFormat);
+		int channels = glFormat == TEX_FORMAT_BC5 ? 2 : (glFormat == TEX_FORMAT_BC3 ? 4 : 3);
+		double squaredError = 0.0;
+		const uchar *texels = image.constBits();
+		for (size_t t = 0; t < decoded.data.size(); t += 4) {
+			for (int c = 0; c < channels; ++c) {
+				double e = (double)texels[t + c] - decoded.data[t + c];
+				squaredError += e * e;
+			}
+		}
+		double mse = squaredError / ((double)image.width() * image.height() * channels);
+
+		size_t compressedBytes = 0, uncompressedBytes = 0;
+		for (size_t l = 0; l < chain.size(); ++l) {
+			compressedBytes += texture.levels[l].data.size();
+			uncompressedBytes += chain[l].data.size();
+		}
+
+		const char *formatName = glFormat == TEX_FORMAT_BC1 ? "BC1" : (glFormat == TEX_FORMAT_BC3 ? "BC3" : "BC5");
+		std::cout << output.toStdString() << ": " << image.width() << "x" << image.height() << " " << formatName
+			<< ", " << chain.size() << " levels, " << compressedBytes / 1024 << " KB ("
+			<< (double)uncompressedBytes / compressedBytes << "x smaller than RGBA8), PSNR ";
+		if (mse > 0.0)
+			std::cout << 10.0 * std::log10(255.0 * 255.0 / mse) << " dB";
+		else
+			std::cout << "inf";
+		std::cout << ", " << compressTime << " ms" << std::endl;
+	}
+
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,540 @@
+#include "../headers/texturecompressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+#define GL_RGB_FORMAT 0x1907
+#define GL_RGBA_FORMAT 0x1908
+#define GL_RG_FORMAT 0x8227
+
+// KTX 1.1 header after the identifier
+struct KTXHeader {
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+// RGB 565 endpoints
+static int packColor(const float c[3])
+{
+	int r = (int)std::floor(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)std::floor(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)std::floor(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (r << 11) | (g << 5) | b;
+}
+
+static void unpackColor(int c, int rgb[3])
+{
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Four-color palette of a BC1 block (c0 > c1)
+static void colorPalette(int c0, int c1, int palette[4][3])
+{
+	unpackColor(c0, palette[0]);
+	unpackColor(c1, palette[1]);
+	for (int k = 0; k < 3; ++k) {
+		palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+		palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+	}
+}
+
+// Nearest palette entry of every texel, returns the squared error
+static int fitColorIndices(const unsigned char block[64], int c0, int c1, int indices[16])
+{
+	int palette[4][3];
+	colorPalette(c0, c1, palette);
+
+	int error = 0;
+	for (int i = 0; i < 16; ++i) {
+		int best = 0;
+		int bestDist = 1 << 30;
+		for (int p = 0; p < 4; ++p) {
+			int dr = block[i * 4] - palette[p][0];
+			int dg = block[i * 4 + 1] - palette[p][1];
+			int db = block[i * 4 + 2] - palette[p][2];
+			int dist = dr * dr + dg * dg + db * db;
+			if (dist < bestDist) {
+				bestDist = dist;
+				best = p;
+			}
+		}
+		indices[i] = best;
+		error += bestDist;
+	}
+	return error;
+}
+
+// Orders the endpoints for the four-color mode and writes the block
+static void writeColorBlock(int c0, int c1, const int indices[16], unsigned char *out)
+{
+	// Swapping the endpoints swaps 0 <-> 1 and 2 <-> 3
+	static const int swapped[4] = { 1, 0, 3, 2 };
+	bool swap = c0 < c1;
+	if (swap)
+		std::swap(c0, c1);
+
+	uint32_t bits = 0;
+	if (c0 != c1) {
+		for (int i = 0; i < 16; ++i)
+			bits |= (uint32_t)(swap ? swapped[indices[i]] : indices[i]) << (2 * i);
+	}
+
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+	for (int b = 0; b < 4; ++b)
+		out[4 + b] = (bits >> (8 * b)) & 0xFF;
+}
+
+// Texels of the 4x4 block at (bx, by), clamped at the borders
+static void fetchBlock(const TextureLevel &level, int bx, int by, unsigned char block[64])
+{
+	for (int y = 0; y < 4; ++y) {
+		int sy = std::min(by * 4 + y, level.height - 1);
+		for (int x = 0; x < 4; ++x) {
+			int sx = std::min(bx * 4 + x, level.width - 1);
+			memcpy(&block[(y * 4 + x) * 4], &level.data[(sy * level.width + sx) * 4], 4);
+		}
+	}
+}
+
+std::vector<TextureLevel> TextureCompressor::buildMipChain(const unsigned char *rgba, int width, int height, bool normalMap)
+{
+	std::vector<TextureLevel> chain(1);
+	chain[0].width = width;
+	chain[0].height = height;
+	chain[0].data.assign(rgba, rgba + (size_t)width * height * 4);
+
+	while (chain.back().width > 1 || chain.back().height > 1) {
+		const TextureLevel &src = chain.back();
+		TextureLevel dst;
+		dst.width = std::max(1, src.width / 2);
+		dst.height = std::max(1, src.height / 2);
+		dst.data.resize((size_t)dst.width * dst.height * 4);
+
+		for (int y = 0; y < dst.height; ++y) {
+			for (int x = 0; x < dst.width; ++x) {
+				// 2x2 box filter, odd sizes repeat the last row or column
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int dy = 0; dy < 2; ++dy) {
+					int sy = std::min(y * 2 + dy, src.height - 1);
+					for (int dx = 0; dx < 2; ++dx) {
+						int sx = std::min(x * 2 + dx, src.width - 1);
+						const unsigned char *texel = &src.data[(sy * src.width + sx) * 4];
+						for (int c = 0; c < 4; ++c)
+							sum[c] += normalMap && c < 3 ? texel[c] / 127.5f - 1.0f : texel[c];
+					}
+				}
+
+				unsigned char *texel = &dst.data[(y * dst.width + x) * 4];
+				if (normalMap) {
+					float len = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+					if (len < 1e-6f) {
+						sum[0] = sum[1] = 0.0f;
+						sum[2] = len = 1.0f;
+					}
+					for (int c = 0; c < 3; ++c)
+						texel[c] = (unsigned char)std::floor((sum[c] / len * 0.5f + 0.5f) * 255.0f + 0.5f);
+				}
+				else {
+					for (int c = 0; c < 3; ++c)
+						texel[c] = (unsigned char)std::floor(sum[c] / 4.0f + 0.5f);
+				}
+				texel[3] = (unsigned char)std::floor(sum[3] / 4.0f + 0.5f);
+			}
+		}
+		chain.push_back(dst);
+	}
+	return chain;
+}
+
+int TextureCompressor::levelSize(int width, int height, unsigned int glFormat)
+{
+	int blocks = ((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (glFormat == TEX_FORMAT_BC1 ? 8 : 16);
+}
+
+CompressedTexture TextureCompressor::compress(const std::vector<TextureLevel> &mipChain, unsigned int glFormat)
+{
+	CompressedTexture texture;
+	texture.glFormat = glFormat;
+	texture.glBaseFormat = glFormat == TEX_FORMAT_BC1 ? GL_RGB_FORMAT : (glFormat == TEX_FORMAT_BC3 ? GL_RGBA_FORMAT : GL_RG_FORMAT);
+
+	for (size_t l = 0; l < mipChain.size(); ++l) {
+		const TextureLevel &src = mipChain[l];
+		TextureLevel level;
+		level.width = src.width;
+		level.height = src.height;
+		level.data.resize(levelSize(src.width, src.height, glFormat));
+
+		int blocksX = (src.width + 3) / 4;
+		int blocksY = (src.height + 3) / 4;
+		unsigned char *out = level.data.data();
+		unsigned char block[64];
+		for (int by = 0; by < blocksY; ++by) {
+			for (int bx = 0; bx < blocksX; ++bx) {
+				fetchBlock(src, bx, by, block);
+				if (glFormat == TEX_FORMAT_BC1) {
+					compressColorBlock(block, out);
+					out += 8;
+				}
+				else if (glFormat == TEX_FORMAT_BC3) {
+					compressChannelBlock(block, 3, out);
+					compressColorBlock(block, out + 8);
+					out += 16;
+				}
+				else {
+					compressChannelBlock(block, 0, out);
+					compressChannelBlock(block, 1, out + 8);
+					out += 16;
+				}
+			}
+		}
+		texture.levels.push_back(level);
+	}
+	return texture;
+}
+
+void TextureCompressor::compressColorBlock(const unsigned char block[64], unsigned char *out)
+{
+	// Principal axis of the colors (power iteration on the covariance)
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i)
+		for (int k = 0; k < 3; ++k)
+			mean[k] += block[i * 4 + k] / 16.0f;
+
+	float cov[3][3] = { { 0.0f } };
+	for (int i = 0; i < 16; ++i) {
+		float d[3];
+		for (int k = 0; k < 3; ++k)
+			d[k] = block[i * 4 + k] - mean[k];
+		for (int a = 0; a < 3; ++a)
+			for (int b = 0; b < 3; ++b)
+				cov[a][b] += d[a] * d[b];
+	}
+
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int it = 0; it < 8; ++it) {
+		float next[3];
+		for (int a = 0; a < 3; ++a)
+			next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+		float len = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (len < 1e-6f)
+			break;
+		for (int a = 0; a < 3; ++a)
+			axis[a] = next[a] / len;
+	}
+
+	// Endpoints at the extremes of the projections on the axis
+	float minT = 1e30f, maxT = -1e30f;
+	for (int i = 0; i < 16; ++i) {
+		float t = 0.0f;
+		for (int k = 0; k < 3; ++k)
+			t += (block[i * 4 + k] - mean[k]) * axis[k];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	float e0[3], e1[3];
+	for (int k = 0; k < 3; ++k) {
+		e0[k] = mean[k] + axis[k] * maxT;
+		e1[k] = mean[k] + axis[k] * minT;
+	}
+
+	int c0 = packColor(e0);
+	int c1 = packColor(e1);
+	int indices[16];
+	int error = fitColorIndices(block, c0, c1, indices);
+
+	// Least squares endpoints for those indices, kept if they are better
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i) {
+		float w = weights[indices[i]];
+		aa += w * w;
+		ab += w * (1.0f - w);
+		bb += (1.0f - w) * (1.0f - w);
+		for (int k = 0; k < 3; ++k) {
+			ax[k] += w * block[i * 4 + k];
+			bx[k] += (1.0f - w) * block[i * 4 + k];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::fabs(det) > 1e-6f) {
+		for (int k = 0; k < 3; ++k) {
+			e0[k] = (ax[k] * bb - bx[k] * ab) / det;
+			e1[k] = (bx[k] * aa - ax[k] * ab) / det;
+		}
+		int r0 = packColor(e0);
+		int r1 = packColor(e1);
+		int refined[16];
+		int refinedError = fitColorIndices(block, r0, r1, refined);
+		if (refinedError < error) {
+			c0 = r0;
+			c1 = r1;
+			memcpy(indices, refined, sizeof(indices));
+		}
+	}
+
+	writeColorBlock(c0, c1, indices, out);
+}
+
+void TextureCompressor::compressChannelBlock(const unsigned char block[64], int channel, unsigned char *out)
+{
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; ++i) {
+		a0 = std::max(a0, (int)block[i * 4 + channel]);
+		a1 = std::min(a1, (int)block[i * 4 + channel]);
+	}
+
+	// Eight-value mode (a0 > a1): codes 2..7 go from a0 to a1
+	int values[8];
+	values[0] = a0;
+	values[1] = a1;
+	for (int k = 2; k < 8; ++k)
+		values[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+
+	uint64_t bits = 0;
+	if (a0 != a1) {
+		for (int i = 0; i < 16; ++i) {
+			int v = block[i * 4 + channel];
+			int best = 0;
+			for (int k = 1; k < 8; ++k) {
+				if (std::abs(values[k] - v) < std::abs(values[best] - v))
+					best = k;
+			}
+			bits |= (uint64_t)best << (3 * i);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int b = 0; b < 6; ++b)
+		out[2 + b] = (bits >> (8 * b)) & 0xFF;
+}
+
+TextureLevel TextureCompressor::decompress(const TextureLevel &level, unsigned int glFormat)
+{
+	TextureLevel rgba;
+	rgba.width = level.width;
+	rgba.height = level.height;
+	rgba.data.resize((size_t)level.width * level.height * 4);
+
+	int blocksX = (level.width + 3) / 4;
+	int blocksY = (level.height + 3) / 4;
+	const unsigned char *in = level.data.data();
+	unsigned char block[64];
+	for (int by = 0; by < blocksY; ++by) {
+		for (int bx = 0; bx < blocksX; ++bx) {
+			if (glFormat == TEX_FORMAT_BC1) {
+				decompressColorBlock(in, true, block);
+				in += 8;
+			}
+			else if (glFormat == TEX_FORMAT_BC3) {
+				decompressColorBlock(in + 8, false, block);
+				decompressChannelBlock(in, 3, block);
+				in += 16;
+			}
+			else {
+				decompressChannelBlock(in, 0, block);
+				decompressChannelBlock(in + 8, 1, block);
+				for (int i = 0; i < 16; ++i) {
+					float x = block[i * 4] / 127.5f - 1.0f;
+					float y = block[i * 4 + 1] / 127.5f - 1.0f;
+					float z = std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+					block[i * 4 + 2] = (unsigned char)std::floor((z * 0.5f + 0.5f) * 255.0f + 0.5f);
+					block[i * 4 + 3] = 255;
+				}
+				in += 16;
+			}
+
+			for (int y = 0; y < 4 && by * 4 + y < level.height; ++y) {
+				for (int x = 0; x < 4 && bx * 4 + x < level.width; ++x) {
+					size_t dst = ((size_t)(by * 4 + y) * level.width + bx * 4 + x) * 4;
+					memcpy(&rgba.data[dst], &block[(y * 4 + x) * 4], 4);
+				}
+			}
+		}
+	}
+	return rgba;
+}
+
+void TextureCompressor::decompressColorBlock(const unsigned char *in, bool threeColorMode, unsigned char block[64])
+{
+	int c0 = in[0] | (in[1] << 8);
+	int c1 = in[2] | (in[3] << 8);
+	uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+
+	int palette[4][3];
+	int alpha[4] = { 255, 255, 255, 255 };
+	colorPalette(c0, c1, palette);
+	if (threeColorMode && c0 <= c1) {
+		// Third color halfway, the fourth one is transparent black
+		for (int k = 0; k < 3; ++k) {
+			palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+			palette[3][k] = 0;
+		}
+		alpha[3] = 0;
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		int index = (bits >> (2 * i)) & 3;
+		block[i * 4] = (unsigned char)palette[index][0];
+		block[i * 4 + 1] = (unsigned char)palette[index][1];
+		block[i * 4 + 2] = (unsigned char)palette[index][2];
+		block[i * 4 + 3] = (unsigned char)alpha[index];
+	}
+}
+
+void TextureCompressor::decompressChannelBlock(const unsigned char *in, int channel, unsigned char block[64])
+{
+	int a0 = in[0];
+	int a1 = in[1];
+	uint64_t bits = 0;
+	for (int b = 0; b < 6; ++b)
+		bits |= (uint64_t)in[2 + b] << (8 * b);
+
+	int values[8];
+	values[0] = a0;
+	values[1] = a1;
+	if (a0 > a1) {
+		for (int k = 2; k < 8; ++k)
+			values[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+	}
+	else {
+		// Six-value mode with explicit 0 and 255
+		for (int k = 2; k < 6; ++k)
+			values[k] = ((6 - k) * a0 + (k - 1) * a1) / 5;
+		values[6] = 0;
+		values[7] = 255;
+	}
+
+	for (int i = 0; i < 16; ++i)
+		block[i * 4 + channel] = (unsigned char)values[(bits >> (3 * i)) & 7];
+}
+
+bool TextureCompressor::saveKTX(const std::string &filename, const CompressedTexture &texture)
+{
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		std::cerr << "Cannot open " << filename << " for writing" << std::endl;
+		return false;
+	}
+
+	// The rows are stored bottom first
+	static const char orientation[] = "KTXorientation\0S=r,T=u";
+	uint32_t keyValueSize = sizeof(orientation);
+	uint32_t keyValuePadding = 3 - ((keyValueSize + 3) % 4);
+
+	KTXHeader header;
+	header.endianness = KTX_ENDIANNESS;
+	header.glType = 0;
+	header.glTypeSize = 1;
+	header.glFormat = 0;
+	header.glInternalFormat = texture.glFormat;
+	header.glBaseInternalFormat = texture.glBaseFormat;
+	header.pixelWidth = texture.levels[0].width;
+	header.pixelHeight = texture.levels[0].height;
+	header.pixelDepth = 0;
+	header.numberOfArrayElements = 0;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = (uint32_t)texture.levels.size();
+	header.bytesOfKeyValueData = 4 + keyValueSize + keyValuePadding;
+
+	static const char padding[4] = { 0, 0, 0, 0 };
+	file.write((const char*)KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)&keyValueSize, 4);
+	file.write(orientation, keyValueSize);
+	file.write(padding, keyValuePadding);
+
+	// Block sizes are multiples of 4, no mip padding is needed
+	for (size_t l = 0; l < texture.levels.size(); ++l) {
+		uint32_t imageSize = (uint32_t)texture.levels[l].data.size();
+		file.write((const char*)&imageSize, 4);
+		file.write((const char*)texture.levels[l].data.data(), imageSize);
+	}
+
+	return file.good();
+}
+
+bool TextureCompressor::loadKTX(const std::string &filename, CompressedTexture &texture)
+{
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		std::cerr << "Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	unsigned char identifier[12];
+	KTXHeader header;
+	file.read((char*)identifier, sizeof(identifier));
+	file.read((char*)&header, sizeof(header));
+	if (!file || memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0) {
+		std::cerr << filename << " is not a KTX file" << std::endl;
+		return false;
+	}
+	if (header.endianness != KTX_ENDIANNESS) {
+		std::cerr << filename << ": only little-endian KTX files are supported" << std::endl;
+		return false;
+	}
+	if (header.glType != 0 ||
+		(header.glInternalFormat != TEX_FORMAT_BC1 && header.glInternalFormat != TEX_FORMAT_BC3 && header.glInternalFormat != TEX_FORMAT_BC5) ||
+		header.pixelDepth > 1 || header.numberOfArrayElements > 0 || header.numberOfFaces != 1 ||
+		header.numberOfMipmapLevels == 0) {
+		std::cerr << filename << ": only 2D BC1, BC3 and BC5 textures with their mipmaps are supported" << std::endl;
+		return false;
+	}
+
+	file.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+	texture.glFormat = header.glInternalFormat;
+	texture.glBaseFormat = header.glBaseInternalFormat;
+	texture.levels.resize(header.numberOfMipmapLevels);
+	for (uint32_t l = 0; l < header.numberOfMipmapLevels; ++l) {
+		TextureLevel &level = texture.levels[l];
+		level.width = std::max(1, (int)(header.pixelWidth >> l));
+		level.height = std::max(1, (int)(header.pixelHeight >> l));
+
+		uint32_t imageSize = 0;
+		file.read((char*)&imageSize, 4);
+		if (!file || (int)imageSize != levelSize(level.width, level.height, texture.glFormat)) {
+			std::cerr << filename << ": wrong size of mip level " << l << std::endl;
+			texture.levels.clear();
+			return false;
+		}
+		level.data.resize(imageSize);
+		file.read((char*)level.data.data(), imageSize);
+	}
+
+	if (!file) {
+		std::cerr << filename << " is truncated" << std::endl;
+		texture.levels.clear();
+		return false;
+	}
+	return true;
+}
@@ -24,6 +24,7 @@ TexturingWindow::TexturingWindow(MainWindow* mw) :m_mainWindow(mw)
 	connect(m_ui.qDeleteTex1Button, SIGNAL(clicked()), this, SLOT(deleteTex1()));
 	connect(m_ui.qLoadTex2Button, SIGNAL(clicked()), this, SLOT(loadTex2()));
 	connect(m_ui.qDeleteTex2Button, SIGNAL(clicked()), this, SLOT(deleteTex2()));
+	connect(m_glWidget, SIGNAL(textureDecoded(int, const QImage&)), this, SLOT(showTexture(int, const QImage&)));
 }
 
 TexturingWindow::~TexturingWindow()
@@ -95,14 +96,8 @@ void TexturingWindow::loadTex1()
 		"./textures/", tr("*.png;;*.jpg *.jpeg;;*.bmp;;*.gif;;*.pbm *.pgm *.ppm;;*.xbm *.xpm;;All files (*.*)"));
 
 	if (m_filenameTex1.size() != 0) {
+		// The preview is shown by showTexture() once the image is decoded
 		m_glWidget->loadTex1Texture(m_filenameTex1);
-
-		QGraphicsScene* texture = new QGraphicsScene();
-		texture->addPixmap(m_filenameTex1);
-		m_ui.qTex1View->setScene(texture);
-		m_ui.qTex1View->fitInView(texture->itemsBoundingRect());
-		m_ui.qTex1View->setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
-		m_ui.qTex1View->show();
 	}
 }
 
@@ -127,14 +122,8 @@ void TexturingWindow::loadTex2()
 		"./textures/", tr("*.png;;*.jpg *.jpeg;;*.bmp;;*.gif;;*.pbm *.pgm *.ppm;;*.xbm *.xpm;;All files (*.*)"));
 
 	if (m_filenameTex2.size() != 0) {
+		// The preview is shown by showTexture() once the image is decoded
 		m_glWidget->loadTex2Texture(m_filenameTex2);
-
-		QGraphicsScene* texture = new QGraphicsScene();
-		texture->addPixmap(m_filenameTex2);
-		m_ui.qTex2View->setScene(texture);
-		m_ui.qTex2View->fitInView(texture->itemsBoundingRect());
-		m_ui.qTex2View->setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
-		m_ui.qTex2View->show();
 	}
 }
 
@@ -151,4 +140,17 @@ void TexturingWindow::deleteTex2()
 	m_ui.qTex2View->show();
 
 	m_filenameTex2.clear();
-}
\ No newline at end of file
+}
+
+void TexturingWindow::showTexture(int slot, const QImage &image)
+{
+	QGraphicsView* view = (slot == 1) ? m_ui.qTex1View : m_ui.qTex2View;
+
+	// The decoded image is flipped for GL
+	QGraphicsScene* texture = new QGraphicsScene();
+	texture->addPixmap(QPixmap::fromImage(image.mirrored()));
+	view->setScene(texture);
+	view->fitInView(texture->itemsBoundingRect());
+	view->setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+	view->show();
+}
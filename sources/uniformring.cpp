@@ -0,0 +1,146 @@
+#include "uniformring.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "../glm/gtc/matrix_inverse.hpp"
+
+ObjectUniforms::ObjectUniforms(const glm::mat4 &model, const glm::mat4 &view)
+{
+	sceneTransform = model;
+	modelViewTransform = view * model;
+	glm::mat3 normal = glm::inverseTranspose(glm::mat3(modelViewTransform));
+	for (int c = 0; c < 3; ++c)
+		normalMatrix[c] = glm::vec4(normal[c], 0.0f);
+}
+
+UniformRing::UniformRing()
+{
+	m_ubo = 0;
+	m_persistentPtr = nullptr;
+	m_alignment = 256;
+	for (int i = 0; i < UNIFORM_RING_FRAMES; ++i)
+		m_fences[i] = 0;
+	m_segment = 0;
+	m_offset = 0;
+	m_overflowReported = false;
+}
+
+void UniformRing::initializeGL()
+{
+	initializeOpenGLFunctions();
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_alignment);
+
+	// Persistent mapping (core since 4.4)
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+	BufferStorageProc bufferStorage = nullptr;
+	if (context->format().version() >= qMakePair(4, 4) ||
+		context->hasExtension(QByteArrayLiteral("GL_ARB_buffer_storage")))
+		bufferStorage = reinterpret_cast<BufferStorageProc>(context->getProcAddress("glBufferStorage"));
+
+	GLsizeiptr size = (GLsizeiptr)UNIFORM_RING_FRAMES * UNIFORM_RING_FRAME_SIZE;
+	glGenBuffers(1, &m_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+	if (bufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+		m_persistentPtr = (uchar*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+	}
+	else {
+		glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	m_segment = 0;
+	m_offset = 0;
+}
+
+void UniformRing::cleanup()
+{
+	for (int i = 0; i < UNIFORM_RING_FRAMES; ++i) {
+		if (m_fences[i])
+			glDeleteSync(m_fences[i]);
+		m_fences[i] = 0;
+	}
+
+	if (m_ubo == 0)
+		return;
+
+	if (m_persistentPtr) {
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_persistentPtr = nullptr;
+	}
+	glDeleteBuffers(1, &m_ubo);
+	m_ubo = 0;
+}
+
+void UniformRing::bindBlocks(GLuint program)
+{
+	// GLSL 3.30 has no binding layout qualifier
+	GLuint frame = glGetUniformBlockIndex(program, "Frame");
+	if (frame != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frame, UBO_FRAME_BINDING);
+	GLuint object = glGetUniformBlockIndex(program, "Object");
+	if (object != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, object, UBO_OBJECT_BINDING);
+}
+
+void UniformRing::beginFrame()
+{
+	m_segment = (m_segment + 1) % UNIFORM_RING_FRAMES;
+	waitSegment(m_segment);
+	m_offset = 0;
+}
+
+void UniformRing::endFrame()
+{
+	if (m_fences[m_segment])
+		glDeleteSync(m_fences[m_segment]);
+	m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformRing::waitSegment(int segment)
+{
+	GLsync &fence = m_fences[segment];
+	if (!fence)
+		return;
+
+	// Only blocks when the CPU is UNIFORM_RING_FRAMES frames ahead
+	while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+void UniformRing::bind(GLuint binding, const void *data, GLsizeiptr size)
+{
+	GLintptr offset = (m_offset + m_alignment - 1) / m_alignment * m_alignment;
+	if (offset + size > UNIFORM_RING_FRAME_SIZE) {
+		// More draws than a segment holds: this frame goes on in the next one
+		if (!m_overflowReported) {
+			std::cout << "-- AGEn message --: Uniform ring segment full, waiting for the GPU" << std::endl;
+			m_overflowReported = true;
+		}
+		endFrame();
+		beginFrame();
+		offset = 0;
+	}
+	m_offset = offset + size;
+
+	GLintptr bufferOffset = (GLintptr)m_segment * UNIFORM_RING_FRAME_SIZE + offset;
+	glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+	if (m_persistentPtr) {
+		memcpy(m_persistentPtr + bufferOffset, data, size);
+	}
+	else {
+		// The segment is not used by the GPU anymore, it can be written without sync
+		void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, bufferOffset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		memcpy(dst, data, size);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_ubo, bufferOffset, size);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,117 @@
+#include "../headers/vertexquantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+void VertexQuantizer::quantizePosition(const float p[3], const float boxMin[3], const float boxMax[3], unsigned short q[3])
+{
+	for (int j = 0; j < 3; ++j) {
+		float extent = boxMax[j] - boxMin[j];
+		float t = extent > 0.0f ? (p[j] - boxMin[j]) / extent : 0.0f;
+		q[j] = (unsigned short)std::lround(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f);
+	}
+}
+
+void VertexQuantizer::dequantizePosition(const unsigned short q[3], const float boxMin[3], const float boxMax[3], float p[3])
+{
+	// As the vertex shaders do: the normalized fetch, then the box
+	for (int j = 0; j < 3; ++j)
+		p[j] = boxMin[j] + (q[j] / 65535.0f) * (boxMax[j] - boxMin[j]);
+}
+
+void VertexQuantizer::encodeOctahedral(const float n[3], short e[2])
+{
+	float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+	if (l1 == 0.0f) {
+		e[0] = e[1] = 0;
+		return;
+	}
+
+	// Onto the octahedron, the lower half folded over the upper one
+	float x = n[0] / l1;
+	float y = n[1] / l1;
+	if (n[2] < 0.0f) {
+		float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	e[0] = (short)std::lround(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f);
+	e[1] = (short)std::lround(std::min(std::max(y, -1.0f), 1.0f) * 32767.0f);
+}
+
+void VertexQuantizer::decodeOctahedral(const short e[2], float n[3])
+{
+	float x = std::max(e[0] / 32767.0f, -1.0f);
+	float y = std::max(e[1] / 32767.0f, -1.0f);
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+	if (z < 0.0f) {
+		float ux = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float uy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = ux;
+		y = uy;
+	}
+	float length = std::sqrt(x * x + y * y + z * z);
+	n[0] = x / length;
+	n[1] = y / length;
+	n[2] = z / length;
+}
+
+unsigned short VertexQuantizer::toHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int floatExponent = (bits >> 23) & 0xff;
+	unsigned int mantissa = bits & 0x7fffff;
+
+	// Infinity and NaN
+	if (floatExponent == 0xff)
+		return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+	int exponent = (int)floatExponent - 127 + 15;
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7c00);
+
+	// Denormals of the half float, zero under them
+	if (exponent <= 0) {
+		if (exponent < -10)
+			return (unsigned short)sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int rest = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			++half;
+		return (unsigned short)(sign | half);
+	}
+
+	// A carry out of the mantissa goes into the exponent, as it should
+	unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+	unsigned int rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		++half;
+	return (unsigned short)half;
+}
+
+float VertexQuantizer::fromHalf(unsigned short half)
+{
+	unsigned int exponent = (half >> 10) & 0x1f;
+	unsigned int mantissa = half & 0x3ff;
+	float value;
+	if (exponent == 0)
+		value = std::ldexp((float)mantissa, -24);
+	else if (exponent == 31)
+		value = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+	else
+		value = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+	return (half & 0x8000) ? -value : value;
+}
+
+unsigned char VertexQuantizer::toUnorm8(float value)
+{
+	return (unsigned char)std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+}